@@ -0,0 +1,71 @@
+#pragma once
+#include "myLib/ThreadPool.h"
+#include <cstdint>
+
+/// <summary>
+/// カーネルに渡されるスレッドID
+/// HLSLのシステム値セマンティクスに対応する
+/// </summary>
+struct ComputeThreadID
+{
+	uint32_t groupID;			//SV_GroupID.x
+	uint32_t groupThreadID;		//SV_GroupThreadID.x
+	uint32_t dispatchThreadID;	//SV_DispatchThreadID.x
+};
+
+/// <summary>
+/// Dispatch(groupCount, threadsPerGroup)をCPUで実行するバックエンド
+/// グループ単位でスレッドプールに分配し，グループ内のスレッドは順番に実行する
+/// 1回のDispatchの完了はUAVバリアに相当する
+/// </summary>
+class ComputeDispatcher
+{
+public:
+	/// <param name="_threadPool">グループを分配するスレッドプール nullptrなら呼び出し元だけで実行</param>
+	explicit ComputeDispatcher(ThreadPool* _threadPool = nullptr) : threadPool(_threadPool) {}
+
+	/// <summary>
+	/// カーネルを実行する
+	/// </summary>
+	/// <param name="_groupCount">スレッドグループ数</param>
+	/// <param name="_threadsPerGroup">1グループあたりのスレッド数 ([numthreads(x,1,1)])</param>
+	/// <param name="_kernel">void(const ComputeThreadID&)</param>
+	template <class Kernel>
+	void Dispatch(uint32_t _groupCount, uint32_t _threadsPerGroup, const Kernel& _kernel)
+	{
+		auto runGroup = [&](uint32_t _groupID)
+			{
+				ComputeThreadID id{};
+				id.groupID = _groupID;
+				for (uint32_t thread = 0; thread < _threadsPerGroup; thread++)
+				{
+					id.groupThreadID = thread;
+					id.dispatchThreadID = _groupID * _threadsPerGroup + thread;
+					_kernel(id);
+				}
+			};
+
+		if (threadPool == nullptr)
+		{
+			for (uint32_t group = 0; group < _groupCount; group++)
+			{
+				runGroup(group);
+			}
+			return;
+		}
+		threadPool->ParallelFor(_groupCount, runGroup);
+	}
+
+	/// <summary>
+	/// スレッド数を満たすのに必要なグループ数
+	/// </summary>
+	static uint32_t CalculateGroupCount(uint32_t _threadCount, uint32_t _threadsPerGroup)
+	{
+		return (_threadCount + _threadsPerGroup - 1) / _threadsPerGroup;
+	}
+
+	ThreadPool* GetThreadPool() const { return threadPool; }
+
+private:
+	ThreadPool* threadPool;
+};
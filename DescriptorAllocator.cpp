@@ -0,0 +1,136 @@
+#include "DescriptorAllocator.h"
+#include <algorithm>
+#include <iterator>
+
+DescriptorAllocator::DescriptorAllocator(uint32_t _capacity, uint32_t _persistentCount, uint32_t _maxFramesInFlight) :
+	capacity(_capacity),
+	persistentCount(_persistentCount),
+	transientCount(_capacity - _persistentCount),
+	transientHead(0),
+	transientTail(0),
+	pendingFrames(_maxFramesInFlight),
+	pendingFirst(0),
+	pendingCount(0)
+{
+	assert(_persistentCount <= _capacity);
+	assert(0 < _maxFramesInFlight);
+	if (0 < _persistentCount)
+	{
+		freeRanges.push_back({ 0, _persistentCount });
+	}
+}
+
+uint32_t DescriptorAllocator::Allocate(uint32_t _count)
+{
+	assert(0 < _count);
+	for (size_t range = 0; range < freeRanges.size(); range++)
+	{
+		FreeRange& freeRange = freeRanges[range];
+		if (freeRange.count < _count)
+		{
+			continue;
+		}
+		uint32_t index = freeRange.index;
+		freeRange.index += _count;
+		freeRange.count -= _count;
+		if (freeRange.count == 0)
+		{
+			freeRanges.erase(freeRanges.begin() + range);
+		}
+		return index;
+	}
+	return kInvalidDescriptorIndex;
+}
+
+void DescriptorAllocator::Free(uint32_t _index, uint32_t _count)
+{
+	assert(0 < _count);
+	assert(_index + _count <= persistentCount);
+
+	//後ろの空き範囲
+	auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), _index,
+		[](const FreeRange& _range, uint32_t _value) { return _range.index < _value; });
+	//二重に解放していないか (空き範囲と重なっていないか)
+	assert(next == freeRanges.end() || _index + _count <= next->index);
+	assert(next == freeRanges.begin() || std::prev(next)->index + std::prev(next)->count <= _index);
+
+	bool mergePrevious = next != freeRanges.begin() && std::prev(next)->index + std::prev(next)->count == _index;
+	bool mergeNext = next != freeRanges.end() && _index + _count == next->index;
+	if (mergePrevious && mergeNext)
+	{
+		std::prev(next)->count += _count + next->count;
+		freeRanges.erase(next);
+	}
+	else if (mergePrevious)
+	{
+		std::prev(next)->count += _count;
+	}
+	else if (mergeNext)
+	{
+		next->index = _index;
+		next->count += _count;
+	}
+	else
+	{
+		freeRanges.insert(next, { _index, _count });
+	}
+}
+
+void DescriptorAllocator::BeginFrame(uint64_t _completedFenceValue)
+{
+	while (0 < pendingCount && pendingFrames[pendingFirst].fenceValue <= _completedFenceValue)
+	{
+		transientTail = pendingFrames[pendingFirst].end;
+		pendingFirst = (pendingFirst + 1) % pendingFrames.size();
+		pendingCount--;
+	}
+}
+
+uint32_t DescriptorAllocator::AllocateTransient(uint32_t _count)
+{
+	assert(0 < _count);
+	if (transientCount == 0)
+	{
+		return kInvalidDescriptorIndex;
+	}
+	uint64_t offset = transientHead % transientCount;
+	//終端をまたぐ分は余りとして捨てて先頭から切り出す
+	uint64_t padding = transientCount < offset + _count ? transientCount - offset : 0;
+	if (transientCount < transientHead + padding + _count - transientTail)
+	{
+		return kInvalidDescriptorIndex;
+	}
+
+	transientHead += padding;
+	offset = transientHead % transientCount;
+	transientHead += _count;
+	return persistentCount + static_cast<uint32_t>(offset);
+}
+
+void DescriptorAllocator::EndFrame(uint64_t _fenceValue)
+{
+	assert(pendingCount < pendingFrames.size());
+	const uint32_t last = static_cast<uint32_t>((pendingFirst + pendingCount) % pendingFrames.size());
+	pendingFrames[last] = { _fenceValue, transientHead };
+	pendingCount++;
+}
+
+uint32_t DescriptorAllocator::GetFreeCount() const
+{
+	uint32_t count = 0;
+	for (const FreeRange& range : freeRanges)
+	{
+		count += range.count;
+	}
+	return count;
+}
+
+uint32_t DescriptorAllocator::GetLargestFreeRange() const
+{
+	uint32_t count = 0;
+	for (const FreeRange& range : freeRanges)
+	{
+		count = (std::max)(count, range.count);
+	}
+	return count;
+}
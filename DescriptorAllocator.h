@@ -0,0 +1,92 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+//確保できなかったことを表すディスクリプタ番号
+static const uint32_t kInvalidDescriptorIndex = UINT32_MAX;
+
+/// <summary>
+/// ディスクリプタヒープの番号を管理する ヒープには触れないので，番号からハンドルを作るのは呼び出し側
+/// 先頭の_persistentCount個は長く使うもの (テクスチャなど) で，空き範囲のリストから連続した範囲を切り出し，解放すると隣の空きとつなげる
+/// 残りはフレームごとに使い捨てるもので，リングとして切り出し，GPUが終えたフレームの分から使い直す
+/// </summary>
+class DescriptorAllocator
+{
+public:
+	/// <param name="_capacity">ヒープのディスクリプタ数</param>
+	/// <param name="_persistentCount">長く使う領域の数 残りがフレームごとの領域になる</param>
+	/// <param name="_maxFramesInFlight">GPUが処理中でも記録しておけるフレーム数</param>
+	DescriptorAllocator(uint32_t _capacity, uint32_t _persistentCount, uint32_t _maxFramesInFlight);
+
+	/// <summary>
+	/// 連続した_count個を切り出す 空き範囲の中で最も番号の小さいものから使う
+	/// </summary>
+	/// <returns>先頭の番号 足りなければkInvalidDescriptorIndex</returns>
+	uint32_t Allocate(uint32_t _count = 1);
+	/// <summary>
+	/// Allocateで切り出した範囲を返す 一部だけ返してもよい
+	/// GPUが使い終えてから呼ぶこと
+	/// </summary>
+	void Free(uint32_t _index, uint32_t _count = 1);
+
+	/// <summary>
+	/// フレームの始めに呼ぶ GPUが_completedFenceValueまで終えたフレームの一時的なディスクリプタを空ける
+	/// </summary>
+	void BeginFrame(uint64_t _completedFenceValue);
+	/// <summary>
+	/// このフレームだけ使う連続した_count個を切り出す 終端をまたぐときは領域の先頭に戻る
+	/// </summary>
+	/// <returns>先頭の番号 足りなければkInvalidDescriptorIndex</returns>
+	uint32_t AllocateTransient(uint32_t _count = 1);
+	/// <summary>
+	/// フレームの終わりに呼ぶ このフレームで切り出した一時的なディスクリプタは_fenceValueが終わるまで使わない
+	/// </summary>
+	void EndFrame(uint64_t _fenceValue);
+
+	uint32_t GetCapacity() const { return capacity; }
+	uint32_t GetPersistentCount() const { return persistentCount; }
+	/// <summary>
+	/// 長く使う領域の空き数の合計
+	/// </summary>
+	uint32_t GetFreeCount() const;
+	/// <summary>
+	/// 長く使う領域で1回に切り出せる最大数
+	/// </summary>
+	uint32_t GetLargestFreeRange() const;
+	/// <summary>
+	/// GPUが使っているかもしれない一時的なディスクリプタの数 (終端の余りも含む)
+	/// </summary>
+	uint32_t GetTransientUsedCount() const { return static_cast<uint32_t>(transientHead - transientTail); }
+
+private:
+	/// <summary>
+	/// 空いている範囲 番号順に並べて持つ
+	/// </summary>
+	struct FreeRange
+	{
+		uint32_t index;
+		uint32_t count;
+	};
+
+	/// <summary>
+	/// GPUの処理を待っているフレーム
+	/// </summary>
+	struct PendingFrame
+	{
+		uint64_t fenceValue;
+		uint64_t end;		//このフレームの終わりのtransientHead
+	};
+
+	uint32_t capacity;
+	uint32_t persistentCount;
+	std::vector<FreeRange> freeRanges;
+
+	uint32_t transientCount;
+	//どちらも通算の数 一時的な領域内の位置はtransientCountで割った余り
+	uint64_t transientHead;
+	uint64_t transientTail;
+	std::vector<PendingFrame> pendingFrames;	//リングとして使う
+	uint32_t pendingFirst;
+	uint32_t pendingCount;
+};
@@ -0,0 +1,158 @@
+#include "EmitterSystem.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+EmitterSystem::EmitterSystem(float _tickTime)
+{
+	assert(_tickTime > 0.0f);
+	tickTime = _tickTime;
+	accumulatedTime = 0.0f;
+	currentTick = 0;
+	cullDistance = 100.0f;
+	particleBudget = UINT32_MAX;
+	stats = {};
+}
+
+uint32_t EmitterSystem::AddEmitter(const EmitterDesc& _desc)
+{
+	uint32_t emitter;
+	if (!freeList.empty())
+	{
+		emitter = freeList.back();
+		freeList.pop_back();
+	}
+	else
+	{
+		emitter = static_cast<uint32_t>(translates.size());
+		translates.emplace_back();
+		counts.emplace_back();
+		intervalTicks.emplace_back();
+		boundsRadii.emplace_back();
+		priorities.emplace_back();
+		fireTicks.emplace_back();
+		generations.emplace_back(0u);
+		isActive.emplace_back(uint8_t(0));
+	}
+
+	translates[emitter] = _desc.translate;
+	counts[emitter] = _desc.count;
+	intervalTicks[emitter] = (std::max)(1u, static_cast<uint32_t>(std::lround(_desc.frequency / tickTime)));
+	boundsRadii[emitter] = _desc.boundsRadius;
+	priorities[emitter] = _desc.priority;
+	isActive[emitter] = 1;
+	stats.activeEmitters++;
+
+	Schedule(emitter, currentTick + intervalTicks[emitter]);
+	return emitter;
+}
+
+void EmitterSystem::RemoveEmitter(uint32_t _emitter)
+{
+	assert(_emitter < isActive.size() && isActive[_emitter]);
+	isActive[_emitter] = 0;
+	//ホイールに残っている登録はProcessTickで捨てる
+	generations[_emitter]++;
+	freeList.push_back(_emitter);
+	stats.activeEmitters--;
+}
+
+void EmitterSystem::Update(float _deltaTime, const Frustum& _frustum, const Vector3& _cameraPosition, uint32_t _aliveParticles, std::vector<EmitRequest>& _requests)
+{
+	_requests.clear();
+	dueRequests.clear();
+	stats.dueEmitters = 0;
+	stats.culledEmitters = 0;
+	stats.throttledEmitters = 0;
+	stats.emittedParticles = 0;
+
+	accumulatedTime += _deltaTime;
+	//止まっていた場合などに一度に回しすぎない
+	uint32_t tickCount = 0;
+	while (accumulatedTime >= tickTime && tickCount < kWheelSize)
+	{
+		accumulatedTime -= tickTime;
+		currentTick++;
+		tickCount++;
+		ProcessTick(_frustum, _cameraPosition);
+	}
+	if (tickCount == kWheelSize)
+	{
+		accumulatedTime = 0.0f;
+	}
+
+	//予算の割り振り
+	uint32_t available = particleBudget > _aliveParticles ? particleBudget - _aliveParticles : 0;
+	uint64_t requested = 0;
+	for (const EmitRequest& request : dueRequests)
+	{
+		requested += request.count;
+	}
+	if (available < requested)
+	{
+		std::stable_sort(dueRequests.begin(), dueRequests.end(), [this](const EmitRequest& _a, const EmitRequest& _b)
+			{
+				return priorities[_a.emitter] > priorities[_b.emitter];
+			});
+	}
+
+	for (const EmitRequest& request : dueRequests)
+	{
+		uint32_t count = (std::min)(request.count, available);
+		if (count == 0)
+		{
+			stats.throttledEmitters++;
+			continue;
+		}
+		available -= count;
+		stats.emittedParticles += count;
+		_requests.push_back({ request.emitter, count });
+	}
+}
+
+void EmitterSystem::Schedule(uint32_t _emitter, uint64_t _tick)
+{
+	fireTicks[_emitter] = _tick;
+	wheel[_tick % kWheelSize].push_back({ _emitter, generations[_emitter] });
+}
+
+void EmitterSystem::ProcessTick(const Frustum& _frustum, const Vector3& _cameraPosition)
+{
+	std::vector<WheelEntry>& slot = wheel[currentTick % kWheelSize];
+
+	//間隔がホイールの周期の倍数だと同じ目盛りに入るので，再登録は走査の後で行う
+	rescheduled.clear();
+	size_t keep = 0;
+	for (size_t index = 0; index < slot.size(); index++)
+	{
+		WheelEntry entry = slot[index];
+		if (!isActive[entry.emitter] || generations[entry.emitter] != entry.generation)
+		{
+			continue;
+		}
+		if (fireTicks[entry.emitter] != currentTick)
+		{
+			//まだ先の周回
+			slot[keep++] = entry;
+			continue;
+		}
+
+		stats.dueEmitters++;
+		rescheduled.push_back(entry.emitter);
+
+		Sphere bounds{ translates[entry.emitter], boundsRadii[entry.emitter] };
+		float distance = Length(bounds.center - _cameraPosition) - bounds.radius;
+		if (cullDistance < distance || !IsCollision(_frustum, bounds))
+		{
+			stats.culledEmitters++;
+			continue;
+		}
+		dueRequests.push_back({ entry.emitter, counts[entry.emitter] });
+	}
+	slot.resize(keep);
+
+	for (uint32_t emitter : rescheduled)
+	{
+		Schedule(emitter, currentTick + intervalTicks[emitter]);
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "myLib/MyLib.h"
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// エミッター登録時の設定
+/// </summary>
+struct EmitterDesc
+{
+	Vector3 translate;		//位置
+	uint32_t count;			//1回の発生数
+	float frequency;		//発生間隔(秒)
+	float boundsRadius;		//発生範囲を包む球の半径 カリングに使う
+	uint32_t priority;		//予算が足りないときは大きいものから発生させる
+};
+
+/// <summary>
+/// 発生させるべきエミッターと発生数
+/// </summary>
+struct EmitRequest
+{
+	uint32_t emitter;
+	uint32_t count;
+};
+
+/// <summary>
+/// エミッターの統計 (デバッグ表示用)
+/// </summary>
+struct EmitterStats
+{
+	uint32_t activeEmitters;	//登録中のエミッター数
+	uint32_t dueEmitters;		//今回発生時刻を迎えたエミッター数
+	uint32_t culledEmitters;	//視錐台外・距離外で発生を見送った数
+	uint32_t throttledEmitters;	//予算不足で発生を見送った数
+	uint32_t emittedParticles;	//今回発生させたパーティクル数
+};
+
+/// <summary>
+/// 大量のエミッターの発生タイミングを管理する
+/// 状態はSoAで持ち，タイミングホイールで発生時刻を迎えたものだけを調べる
+/// </summary>
+class EmitterSystem
+{
+public:
+	/// <param name="_tickTime">ホイールの1目盛りの時間</param>
+	explicit EmitterSystem(float _tickTime = 1.0f / 60.0f);
+
+	/// <summary>
+	/// エミッターを登録する
+	/// </summary>
+	/// <returns>エミッター番号</returns>
+	uint32_t AddEmitter(const EmitterDesc& _desc);
+	void RemoveEmitter(uint32_t _emitter);
+
+	void SetTranslate(uint32_t _emitter, const Vector3& _translate) { translates[_emitter] = _translate; }
+	const Vector3& GetTranslate(uint32_t _emitter) const { return translates[_emitter]; }
+
+	/// <summary>
+	/// カメラからこれ以上離れたエミッターは発生させない
+	/// </summary>
+	void SetCullDistance(float _distance) { cullDistance = _distance; }
+	/// <summary>
+	/// 全体で生存できるパーティクル数
+	/// </summary>
+	void SetParticleBudget(uint32_t _budget) { particleBudget = _budget; }
+
+	/// <summary>
+	/// 時間を進め，発生させるべきエミッターを集める
+	/// </summary>
+	/// <param name="_deltaTime">経過時間</param>
+	/// <param name="_frustum">カメラの視錐台</param>
+	/// <param name="_cameraPosition">カメラの位置</param>
+	/// <param name="_aliveParticles">現在生存しているパーティクル数</param>
+	/// <param name="_requests">発生要求の出力先 (クリアしてから詰める)</param>
+	void Update(float _deltaTime, const Frustum& _frustum, const Vector3& _cameraPosition, uint32_t _aliveParticles, std::vector<EmitRequest>& _requests);
+
+	const EmitterStats& GetStats() const { return stats; }
+
+private:
+	//ホイールの目盛り数 これより先の発生時刻は周回して待つ
+	static const uint32_t kWheelSize = 256;
+
+	struct WheelEntry
+	{
+		uint32_t emitter;
+		uint32_t generation;	//削除後に番号が再利用されたときの古い登録を弾く
+	};
+
+	void Schedule(uint32_t _emitter, uint64_t _tick);
+	void ProcessTick(const Frustum& _frustum, const Vector3& _cameraPosition);
+
+	float tickTime;
+	float accumulatedTime;
+	uint64_t currentTick;
+	float cullDistance;
+	uint32_t particleBudget;
+
+	//エミッターのSoA
+	std::vector<Vector3> translates;
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> intervalTicks;
+	std::vector<float> boundsRadii;
+	std::vector<uint32_t> priorities;
+	std::vector<uint64_t> fireTicks;
+	std::vector<uint32_t> generations;
+	std::vector<uint8_t> isActive;
+	std::vector<uint32_t> freeList;
+
+	std::vector<WheelEntry> wheel[kWheelSize];
+	std::vector<EmitRequest> dueRequests;	//視錐台内で発生時刻を迎えたもの
+	std::vector<uint32_t> rescheduled;		//ProcessTickの作業用
+
+	EmitterStats stats;
+};
@@ -0,0 +1,67 @@
+#include "LinearAllocator.h"
+
+LinearAllocator::LinearAllocator(void* _cpuBase, uint64_t _gpuBase, size_t _size, uint32_t _maxFramesInFlight, size_t _alignment) :
+	cpuBase(static_cast<unsigned char*>(_cpuBase)),
+	gpuBase(_gpuBase),
+	capacity(_size),
+	alignment(_alignment),
+	head(0),
+	tail(0),
+	frameBegin(0),
+	pendingFrames(_maxFramesInFlight),
+	pendingFirst(0),
+	pendingCount(0)
+{
+	assert(_cpuBase != nullptr);
+	assert(0 < _maxFramesInFlight);
+	//2のべき乗に限ることで切り上げをビット演算にする
+	assert(_alignment != 0 && (_alignment & (_alignment - 1)) == 0);
+	assert(_gpuBase % _alignment == 0);
+	assert(0 < _size && _size % _alignment == 0);
+}
+
+void LinearAllocator::BeginFrame(uint64_t _completedFenceValue)
+{
+	while (0 < pendingCount && pendingFrames[pendingFirst].fenceValue <= _completedFenceValue)
+	{
+		tail = pendingFrames[pendingFirst].end;
+		pendingFirst = (pendingFirst + 1) % pendingFrames.size();
+		pendingCount--;
+	}
+	frameBegin = head;
+}
+
+LinearAllocation LinearAllocator::Allocate(size_t _size)
+{
+	const uint64_t alignedSize = (uint64_t(_size) + alignment - 1) & ~uint64_t(alignment - 1);
+	//何も使っていなければ先頭から切り出す (終端の余りのせいで大きな切り出しが入らないことがないように)
+	//GPUを待っているフレームがあると，その終わりの位置より先へ進めたtailが後で戻されるので，待っているものがないときだけにする
+	if (head == tail && pendingCount == 0 && head % capacity != 0)
+	{
+		head += capacity - head % capacity;
+		tail = head;
+		frameBegin = head;
+	}
+	uint64_t offset = head % capacity;
+	//終端をまたぐ分は余りとして捨てて先頭から切り出す
+	uint64_t padding = capacity < offset + alignedSize ? capacity - offset : 0;
+	if (capacity < head + padding + alignedSize - tail)
+	{
+		//GPUがまだ使っている範囲に届くので切り出せない
+		return { nullptr, 0 };
+	}
+
+	head += padding;
+	offset = head % capacity;
+	head += alignedSize;
+	return { cpuBase + offset, gpuBase + offset };
+}
+
+void LinearAllocator::EndFrame(uint64_t _fenceValue)
+{
+	assert(pendingCount < pendingFrames.size());
+	const uint32_t last = static_cast<uint32_t>((pendingFirst + pendingCount) % pendingFrames.size());
+	pendingFrames[last] = { _fenceValue, head };
+	pendingCount++;
+	frameBegin = head;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/// <summary>
+/// 切り出した領域 CPUから書き込むアドレスとGPUから読むアドレスの組
+/// </summary>
+struct LinearAllocation
+{
+	void* cpuAddress;		//足りなかったときはnullptr
+	uint64_t gpuAddress;
+};
+
+/// <summary>
+/// 1つの大きなアップロードバッファ (Mapしたまま) を先頭から順に切り出すリングバッファ
+/// フレームの終わりにそのフレームで使った範囲とフェンス値を記録し，GPUが終えたフレームの範囲から使い直す
+/// デバイスには触れないので，バッファの先頭アドレス (CPU/GPU) を渡して使う
+/// </summary>
+class LinearAllocator
+{
+public:
+	/// <param name="_cpuBase">Mapしたバッファの先頭</param>
+	/// <param name="_gpuBase">バッファのGPU仮想アドレス _alignmentの倍数</param>
+	/// <param name="_size">バッファのバイト数 _alignmentの倍数</param>
+	/// <param name="_maxFramesInFlight">GPUが処理中でも記録しておけるフレーム数</param>
+	/// <param name="_alignment">切り出しの単位 定数バッファは256</param>
+	LinearAllocator(void* _cpuBase, uint64_t _gpuBase, size_t _size, uint32_t _maxFramesInFlight, size_t _alignment = 256);
+
+	/// <summary>
+	/// フレームの始めに呼ぶ GPUが_completedFenceValueまで終えたフレームの範囲を空ける
+	/// </summary>
+	void BeginFrame(uint64_t _completedFenceValue);
+	/// <summary>
+	/// _sizeバイトを_alignmentにそろえて切り出す 終端をまたぐときは先頭に戻る
+	/// </summary>
+	LinearAllocation Allocate(size_t _size);
+	/// <summary>
+	/// _valueを書き込んだ領域を切り出す
+	/// </summary>
+	template <class T>
+	LinearAllocation Push(const T& _value);
+	/// <summary>
+	/// フレームの終わりに呼ぶ このフレームで切り出した範囲は_fenceValueが終わるまで使わない
+	/// </summary>
+	/// <param name="_fenceValue">このフレームのコマンドの後にSignalした値</param>
+	void EndFrame(uint64_t _fenceValue);
+
+	size_t GetCapacity() const { return capacity; }
+	/// <summary>
+	/// GPUが使っているかもしれない範囲と，このフレームで切り出した範囲の合計 (終端の余りも含む)
+	/// </summary>
+	size_t GetUsedSize() const { return static_cast<size_t>(head - tail); }
+	/// <summary>
+	/// このフレームで切り出したバイト数
+	/// </summary>
+	size_t GetFrameSize() const { return static_cast<size_t>(head - frameBegin); }
+	uint32_t GetFramesInFlight() const { return pendingCount; }
+
+private:
+	/// <summary>
+	/// GPUの処理を待っているフレーム
+	/// </summary>
+	struct PendingFrame
+	{
+		uint64_t fenceValue;
+		uint64_t end;		//このフレームの終わりのhead
+	};
+
+	unsigned char* cpuBase;
+	uint64_t gpuBase;
+	size_t capacity;
+	size_t alignment;
+	//どちらも先頭からの通算バイト数 バッファ内の位置はcapacityで割った余り
+	uint64_t head;			//次に切り出す位置
+	uint64_t tail;			//GPUが使っているかもしれない最も古い位置
+	uint64_t frameBegin;	//このフレームの始めのhead
+	std::vector<PendingFrame> pendingFrames;	//リングとして使う
+	uint32_t pendingFirst;
+	uint32_t pendingCount;
+};
+
+template<class T>
+inline LinearAllocation LinearAllocator::Push(const T& _value)
+{
+	LinearAllocation allocation = Allocate(sizeof(T));
+	if (allocation.cpuAddress != nullptr)
+	{
+		std::memcpy(allocation.cpuAddress, &_value, sizeof(T));
+	}
+	return allocation;
+}
@@ -27,6 +27,12 @@ cbuffer Camera : register(b3)
     float3 worldPosition;
 }
 
+//テクスチャテーブルの番号 (ルート定数)
+cbuffer gTextureIndex : register(b5)
+{
+    uint textureIndex;
+}
+
 ////点光源
 //cbuffer gPointLight : register(b4)
 //{
@@ -40,7 +46,8 @@ struct PixelShaderOutput
     float4 color : SV_TARGET0;
 };
 
-Texture2D<float4> gTexture : register(t0);
+//ルートシグネチャのテクスチャテーブル (main.cppのkMaxTextures) と同じ数にする
+Texture2D<float4> gTextures[256] : register(t0);
 SamplerState gSampler : register(s0);
 
 PixelShaderOutput main(VertexShaderOutput _input)
@@ -53,7 +60,7 @@ PixelShaderOutput main(VertexShaderOutput _input)
     if (isVisible == 1.0f)
     {
         float4 transformedUV = mul(float4(_input.texcoord, 0.0f, 1.0f), unTransform);
-        textureColor = materialColor * gTexture.Sample(gSampler, transformedUV.xy);
+        textureColor = materialColor * gTextures[textureIndex].Sample(gSampler, transformedUV.xy);
     }
     else
         textureColor = materialColor;
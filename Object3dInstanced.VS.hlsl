@@ -0,0 +1,29 @@
+#include "Object3d.hlsli"
+
+struct TransformationMatrix
+{
+    float4x4 WVP;
+    float4x4 World;
+    float4x4 worldInverseTranspose;
+};
+
+//RenderQueueがまとめた描画の行列 Object3d.VS.hlslのcbufferと同じ並び
+StructuredBuffer<TransformationMatrix> gTransformationMatrices : register(t0);
+
+struct VertexShaderInput
+{
+    float4 position : POSITION0;
+    float2 texcoord : TEXCOORD0;
+    float3 normal : NORMAL0;
+};
+
+VertexShaderOutput main(VertexShaderInput _input, uint instanceID : SV_InstanceID)
+{
+    TransformationMatrix transformationMatrix = gTransformationMatrices[instanceID];
+    VertexShaderOutput output;
+    output.position = mul(_input.position, transformationMatrix.WVP);
+    output.texcoord = _input.texcoord;
+    output.normal = normalize(mul(_input.normal, (float3x3) transformationMatrix.worldInverseTranspose));
+    output.worldPosition = mul(_input.position, transformationMatrix.WVP).xyz;
+    return output;
+}
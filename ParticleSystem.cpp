@@ -0,0 +1,326 @@
+#include "ParticleSystem.h"
+#include "myLib/RadixSort.h"
+#include <algorithm>
+#include <cassert>
+
+void ParticleBuffer::Resize(uint32_t _capacity)
+{
+	translate.resize(_capacity);
+	scale.resize(_capacity);
+	velocity.resize(_capacity);
+	color.resize(_capacity);
+	lifeTime.resize(_capacity);
+	currentTime.resize(_capacity);
+}
+
+void ParticleBuffer::Copy(uint32_t _dst, const ParticleBuffer& _src, uint32_t _srcIndex)
+{
+	translate[_dst] = _src.translate[_srcIndex];
+	scale[_dst] = _src.scale[_srcIndex];
+	velocity[_dst] = _src.velocity[_srcIndex];
+	color[_dst] = _src.color[_srcIndex];
+	lifeTime[_dst] = _src.lifeTime[_srcIndex];
+	currentTime[_dst] = _src.currentTime[_srcIndex];
+}
+
+uint32_t PCGHash(uint32_t _input)
+{
+	uint32_t state = _input * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float RandomFloat(uint32_t& _seed)
+{
+	_seed = PCGHash(_seed);
+	//上位24bitを使うとfloatで正確に表せる
+	return float(_seed >> 8) * (1.0f / 16777216.0f);
+}
+
+namespace
+{
+	//力の場のグリッド 場は数十個程度を想定
+	const float kForceFieldCellSize = 4.0f;
+	const uint32_t kForceFieldTableSize = 1024;
+
+	Vector3 CalculateForce(const ForceField& _field, const Vector3& _point)
+	{
+		Vector3 toCenter = _field.position - _point;
+		float distance = Length(toCenter);
+		if (_field.radius <= distance)
+		{
+			return { 0.0f, 0.0f, 0.0f };
+		}
+		float strength = _field.strength * (1.0f - distance / _field.radius);
+		switch (_field.type)
+		{
+		case ForceFieldType::kWind:
+			return Normalize(_field.direction) * strength;
+		case ForceFieldType::kAttractor:
+			return Normalize(toCenter) * strength;
+		case ForceFieldType::kVortex:
+			return Normalize(Cross(_field.direction, toCenter)) * strength;
+		}
+		return { 0.0f, 0.0f, 0.0f };
+	}
+}
+
+ParticleSystem::ParticleSystem(ComputeDispatcher* _dispatcher, uint32_t _capacity) :
+	forceFieldGrid(kForceFieldCellSize, kForceFieldTableSize),
+	particleGrid(1.0f, _capacity)
+{
+	assert(_dispatcher != nullptr);
+	dispatcher = _dispatcher;
+	capacity = _capacity;
+	count = 0;
+	current = 0;
+	repulsionRadius = 0.0f;
+	repulsionStrength = 0.0f;
+
+	buffers[0].Resize(capacity);
+	buffers[1].Resize(capacity);
+	aliveFlags.resize(capacity);
+	localOffsets.resize(capacity);
+	sortKeys.resize(capacity);
+	drawOrder.resize(capacity);
+	sortKeysTemp.resize(capacity);
+	drawOrderTemp.resize(capacity);
+
+	uint32_t groupCount = ComputeDispatcher::CalculateGroupCount(capacity, kParticleThreadGroupSize);
+	groupCounts.resize(groupCount);
+	groupOffsets.resize(groupCount);
+}
+
+void ParticleSystem::Emit(const Emitter& _emitter, uint32_t _seed)
+{
+	uint32_t emitCount = (std::min)(_emitter.count, capacity - count);
+	if (emitCount == 0)
+	{
+		return;
+	}
+
+	ParticleBuffer& buffer = buffers[current];
+	const uint32_t baseIndex = count;
+	const Vector3 emitterTranslate = _emitter.transform.translate;
+
+	uint32_t groupCount = ComputeDispatcher::CalculateGroupCount(emitCount, kParticleThreadGroupSize);
+	dispatcher->Dispatch(groupCount, kParticleThreadGroupSize, [&](const ComputeThreadID& _id)
+		{
+			if (_id.dispatchThreadID >= emitCount)
+			{
+				return;
+			}
+			uint32_t index = baseIndex + _id.dispatchThreadID;
+			//スレッドごとに独立した乱数列
+			uint32_t seed = PCGHash(_seed ^ PCGHash(_id.dispatchThreadID));
+
+			Vector3 randomTranslate{ RandomFloat(seed) * 2.0f - 1.0f, RandomFloat(seed) * 2.0f - 1.0f, RandomFloat(seed) * 2.0f - 1.0f };
+			buffer.translate[index] = emitterTranslate + randomTranslate;
+			buffer.scale[index] = { 1.0f, 1.0f, 1.0f };
+			buffer.velocity[index] = { RandomFloat(seed) * 2.0f - 1.0f, RandomFloat(seed) * 2.0f - 1.0f, RandomFloat(seed) * 2.0f - 1.0f };
+			buffer.color[index] = { RandomFloat(seed), RandomFloat(seed), RandomFloat(seed), 1.0f };
+			buffer.lifeTime[index] = 1.0f + RandomFloat(seed) * 2.0f;
+			buffer.currentTime[index] = 0.0f;
+		});
+
+	count += emitCount;
+}
+
+void ParticleSystem::SetRepulsion(float _radius, float _strength)
+{
+	repulsionRadius = _radius;
+	repulsionStrength = _strength;
+	if (0.0f < _radius && particleGrid.GetCellSize() != _radius)
+	{
+		particleGrid = SpatialHashGrid(_radius, capacity);
+	}
+}
+
+void ParticleSystem::Update(float _deltaTime, const AccelerationField* _field)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	ParticleBuffer& buffer = buffers[current];
+	const uint32_t particleCount = count;
+
+	//場は重なるセルすべてに入れておき，パーティクルは自分のセルだけを引く
+	const bool useForceFields = !forceFields.empty();
+	if (useForceFields)
+	{
+		forceFieldBounds.resize(forceFields.size());
+		for (size_t index = 0; index < forceFields.size(); index++)
+		{
+			Vector3 extent = { forceFields[index].radius, forceFields[index].radius, forceFields[index].radius };
+			forceFieldBounds[index] = { forceFields[index].position - extent, forceFields[index].position + extent };
+		}
+		forceFieldGrid.BuildBounds(forceFieldBounds.data(), static_cast<uint32_t>(forceFieldBounds.size()));
+	}
+	//グリッドは位置のコピーを持つので，カーネル内で位置を書き換えても前フレームの位置で判定できる
+	const bool useRepulsion = 0.0f < repulsionRadius && 0.0f != repulsionStrength;
+	if (useRepulsion)
+	{
+		particleGrid.BuildPoints(buffer.translate.data(), particleCount, dispatcher->GetThreadPool());
+	}
+
+	uint32_t groupCount = ComputeDispatcher::CalculateGroupCount(particleCount, kParticleThreadGroupSize);
+	dispatcher->Dispatch(groupCount, kParticleThreadGroupSize, [&](const ComputeThreadID& _id)
+		{
+			uint32_t index = _id.dispatchThreadID;
+			if (index >= particleCount)
+			{
+				return;
+			}
+			if (buffer.lifeTime[index] <= buffer.currentTime[index])
+			{
+				aliveFlags[index] = 0;
+				return;
+			}
+			aliveFlags[index] = 1;
+
+			float alpha = 1.0f - (buffer.currentTime[index] / buffer.lifeTime[index]);
+			if (_field != nullptr && IsCollision(_field->area, buffer.translate[index]))
+			{
+				buffer.velocity[index] += _field->acceleration * _deltaTime;
+			}
+			if (useForceFields)
+			{
+				Vector3 acceleration = { 0.0f, 0.0f, 0.0f };
+				forceFieldGrid.ForEachInCell(buffer.translate[index], [&](uint32_t _fieldIndex)
+					{
+						acceleration += CalculateForce(forceFields[_fieldIndex], buffer.translate[index]);
+					});
+				buffer.velocity[index] += acceleration * _deltaTime;
+			}
+			if (useRepulsion)
+			{
+				Vector3 acceleration = { 0.0f, 0.0f, 0.0f };
+				Sphere range{ buffer.translate[index], repulsionRadius };
+				particleGrid.ForEachNeighbor(range, [&](uint32_t _other, const Vector3& _otherPosition)
+					{
+						Vector3 away = range.center - _otherPosition;
+						float distance = Length(away);
+						if (_other == index || repulsionRadius <= distance)
+						{
+							return;
+						}
+						acceleration += Normalize(away) * (repulsionStrength * (1.0f - distance / repulsionRadius));
+					});
+				buffer.velocity[index] += acceleration * _deltaTime;
+			}
+			buffer.translate[index] += buffer.velocity[index] * _deltaTime;
+			buffer.currentTime[index] += _deltaTime;
+			buffer.color[index].w = alpha;
+		});
+
+	Compact();
+}
+
+void ParticleSystem::Compact()
+{
+	const ParticleBuffer& src = buffers[current];
+	ParticleBuffer& dst = buffers[current ^ 1];
+	const uint32_t particleCount = count;
+	const uint32_t groupCount = ComputeDispatcher::CalculateGroupCount(particleCount, kParticleThreadGroupSize);
+
+	//グループ内のprefix sum GPUではgroupsharedのscanに相当する
+	dispatcher->Dispatch(groupCount, 1, [&](const ComputeThreadID& _id)
+		{
+			uint32_t begin = _id.groupID * kParticleThreadGroupSize;
+			uint32_t end = (std::min)(begin + kParticleThreadGroupSize, particleCount);
+			uint32_t sum = 0;
+			for (uint32_t index = begin; index < end; index++)
+			{
+				localOffsets[index] = sum;
+				sum += aliveFlags[index];
+			}
+			groupCounts[_id.groupID] = sum;
+		});
+
+	//グループ間のexclusive scan グループ数は少ないので1スレッドで行う
+	dispatcher->Dispatch(1, 1, [&](const ComputeThreadID&)
+		{
+			uint32_t sum = 0;
+			for (uint32_t group = 0; group < groupCount; group++)
+			{
+				groupOffsets[group] = sum;
+				sum += groupCounts[group];
+			}
+		});
+
+	dispatcher->Dispatch(groupCount, kParticleThreadGroupSize, [&](const ComputeThreadID& _id)
+		{
+			uint32_t index = _id.dispatchThreadID;
+			if (index >= particleCount || aliveFlags[index] == 0)
+			{
+				return;
+			}
+			dst.Copy(groupOffsets[_id.groupID] + localOffsets[index], src, index);
+		});
+
+	count = groupCount == 0 ? 0 : groupOffsets[groupCount - 1] + groupCounts[groupCount - 1];
+	current ^= 1;
+}
+
+uint32_t ParticleSystem::WriteInstances(const ParticleDrawDesc& _desc, ParticleForGPU* _instances, uint32_t _maxInstances)
+{
+	const ParticleBuffer& buffer = buffers[current];
+	const uint32_t instanceCount = (std::min)(count, _maxInstances);
+	const uint32_t groupCount = ComputeDispatcher::CalculateGroupCount(instanceCount, kParticleThreadGroupSize);
+
+	if (_desc.sortBackToFront)
+	{
+		const Matrix4x4& view = _desc.viewMatrix;
+		dispatcher->Dispatch(groupCount, kParticleThreadGroupSize, [&](const ComputeThreadID& _id)
+			{
+				uint32_t index = _id.dispatchThreadID;
+				if (index >= instanceCount)
+				{
+					return;
+				}
+				Vector3 translate = buffer.translate[index] - buffer.velocity[index] * _desc.interpolationTime;
+				float depth = translate.x * view.m[0][2] + translate.y * view.m[1][2] + translate.z * view.m[2][2] + view.m[3][2];
+				//奥から描きたいので降順にする
+				sortKeys[index] = ~FloatToSortableKey(depth);
+				drawOrder[index] = index;
+			});
+		RadixSort(sortKeys.data(), drawOrder.data(), sortKeysTemp.data(), drawOrderTemp.data(), sortHistograms, instanceCount, dispatcher->GetThreadPool());
+	}
+
+	dispatcher->Dispatch(groupCount, kParticleThreadGroupSize, [&](const ComputeThreadID& _id)
+		{
+			uint32_t instance = _id.dispatchThreadID;
+			if (instance >= instanceCount)
+			{
+				return;
+			}
+			uint32_t index = _desc.sortBackToFront ? drawOrder[instance] : instance;
+
+			//scale * billboard * translate を展開したもの
+			const Vector3& scale = buffer.scale[index];
+			//位置は速度で一定に進めているので，速度で戻せば前回の更新との線形補間になる
+			Vector3 translate = buffer.translate[index] - buffer.velocity[index] * _desc.interpolationTime;
+			const float scales[3] = { scale.x, scale.y, scale.z };
+			Matrix4x4 world{};
+			for (int row = 0; row < 3; row++)
+			{
+				for (int column = 0; column < 3; column++)
+				{
+					world.m[row][column] = scales[row] * _desc.billboard.m[row][column];
+				}
+				world.m[row][3] = 0.0f;
+			}
+			world.m[3][0] = translate.x;
+			world.m[3][1] = translate.y;
+			world.m[3][2] = translate.z;
+			world.m[3][3] = 1.0f;
+
+			_instances[instance].World = world;
+			_instances[instance].WVP = Multiply(world, _desc.viewProjection);
+			_instances[instance].color = buffer.color[index];
+		});
+
+	return instanceCount;
+}
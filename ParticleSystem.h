@@ -0,0 +1,172 @@
+#pragma once
+#include "myLib/MyLib.h"
+#include "ComputeDispatch.h"
+#include "myLib/SpatialHashGrid.h"
+#include <cstdint>
+#include <vector>
+
+struct Emitter
+{
+	stTransform transform;  //
+	uint32_t count;			//発生数
+	float frequency;		//発生頻度
+	float frequencyTime;	//頻度用時刻
+};
+
+struct ParticleForGPU
+{
+	Matrix4x4 WVP;
+	Matrix4x4 World;
+	Vector4 color;
+};
+
+struct AccelerationField
+{
+	Vector3 acceleration;
+	AABB area;
+};
+
+enum class ForceFieldType
+{
+	kWind,			//directionの向きに一定の力
+	kAttractor,		//中心へ引き寄せる (strengthが負なら押し出す)
+	kVortex,		//directionを軸に回転させる
+};
+
+/// <summary>
+/// 球状の範囲に働く力の場 中心から離れるほど弱くなる
+/// </summary>
+struct ForceField
+{
+	ForceFieldType type;
+	Vector3 position;		//中心
+	Vector3 direction;		//風向き・渦の軸
+	float radius;			//影響半径
+	float strength;			//中心での加速度の大きさ
+};
+
+//1グループあたりのスレッド数 ([numthreads(kParticleThreadGroupSize,1,1)])
+static const uint32_t kParticleThreadGroupSize = 64;
+
+/// <summary>
+/// パーティクルのSoAバッファ
+/// 要素ごとにRWStructuredBufferへそのまま移せる並び
+/// </summary>
+struct ParticleBuffer
+{
+	std::vector<Vector3> translate;
+	std::vector<Vector3> scale;
+	std::vector<Vector3> velocity;
+	std::vector<Vector4> color;
+	std::vector<float> lifeTime;
+	std::vector<float> currentTime;
+
+public:
+	void Resize(uint32_t _capacity);
+	/// <summary>
+	/// 1要素コピー
+	/// </summary>
+	void Copy(uint32_t _dst, const ParticleBuffer& _src, uint32_t _srcIndex);
+};
+
+/// <summary>
+/// インスタンスデータ書き出し時の設定
+/// </summary>
+struct ParticleDrawDesc
+{
+	Matrix4x4 viewMatrix;		//深度ソート用のビュー行列
+	Matrix4x4 viewProjection;	//ビュープロジェクション行列
+	Matrix4x4 billboard;		//ビルボード行列 (平行移動成分なし)
+	bool sortBackToFront;		//アルファブレンド用に奥から順に並べるか
+	float interpolationTime;	//描画時刻を最後の更新からどれだけ戻すか 速度で位置を戻して前回の更新との間を補間する
+};
+
+/// <summary>
+/// HLSLへ移植しやすい乱数 (PCG hash)
+/// </summary>
+uint32_t PCGHash(uint32_t _input);
+/// <summary>
+/// [0,1)の乱数を返し，_seedを進める
+/// </summary>
+float RandomFloat(uint32_t& _seed);
+
+/// <summary>
+/// コンピュートシェーダー形式のパーティクルシミュレーション
+/// 発生・更新・詰め直し・GPU用データ書き出しをすべてDispatch単位のカーネルで行う
+/// </summary>
+class ParticleSystem
+{
+public:
+	/// <param name="_dispatcher">カーネルを実行するディスパッチャ</param>
+	/// <param name="_capacity">最大パーティクル数</param>
+	ParticleSystem(ComputeDispatcher* _dispatcher, uint32_t _capacity);
+
+	/// <summary>
+	/// エミッターからパーティクルを発生させる 容量を超えた分は発生しない
+	/// </summary>
+	/// <param name="_emitter">エミッター</param>
+	/// <param name="_seed">乱数の種</param>
+	void Emit(const Emitter& _emitter, uint32_t _seed);
+
+	/// <summary>
+	/// 寿命を迎えたものを除き，移動させて詰め直す
+	/// </summary>
+	/// <param name="_deltaTime">経過時間</param>
+	/// <param name="_field">加速度場 nullptrなら無効</param>
+	void Update(float _deltaTime, const AccelerationField* _field);
+
+	/// <summary>
+	/// 力の場を設定する Updateのたびにグリッドへ登録し直すので毎フレーム動かしてよい
+	/// </summary>
+	void SetForceFields(const std::vector<ForceField>& _fields) { forceFields = _fields; }
+	/// <summary>
+	/// パーティクル同士の反発を設定する
+	/// </summary>
+	/// <param name="_radius">反発し合う距離 0以下なら無効</param>
+	/// <param name="_strength">重なったときの加速度の大きさ</param>
+	void SetRepulsion(float _radius, float _strength);
+
+	/// <summary>
+	/// インスタンシング用データを書き出す
+	/// sortBackToFrontならビュー空間の深度で基数ソートし，奥から順に書き出す
+	/// </summary>
+	/// <param name="_desc">書き出し設定</param>
+	/// <param name="_instances">書き出し先</param>
+	/// <param name="_maxInstances">書き出し先の要素数</param>
+	/// <returns>書き出したインスタンス数</returns>
+	uint32_t WriteInstances(const ParticleDrawDesc& _desc, ParticleForGPU* _instances, uint32_t _maxInstances);
+
+	uint32_t GetCount() const { return count; }
+	uint32_t GetCapacity() const { return capacity; }
+	const ParticleBuffer& GetBuffer() const { return buffers[current]; }
+
+private:
+	/// <summary>
+	/// 生存フラグをもとに前詰めする (グループ内prefix sum → グループ間scan → scatter)
+	/// </summary>
+	void Compact();
+
+	ComputeDispatcher* dispatcher;
+	ParticleBuffer buffers[2];		//詰め直し用にピンポンする
+	uint32_t current;
+	uint32_t count;
+	uint32_t capacity;
+
+	std::vector<ForceField> forceFields;
+	std::vector<AABB> forceFieldBounds;
+	SpatialHashGrid forceFieldGrid;		//力の場の検索用
+	SpatialHashGrid particleGrid;		//反発の近傍探索用 セルの大きさは反発半径
+	float repulsionRadius;
+	float repulsionStrength;
+
+	std::vector<uint32_t> aliveFlags;	//生存フラグ
+	std::vector<uint32_t> localOffsets;	//グループ内での書き込み位置
+	std::vector<uint32_t> groupCounts;	//グループごとの生存数
+	std::vector<uint32_t> groupOffsets;	//グループの書き込み開始位置
+
+	std::vector<uint32_t> sortKeys;		//深度キー
+	std::vector<uint32_t> drawOrder;	//描画順のパーティクル番号
+	std::vector<uint32_t> sortKeysTemp;
+	std::vector<uint32_t> drawOrderTemp;
+	std::vector<uint32_t> sortHistograms;	//基数ソートの作業用
+};
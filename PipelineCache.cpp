@@ -0,0 +1,292 @@
+#include "PipelineCache.h"
+#include "myLib/ThreadPool.h"
+#include <cassert>
+#include <vector>
+
+namespace
+{
+	//キーの作り方を変えたら上げる 古いキーのキャッシュは使われなくなる
+	const uint32_t kKeyVersion = 1;
+
+	void AddShader(PipelineHash& _hash, const D3D12_SHADER_BYTECODE& _shader)
+	{
+		_hash.Add(static_cast<uint64_t>(_shader.BytecodeLength));
+		if (_shader.pShaderBytecode != nullptr)
+		{
+			_hash.AddBytes(_shader.pShaderBytecode, _shader.BytecodeLength);
+		}
+	}
+
+	void AddStencilOp(PipelineHash& _hash, const D3D12_DEPTH_STENCILOP_DESC& _op)
+	{
+		_hash.Add(_op.StencilFailOp);
+		_hash.Add(_op.StencilDepthFailOp);
+		_hash.Add(_op.StencilPassOp);
+		_hash.Add(_op.StencilFunc);
+	}
+}
+
+PipelineCache::PipelineCache(ID3D12Device* _device) :
+	device(_device),
+	stats{}
+{
+	assert(_device != nullptr);
+}
+
+void PipelineCache::RegisterRootSignature(ID3D12RootSignature* _rootSignature, const void* _serialized, size_t _size)
+{
+	PipelineHash hash;
+	hash.AddBytes(_serialized, _size);
+	std::lock_guard<std::mutex> lock(mutex);
+	rootSignatureKeys[_rootSignature] = hash.GetValue();
+}
+
+uint64_t PipelineCache::CalculateKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& _desc) const
+{
+	PipelineHash hash;
+	hash.Add(kKeyVersion);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto rootSignature = rootSignatureKeys.find(_desc.pRootSignature);
+		//登録していないルートシグネチャは中身が分からないのでキーを作れない
+		assert(rootSignature != rootSignatureKeys.end());
+		hash.Add(rootSignature != rootSignatureKeys.end() ? rootSignature->second : 0);
+	}
+
+	AddShader(hash, _desc.VS);
+	AddShader(hash, _desc.PS);
+	AddShader(hash, _desc.DS);
+	AddShader(hash, _desc.HS);
+	AddShader(hash, _desc.GS);
+
+	const D3D12_STREAM_OUTPUT_DESC& streamOutput = _desc.StreamOutput;
+	hash.Add(streamOutput.NumEntries);
+	for (UINT entry = 0; entry < streamOutput.NumEntries; entry++)
+	{
+		const D3D12_SO_DECLARATION_ENTRY& declaration = streamOutput.pSODeclaration[entry];
+		hash.Add(declaration.Stream);
+		hash.AddString(declaration.SemanticName);
+		hash.Add(declaration.SemanticIndex);
+		hash.Add(declaration.StartComponent);
+		hash.Add(declaration.ComponentCount);
+		hash.Add(declaration.OutputSlot);
+	}
+	hash.Add(streamOutput.NumStrides);
+	for (UINT stride = 0; stride < streamOutput.NumStrides; stride++)
+	{
+		hash.Add(streamOutput.pBufferStrides[stride]);
+	}
+	hash.Add(streamOutput.RasterizedStream);
+
+	//IndependentBlendEnableでなければ0番目の設定がすべてのターゲットに使われる
+	const D3D12_BLEND_DESC& blend = _desc.BlendState;
+	hash.Add(blend.AlphaToCoverageEnable);
+	hash.Add(blend.IndependentBlendEnable);
+	const UINT blendTargetCount = blend.IndependentBlendEnable ? _desc.NumRenderTargets : 1;
+	for (UINT target = 0; target < blendTargetCount; target++)
+	{
+		const D3D12_RENDER_TARGET_BLEND_DESC& targetBlend = blend.RenderTarget[target];
+		hash.Add(targetBlend.BlendEnable);
+		if (targetBlend.BlendEnable)
+		{
+			hash.Add(targetBlend.SrcBlend);
+			hash.Add(targetBlend.DestBlend);
+			hash.Add(targetBlend.BlendOp);
+			hash.Add(targetBlend.SrcBlendAlpha);
+			hash.Add(targetBlend.DestBlendAlpha);
+			hash.Add(targetBlend.BlendOpAlpha);
+		}
+		hash.Add(targetBlend.LogicOpEnable);
+		if (targetBlend.LogicOpEnable)
+		{
+			hash.Add(targetBlend.LogicOp);
+		}
+		hash.Add(targetBlend.RenderTargetWriteMask);
+	}
+	hash.Add(_desc.SampleMask);
+
+	const D3D12_RASTERIZER_DESC& rasterizer = _desc.RasterizerState;
+	hash.Add(rasterizer.FillMode);
+	hash.Add(rasterizer.CullMode);
+	hash.Add(rasterizer.FrontCounterClockwise);
+	hash.Add(rasterizer.DepthBias);
+	hash.Add(rasterizer.DepthBiasClamp);
+	hash.Add(rasterizer.SlopeScaledDepthBias);
+	hash.Add(rasterizer.DepthClipEnable);
+	hash.Add(rasterizer.MultisampleEnable);
+	hash.Add(rasterizer.AntialiasedLineEnable);
+	hash.Add(rasterizer.ForcedSampleCount);
+	hash.Add(rasterizer.ConservativeRaster);
+
+	const D3D12_DEPTH_STENCIL_DESC& depthStencil = _desc.DepthStencilState;
+	hash.Add(depthStencil.DepthEnable);
+	if (depthStencil.DepthEnable)
+	{
+		hash.Add(depthStencil.DepthWriteMask);
+		hash.Add(depthStencil.DepthFunc);
+	}
+	hash.Add(depthStencil.StencilEnable);
+	if (depthStencil.StencilEnable)
+	{
+		hash.Add(depthStencil.StencilReadMask);
+		hash.Add(depthStencil.StencilWriteMask);
+		AddStencilOp(hash, depthStencil.FrontFace);
+		AddStencilOp(hash, depthStencil.BackFace);
+	}
+
+	const D3D12_INPUT_LAYOUT_DESC& inputLayout = _desc.InputLayout;
+	hash.Add(inputLayout.NumElements);
+	for (UINT element = 0; element < inputLayout.NumElements; element++)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& inputElement = inputLayout.pInputElementDescs[element];
+		hash.AddString(inputElement.SemanticName);
+		hash.Add(inputElement.SemanticIndex);
+		hash.Add(inputElement.Format);
+		hash.Add(inputElement.InputSlot);
+		hash.Add(inputElement.AlignedByteOffset);
+		hash.Add(inputElement.InputSlotClass);
+		hash.Add(inputElement.InstanceDataStepRate);
+	}
+
+	hash.Add(_desc.IBStripCutValue);
+	hash.Add(_desc.PrimitiveTopologyType);
+	//NumRenderTargetsより後ろの形式は使われない
+	hash.Add(_desc.NumRenderTargets);
+	for (UINT target = 0; target < _desc.NumRenderTargets; target++)
+	{
+		hash.Add(_desc.RTVFormats[target]);
+	}
+	hash.Add(_desc.DSVFormat);
+	hash.Add(_desc.SampleDesc.Count);
+	hash.Add(_desc.SampleDesc.Quality);
+	hash.Add(_desc.NodeMask);
+	hash.Add(_desc.Flags);
+	//CachedPSOは作り方の違いだけで結果は同じなのでキーに入れない
+	return hash.GetValue();
+}
+
+ID3D12PipelineState* PipelineCache::GetOrCreate(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& _desc)
+{
+	const uint64_t key = CalculateKey(_desc);
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = _desc;
+	desc.CachedPSO = {};
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto pipelineState = pipelineStates.find(key);
+		if (pipelineState != pipelineStates.end())
+		{
+			stats.hits++;
+			return pipelineState->second.Get();
+		}
+		//ファイルのキャッシュはこの後も消さないので，ロックの外で読んでよい
+		auto blob = diskBlobs.find(key);
+		if (blob != diskBlobs.end())
+		{
+			desc.CachedPSO = { blob->second.data(), blob->second.size() };
+		}
+	}
+
+	//作るのは時間がかかるのでロックの外で作る 同時に同じものを作ったら先に入れた方を使う
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> created = nullptr;
+	bool isDiskHit = false;
+	bool isDiskRejected = false;
+	if (desc.CachedPSO.pCachedBlob != nullptr)
+	{
+		//ドライバやGPUが変わっていると失敗するので，そのときは最初から作る
+		isDiskHit = SUCCEEDED(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&created)));
+		isDiskRejected = !isDiskHit;
+		desc.CachedPSO = {};
+	}
+	if (created == nullptr && FAILED(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&created))))
+	{
+		//失敗したものを入れると次からnullptrが返り続けるので入れない
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.failures++;
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto [pipelineState, isInserted] = pipelineStates.emplace(key, created);
+	if (isInserted)
+	{
+		stats.creates++;
+		stats.diskHits += isDiskHit ? 1 : 0;
+		stats.diskRejects += isDiskRejected ? 1 : 0;
+	}
+	else
+	{
+		stats.hits++;
+	}
+	return pipelineState->second.Get();
+}
+
+void PipelineCache::Precompile(const D3D12_GRAPHICS_PIPELINE_STATE_DESC* _descs, uint32_t _count, ThreadPool* _threadPool)
+{
+	auto create = [&](uint32_t _index) { GetOrCreate(_descs[_index]); };
+	if (_threadPool != nullptr && 1 < _count)
+	{
+		_threadPool->ParallelFor(_count, create);
+	}
+	else
+	{
+		for (uint32_t index = 0; index < _count; index++)
+		{
+			create(index);
+		}
+	}
+}
+
+Microsoft::WRL::ComPtr<ID3D12PipelineState> PipelineCache::Remove(uint64_t _key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto pipelineState = pipelineStates.find(_key);
+	if (pipelineState == pipelineStates.end())
+	{
+		return nullptr;
+	}
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> removed = std::move(pipelineState->second);
+	pipelineStates.erase(pipelineState);
+	return removed;
+}
+
+bool PipelineCache::Load(const std::string& _path)
+{
+	PipelineBlobMap blobs;
+	bool isLoaded = LoadPipelineBlobs(_path, blobs);
+	std::lock_guard<std::mutex> lock(mutex);
+	diskBlobs = std::move(blobs);
+	return isLoaded;
+}
+
+bool PipelineCache::Save(const std::string& _path) const
+{
+	//今回作ったPSOの分だけ保存する 読んだが使わなかったキャッシュは古い設定のものなので持ち越さない
+	PipelineBlobMap blobs;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& [key, pipelineState] : pipelineStates)
+		{
+			Microsoft::WRL::ComPtr<ID3DBlob> blob = nullptr;
+			if (FAILED(pipelineState->GetCachedBlob(&blob)))
+			{
+				continue;
+			}
+			const unsigned char* data = static_cast<const unsigned char*>(blob->GetBufferPointer());
+			blobs[key].assign(data, data + blob->GetBufferSize());
+		}
+	}
+	return SavePipelineBlobs(_path, blobs);
+}
+
+uint32_t PipelineCache::GetCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return static_cast<uint32_t>(pipelineStates.size());
+}
+
+PipelineCacheStats PipelineCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
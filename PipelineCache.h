@@ -0,0 +1,83 @@
+#pragma once
+#include "PipelineCacheFile.h"
+#include <d3d12.h>
+#include <wrl.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class ThreadPool;
+
+/// <summary>
+/// PSOキャッシュの統計 (デバッグ表示用)
+/// </summary>
+struct PipelineCacheStats
+{
+	uint32_t hits;			//作ってあったものを返した数
+	uint32_t creates;		//新しく作った数
+	uint32_t diskHits;		//そのうちファイルのキャッシュから作れた数
+	uint32_t diskRejects;	//ファイルのキャッシュが使えなかった数 (ドライバが変わったなど)
+	uint32_t failures;		//作れなかった数 (シェーダーとルートシグネチャが合わないなど)
+};
+
+/// <summary>
+/// PSOを設定 (D3D12_GRAPHICS_PIPELINE_STATE_DESC) の中身とシェーダーのバイトコードから作ったキーで持つ
+/// 同じ設定ならもう一度作らずに返す 作ったPSOのドライバ向けのキャッシュをファイルに保存し，次に起動したときはそこから作る
+/// GetOrCreateとPrecompileは複数のスレッドから呼んでよい
+/// </summary>
+class PipelineCache
+{
+public:
+	explicit PipelineCache(ID3D12Device* _device);
+
+	/// <summary>
+	/// ルートシグネチャを登録する ポインタは起動ごとに変わるので，キーにはシリアライズした中身を使う
+	/// 設定に使うルートシグネチャはすべて先に登録しておく
+	/// </summary>
+	void RegisterRootSignature(ID3D12RootSignature* _rootSignature, const void* _serialized, size_t _size);
+
+	/// <summary>
+	/// 設定のキーを作る 結果に影響しない値 (使わないRTVの形式，無効なブレンドの係数など) は無視する
+	/// </summary>
+	uint64_t CalculateKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& _desc) const;
+	/// <summary>
+	/// _descのPSOを返す なければ作る (ファイルのキャッシュがあればそれを使う)
+	/// 作れなかったときはキャッシュに入れないので，次に同じ設定で呼ぶともう一度作ろうとする
+	/// </summary>
+	/// <returns>キャッシュが持つPSO キャッシュより長く持たないこと 作れなければnullptr</returns>
+	ID3D12PipelineState* GetOrCreate(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& _desc);
+	/// <summary>
+	/// _count個の設定のPSOをスレッドプールで並列に作っておく 全部作り終えるまで戻らない
+	/// 作れなかったものはキャッシュに入らないので，使う前にGetOrCreateで確かめる
+	/// </summary>
+	/// <param name="_threadPool">nullptrなら呼び出し元だけで作る</param>
+	void Precompile(const D3D12_GRAPHICS_PIPELINE_STATE_DESC* _descs, uint32_t _count, ThreadPool* _threadPool);
+	/// <summary>
+	/// _keyのPSOをキャッシュから外す 外したものはSaveにも含まれない
+	/// GPUがまだ使っているかもしれないので，解放は呼び出し側が使い終わるまで戻り値を持って待つ
+	/// </summary>
+	/// <returns>外したPSO なければnullptr</returns>
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> Remove(uint64_t _key);
+
+	/// <summary>
+	/// 前回保存したキャッシュを読む 読めなければ何もしない
+	/// GetOrCreateやPrecompileより前に呼ぶこと
+	/// </summary>
+	bool Load(const std::string& _path);
+	/// <summary>
+	/// 持っているPSOのキャッシュを保存する 読んだが使わなかったキャッシュは捨てる
+	/// </summary>
+	bool Save(const std::string& _path) const;
+
+	uint32_t GetCount() const;
+	PipelineCacheStats GetStats() const;
+
+private:
+	ID3D12Device* device;
+	mutable std::mutex mutex;
+	std::unordered_map<ID3D12RootSignature*, uint64_t> rootSignatureKeys;
+	std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D12PipelineState>> pipelineStates;
+	PipelineBlobMap diskBlobs;	//ファイルから読んだキャッシュ
+	PipelineCacheStats stats;
+};
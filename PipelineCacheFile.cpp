@@ -0,0 +1,102 @@
+#include "PipelineCacheFile.h"
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const uint32_t kFileMagic = 0x434F5350;	//"PSOC"
+	//形式を変えたら上げる 古いファイルは読まずに作り直す
+	const uint32_t kFileVersion = 1;
+	//壊れたファイルで大きな確保をしないための上限
+	const uint32_t kMaxBlobSize = 64 * 1024 * 1024;
+
+	template <class T>
+	bool Read(std::ifstream& _file, T& _value)
+	{
+		return static_cast<bool>(_file.read(reinterpret_cast<char*>(&_value), sizeof(T)));
+	}
+
+	template <class T>
+	void Write(std::ofstream& _file, const T& _value)
+	{
+		_file.write(reinterpret_cast<const char*>(&_value), sizeof(T));
+	}
+}
+
+void PipelineHash::AddBytes(const void* _data, size_t _size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(_data);
+	for (size_t index = 0; index < _size; index++)
+	{
+		value ^= bytes[index];
+		value *= 1099511628211ull;
+	}
+}
+
+void PipelineHash::AddString(const char* _string)
+{
+	if (_string == nullptr)
+	{
+		Add(UINT64_MAX);
+		return;
+	}
+	const uint64_t length = std::strlen(_string);
+	Add(length);
+	AddBytes(_string, length);
+}
+
+bool LoadPipelineBlobs(const std::string& _path, PipelineBlobMap& _blobs)
+{
+	_blobs.clear();
+	std::ifstream file(_path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	uint32_t count = 0;
+	if (!Read(file, magic) || !Read(file, version) || !Read(file, count) || magic != kFileMagic || version != kFileVersion)
+	{
+		return false;
+	}
+	for (uint32_t entry = 0; entry < count; entry++)
+	{
+		uint64_t key = 0;
+		uint32_t size = 0;
+		if (!Read(file, key) || !Read(file, size) || kMaxBlobSize < size)
+		{
+			_blobs.clear();
+			return false;
+		}
+		std::vector<unsigned char>& blob = _blobs[key];
+		blob.resize(size);
+		if (!file.read(reinterpret_cast<char*>(blob.data()), size))
+		{
+			_blobs.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SavePipelineBlobs(const std::string& _path, const PipelineBlobMap& _blobs)
+{
+	std::ofstream file(_path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+
+	Write(file, kFileMagic);
+	Write(file, kFileVersion);
+	Write(file, static_cast<uint32_t>(_blobs.size()));
+	for (const auto& [key, blob] : _blobs)
+	{
+		Write(file, key);
+		Write(file, static_cast<uint32_t>(blob.size()));
+		file.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+	}
+	return static_cast<bool>(file);
+}
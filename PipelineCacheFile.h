@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// PSOのキャッシュのキーを作るハッシュ (FNV-1a 64bit)
+/// 構造体をまるごと入れるとパディングの中身まで混ざるので，値は1つずつ入れる
+/// </summary>
+class PipelineHash
+{
+public:
+	void AddBytes(const void* _data, size_t _size);
+	/// <summary>
+	/// 整数や列挙型などパディングのない値を入れる
+	/// </summary>
+	template <class T>
+	void Add(const T& _value) { AddBytes(&_value, sizeof(T)); }
+	/// <summary>
+	/// 終端までの文字列と長さを入れる nullptrは空文字列と区別する
+	/// </summary>
+	void AddString(const char* _string);
+
+	uint64_t GetValue() const { return value; }
+
+private:
+	uint64_t value = 14695981039346656037ull;
+};
+
+/// <summary>
+/// キーごとのPSOのキャッシュ (ID3D12PipelineState::GetCachedBlobで取り出したもの)
+/// </summary>
+using PipelineBlobMap = std::unordered_map<uint64_t, std::vector<unsigned char>>;
+
+/// <summary>
+/// ファイルからキャッシュを読む
+/// </summary>
+/// <returns>ファイルがない，または形式が違うならfalseで，_blobsは空になる</returns>
+bool LoadPipelineBlobs(const std::string& _path, PipelineBlobMap& _blobs);
+/// <summary>
+/// キャッシュをファイルへ書く
+/// </summary>
+/// <returns>書き込めなかったらfalse</returns>
+bool SavePipelineBlobs(const std::string& _path, const PipelineBlobMap& _blobs);
@@ -0,0 +1,281 @@
+#include "RenderQueue.h"
+#include "myLib/RadixSort.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const uint32_t kPassBits = 4;
+	const uint32_t kPipelineStateBits = 12;
+	const uint32_t kRootSignatureBits = 8;
+	const uint32_t kTextureBits = 16;
+	const uint32_t kDepthBits = 24;
+
+	/// <summary>
+	/// ソートキーのPSOとルートシグネチャを差し替える
+	/// </summary>
+	uint64_t ReplaceSortKeyState(uint64_t _key, uint32_t _pipelineState, uint32_t _rootSignature)
+	{
+		assert(_pipelineState < (1u << kPipelineStateBits));
+		assert(_rootSignature < (1u << kRootSignatureBits));
+		const uint32_t rootSignatureShift = kTextureBits + kDepthBits;
+		const uint32_t pipelineStateShift = rootSignatureShift + kRootSignatureBits;
+		const uint64_t mask = ((uint64_t(1) << (kPipelineStateBits + kRootSignatureBits)) - 1) << rootSignatureShift;
+		return (_key & ~mask) | (uint64_t(_pipelineState) << pipelineStateShift) | (uint64_t(_rootSignature) << rootSignatureShift);
+	}
+}
+
+uint64_t MakeSortKey(RenderPass _pass, uint32_t _pipelineState, uint32_t _rootSignature, uint32_t _texture, uint32_t _depth)
+{
+	assert(static_cast<uint32_t>(_pass) < (1u << kPassBits));
+	assert(_pipelineState < (1u << kPipelineStateBits));
+	assert(_rootSignature < (1u << kRootSignatureBits));
+	assert(_texture < (1u << kTextureBits));
+	assert(_depth < (1u << kDepthBits));
+
+	uint64_t key = static_cast<uint64_t>(_pass);
+	key = (key << kPipelineStateBits) | _pipelineState;
+	key = (key << kRootSignatureBits) | _rootSignature;
+	key = (key << kTextureBits) | _texture;
+	//半透明は奥から描かないとブレンドの結果が変わるので，深度を反転して遠いものほど前に並べる
+	const uint32_t depth = _pass == RenderPass::kTransparent ? ((1u << kDepthBits) - 1) - _depth : _depth;
+	key = (key << kDepthBits) | depth;
+	return key;
+}
+
+uint32_t QuantizeDepth(float _viewDepth, float _nearZ, float _farZ)
+{
+	const float maxDepth = float((1u << kDepthBits) - 1);
+	float normalized = std::clamp((_viewDepth - _nearZ) / (_farZ - _nearZ), 0.0f, 1.0f);
+	return static_cast<uint32_t>(normalized * maxDepth);
+}
+
+RenderQueue::RenderQueue(ThreadPool* _threadPool) :
+	threadPool(_threadPool),
+	stats{}
+{
+}
+
+void RenderQueue::Clear()
+{
+	packets.clear();
+	sortKeys.clear();
+	drawOrder.clear();
+	instanceRecords.clear();
+	instanceBytes.clear();
+	stats.instancedPackets = 0;
+	stats.instancedDraws = 0;
+}
+
+void RenderQueue::Submit(const DrawPacket& _packet)
+{
+	assert(_packet.bindingCount <= kMaxRootBindings);
+	drawOrder.push_back(static_cast<uint32_t>(packets.size()));
+	sortKeys.push_back(_packet.sortKey);
+	packets.push_back(_packet);
+	instanceRecords.push_back({ kRenderInvalidIndex, 0, 0 });
+}
+
+void RenderQueue::Submit(const DrawPacket& _packet, uint32_t _instanceBinding, const void* _instanceData, uint32_t _instanceSize)
+{
+	assert(_instanceBinding < _packet.bindingCount);
+	assert(_packet.instanceCount == 1);
+	assert(0 < _instanceSize);
+	Submit(_packet);
+
+	InstanceRecord& record = instanceRecords.back();
+	record.binding = _instanceBinding;
+	record.offset = static_cast<uint32_t>(instanceBytes.size());
+	record.size = _instanceSize;
+	const unsigned char* bytes = static_cast<const unsigned char*>(_instanceData);
+	instanceBytes.insert(instanceBytes.end(), bytes, bytes + _instanceSize);
+}
+
+void RenderQueue::SetInstancing(uint32_t _pipelineState, const InstancingDesc& _desc)
+{
+	for (std::pair<uint32_t, InstancingDesc>& instancing : instancings)
+	{
+		if (instancing.first == _pipelineState)
+		{
+			instancing.second = _desc;
+			return;
+		}
+	}
+	instancings.push_back({ _pipelineState, _desc });
+}
+
+void RenderQueue::BuildInstanceBatches(const std::function<LinearAllocation(size_t)>& _allocate)
+{
+	const uint32_t count = GetPacketCount();
+	batchCandidates.clear();
+	for (uint32_t index = 0; index < count; index++)
+	{
+		if (instanceRecords[index].binding != kRenderInvalidIndex && FindInstancing(packets[index].pipelineState) != nullptr)
+		{
+			batchCandidates.push_back(index);
+		}
+	}
+	if (batchCandidates.empty())
+	{
+		return;
+	}
+
+	//まとめられるものを隣り合わせる 同じ組の中は積んだ順
+	std::sort(batchCandidates.begin(), batchCandidates.end(), [this](uint32_t _left, uint32_t _right)
+		{
+			int compare = CompareBatch(_left, _right);
+			return compare != 0 ? compare < 0 : _left < _right;
+		});
+
+	batchedPackets.clear();
+	for (size_t begin = 0; begin < batchCandidates.size();)
+	{
+		size_t end = begin + 1;
+		while (end < batchCandidates.size() && CompareBatch(batchCandidates[begin], batchCandidates[end]) == 0)
+		{
+			end++;
+		}
+
+		const uint32_t first = batchCandidates[begin];
+		const InstanceRecord& firstRecord = instanceRecords[first];
+		const InstancingDesc& instancing = *FindInstancing(packets[first].pipelineState);
+		const uint32_t instanceCount = static_cast<uint32_t>(end - begin);
+		LinearAllocation allocation = _allocate(size_t(firstRecord.size) * instanceCount);
+		assert(allocation.cpuAddress != nullptr);
+
+		//深度は組の中で最も先に描くもの (不透明なら最も手前) を使う
+		uint64_t sortKey = UINT64_MAX;
+		unsigned char* destination = static_cast<unsigned char*>(allocation.cpuAddress);
+		for (size_t candidate = begin; candidate < end; candidate++)
+		{
+			const uint32_t index = batchCandidates[candidate];
+			std::memcpy(destination, &instanceBytes[instanceRecords[index].offset], firstRecord.size);
+			destination += firstRecord.size;
+			sortKey = (std::min)(sortKey, packets[index].sortKey);
+		}
+
+		DrawPacket batch = packets[first];
+		batch.sortKey = ReplaceSortKeyState(sortKey, instancing.pipelineState, instancing.rootSignature);
+		batch.pipelineState = instancing.pipelineState;
+		batch.rootSignature = instancing.rootSignature;
+		batch.instanceCount = instanceCount;
+		batch.bindings[firstRecord.binding] = { instancing.rootParameter, RootBindingType::kShaderResource, allocation.gpuAddress };
+		batchedPackets.push_back(batch);
+		begin = end;
+	}
+
+	//まとめたパケットを抜いて詰め，代わりにインスタンス描画を足す
+	for (uint32_t index : batchCandidates)
+	{
+		packets[index].instanceCount = 0;
+	}
+	uint32_t remain = 0;
+	for (uint32_t index = 0; index < count; index++)
+	{
+		if (packets[index].instanceCount != 0)
+		{
+			packets[remain] = packets[index];
+			instanceRecords[remain] = instanceRecords[index];
+			remain++;
+		}
+	}
+	packets.resize(remain);
+	instanceRecords.resize(remain);
+	for (const DrawPacket& batch : batchedPackets)
+	{
+		packets.push_back(batch);
+		instanceRecords.push_back({ kRenderInvalidIndex, 0, 0 });
+	}
+
+	sortKeys.resize(packets.size());
+	drawOrder.resize(packets.size());
+	for (uint32_t index = 0; index < GetPacketCount(); index++)
+	{
+		sortKeys[index] = packets[index].sortKey;
+		drawOrder[index] = index;
+	}
+	stats.instancedPackets = static_cast<uint32_t>(batchCandidates.size());
+	stats.instancedDraws = static_cast<uint32_t>(batchedPackets.size());
+}
+
+const InstancingDesc* RenderQueue::FindInstancing(uint32_t _pipelineState) const
+{
+	for (const std::pair<uint32_t, InstancingDesc>& instancing : instancings)
+	{
+		if (instancing.first == _pipelineState)
+		{
+			return &instancing.second;
+		}
+	}
+	return nullptr;
+}
+
+int RenderQueue::CompareBatch(uint32_t _left, uint32_t _right) const
+{
+	auto compare = [](uint64_t _a, uint64_t _b) { return _a < _b ? -1 : (_b < _a ? 1 : 0); };
+	const DrawPacket& left = packets[_left];
+	const DrawPacket& right = packets[_right];
+	const InstanceRecord& leftRecord = instanceRecords[_left];
+	const InstanceRecord& rightRecord = instanceRecords[_right];
+
+	//深度より上のキー (パス，PSO，ルートシグネチャ，テクスチャ) から比べる
+	const uint64_t values[][2] =
+	{
+		{ left.sortKey >> kDepthBits, right.sortKey >> kDepthBits },
+		{ left.pipelineState, right.pipelineState },
+		{ left.rootSignature, right.rootSignature },
+		{ left.vertexBuffer, right.vertexBuffer },
+		{ left.indexBuffer, right.indexBuffer },
+		{ left.count, right.count },
+		{ left.bindingCount, right.bindingCount },
+		{ leftRecord.binding, rightRecord.binding },
+		{ leftRecord.size, rightRecord.size },
+	};
+	for (const uint64_t* value : values)
+	{
+		if (int result = compare(value[0], value[1]); result != 0)
+		{
+			return result;
+		}
+	}
+	for (uint32_t binding = 0; binding < left.bindingCount; binding++)
+	{
+		if (binding == leftRecord.binding)
+		{
+			continue;
+		}
+		const RootBinding& a = left.bindings[binding];
+		const RootBinding& b = right.bindings[binding];
+		int result = compare(a.rootParameter, b.rootParameter);
+		result = result != 0 ? result : compare(static_cast<uint32_t>(a.type), static_cast<uint32_t>(b.type));
+		result = result != 0 ? result : compare(a.value, b.value);
+		if (result != 0)
+		{
+			return result;
+		}
+	}
+	return 0;
+}
+
+uint32_t RenderQueue::CalculateChunkCount(uint32_t _maxChunks, uint32_t _minDrawsPerChunk) const
+{
+	assert(0 < _maxChunks);
+	assert(0 < _minDrawsPerChunk);
+	return std::clamp(GetPacketCount() / _minDrawsPerChunk, 1u, _maxChunks);
+}
+
+uint32_t RenderQueue::GetChunkBegin(uint32_t _chunk, uint32_t _chunkCount) const
+{
+	assert(_chunk <= _chunkCount);
+	//範囲の大きさの差は1以下になる
+	return static_cast<uint32_t>(uint64_t(GetPacketCount()) * _chunk / _chunkCount);
+}
+
+void RenderQueue::Sort()
+{
+	const uint32_t count = GetPacketCount();
+	sortKeysTemp.resize(count);
+	drawOrderTemp.resize(count);
+	RadixSort(sortKeys.data(), drawOrder.data(), sortKeysTemp.data(), drawOrderTemp.data(), sortHistograms, count, threadPool);
+}
@@ -0,0 +1,317 @@
+#pragma once
+#include "LinearAllocator.h"
+#include "myLib/ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+//使わないバッファ・無効な状態を表す番号
+static const uint32_t kRenderInvalidIndex = UINT32_MAX;
+//1つの描画で設定できるルートパラメータの数
+static const uint32_t kMaxRootBindings = 7;
+//状態を追跡するルートパラメータ番号の上限
+static const uint32_t kMaxRootParameters = 16;
+
+/// <summary>
+/// 描画パス ソートキーの最上位に入るので，小さいものから先に描かれる
+/// </summary>
+enum class RenderPass : uint32_t
+{
+	kOpaque,
+	kTransparent,
+	kOverlay,
+};
+
+enum class RootBindingType : uint32_t
+{
+	kConstantBuffer,	//valueはGPU仮想アドレス
+	kDescriptorTable,	//valueはGPUディスクリプタハンドル
+	kShaderResource,	//valueはGPU仮想アドレス (ルートSRV)
+	kConstant,			//valueは32bitのルート定数
+};
+
+/// <summary>
+/// ルートパラメータ1つ分の設定
+/// </summary>
+struct RootBinding
+{
+	uint32_t rootParameter;
+	RootBindingType type;
+	uint64_t value;
+};
+
+/// <summary>
+/// 1回の描画に必要な情報 PSOなどはバックエンドが持つ表の番号で指す
+/// </summary>
+struct DrawPacket
+{
+	uint64_t sortKey;			//MakeSortKeyで作る
+	uint32_t pipelineState;
+	uint32_t rootSignature;
+	uint32_t vertexBuffer;
+	uint32_t indexBuffer;		//kRenderInvalidIndexなら非インデックス描画
+	uint32_t count;				//頂点数 (インデックス描画ならインデックス数)
+	uint32_t instanceCount;
+	uint32_t bindingCount;
+	RootBinding bindings[kMaxRootBindings];
+};
+
+/// <summary>
+/// 同じPSOの描画をまとめてインスタンス描画にするときの設定
+/// </summary>
+struct InstancingDesc
+{
+	uint32_t pipelineState;		//個別データをSV_InstanceIDで引く頂点シェーダーのPSO
+	uint32_t rootSignature;
+	uint32_t rootParameter;		//個別データのStructuredBufferを設定するルートパラメータ
+};
+
+/// <summary>
+/// 描画パケットのソートキーを作る
+/// 上位から パス(4bit) PSO(12bit) ルートシグネチャ(8bit) テクスチャ(16bit) 深度(24bit)
+/// 同じ状態の描画が隣り合い，その中では手前から描かれる kTransparentだけは深度を反転して奥から描かれる
+/// </summary>
+/// <param name="_depth">QuantizeDepthで量子化した深度</param>
+uint64_t MakeSortKey(RenderPass _pass, uint32_t _pipelineState, uint32_t _rootSignature, uint32_t _texture, uint32_t _depth);
+
+/// <summary>
+/// ビュー空間の深度を[_nearZ, _farZ]で24bitに量子化する 範囲外は端に寄せる
+/// </summary>
+uint32_t QuantizeDepth(float _viewDepth, float _nearZ, float _farZ);
+
+/// <summary>
+/// 描画キューの統計 (デバッグ表示用)
+/// </summary>
+struct RenderQueueStats
+{
+	uint32_t packets;					//描画数
+	uint32_t stateChanges;				//バックエンドへ積んだ状態の設定数
+	uint32_t redundantStateChanges;		//直前と同じだったので積まなかった設定数
+	uint32_t instancedPackets;			//インスタンス描画にまとめたパケット数
+	uint32_t instancedDraws;			//まとめてできたインスタンス描画の数
+	uint32_t chunks;					//分けて積んだ範囲 (コマンドリスト) の数
+};
+
+/// <summary>
+/// 描画パケットを集め，ソートキーで並べて状態が変わったところだけ設定しながら描く
+/// バックエンドは次の関数を持つ型 (D3D12のコマンドリストへ積むもの，テスト用に数えるもの など)
+///   SetRootSignature(uint32_t) SetPipelineState(uint32_t) SetVertexBuffer(uint32_t) SetIndexBuffer(uint32_t)
+///   SetConstantBuffer(uint32_t rootParameter, uint64_t address) SetDescriptorTable(uint32_t rootParameter, uint64_t handle)
+///   SetShaderResource(uint32_t rootParameter, uint64_t address) SetConstant(uint32_t rootParameter, uint32_t value)
+///   Draw(const DrawPacket&)
+/// </summary>
+class RenderQueue
+{
+public:
+	/// <param name="_threadPool">ソートの並列化に使う nullptrなら単一スレッド</param>
+	explicit RenderQueue(ThreadPool* _threadPool);
+
+	void Clear();
+	void Submit(const DrawPacket& _packet);
+	/// <summary>
+	/// 描画ごとに違うデータ (TransformationMatrixなど) を持つ描画を積む
+	/// BuildInstanceBatchesで，このデータ以外が同じ描画を1つのインスタンス描画にまとめる
+	/// </summary>
+	/// <param name="_instanceBinding">個別データを設定しているbindingsの番号 まとめたときはSRVに置き換わる</param>
+	/// <param name="_instanceData">個別データ コピーして持つ</param>
+	/// <param name="_instanceSize">個別データのバイト数 (StructuredBufferの要素の大きさ)</param>
+	void Submit(const DrawPacket& _packet, uint32_t _instanceBinding, const void* _instanceData, uint32_t _instanceSize);
+
+	/// <summary>
+	/// _pipelineStateの描画をインスタンス描画にまとめるときの設定を登録する
+	/// 登録したPSOの描画は1つだけでもインスタンス描画にするので，個別データのbindingは使われない
+	/// </summary>
+	void SetInstancing(uint32_t _pipelineState, const InstancingDesc& _desc);
+	/// <summary>
+	/// 個別データ以外 (PSO，頂点バッファ，マテリアル，テクスチャなど) が同じ描画を1つのインスタンス描画に置き換える
+	/// Sortの前に1回だけ呼ぶ 個別データは積んだ順に並べる
+	/// </summary>
+	/// <param name="_allocate">バイト数を受け取り，このフレームの間有効な書き込み先を返す (LinearAllocator::Allocateなど)</param>
+	void BuildInstanceBatches(const std::function<LinearAllocation(size_t)>& _allocate);
+	/// <summary>
+	/// ソートキーで基数ソートする 同じキーは積んだ順のまま
+	/// </summary>
+	void Sort();
+
+	/// <summary>
+	/// ソート済みの順に描く 直前と同じ状態は設定しない
+	/// ルートシグネチャが変わるとルートパラメータは設定し直す (D3D12と同じ)
+	/// </summary>
+	template <class Backend>
+	void Execute(Backend& _backend);
+	/// <summary>
+	/// 描画順を_chunkCount個の連続した範囲に分け，範囲ごとに別のバックエンド (コマンドリスト) へ並列に積む
+	/// どの範囲も状態を設定し直してから描くので，積んだコマンドリストを範囲の順に実行すればExecuteと同じ結果になる
+	/// </summary>
+	/// <param name="_backends">_chunkCount個のバックエンド i番目の範囲は_backends[i]へ積む</param>
+	/// <param name="_chunkCount">CalculateChunkCountで決めた分割数</param>
+	template <class Backend>
+	void ExecuteParallel(Backend* _backends, uint32_t _chunkCount);
+	/// <summary>
+	/// 1つの範囲が_minDrawsPerChunk以上になるように，_maxChunks以下で分割数を決める 描画がなくても1
+	/// </summary>
+	uint32_t CalculateChunkCount(uint32_t _maxChunks, uint32_t _minDrawsPerChunk) const;
+	/// <summary>
+	/// _chunkCount個に分けたときの_chunk番目の範囲の始まり (描画順での位置) _chunk == _chunkCountなら終わり
+	/// </summary>
+	uint32_t GetChunkBegin(uint32_t _chunk, uint32_t _chunkCount) const;
+
+	uint32_t GetPacketCount() const { return static_cast<uint32_t>(packets.size()); }
+	const RenderQueueStats& GetStats() const { return stats; }
+
+private:
+	/// <summary>
+	/// パケットごとの個別データの位置 まとめない描画はbindingがkRenderInvalidIndex
+	/// </summary>
+	struct InstanceRecord
+	{
+		uint32_t binding;
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	const InstancingDesc* FindInstancing(uint32_t _pipelineState) const;
+	/// <summary>
+	/// まとめられるかの並び順 個別データ以外を比べる
+	/// </summary>
+	int CompareBatch(uint32_t _left, uint32_t _right) const;
+	/// <summary>
+	/// 描画順の[_begin, _end)を積む 状態は何も設定されていないところから始める
+	/// </summary>
+	template <class Backend>
+	void ExecuteRange(Backend& _backend, uint32_t _begin, uint32_t _end, RenderQueueStats& _stats) const;
+
+	ThreadPool* threadPool;
+	std::vector<DrawPacket> packets;
+	std::vector<InstanceRecord> instanceRecords;
+	std::vector<unsigned char> instanceBytes;
+	std::vector<std::pair<uint32_t, InstancingDesc>> instancings;	//元のPSOと設定
+	std::vector<uint32_t> batchCandidates;
+	std::vector<DrawPacket> batchedPackets;
+	std::vector<uint64_t> sortKeys;
+	std::vector<uint32_t> drawOrder;	//ソート後の描画順のパケット番号
+	std::vector<uint64_t> sortKeysTemp;
+	std::vector<uint32_t> drawOrderTemp;
+	std::vector<uint32_t> sortHistograms;	//基数ソートの作業用
+	std::vector<RenderQueueStats> chunkStats;	//ExecuteParallelで範囲ごとに数える
+	RenderQueueStats stats;
+};
+
+template<class Backend>
+inline void RenderQueue::Execute(Backend& _backend)
+{
+	//まとめた数はBuildInstanceBatchesで数えてあるので残す
+	stats.packets = GetPacketCount();
+	stats.stateChanges = 0;
+	stats.redundantStateChanges = 0;
+	stats.chunks = 1;
+	ExecuteRange(_backend, 0, GetPacketCount(), stats);
+}
+
+template<class Backend>
+inline void RenderQueue::ExecuteParallel(Backend* _backends, uint32_t _chunkCount)
+{
+	assert(0 < _chunkCount);
+	stats.packets = GetPacketCount();
+	stats.stateChanges = 0;
+	stats.redundantStateChanges = 0;
+	stats.chunks = _chunkCount;
+
+	chunkStats.assign(_chunkCount, RenderQueueStats{});
+	auto executeChunk = [&](uint32_t _chunk)
+		{
+			ExecuteRange(_backends[_chunk], GetChunkBegin(_chunk, _chunkCount), GetChunkBegin(_chunk + 1, _chunkCount), chunkStats[_chunk]);
+		};
+	if (threadPool != nullptr && 1 < _chunkCount)
+	{
+		threadPool->ParallelFor(_chunkCount, executeChunk);
+	}
+	else
+	{
+		for (uint32_t chunk = 0; chunk < _chunkCount; chunk++)
+		{
+			executeChunk(chunk);
+		}
+	}
+
+	for (const RenderQueueStats& chunk : chunkStats)
+	{
+		stats.stateChanges += chunk.stateChanges;
+		stats.redundantStateChanges += chunk.redundantStateChanges;
+	}
+}
+
+template<class Backend>
+inline void RenderQueue::ExecuteRange(Backend& _backend, uint32_t _begin, uint32_t _end, RenderQueueStats& _stats) const
+{
+	uint32_t rootSignature = kRenderInvalidIndex;
+	uint32_t pipelineState = kRenderInvalidIndex;
+	uint32_t vertexBuffer = kRenderInvalidIndex;
+	uint32_t indexBuffer = kRenderInvalidIndex;
+	bool isBound[kMaxRootParameters] = {};
+	uint64_t boundValues[kMaxRootParameters] = {};
+
+	//値が変わったときだけ_setを呼ぶ
+	auto update = [&_stats](uint32_t& _current, uint32_t _next, const auto& _set)
+		{
+			if (_current == _next)
+			{
+				_stats.redundantStateChanges++;
+				return;
+			}
+			_current = _next;
+			_set(_next);
+			_stats.stateChanges++;
+		};
+
+	for (uint32_t order = _begin; order < _end; order++)
+	{
+		const DrawPacket& packet = packets[drawOrder[order]];
+		if (rootSignature != packet.rootSignature)
+		{
+			std::fill(std::begin(isBound), std::end(isBound), false);
+		}
+		update(rootSignature, packet.rootSignature, [&](uint32_t _value) { _backend.SetRootSignature(_value); });
+		update(pipelineState, packet.pipelineState, [&](uint32_t _value) { _backend.SetPipelineState(_value); });
+		update(vertexBuffer, packet.vertexBuffer, [&](uint32_t _value) { _backend.SetVertexBuffer(_value); });
+		if (packet.indexBuffer != kRenderInvalidIndex)
+		{
+			update(indexBuffer, packet.indexBuffer, [&](uint32_t _value) { _backend.SetIndexBuffer(_value); });
+		}
+
+		for (uint32_t binding = 0; binding < packet.bindingCount; binding++)
+		{
+			const RootBinding& rootBinding = packet.bindings[binding];
+			assert(rootBinding.rootParameter < kMaxRootParameters);
+			if (isBound[rootBinding.rootParameter] && boundValues[rootBinding.rootParameter] == rootBinding.value)
+			{
+				_stats.redundantStateChanges++;
+				continue;
+			}
+			isBound[rootBinding.rootParameter] = true;
+			boundValues[rootBinding.rootParameter] = rootBinding.value;
+			if (rootBinding.type == RootBindingType::kConstantBuffer)
+			{
+				_backend.SetConstantBuffer(rootBinding.rootParameter, rootBinding.value);
+			}
+			else if (rootBinding.type == RootBindingType::kDescriptorTable)
+			{
+				_backend.SetDescriptorTable(rootBinding.rootParameter, rootBinding.value);
+			}
+			else if (rootBinding.type == RootBindingType::kShaderResource)
+			{
+				_backend.SetShaderResource(rootBinding.rootParameter, rootBinding.value);
+			}
+			else
+			{
+				_backend.SetConstant(rootBinding.rootParameter, static_cast<uint32_t>(rootBinding.value));
+			}
+			_stats.stateChanges++;
+		}
+
+		_backend.Draw(packet);
+	}
+}
@@ -0,0 +1,556 @@
+#include "SelfTest.h"
+#include "RenderQueue.h"
+#include "LinearAllocator.h"
+#include "ShaderCache.h"
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+	/// <summary>
+	/// 呼び出しを数え，D3D12のコマンドリストと同じ規則で今の状態を追うだけのバックエンド
+	/// </summary>
+	struct RecordingBackend
+	{
+		uint32_t rootSignature;
+		uint32_t pipelineState;
+		uint32_t vertexBuffer;
+		uint32_t indexBuffer;
+		bool isBound[kMaxRootParameters];
+		RootBinding bound[kMaxRootParameters];
+		uint32_t calls;			//状態の設定の呼び出し数
+		uint32_t redundantCalls;	//今と同じ値を設定した数
+		uint32_t errors;		//描画時に状態が合わなかった数
+		std::vector<uint32_t> drawnOrders;	//描いた順の，パケットを積んだ順番 (countに入れてある)
+
+		RecordingBackend() :
+			rootSignature(kRenderInvalidIndex),
+			pipelineState(kRenderInvalidIndex),
+			vertexBuffer(kRenderInvalidIndex),
+			indexBuffer(kRenderInvalidIndex),
+			isBound{},
+			bound{},
+			calls(0),
+			redundantCalls(0),
+			errors(0)
+		{
+		}
+
+		void Set(uint32_t& _current, uint32_t _value)
+		{
+			calls++;
+			redundantCalls += _current == _value ? 1 : 0;
+			_current = _value;
+		}
+		void SetRootSignature(uint32_t _value)
+		{
+			//ルートシグネチャを設定するとルートパラメータはすべて未設定に戻る
+			std::fill(std::begin(isBound), std::end(isBound), false);
+			Set(rootSignature, _value);
+		}
+		void SetPipelineState(uint32_t _value) { Set(pipelineState, _value); }
+		void SetVertexBuffer(uint32_t _value) { Set(vertexBuffer, _value); }
+		void SetIndexBuffer(uint32_t _value) { Set(indexBuffer, _value); }
+		void Bind(uint32_t _rootParameter, RootBindingType _type, uint64_t _value)
+		{
+			calls++;
+			if (isBound[_rootParameter] && bound[_rootParameter].type == _type && bound[_rootParameter].value == _value)
+			{
+				redundantCalls++;
+			}
+			isBound[_rootParameter] = true;
+			bound[_rootParameter] = { _rootParameter, _type, _value };
+		}
+		void SetConstantBuffer(uint32_t _rootParameter, uint64_t _address) { Bind(_rootParameter, RootBindingType::kConstantBuffer, _address); }
+		void SetDescriptorTable(uint32_t _rootParameter, uint64_t _handle) { Bind(_rootParameter, RootBindingType::kDescriptorTable, _handle); }
+		void SetShaderResource(uint32_t _rootParameter, uint64_t _address) { Bind(_rootParameter, RootBindingType::kShaderResource, _address); }
+		void SetConstant(uint32_t _rootParameter, uint32_t _value) { Bind(_rootParameter, RootBindingType::kConstant, _value); }
+		void Draw(const DrawPacket& _packet)
+		{
+			bool isValid = rootSignature == _packet.rootSignature && pipelineState == _packet.pipelineState && vertexBuffer == _packet.vertexBuffer;
+			isValid = isValid && (_packet.indexBuffer == kRenderInvalidIndex || indexBuffer == _packet.indexBuffer);
+			for (uint32_t binding = 0; binding < _packet.bindingCount; binding++)
+			{
+				const RootBinding& expected = _packet.bindings[binding];
+				const RootBinding& actual = bound[expected.rootParameter];
+				isValid = isValid && isBound[expected.rootParameter] && actual.type == expected.type && actual.value == expected.value;
+			}
+			errors += isValid ? 0 : 1;
+			drawnOrders.push_back(_packet.count);
+		}
+	};
+
+	/// <summary>
+	/// 状態の種類を少なくした乱数のパケット 同じ状態が続くものも続かないものも混ざる
+	/// 描画数 (count) に積んだ順を入れておき，同じキーの順を確かめるのに使う
+	/// </summary>
+	DrawPacket MakeRandomPacket(std::mt19937& _randomEngine, uint32_t _order)
+	{
+		const RenderPass passes[] = { RenderPass::kOpaque, RenderPass::kTransparent, RenderPass::kOverlay };
+		const RootBindingType types[] = { RootBindingType::kConstantBuffer, RootBindingType::kDescriptorTable, RootBindingType::kShaderResource, RootBindingType::kConstant };
+		DrawPacket packet{};
+		packet.pipelineState = _randomEngine() % 4;
+		packet.rootSignature = _randomEngine() % 2;
+		packet.vertexBuffer = _randomEngine() % 3;
+		packet.indexBuffer = _randomEngine() % 3 == 0 ? kRenderInvalidIndex : _randomEngine() % 2;
+		packet.count = _order;
+		packet.instanceCount = 1;
+		//ルートパラメータはパケットの中で重ならないように順に選ぶ 種類はルートシグネチャで決まる
+		packet.bindingCount = 1 + _randomEngine() % 3;
+		uint32_t rootParameter = 0;
+		for (uint32_t binding = 0; binding < packet.bindingCount; binding++)
+		{
+			rootParameter += _randomEngine() % 2;
+			packet.bindings[binding] = { rootParameter, types[(rootParameter + packet.rootSignature) % 4], _randomEngine() % 3 };
+			rootParameter++;
+		}
+		packet.sortKey = MakeSortKey(passes[_randomEngine() % 3], packet.pipelineState, packet.rootSignature, _randomEngine() % 4, _randomEngine() % 8);
+		return packet;
+	}
+}
+
+RenderQueueTestResult TestRenderQueue(uint32_t _seed, uint32_t _rounds)
+{
+	const uint32_t kPackets = 1000;
+	std::mt19937 randomEngine(_seed);
+
+	RenderQueueTestResult result{};
+	RenderQueue renderQueue(nullptr);
+	std::vector<DrawPacket> submitted;
+	for (uint32_t round = 0; round < _rounds; round++)
+	{
+		renderQueue.Clear();
+		submitted.clear();
+		//積む数も回ごとに変えて，空のキューも確かめる
+		const uint32_t packetCount = round == 0 ? 0 : 1 + randomEngine() % kPackets;
+		for (uint32_t order = 0; order < packetCount; order++)
+		{
+			submitted.push_back(MakeRandomPacket(randomEngine, order));
+			renderQueue.Submit(submitted.back());
+		}
+		renderQueue.Sort();
+		RecordingBackend backend;
+		renderQueue.Execute(backend);
+
+		//ソートキーの順，同じキーは積んだ順 (countに入れた番号) に描かれているか
+		std::stable_sort(submitted.begin(), submitted.end(), [](const DrawPacket& _left, const DrawPacket& _right) { return _left.sortKey < _right.sortKey; });
+		uint32_t orderErrors = backend.drawnOrders.size() == submitted.size() ? 0 : 1;
+		for (size_t index = 0; orderErrors == 0 && index < submitted.size(); index++)
+		{
+			orderErrors += backend.drawnOrders[index] == submitted[index].count ? 0 : 1;
+		}
+
+		//すべての設定の要求は，積んだか，同じ値なので積まなかったかのどちらかに数えられる
+		uint32_t requests = 0;
+		for (const DrawPacket& packet : submitted)
+		{
+			requests += 3 + (packet.indexBuffer != kRenderInvalidIndex ? 1 : 0) + packet.bindingCount;
+		}
+		const RenderQueueStats& stats = renderQueue.GetStats();
+		uint32_t statsErrors = stats.packets == packetCount ? 0 : 1;
+		statsErrors += stats.stateChanges == backend.calls ? 0 : 1;
+		statsErrors += stats.stateChanges + stats.redundantStateChanges == requests ? 0 : 1;
+
+		result.packets += stats.packets;
+		result.stateChanges += stats.stateChanges;
+		result.redundantStateChanges += stats.redundantStateChanges;
+		result.errors += backend.errors + backend.redundantCalls + orderErrors + statsErrors;
+	}
+	return result;
+}
+
+RenderQueueChunkTestResult TestRenderQueueChunks(uint32_t _seed, uint32_t _rounds, uint32_t _maxChunks, ThreadPool* _threadPool)
+{
+	const uint32_t kPackets = 1000;
+	std::mt19937 randomEngine(_seed);
+
+	RenderQueueChunkTestResult result{};
+	RenderQueue renderQueue(_threadPool);
+	std::vector<RecordingBackend> backends;
+	for (uint32_t round = 0; round < _rounds; round++)
+	{
+		//範囲の数より描画が少ない回も混ぜる
+		renderQueue.Clear();
+		const uint32_t packetCount = randomEngine() % 4 == 0 ? randomEngine() % (_maxChunks + 1) : 1 + randomEngine() % kPackets;
+		for (uint32_t order = 0; order < packetCount; order++)
+		{
+			renderQueue.Submit(MakeRandomPacket(randomEngine, order));
+		}
+		renderQueue.Sort();
+		RecordingBackend reference;
+		renderQueue.Execute(reference);
+
+		const uint32_t minDraws = 1 + randomEngine() % 64;
+		const uint32_t calculated = renderQueue.CalculateChunkCount(_maxChunks, minDraws);
+		result.errors += (1 <= calculated && calculated <= _maxChunks && (calculated == 1 || minDraws * calculated <= packetCount)) ? 0 : 1;
+
+		for (uint32_t chunkCount = 1; chunkCount <= _maxChunks; chunkCount++)
+		{
+			backends.assign(chunkCount, RecordingBackend());
+			renderQueue.ExecuteParallel(backends.data(), chunkCount);
+			result.executions++;
+			result.chunks += chunkCount;
+
+			uint32_t calls = 0;
+			std::vector<uint32_t> drawnOrders;
+			for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				const RecordingBackend& backend = backends[chunk];
+				const uint32_t begin = renderQueue.GetChunkBegin(chunk, chunkCount);
+				const uint32_t end = renderQueue.GetChunkBegin(chunk + 1, chunkCount);
+				//範囲は先頭から終わりまで隙間なく続き，大きさの差は1以下
+				result.errors += (chunk != 0 || begin == 0) && begin <= end && end - begin <= packetCount / chunkCount + 1 && packetCount / chunkCount <= end - begin ? 0 : 1;
+				result.errors += backend.drawnOrders.size() == end - begin ? 0 : 1;
+				result.errors += backend.errors + backend.redundantCalls;
+				calls += backend.calls;
+				drawnOrders.insert(drawnOrders.end(), backend.drawnOrders.begin(), backend.drawnOrders.end());
+			}
+			result.errors += renderQueue.GetChunkBegin(chunkCount, chunkCount) == packetCount ? 0 : 1;
+			result.errors += drawnOrders == reference.drawnOrders ? 0 : 1;
+
+			const RenderQueueStats& stats = renderQueue.GetStats();
+			result.errors += (stats.chunks == chunkCount && stats.packets == packetCount && stats.stateChanges == calls) ? 0 : 1;
+		}
+	}
+	return result;
+}
+
+LinearAllocatorTestResult TestLinearAllocator(uint32_t _seed, uint32_t _frames)
+{
+	const size_t kAlignment = 256;
+	const size_t kCapacity = kAlignment * 256;
+	const uint32_t kMaxFramesInFlight = 3;
+	const uint64_t kGpuBase = 0x100000;
+	std::mt19937 randomEngine(_seed);
+
+	LinearAllocatorTestResult result{};
+	std::vector<unsigned char> buffer(kCapacity);
+	LinearAllocator allocator(buffer.data(), kGpuBase, kCapacity, kMaxFramesInFlight, kAlignment);
+	//_alignmentごとに，その範囲を使ったフレームのフェンス値 0なら空き
+	std::vector<uint64_t> owners(kCapacity / kAlignment, 0);
+	uint64_t completedFenceValue = 0;
+	for (uint32_t frame = 0; frame < _frames; frame++)
+	{
+		//このフレームのフェンス値はframe + 1 GPUは0から(kMaxFramesInFlight - 1)フレーム遅れて終える
+		const uint64_t fenceValue = frame + 1;
+		const uint64_t lag = randomEngine() % kMaxFramesInFlight;
+		completedFenceValue = (std::max)(completedFenceValue, frame < lag ? 0 : frame - lag);
+		allocator.BeginFrame(completedFenceValue);
+		//待っているフレームがなくなればすべて空く tailが戻されると使用中のまま残る
+		result.errors += (allocator.GetFramesInFlight() == 0 && allocator.GetUsedSize() != 0) ? 1 : 0;
+		for (uint64_t& owner : owners)
+		{
+			owner = owner <= completedFenceValue ? 0 : owner;
+		}
+
+		//小さなものを多く，時々容量の半分以上や容量ちょうどを切り出す
+		const uint32_t allocationCount = randomEngine() % 12;
+		for (uint32_t allocation = 0; allocation < allocationCount; allocation++)
+		{
+			const uint32_t kind = randomEngine() % 16;
+			const size_t size = kind == 0 ? kCapacity : (kind == 1 ? kCapacity / 2 + randomEngine() % (kCapacity / 2) : 1 + randomEngine() % (kCapacity / 8));
+			const bool isEmpty = allocator.GetUsedSize() == 0 && allocator.GetFramesInFlight() == 0;
+			const LinearAllocation linearAllocation = allocator.Allocate(size);
+			if (linearAllocation.cpuAddress == nullptr)
+			{
+				result.failures++;
+				//何も使っていなければ容量までは必ず切り出せる
+				result.errors += isEmpty ? 1 : 0;
+				continue;
+			}
+
+			result.allocations++;
+			const size_t offset = static_cast<unsigned char*>(linearAllocation.cpuAddress) - buffer.data();
+			if (offset % kAlignment != 0 || kCapacity < offset + size || linearAllocation.gpuAddress != kGpuBase + offset)
+			{
+				result.errors++;
+				continue;
+			}
+			for (size_t slot = offset / kAlignment; slot < (offset + size + kAlignment - 1) / kAlignment; slot++)
+			{
+				result.errors += owners[slot] == 0 ? 0 : 1;
+				owners[slot] = fenceValue;
+			}
+		}
+		result.errors += kCapacity < allocator.GetUsedSize() ? 1 : 0;
+		allocator.EndFrame(fenceValue);
+		result.frames++;
+	}
+	return result;
+}
+
+UploadRingTestResult TestUploadRing(uint32_t _seed, uint32_t _batches)
+{
+	//UploadManagerと同じくテクスチャのデータの置き場所の単位で切り出す
+	const size_t kAlignment = 512;
+	const size_t kCapacity = kAlignment * 64;
+	const uint32_t kMaxBatchesInFlight = 3;
+	const uint64_t kGpuBase = 0x200000;
+	std::mt19937 randomEngine(_seed);
+
+	UploadRingTestResult result{};
+	std::vector<unsigned char> buffer(kCapacity);
+	LinearAllocator allocator(buffer.data(), kGpuBase, kCapacity, kMaxBatchesInFlight, kAlignment);
+	//_alignmentごとに，その範囲を読むバッチのフェンス値 0なら空き
+	std::vector<uint64_t> owners(kCapacity / kAlignment, 0);
+	std::vector<uint64_t> batchFenceValues(kMaxBatchesInFlight, 0);
+	uint32_t batchIndex = 0;
+	uint64_t submittedFenceValue = 0;
+	uint64_t completedFenceValue = 0;
+	bool isRecording = false;
+	bool isBatchEmpty = true;
+
+	auto retire = [&]()
+		{
+			allocator.BeginFrame(completedFenceValue);
+			for (uint64_t& owner : owners)
+			{
+				owner = owner <= completedFenceValue ? 0 : owner;
+			}
+		};
+	auto beginBatch = [&]()
+		{
+			if (isRecording)
+			{
+				return;
+			}
+			//このバッチの枠を前に使ったバッチが終わるまで待つ
+			completedFenceValue = (std::max)(completedFenceValue, batchFenceValues[batchIndex]);
+			retire();
+			isRecording = true;
+			isBatchEmpty = true;
+		};
+	auto flush = [&]()
+		{
+			if (!isRecording)
+			{
+				return;
+			}
+			submittedFenceValue++;
+			batchFenceValues[batchIndex] = submittedFenceValue;
+			batchIndex = (batchIndex + 1) % kMaxBatchesInFlight;
+			allocator.EndFrame(submittedFenceValue);
+			isRecording = false;
+			result.batches++;
+			result.emptyBatches += isBatchEmpty ? 1 : 0;
+		};
+	auto waitIdle = [&]()
+		{
+			completedFenceValue = submittedFenceValue;
+			retire();
+		};
+	//UploadTextureと同じく，入らなければ送って待ってから入れ直し，ステージングより大きいものは専用のバッファにする
+	auto upload = [&](size_t _size)
+		{
+			beginBatch();
+			if (kCapacity < _size)
+			{
+				return;
+			}
+			LinearAllocation allocation = allocator.Allocate(_size);
+			if (allocation.cpuAddress == nullptr)
+			{
+				flush();
+				waitIdle();
+				result.stalls++;
+				beginBatch();
+				allocation = allocator.Allocate(_size);
+				//何も待っていないので必ず入る
+				if (allocation.cpuAddress == nullptr)
+				{
+					result.errors++;
+					return;
+				}
+			}
+
+			result.uploads++;
+			isBatchEmpty = false;
+			const size_t offset = static_cast<unsigned char*>(allocation.cpuAddress) - buffer.data();
+			if (offset % kAlignment != 0 || kCapacity < offset + _size || allocation.gpuAddress != kGpuBase + offset)
+			{
+				result.errors++;
+				return;
+			}
+			for (size_t slot = offset / kAlignment; slot < (offset + _size + kAlignment - 1) / kAlignment; slot++)
+			{
+				result.errors += owners[slot] == 0 ? 0 : 1;
+				owners[slot] = submittedFenceValue + 1;
+			}
+		};
+
+	//ステージングを使わないバッチが待っているあいだに，空になったリングで切り出す
+	//先頭へ戻すとそのバッチが終わったときにtailが戻され，使用量が容量近くまで膨らむ
+	upload(kAlignment * 3);
+	flush();
+	completedFenceValue = submittedFenceValue;
+	upload(kCapacity + 1);
+	flush();
+	upload(kAlignment * 2);
+	flush();
+	completedFenceValue = submittedFenceValue - 1;
+	retire();
+	result.errors += allocator.GetUsedSize() != kAlignment * 2 ? 1 : 0;
+	waitIdle();
+	result.errors += allocator.GetUsedSize() != 0 ? 1 : 0;
+
+	//小さなものを多く，時々ステージングの半分以上や入らないものを転送する
+	while (result.batches < _batches)
+	{
+		const uint32_t uploadCount = randomEngine() % 6;
+		for (uint32_t index = 0; index < uploadCount; index++)
+		{
+			const uint32_t kind = randomEngine() % 16;
+			const size_t size = kind == 0 ? kCapacity + 1 + randomEngine() % kCapacity : (kind == 1 ? kCapacity / 2 + randomEngine() % (kCapacity / 2) : 1 + randomEngine() % (kCapacity / 8));
+			upload(size);
+		}
+		result.errors += kCapacity < allocator.GetUsedSize() ? 1 : 0;
+		flush();
+		//コピーキューは送ったものの途中まで進んでいる
+		completedFenceValue += randomEngine() % (submittedFenceValue - completedFenceValue + 1);
+		if (randomEngine() % 8 == 0)
+		{
+			//すべて終わればステージングは空になる
+			waitIdle();
+			result.errors += allocator.GetUsedSize() != 0 ? 1 : 0;
+		}
+	}
+	return result;
+}
+
+ShaderCacheTestResult TestShaderCache(const std::filesystem::path& _directory, ThreadPool* _threadPool)
+{
+	std::error_code error;
+	std::filesystem::remove_all(_directory, error);
+	const std::filesystem::path sourceDirectory = _directory / "sources";
+	const std::filesystem::path cacheDirectory = _directory / "cache";
+	std::filesystem::create_directories(sourceDirectory / "include", error);
+	auto writeSource = [&](const std::filesystem::path& _name, const std::string& _text)
+		{
+			std::ofstream file(sourceDirectory / _name, std::ios::binary | std::ios::trunc);
+			file << _text;
+		};
+	//Inner.hlsliはCommon.hlsli越しにだけincludeする
+	writeSource("include/Inner.hlsli", "float inner = 1.0f;\n");
+	writeSource("include/Common.hlsli", "#include \"Inner.hlsli\"\n#include \"Missing.hlsli\"\n");
+	writeSource("Nested.VS.hlsl", "#include \"include/Common.hlsli\"\nvoid main() {}\n");
+	writeSource("Plain.PS.hlsl", "void main() {}\n");
+	writeSource("Cycle.PS.hlsl", "#include \"Cycle.PS.hlsl\"\n #include <include/Common.hlsli>\n");
+	writeSource("Broken.PS.hlsl", "#error broken\n");
+
+	//代わりのコンパイラは，たどれるソースすべてとプロファイル，引数をつなげたものを返す 同じ入力なら同じ結果になる
+	std::atomic<uint32_t> compileCalls = 0;
+	auto makeBytecode = [](const ShaderCompileRequest& _request, std::vector<unsigned char>& _bytecode)
+		{
+			std::vector<std::filesystem::path> sources;
+			if (!ShaderCache::CollectSources(_request.path, sources))
+			{
+				return false;
+			}
+			_bytecode.clear();
+			std::wstring options = _request.profile;
+			for (const std::wstring& argument : _request.arguments)
+			{
+				options += L" " + argument;
+			}
+			_bytecode.insert(_bytecode.end(), reinterpret_cast<const unsigned char*>(options.data()), reinterpret_cast<const unsigned char*>(options.data() + options.size()));
+			for (const std::filesystem::path& source : sources)
+			{
+				std::ifstream file(source, std::ios::binary);
+				std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+				if (text.find("#error") != std::string::npos)
+				{
+					return false;
+				}
+				_bytecode.insert(_bytecode.end(), text.begin(), text.end());
+			}
+			return true;
+		};
+	auto compile = [&](const ShaderCompileRequest& _request, std::vector<unsigned char>& _bytecode)
+		{
+			compileCalls++;
+			return makeBytecode(_request, _bytecode);
+		};
+
+	enum Request : uint32_t
+	{
+		kNested,
+		kPlain,
+		kCycle,
+		kBroken,
+		kRequestCount,
+	};
+	std::vector<ShaderCompileRequest> requests(kRequestCount);
+	requests[kNested] = { (sourceDirectory / "Nested.VS.hlsl").wstring(), L"vs_6_0", { L"-O3" } };
+	requests[kPlain] = { (sourceDirectory / "Plain.PS.hlsl").wstring(), L"ps_6_0", { L"-O3" } };
+	requests[kCycle] = { (sourceDirectory / "Cycle.PS.hlsl").wstring(), L"ps_6_0", { L"-O3" } };
+	requests[kBroken] = { (sourceDirectory / "Broken.PS.hlsl").wstring(), L"ps_6_0", { L"-O3" } };
+
+	ShaderCacheTestResult result{};
+	std::vector<std::vector<unsigned char>> bytecodes(kRequestCount);
+	std::vector<unsigned char> expected;
+	//_hitsのビットが立っているものはキャッシュに当たり，それ以外はコンパイルされるはず 失敗するものはどちらでもない
+	auto check = [&](ShaderCache& _cache, uint32_t _hits)
+		{
+			const ShaderCacheStats before = _cache.GetStats();
+			const uint32_t callsBefore = compileCalls;
+			const bool isSucceeded = _cache.CompileAll(requests.data(), kRequestCount, bytecodes.data(), _threadPool);
+			const ShaderCacheStats after = _cache.GetStats();
+			uint32_t expectedHits = 0;
+			for (uint32_t request = 0; request < kRequestCount; request++)
+			{
+				expectedHits += (_hits >> request) & 1;
+				if (request != kBroken)
+				{
+					result.errors += makeBytecode(requests[request], expected) && bytecodes[request] == expected ? 0 : 1;
+				}
+			}
+			result.requests += kRequestCount;
+			result.hits += after.hits - before.hits;
+			result.compiles += compileCalls - callsBefore;
+			result.errors += isSucceeded ? 1 : 0;
+			result.errors += after.hits - before.hits == expectedHits ? 0 : 1;
+			result.errors += compileCalls - callsBefore == kRequestCount - expectedHits ? 0 : 1;
+			result.errors += after.failures - before.failures == 1 ? 0 : 1;
+		};
+	const uint32_t kNone = 0;
+	const uint32_t kAll = (1u << kNested) | (1u << kPlain) | (1u << kCycle);
+
+	{
+		ShaderCache cache(cacheDirectory, compile, L"compiler 1");
+		check(cache, kNone);
+		check(cache, kAll);
+	}
+	{
+		//作り直しても (次に起動しても) ファイルから読む
+		ShaderCache cache(cacheDirectory, compile, L"compiler 1");
+		check(cache, kAll);
+
+		//入れ子のincludeを変えると，それをたどれるものだけコンパイルし直す
+		writeSource("include/Inner.hlsli", "float inner = 2.0f;\n");
+		check(cache, 1u << kPlain);
+		check(cache, kAll);
+		//元に戻すと前のキーになるので，残っていたファイルに当たる
+		writeSource("include/Inner.hlsli", "float inner = 1.0f;\n");
+		check(cache, kAll);
+
+		//見つからなかったincludeができたら変わったとみなす
+		writeSource("include/Missing.hlsli", "float missing = 0.0f;\n");
+		check(cache, 1u << kPlain);
+
+		//引数を変えたものだけ外れる
+		requests[kPlain].arguments.push_back(L"-Zi");
+		check(cache, kAll & ~(1u << kPlain));
+	}
+	{
+		//コンパイラの版が変わるとすべて外れる
+		ShaderCache cache(cacheDirectory, compile, L"compiler 2");
+		check(cache, kNone);
+	}
+
+	std::filesystem::remove_all(_directory, error);
+	return result;
+}
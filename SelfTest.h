@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+
+class ThreadPool;
+
+/// <summary>
+/// TestRenderQueueの結果
+/// </summary>
+struct RenderQueueTestResult
+{
+	uint32_t packets;				//描いたパケットの数
+	uint32_t stateChanges;			//バックエンドへ積んだ状態の設定数
+	uint32_t redundantStateChanges;	//直前と同じだったので積まなかった設定数
+	uint32_t errors;				//描画時の状態の誤り，同じ値の設定，統計や描画順の食い違いの数
+};
+
+/// <summary>
+/// 乱数のパケットを記録するだけのバックエンドでExecuteし，D3D12と同じ規則 (ルートシグネチャを変えるとルートパラメータは未設定) で状態を追って確かめる
+/// どの描画も自分の状態で描かれ，同じ値を設定し直さず，統計の設定数が呼び出しと合い，ソートキーの順 (同じキーは積んだ順) に描かれるか
+/// 同じ_seedなら同じパケットを調べる
+/// </summary>
+/// <param name="_rounds">パケットを積み直して描く回数</param>
+RenderQueueTestResult TestRenderQueue(uint32_t _seed, uint32_t _rounds);
+
+/// <summary>
+/// TestRenderQueueChunksの結果
+/// </summary>
+struct RenderQueueChunkTestResult
+{
+	uint32_t executions;	//ExecuteParallelを呼んだ回数
+	uint32_t chunks;		//分けた範囲の合計
+	uint32_t errors;		//範囲の分け方，範囲ごとの状態，Executeとの描画順，統計の食い違いの数
+};
+
+/// <summary>
+/// 同じパケットをExecuteと1から_maxChunks個に分けたExecuteParallelで記録し，範囲をつなげるとExecuteと同じ順になるか確かめる
+/// どの範囲も何も設定されていない状態から自分で設定し直して描くか，範囲が連続して大きさの差が1以下か，CalculateChunkCountが範囲内かも見る
+/// </summary>
+/// <param name="_threadPool">範囲を並列に積むのに使う nullptrなら順に積む</param>
+RenderQueueChunkTestResult TestRenderQueueChunks(uint32_t _seed, uint32_t _rounds, uint32_t _maxChunks, ThreadPool* _threadPool);
+
+/// <summary>
+/// TestLinearAllocatorの結果
+/// </summary>
+struct LinearAllocatorTestResult
+{
+	uint32_t frames;		//進めたフレーム数
+	uint32_t allocations;	//切り出せた数
+	uint32_t failures;		//空きが足りずnullptrが返った数
+	uint32_t errors;		//GPUが使っている範囲との重なり，はみ出し，アラインメント，空なのに失敗した数，使用量の食い違い
+};
+
+/// <summary>
+/// 遅れてフェンスを進めるGPUを真似て，LinearAllocatorが切り出した範囲を_alignmentごとの持ち主の表と突き合わせる
+/// 終了していないフレームの範囲を渡さないか，空のときは容量までの切り出しが必ず通るか，
+/// すべてのフレームが終われば使用量が0に戻るかを，終端の折り返しを含めて確かめる
+/// 同じ_seedなら同じ順に切り出す
+/// </summary>
+/// <param name="_frames">進めるフレーム数</param>
+LinearAllocatorTestResult TestLinearAllocator(uint32_t _seed, uint32_t _frames);
+
+/// <summary>
+/// TestUploadRingの結果
+/// </summary>
+struct UploadRingTestResult
+{
+	uint32_t batches;		//送ったバッチの数
+	uint32_t uploads;		//ステージングに入れた転送の数
+	uint32_t emptyBatches;	//専用のバッファだけでステージングを使わなかったバッチの数
+	uint32_t stalls;		//空くのを待ってから入れ直した数
+	uint32_t errors;		//コピーキューが読んでいる範囲との重なり，待った後に入らなかった数，使用量の食い違い
+};
+
+/// <summary>
+/// UploadManagerと同じ順 (バッチの始めにRetire，Flushでフェンス値を記録，入らなければ送って待ってから入れ直す) でLinearAllocatorのステージングを使い，
+/// 遅れて進むコピーキューを真似て確かめる ステージングを使わないバッチが待っているあいだに終端で折り返すときも，使用量が膨らまないか
+/// 同じ_seedなら同じ順に転送する
+/// </summary>
+/// <param name="_batches">送るバッチの数</param>
+UploadRingTestResult TestUploadRing(uint32_t _seed, uint32_t _batches);
+
+/// <summary>
+/// TestShaderCacheの結果
+/// </summary>
+struct ShaderCacheTestResult
+{
+	uint32_t requests;	//ShaderCacheに頼んだコンパイルの数
+	uint32_t hits;		//キャッシュから読んだ数
+	uint32_t compiles;	//代わりのコンパイラを呼んだ数
+	uint32_t errors;	//キャッシュに当たるべきところで外れた，外れるべきところで当たった，古い結果を返した数
+};
+
+/// <summary>
+/// _directoryにincludeを入れ子にしたhlslを書き，ソースをつなげて返すだけの代わりのコンパイラでShaderCacheを確かめる
+/// 2回目は当たるか，入れ子のincludeだけ変えてもそれを含むものはコンパイルし直して新しい結果を返すか，
+/// 引数やコンパイラの版を変えると外れるか，元に戻すとまた当たるか，失敗は保存されないか
+/// _directoryは最初と最後に消す
+/// </summary>
+/// <param name="_threadPool">CompileAllに渡す nullptrなら順に処理する</param>
+ShaderCacheTestResult TestShaderCache(const std::filesystem::path& _directory, ThreadPool* _threadPool);
@@ -0,0 +1,222 @@
+#include "ShaderCache.h"
+#include "PipelineCacheFile.h"
+#include "myLib/ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+namespace
+{
+	//キーの作り方を変えたら上げる 古いキャッシュは使われなくなる
+	const uint32_t kKeyVersion = 1;
+
+	bool ReadFile(const std::filesystem::path& _path, std::vector<unsigned char>& _bytes)
+	{
+		std::ifstream file(_path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+		_bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	void AddWideString(PipelineHash& _hash, const std::wstring& _string)
+	{
+		_hash.Add(static_cast<uint64_t>(_string.size()));
+		_hash.AddBytes(_string.data(), _string.size() * sizeof(wchar_t));
+	}
+
+	/// <summary>
+	/// 行が#include "name" か #include <name> ならnameを取り出す
+	/// </summary>
+	bool ParseInclude(const std::string& _line, std::string& _name)
+	{
+		size_t position = _line.find_first_not_of(" \t");
+		if (position == std::string::npos || _line[position] != '#')
+		{
+			return false;
+		}
+		position = _line.find_first_not_of(" \t", position + 1);
+		if (position == std::string::npos || _line.compare(position, 7, "include") != 0)
+		{
+			return false;
+		}
+		position = _line.find_first_not_of(" \t", position + 7);
+		if (position == std::string::npos || (_line[position] != '"' && _line[position] != '<'))
+		{
+			return false;
+		}
+		const char close = _line[position] == '"' ? '"' : '>';
+		const size_t end = _line.find(close, position + 1);
+		if (end == std::string::npos)
+		{
+			return false;
+		}
+		_name = _line.substr(position + 1, end - position - 1);
+		return true;
+	}
+}
+
+ShaderCache::ShaderCache(const std::filesystem::path& _directory, ShaderCompileFunction _compile, const std::wstring& _compilerTag) :
+	directory(_directory),
+	compile(std::move(_compile)),
+	compilerTag(_compilerTag),
+	stats{}
+{
+	assert(compile != nullptr);
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+}
+
+bool ShaderCache::CalculateKey(const ShaderCompileRequest& _request, uint64_t& _key) const
+{
+	std::vector<std::filesystem::path> sources;
+	if (!CollectSources(_request.path, sources))
+	{
+		return false;
+	}
+
+	PipelineHash hash;
+	hash.Add(kKeyVersion);
+	AddWideString(hash, compilerTag);
+	AddWideString(hash, _request.path);
+	AddWideString(hash, _request.profile);
+	hash.Add(static_cast<uint64_t>(_request.arguments.size()));
+	for (const std::wstring& argument : _request.arguments)
+	{
+		AddWideString(hash, argument);
+	}
+	//includeしたファイルは名前と中身を入れる (どこでincludeしたかの違いは名前に出る)
+	std::vector<unsigned char> bytes;
+	for (const std::filesystem::path& source : sources)
+	{
+		if (!ReadFile(source, bytes))
+		{
+			return false;
+		}
+		AddWideString(hash, source.generic_wstring());
+		hash.Add(static_cast<uint64_t>(bytes.size()));
+		hash.AddBytes(bytes.data(), bytes.size());
+	}
+	_key = hash.GetValue();
+	return true;
+}
+
+bool ShaderCache::Compile(const ShaderCompileRequest& _request, std::vector<unsigned char>& _bytecode)
+{
+	uint64_t key = 0;
+	const bool hasKey = CalculateKey(_request, key);
+	if (hasKey && ReadFile(GetCachePath(key), _bytecode) && !_bytecode.empty())
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.hits++;
+		return true;
+	}
+
+	_bytecode.clear();
+	const bool isCompiled = compile(_request, _bytecode) && !_bytecode.empty();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		(isCompiled ? stats.compiles : stats.failures)++;
+	}
+	if (!isCompiled || !hasKey)
+	{
+		return isCompiled;
+	}
+
+	//同じシェーダーを同時に書いても壊れないよう，スレッドごとの一時ファイルに書いてから置き換える
+	const std::filesystem::path cachePath = GetCachePath(key);
+	std::filesystem::path temporaryPath = cachePath;
+	temporaryPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(_bytecode.data()), _bytecode.size());
+		if (!file)
+		{
+			//保存できなくてもコンパイルはできているので使う
+			return true;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, cachePath, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+	}
+	return true;
+}
+
+bool ShaderCache::CompileAll(const ShaderCompileRequest* _requests, uint32_t _count, std::vector<unsigned char>* _bytecodes, ThreadPool* _threadPool)
+{
+	std::vector<char> isSucceeded(_count, 0);
+	auto compileOne = [&](uint32_t _index) { isSucceeded[_index] = Compile(_requests[_index], _bytecodes[_index]) ? 1 : 0; };
+	if (_threadPool != nullptr && 1 < _count)
+	{
+		_threadPool->ParallelFor(_count, compileOne);
+	}
+	else
+	{
+		for (uint32_t index = 0; index < _count; index++)
+		{
+			compileOne(index);
+		}
+	}
+	return std::all_of(isSucceeded.begin(), isSucceeded.end(), [](char _value) { return _value != 0; });
+}
+
+ShaderCacheStats ShaderCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+bool ShaderCache::CollectSources(const std::filesystem::path& _path, std::vector<std::filesystem::path>& _sources)
+{
+	_sources.clear();
+	std::error_code error;
+	if (!std::filesystem::is_regular_file(_path, error))
+	{
+		return false;
+	}
+
+	//たどった順に並べる 同じファイルは1回だけ (includeガードや循環に備える)
+	_sources.push_back(_path.lexically_normal());
+	for (size_t index = 0; index < _sources.size(); index++)
+	{
+		std::ifstream file(_sources[index]);
+		std::string line;
+		std::string name;
+		while (std::getline(file, line))
+		{
+			if (!ParseInclude(line, name))
+			{
+				continue;
+			}
+			std::filesystem::path include = (_sources[index].parent_path() / name).lexically_normal();
+			if (!std::filesystem::is_regular_file(include, error))
+			{
+				include = std::filesystem::path(name).lexically_normal();
+				if (!std::filesystem::is_regular_file(include, error))
+				{
+					continue;
+				}
+			}
+			if (std::find(_sources.begin(), _sources.end(), include) == _sources.end())
+			{
+				_sources.push_back(include);
+			}
+		}
+	}
+	return true;
+}
+
+std::filesystem::path ShaderCache::GetCachePath(uint64_t _key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.cso", static_cast<unsigned long long>(_key));
+	return directory / name;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/// <summary>
+/// 1つのシェーダーのコンパイルに必要なもの
+/// </summary>
+struct ShaderCompileRequest
+{
+	std::wstring path;						//hlslファイルへのパス
+	std::wstring profile;					//vs_6_0など
+	std::vector<std::wstring> arguments;	//ファイル名と-T以外のコンパイラ引数
+};
+
+/// <summary>
+/// 実際にコンパイルする関数 (DXCなど) 成功したら_bytecodeに結果を入れてtrueを返す
+/// 複数のスレッドから同時に呼ばれる
+/// </summary>
+using ShaderCompileFunction = std::function<bool(const ShaderCompileRequest& _request, std::vector<unsigned char>& _bytecode)>;
+
+/// <summary>
+/// シェーダーキャッシュの統計 (デバッグ表示用)
+/// </summary>
+struct ShaderCacheStats
+{
+	uint32_t hits;		//ファイルのキャッシュから読んだ数
+	uint32_t compiles;	//コンパイルした数
+	uint32_t failures;	//コンパイルできなかった数
+};
+
+/// <summary>
+/// コンパイルしたシェーダーをファイルに保存し，次からはコンパイルせずに読む
+/// キーはソース，そこからincludeしているファイル (たどれる分すべて)，パス，プロファイル，引数，_compilerTagの中身から作る
+/// どれかが変わればキーが変わるのでコンパイルし直す 古いファイルは残るが使われない
+/// </summary>
+class ShaderCache
+{
+public:
+	/// <param name="_directory">キャッシュを置くディレクトリ なければ作る</param>
+	/// <param name="_compile">キャッシュになかったときに呼ぶ関数</param>
+	/// <param name="_compilerTag">コンパイラの版など 変わったら全部コンパイルし直したいもの</param>
+	ShaderCache(const std::filesystem::path& _directory, ShaderCompileFunction _compile, const std::wstring& _compilerTag);
+
+	/// <summary>
+	/// _requestのキーを作る ソースが読めなければfalse
+	/// </summary>
+	bool CalculateKey(const ShaderCompileRequest& _request, uint64_t& _key) const;
+	/// <summary>
+	/// キャッシュにあれば読み，なければコンパイルして保存する
+	/// </summary>
+	/// <returns>コンパイルできなかったらfalse</returns>
+	bool Compile(const ShaderCompileRequest& _request, std::vector<unsigned char>& _bytecode);
+	/// <summary>
+	/// _count個をスレッドプールで並列に処理する 全部終わるまで戻らない
+	/// </summary>
+	/// <param name="_bytecodes">_count個の出力先</param>
+	/// <param name="_threadPool">nullptrなら呼び出し元だけで処理する</param>
+	/// <returns>1つでも失敗したらfalse</returns>
+	bool CompileAll(const ShaderCompileRequest* _requests, uint32_t _count, std::vector<unsigned char>* _bytecodes, ThreadPool* _threadPool);
+
+	ShaderCacheStats GetStats() const;
+
+	/// <summary>
+	/// _pathと，そこから#includeでたどれるファイルを並べる 見つからないincludeは飛ばす
+	/// includeは含んでいるファイルのディレクトリから探し，なければ今のディレクトリから探す
+	/// </summary>
+	/// <returns>_path自体が読めなければfalse</returns>
+	static bool CollectSources(const std::filesystem::path& _path, std::vector<std::filesystem::path>& _sources);
+
+private:
+	std::filesystem::path GetCachePath(uint64_t _key) const;
+
+	std::filesystem::path directory;
+	ShaderCompileFunction compile;
+	std::wstring compilerTag;
+	mutable std::mutex mutex;
+	ShaderCacheStats stats;
+};
@@ -0,0 +1,147 @@
+#include "ShaderHotReloader.h"
+#include "myLib/ThreadPool.h"
+#include <cassert>
+
+ShaderHotReloader::ShaderHotReloader(ShaderCache* _cache, ThreadPool* _threadPool, std::chrono::milliseconds _pollInterval) :
+	cache(_cache),
+	threadPool(_threadPool),
+	pollInterval(_pollInterval),
+	lastPollTime(std::chrono::steady_clock::now()),
+	stats{}
+{
+	assert(_cache != nullptr);
+	assert(_threadPool != nullptr);
+}
+
+ShaderHotReloader::~ShaderHotReloader()
+{
+	//結果の書き込み先がなくなる前に終わるのを待つ
+	if (job.valid())
+	{
+		job.wait();
+	}
+}
+
+uint32_t ShaderHotReloader::AddProgram(const ShaderCompileRequest& _request, std::vector<unsigned char> _bytecode)
+{
+	//コンパイル中に足すと結果の番号がずれるので，始める前に足しておく
+	assert(!job.valid());
+	Program program{ _request, std::move(_bytecode), {}, {} };
+	Watch(program);
+	programs.push_back(std::move(program));
+	return static_cast<uint32_t>(programs.size() - 1);
+}
+
+bool ShaderHotReloader::Update(std::vector<uint32_t>& _reloaded)
+{
+	_reloaded.clear();
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	if (job.valid())
+	{
+		if (job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			return false;
+		}
+		job.get();
+		stats.lastCompileTime = std::chrono::duration<float>(now - jobStartTime).count();
+		for (CompileResult& result : results)
+		{
+			if (!result.isSucceeded)
+			{
+				stats.failures++;
+				continue;
+			}
+			Program& program = programs[result.program];
+			program.previousBytecode = std::move(program.bytecode);
+			program.bytecode = std::move(result.bytecode);
+			_reloaded.push_back(result.program);
+			stats.reloads++;
+		}
+		results.clear();
+		return !_reloaded.empty();
+	}
+
+	if (now - lastPollTime < pollInterval)
+	{
+		return false;
+	}
+	lastPollTime = now;
+
+	//コンパイルを始める前に日時を記録し直すので，コンパイル中にまた保存されたら次に調べたときにもう一度コンパイルする
+	std::vector<uint32_t> changed;
+	for (uint32_t index = 0; index < programs.size(); index++)
+	{
+		if (IsChanged(programs[index]))
+		{
+			Watch(programs[index]);
+			changed.push_back(index);
+		}
+	}
+	if (changed.empty())
+	{
+		return false;
+	}
+
+	results.resize(changed.size());
+	for (size_t index = 0; index < changed.size(); index++)
+	{
+		results[index] = { changed[index], false, {} };
+	}
+	jobStartTime = now;
+	job = threadPool->Submit([this]()
+		{
+			for (CompileResult& result : results)
+			{
+				result.isSucceeded = cache->Compile(programs[result.program].request, result.bytecode);
+			}
+		});
+	return false;
+}
+
+void ShaderHotReloader::Revert(const std::vector<uint32_t>& _programs)
+{
+	for (uint32_t index : _programs)
+	{
+		Program& program = programs[index];
+		//戻せるのは差し替えた直後の1回だけ
+		assert(!program.previousBytecode.empty());
+		program.bytecode = std::move(program.previousBytecode);
+		program.previousBytecode.clear();
+		stats.reloads--;
+		stats.failures++;
+	}
+}
+
+void ShaderHotReloader::Watch(Program& _program)
+{
+	std::vector<std::filesystem::path> sources;
+	ShaderCache::CollectSources(_program.request.path, sources);
+	//ソースが一時的に消えていても (保存の途中など)，ソース自体は見張り続ける
+	if (sources.empty())
+	{
+		sources.push_back(std::filesystem::path(_program.request.path).lexically_normal());
+	}
+
+	_program.files.clear();
+	for (const std::filesystem::path& source : sources)
+	{
+		std::error_code error;
+		std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(source, error);
+		_program.files.push_back({ source, error ? std::filesystem::file_time_type::min() : writeTime });
+	}
+}
+
+bool ShaderHotReloader::IsChanged(const Program& _program)
+{
+	for (const WatchedFile& file : _program.files)
+	{
+		std::error_code error;
+		std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(file.path, error);
+		if ((error ? std::filesystem::file_time_type::min() : writeTime) != file.writeTime)
+		{
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "ShaderCache.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <vector>
+
+class ThreadPool;
+
+/// <summary>
+/// シェーダーの再読み込みの統計 (デバッグ表示用)
+/// </summary>
+struct ShaderHotReloadStats
+{
+	uint32_t reloads;		//差し替えたシェーダーの数
+	uint32_t failures;		//コンパイルできない，またはRevertで戻して前のものを残した数
+	float lastCompileTime;	//最後のコンパイルにかかった秒数
+};
+
+/// <summary>
+/// シェーダーのソースとincludeしているファイルの更新日時を見て，変わったものをバックグラウンドでコンパイルし直す
+/// 結果はUpdateを呼んだとき (フレームの区切り) にまとめて差し替える コンパイルできなかったものは前のバイトコードのまま
+/// </summary>
+class ShaderHotReloader
+{
+public:
+	/// <param name="_cache">コンパイルに使うキャッシュ バックグラウンドのスレッドから使う</param>
+	/// <param name="_threadPool">コンパイルを回すスレッドプール</param>
+	/// <param name="_pollInterval">更新日時を調べる間隔</param>
+	ShaderHotReloader(ShaderCache* _cache, ThreadPool* _threadPool, std::chrono::milliseconds _pollInterval = std::chrono::milliseconds(250));
+	~ShaderHotReloader();
+
+	ShaderHotReloader(const ShaderHotReloader&) = delete;
+	ShaderHotReloader& operator=(const ShaderHotReloader&) = delete;
+
+	/// <summary>
+	/// 見張るシェーダーを足す 今のファイルの状態を基準にする
+	/// </summary>
+	/// <param name="_bytecode">今使っているバイトコード</param>
+	/// <returns>番号 (足した順)</returns>
+	uint32_t AddProgram(const ShaderCompileRequest& _request, std::vector<unsigned char> _bytecode);
+	/// <summary>
+	/// 今使うバイトコード 次にUpdateで差し替えるまで変わらない
+	/// </summary>
+	const std::vector<unsigned char>& GetBytecode(uint32_t _program) const { return programs[_program].bytecode; }
+
+	/// <summary>
+	/// フレームの区切りで呼ぶ
+	/// コンパイルが終わっていれば結果を反映して差し替えた番号を_reloadedに入れる そうでなければ更新日時を調べ，変わったもののコンパイルを始める
+	/// </summary>
+	/// <returns>差し替えたものがあればtrue</returns>
+	bool Update(std::vector<uint32_t>& _reloaded);
+	/// <summary>
+	/// 直前のUpdateで差し替えた_programsを前のバイトコードに戻す 新しいバイトコードでPSOを作れなかったときに使う
+	/// 更新日時は記録し直してあるので，もう一度保存されるまでコンパイルし直さない
+	/// </summary>
+	void Revert(const std::vector<uint32_t>& _programs);
+	/// <summary>
+	/// バックグラウンドでコンパイルしているか
+	/// </summary>
+	bool IsCompiling() const { return job.valid(); }
+
+	const ShaderHotReloadStats& GetStats() const { return stats; }
+
+private:
+	/// <summary>
+	/// 見張っているファイルとその更新日時
+	/// </summary>
+	struct WatchedFile
+	{
+		std::filesystem::path path;
+		std::filesystem::file_time_type writeTime;
+	};
+
+	struct Program
+	{
+		ShaderCompileRequest request;
+		std::vector<unsigned char> bytecode;
+		std::vector<unsigned char> previousBytecode;	//Updateで差し替える前のもの Revertで戻す
+		std::vector<WatchedFile> files;
+	};
+
+	/// <summary>
+	/// バックグラウンドでコンパイルした結果
+	/// </summary>
+	struct CompileResult
+	{
+		uint32_t program;
+		bool isSucceeded;
+		std::vector<unsigned char> bytecode;
+	};
+
+	/// <summary>
+	/// ソースとincludeを調べ直し，今の更新日時を記録する
+	/// </summary>
+	static void Watch(Program& _program);
+	static bool IsChanged(const Program& _program);
+
+	ShaderCache* cache;
+	ThreadPool* threadPool;
+	std::chrono::milliseconds pollInterval;
+	std::chrono::steady_clock::time_point lastPollTime;
+	std::vector<Program> programs;
+	std::future<void> job;
+	std::vector<CompileResult> results;		//jobが書き，終わってからUpdateが読む
+	std::chrono::steady_clock::time_point jobStartTime;
+	ShaderHotReloadStats stats;
+};
@@ -0,0 +1,180 @@
+#include "UploadManager.h"
+#include "externals/DirectXTex/d3dx12.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateUploadBuffer(ID3D12Device* _device, uint64_t _size)
+	{
+		D3D12_HEAP_PROPERTIES heapProperties{};
+		heapProperties.Type = D3D12_HEAP_TYPE_UPLOAD;
+		D3D12_RESOURCE_DESC resourceDesc{};
+		resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		resourceDesc.Width = _size;
+		resourceDesc.Height = 1;
+		resourceDesc.DepthOrArraySize = 1;
+		resourceDesc.MipLevels = 1;
+		resourceDesc.SampleDesc.Count = 1;
+		resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+		HRESULT hr = _device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &resourceDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&resource));
+		assert(SUCCEEDED(hr));
+		(void)hr;
+		return resource;
+	}
+}
+
+UploadManager::UploadManager(ID3D12Device* _device, size_t _stagingSize, uint32_t _maxBatchesInFlight) :
+	device(_device),
+	fenceEvent(nullptr),
+	batches(_maxBatchesInFlight),
+	batchIndex(0),
+	isRecording(false),
+	submittedFenceValue(0),
+	waitedFenceValue(0),
+	stagingData(nullptr),
+	stats{}
+{
+	assert(_device != nullptr);
+	assert(0 < _maxBatchesInFlight);
+
+	//描画とは別のコピー専用のキューに送るので，描画しているあいだも転送が進む
+	D3D12_COMMAND_QUEUE_DESC queueDesc{};
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	HRESULT hr = device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&copyQueue));
+	assert(SUCCEEDED(hr));
+	for (Batch& batch : batches)
+	{
+		hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&batch.commandAllocator));
+		assert(SUCCEEDED(hr));
+		batch.fenceValue = 0;
+	}
+	hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, batches[0].commandAllocator.Get(), nullptr, IID_PPV_ARGS(&commandList));
+	assert(SUCCEEDED(hr));
+	//積むときにResetするので閉じておく
+	commandList->Close();
+	hr = device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
+	assert(SUCCEEDED(hr));
+	fenceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	assert(fenceEvent != nullptr);
+
+	//テクスチャのデータの置き場所は512バイトにそろえる必要があるので，切り出しもその単位にする
+	stagingResource = CreateUploadBuffer(device, _stagingSize);
+	hr = stagingResource->Map(0, nullptr, reinterpret_cast<void**>(&stagingData));
+	assert(SUCCEEDED(hr));
+	stagingAllocator = std::make_unique<LinearAllocator>(stagingData, stagingResource->GetGPUVirtualAddress(), _stagingSize, _maxBatchesInFlight, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+}
+
+UploadManager::~UploadManager()
+{
+	Flush();
+	WaitIdle();
+	CloseHandle(fenceEvent);
+}
+
+void UploadManager::UploadTexture(ID3D12Resource* _texture, const D3D12_SUBRESOURCE_DATA* _subresources, uint32_t _count)
+{
+	const uint64_t size = GetRequiredIntermediateSize(_texture, 0, _count);
+	BeginBatch();
+	LinearAllocation allocation = stagingAllocator->Allocate(static_cast<size_t>(size));
+	if (allocation.cpuAddress == nullptr && size <= stagingAllocator->GetCapacity())
+	{
+		//コピーキューがまだ読んでいる範囲に届いた 今のバッチを送り，終わるのを待ってから空いた分に入れる
+		Flush();
+		WaitIdle();
+		stats.stalls++;
+		BeginBatch();
+		allocation = stagingAllocator->Allocate(static_cast<size_t>(size));
+	}
+
+	if (allocation.cpuAddress != nullptr)
+	{
+		const uint64_t offset = static_cast<uint64_t>(static_cast<unsigned char*>(allocation.cpuAddress) - stagingData);
+		UpdateSubresources(commandList.Get(), _texture, stagingResource.Get(), offset, 0, _count, _subresources);
+	}
+	else
+	{
+		//ステージングより大きいものはそれだけのバッファを作り，このバッチが終わったら解放する
+		DedicatedBuffer buffer{ CreateUploadBuffer(device, size), submittedFenceValue + 1 };
+		UpdateSubresources(commandList.Get(), _texture, buffer.resource.Get(), 0, 0, _count, _subresources);
+		dedicatedBuffers.push_back(std::move(buffer));
+		stats.dedicatedBuffers++;
+	}
+	stats.copies += _count;
+}
+
+uint64_t UploadManager::Flush()
+{
+	if (!isRecording)
+	{
+		return submittedFenceValue;
+	}
+
+	HRESULT hr = commandList->Close();
+	assert(SUCCEEDED(hr));
+	(void)hr;
+	ID3D12CommandList* commandLists[] = { commandList.Get() };
+	copyQueue->ExecuteCommandLists(1, commandLists);
+	submittedFenceValue++;
+	copyQueue->Signal(fence.Get(), submittedFenceValue);
+
+	batches[batchIndex].fenceValue = submittedFenceValue;
+	batchIndex = (batchIndex + 1) % static_cast<uint32_t>(batches.size());
+	stagingAllocator->EndFrame(submittedFenceValue);
+	isRecording = false;
+	stats.batches++;
+	return submittedFenceValue;
+}
+
+void UploadManager::WaitOnQueue(ID3D12CommandQueue* _queue)
+{
+	if (waitedFenceValue < submittedFenceValue)
+	{
+		_queue->Wait(fence.Get(), submittedFenceValue);
+		waitedFenceValue = submittedFenceValue;
+	}
+}
+
+void UploadManager::WaitIdle()
+{
+	WaitForFenceValue(submittedFenceValue);
+	Retire();
+}
+
+void UploadManager::BeginBatch()
+{
+	if (isRecording)
+	{
+		return;
+	}
+
+	//このアロケータを前に使ったのは最も古いバッチなので，それが終われば送っておけるバッチの数に収まる
+	Batch& batch = batches[batchIndex];
+	WaitForFenceValue(batch.fenceValue);
+	Retire();
+	HRESULT hr = batch.commandAllocator->Reset();
+	assert(SUCCEEDED(hr));
+	hr = commandList->Reset(batch.commandAllocator.Get(), nullptr);
+	assert(SUCCEEDED(hr));
+	(void)hr;
+	isRecording = true;
+}
+
+void UploadManager::Retire()
+{
+	const uint64_t completedFenceValue = fence->GetCompletedValue();
+	stagingAllocator->BeginFrame(completedFenceValue);
+	dedicatedBuffers.erase(std::remove_if(dedicatedBuffers.begin(), dedicatedBuffers.end(),
+		[&](const DedicatedBuffer& _buffer) { return _buffer.fenceValue <= completedFenceValue; }), dedicatedBuffers.end());
+}
+
+void UploadManager::WaitForFenceValue(uint64_t _fenceValue)
+{
+	if (fence->GetCompletedValue() < _fenceValue)
+	{
+		fence->SetEventOnCompletion(_fenceValue, fenceEvent);
+		WaitForSingleObject(fenceEvent, INFINITE);
+	}
+}
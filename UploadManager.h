@@ -0,0 +1,110 @@
+#pragma once
+#include "LinearAllocator.h"
+#include <d3d12.h>
+#include <wrl.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// <summary>
+/// 転送の統計 (デバッグ表示用)
+/// </summary>
+struct UploadStats
+{
+	uint32_t batches;			//コピーキューへ送った回数
+	uint32_t copies;			//積んだ転送の数
+	uint32_t dedicatedBuffers;	//ステージングに入らず専用のバッファを作った数
+	uint32_t stalls;			//ステージングが空くのをCPUで待った回数
+};
+
+/// <summary>
+/// テクスチャのデータを大きなステージングバッファ (Mapしたまま) からコピーキューで転送する
+/// 転送はバッチにまとめて1つのコマンドリストに積み，Flushでまとめて送る
+/// ステージングはLinearAllocatorのリングとして切り出し，コピーキューのフェンスが進んだバッチの分から使い直す
+/// 描画するキューはWaitOnQueueでGPU上だけ待つので，CPUは転送の終わりを待たない
+/// </summary>
+class UploadManager
+{
+public:
+	/// <param name="_stagingSize">ステージングバッファのバイト数 入らない転送は専用のバッファを作る</param>
+	/// <param name="_maxBatchesInFlight">コピーキューが処理中でも送っておけるバッチの数</param>
+	UploadManager(ID3D12Device* _device, size_t _stagingSize, uint32_t _maxBatchesInFlight);
+	/// <summary>
+	/// 積んだ転送を送り，すべて終わってから解放する
+	/// </summary>
+	~UploadManager();
+
+	UploadManager(const UploadManager&) = delete;
+	UploadManager& operator=(const UploadManager&) = delete;
+
+	/// <summary>
+	/// _textureの_count個のサブリソースへの転送を今のバッチに積む データはここでステージングへ写すので，戻ったら捨ててよい
+	/// _textureはCOPY_DESTかCOMMONにしておく コピーキューで使ったので転送後はCOMMONになり，シェーダーで読むときに暗黙に昇格する
+	/// </summary>
+	void UploadTexture(ID3D12Resource* _texture, const D3D12_SUBRESOURCE_DATA* _subresources, uint32_t _count);
+	/// <summary>
+	/// 積んだ転送をコピーキューへ送る 何も積んでいなければ何もしない
+	/// </summary>
+	/// <returns>送った転送がすべて終わったときのフェンス値</returns>
+	uint64_t Flush();
+	/// <summary>
+	/// _queueがこの後に実行するコマンドを，送った転送が終わるまでGPU上で待たせる 送っていない転送は含まない
+	/// </summary>
+	void WaitOnQueue(ID3D12CommandQueue* _queue);
+	/// <summary>
+	/// 送った転送がすべて終わるまでCPUで待つ
+	/// </summary>
+	void WaitIdle();
+
+	size_t GetStagingCapacity() const { return stagingAllocator->GetCapacity(); }
+	/// <summary>
+	/// コピーキューが使っているかもしれないステージングのバイト数
+	/// </summary>
+	size_t GetStagingUsedSize() const { return stagingAllocator->GetUsedSize(); }
+	const UploadStats& GetStats() const { return stats; }
+
+private:
+	/// <summary>
+	/// 1回に送るコマンドのアロケータと，それを送ったときのフェンス値
+	/// </summary>
+	struct Batch
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
+		uint64_t fenceValue;
+	};
+
+	/// <summary>
+	/// ステージングに入らなかった転送のバッファ fenceValueまで終わったら解放する
+	/// </summary>
+	struct DedicatedBuffer
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+		uint64_t fenceValue;
+	};
+
+	/// <summary>
+	/// 積み始めていなければ，次のバッチのアロケータが空くのを待ってコマンドリストを開く
+	/// </summary>
+	void BeginBatch();
+	/// <summary>
+	/// コピーキューが終えたバッチのステージングと専用のバッファを空ける
+	/// </summary>
+	void Retire();
+	void WaitForFenceValue(uint64_t _fenceValue);
+
+	ID3D12Device* device;
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> copyQueue;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+	Microsoft::WRL::ComPtr<ID3D12Fence> fence;
+	HANDLE fenceEvent;
+	std::vector<Batch> batches;			//リングとして使う
+	uint32_t batchIndex;				//今積んでいるバッチ
+	bool isRecording;
+	uint64_t submittedFenceValue;		//最後に送ったバッチのフェンス値
+	uint64_t waitedFenceValue;			//描画するキューに最後に待たせたフェンス値
+	Microsoft::WRL::ComPtr<ID3D12Resource> stagingResource;
+	unsigned char* stagingData;
+	std::unique_ptr<LinearAllocator> stagingAllocator;
+	std::vector<DedicatedBuffer> dedicatedBuffers;
+	UploadStats stats;
+};
@@ -15,6 +15,24 @@
 #pragma comment(lib,"dxcompiler.lib")
 
 #include "myLib/MyLib.h"
+#include "myLib/ThreadPool.h"
+#include "myLib/MeshBVH.h"
+#include "myLib/FrameClock.h"
+#include "myLib/FrustumCulling.h"
+#include "myLib/OcclusionCulling.h"
+#include "myLib/Benchmark.h"
+#include "myLib/CollisionFuzz.h"
+#include "myLib/OcclusionFuzz.h"
+#include "ParticleSystem.h"
+#include "EmitterSystem.h"
+#include "RenderQueue.h"
+#include "LinearAllocator.h"
+#include "DescriptorAllocator.h"
+#include "UploadManager.h"
+#include "PipelineCache.h"
+#include "ShaderCache.h"
+#include "ShaderHotReloader.h"
+#include "SelfTest.h"
 
 #include "externals/imgui/imgui.h"
 #include "externals/imgui/imgui_impl_dx12.h"
@@ -25,8 +43,10 @@ extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hwnd, UINT msg
 #include "externals/DirectXTex/d3dx12.h"
 
 #include <vector>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
+#include <filesystem>
 
 #include <random>
 #include <numbers>
@@ -57,13 +77,59 @@ void pLog(const std::string& _objname, ID3D12Resource* _p)
 const int32_t kClientWidth = 1280;
 const int32_t kClientHeight = 720;
 
-const float kDeltaTime = 1.0f / 60.0f;
+// 透視投影の近・遠クリップ面
+const float kNearClip = 0.1f;
+const float kFarClip = 100.0f;
 
-uint32_t globalSrvIndex = 0;
+// GPUが処理中でも先に進めるフレーム数 (2か3)
+// コマンドアロケータ・定数バッファ・一時的なディスクリプタはこの数だけのフレーム分を持ち，使い回すときだけGPUを待つ
+const uint32_t kMaxFramesInFlight = 2;
+static_assert(2 <= kMaxFramesInFlight && kMaxFramesInFlight <= 3, "kMaxFramesInFlight must be 2 or 3");
 
-uint32_t AllocateDescriptor() {
-	return globalSrvIndex++;
-}
+// 描画パケットを分けて並列に積むコマンドリストの最大数
+const uint32_t kMaxRecordingChunks = 4;
+// 1つのコマンドリストに積む最少の描画数 これより少ないと分けてもコマンドリストが増えるだけ
+const uint32_t kMinDrawsPerChunk = 256;
+
+/// <summary>
+/// フレームごとに持つもの GPUがこのフレームのコマンドを終えるまで使い直さない
+/// </summary>
+struct FrameContext
+{
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> chunkAllocators[kMaxRecordingChunks];	//描画パケットを並列に積むコマンドリスト用
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> overlayAllocator;	//ImGuiとPresentへの遷移を積むコマンドリスト用
+	uint64_t fenceValue;	//このフレームのコマンドの後にSignalした値 0ならまだ使っていない
+};
+
+// SRVヒープのディスクリプタ数 後ろのkTransientSrvDescriptorCount個はフレームごとに使い捨てる
+const uint32_t kSrvDescriptorCount = 1024;
+const uint32_t kTransientSrvDescriptorCount = 256;
+// テクスチャは連続した範囲 (テクスチャテーブル) に並べ，シェーダーはテクスチャハンドルを番号にして引く
+const uint32_t kMaxTextures = 256;	//Object3d.PS.hlslのgTexturesの数と合わせる
+// テクスチャの転送に使うステージングバッファの大きさと，コピーキューに送っておけるバッチの数
+const size_t kUploadStagingSize = 32 * 1024 * 1024;
+const uint32_t kMaxUploadBatchesInFlight = 4;
+
+// 作ったPSOのキャッシュを保存するファイル 次に起動したときはここから作る
+const char* const kPipelineCachePath = "pipelineCache.bin";
+// コンパイルしたシェーダーを置くディレクトリ
+const char* const kShaderCacheDirectory = "shaderCache";
+
+// 起動時にコンパイルし，実行中はソースの変更を見張るシェーダー MakeShaderCompileRequestsはこの順に並べる
+enum ShaderProgram : uint32_t
+{
+	kShaderObject3dVS,
+	kShaderObject3dPS,
+	kShaderObject3dInstancedVS,
+	kShaderParticleVS,
+	kShaderParticlePS,
+	kShaderCount,
+};
+
+DescriptorAllocator srvAllocator(kSrvDescriptorCount, kSrvDescriptorCount - kTransientSrvDescriptorCount, kMaxFramesInFlight);
+uint32_t textureTableIndex = kInvalidDescriptorIndex;
+D3D12_GPU_DESCRIPTOR_HANDLE textureTableHandleGPU{};
 
 
 Microsoft::WRL::ComPtr<IDxcBlob> ComplieShader(
@@ -71,11 +137,35 @@ Microsoft::WRL::ComPtr<IDxcBlob> ComplieShader(
 	const std::wstring& _filePath,
 	//Compilerに使用するprofile
 	const wchar_t* _profile,
+	//ファイル名と-T以外のコンパイルオプション
+	const std::vector<std::wstring>& _options,
 	//初期化で生成したものを3つ
 	Microsoft::WRL::ComPtr<IDxcUtils>& _dxcUtils,
 	Microsoft::WRL::ComPtr<IDxcCompiler3>& _dxcCompiler,
 	Microsoft::WRL::ComPtr<IDxcIncludeHandler>& _includeHandler);
 
+/// <summary>
+/// ShaderCacheから呼ばれるDXCでのコンパイル DXCのインスタンスはスレッドをまたいで使えないので呼ぶたびに作る
+/// </summary>
+bool CompileShaderWithDxc(const ShaderCompileRequest& _request, std::vector<unsigned char>& _bytecode);
+
+/// <summary>
+/// ShaderCacheのキーに入れるDXCの版
+/// </summary>
+std::wstring GetShaderCompilerTag();
+
+/// <summary>
+/// ShaderProgramの順にコンパイルの設定を並べる
+/// </summary>
+std::vector<ShaderCompileRequest> MakeShaderCompileRequests();
+
+/// <summary>
+/// ShaderProgramの順にシェーダーを並列にコンパイルする キャッシュにあるものはコンパイルせずに読む
+/// </summary>
+/// <param name="_bytecodes">kShaderCount個のバイトコードが入る</param>
+/// <returns>1つでも失敗したらfalse</returns>
+bool CompileShaders(ShaderCache& _shaderCache, const std::vector<ShaderCompileRequest>& _requests, std::vector<std::vector<unsigned char>>& _bytecodes, ThreadPool& _threadPool);
+
 Microsoft::WRL::ComPtr<ID3D12Resource> CreateBufferResource(const Microsoft::WRL::ComPtr<ID3D12Device>& _device, size_t _sizeInBytes);
 
 Microsoft::WRL::ComPtr<ID3D12Resource> CreateDepthStencilTextureResource(const Microsoft::WRL::ComPtr<ID3D12Device>& _device, int32_t _width, int32_t _height);
@@ -89,7 +179,7 @@ DirectX::ScratchImage LoadTexture(const std::string& _filePath);
 Microsoft::WRL::ComPtr<ID3D12Resource> CreateTextureResource(const Microsoft::WRL::ComPtr<ID3D12Device>& _device, const DirectX::TexMetadata& _metadata);
 
 //データを転送するUploadTextureData関数を作る
-Microsoft::WRL::ComPtr<ID3D12Resource> UploadTextureData(const Microsoft::WRL::ComPtr<ID3D12Resource>& _texture, const DirectX::ScratchImage& _mipImages, const Microsoft::WRL::ComPtr<ID3D12Device>& _device, const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList);
+void UploadTextureData(const Microsoft::WRL::ComPtr<ID3D12Resource>& _texture, const DirectX::ScratchImage& _mipImages, const Microsoft::WRL::ComPtr<ID3D12Device>& _device, UploadManager& _uploadManager);
 
 
 D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandle(const Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& _descriptorHeap, uint32_t _descriptorSize, uint32_t _index);
@@ -140,84 +230,48 @@ struct TransformationMatrix
 	Matrix4x4 worldInverseTranspose;
 };
 
-struct Particle
-{
-	stTransform transform;
-	Vector3 velocity;
-	Vector4 color;
-	float lifeTime;
-	float currentTime;
-};
-
-struct Emitter
-{
-	stTransform transform;  //
-	uint32_t count;			//発生数
-	float frequency;		//発生頻度
-	float frequencyTime;	//頻度用時刻
-};
-
-
-struct ParticleForGPU
-{
-	Matrix4x4 WVP;
-	Matrix4x4 World;
-	Vector4 color;
-};
-
-struct AccelerationField
-{
-	Vector3 acceleration;
-	AABB area;
-};
-
-
-
 struct ModelData
 {
 	std::vector<VertexData> vertices;
 	std::string textureHandlePath;
 
-	TransformationMatrix* transformMat;
+	//定数バッファの中身 描画のたびにフレームごとのLinearAllocatorへ書き込む
+	TransformationMatrix transformMat;
+	Material materialData;
+	float useTexture;
 	VertexData* vertexData;
-	Material* materialData;
-	float* useTexture;
 	uint32_t* indexData;
-	Microsoft::WRL::ComPtr<ID3D12Resource> wvpResource;
 	Microsoft::WRL::ComPtr<ID3D12Resource> vertexResource;
-	Microsoft::WRL::ComPtr<ID3D12Resource> materialResource;
-	Microsoft::WRL::ComPtr<ID3D12Resource> useTextureResource;
 	Microsoft::WRL::ComPtr<ID3D12Resource> indexResource;
 	D3D12_INDEX_BUFFER_VIEW indexBufferView;
 	D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
 	uint32_t vertexNum;
 	uint32_t indexNum;
 	uint32_t textureHandle;
+	MeshBounds bounds;		//ローカル空間の境界 カリングに使う
 };
 
 struct  Object
 {
-	TransformationMatrix* transformMat;
+	//定数バッファの中身 描画のたびにフレームごとのLinearAllocatorへ書き込む
+	TransformationMatrix transformMat;
+	Material materialData;
+	float useTexture;
 	VertexData* vertexData;
-	Material* materialData;
-	float* useTexture;
 	uint32_t* indexData;
-	Microsoft::WRL::ComPtr<ID3D12Resource> wvpResource;
 	Microsoft::WRL::ComPtr<ID3D12Resource> vertexResource;
-	Microsoft::WRL::ComPtr<ID3D12Resource> materialResource;
-	Microsoft::WRL::ComPtr<ID3D12Resource> useTextureResource;
 	Microsoft::WRL::ComPtr<ID3D12Resource> indexResource;
 	D3D12_INDEX_BUFFER_VIEW indexBufferView;
 	D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
 	uint32_t vertexNum;
 	uint32_t indexNum;
 	uint32_t textureHandle;
+	MeshBounds bounds;		//ローカル空間の境界 カリングに使う
 };
 
 struct Texture
 {
 	Microsoft::WRL::ComPtr<ID3D12Resource> resource;
-	Microsoft::WRL::ComPtr<ID3D12Resource> intermediateResource;
 	D3D12_CPU_DESCRIPTOR_HANDLE srvHandlerCPU;
 	D3D12_GPU_DESCRIPTOR_HANDLE srvHandlerGPU;
 	std::string name;
@@ -226,7 +280,50 @@ struct Texture
 std::vector<Texture> textures;
 void DeleteTextures();
 
-ModelData LoadObjFile(const std::string& _directoryPath, const std::string& _filename, const Microsoft::WRL::ComPtr<ID3D12Device>& _device, const  Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, const  Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& _srvDescriptorHeap, uint32_t _srvSize);
+/// <summary>
+/// RenderQueueの命令をコマンドリストへ積むバックエンド
+/// PSOなどは登録順の番号で指す
+/// </summary>
+class D3D12RenderBackend
+{
+public:
+	uint32_t AddPipelineState(ID3D12PipelineState* _pipelineState) { pipelineStates.push_back(_pipelineState); return uint32_t(pipelineStates.size() - 1); }
+	//番号はそのままでPSOだけ入れ替える (シェーダーの再読み込み用)
+	void ReplacePipelineState(uint32_t _pipelineState, ID3D12PipelineState* _newPipelineState) { pipelineStates[_pipelineState] = _newPipelineState; }
+	uint32_t AddRootSignature(ID3D12RootSignature* _rootSignature) { rootSignatures.push_back(_rootSignature); return uint32_t(rootSignatures.size() - 1); }
+	uint32_t AddVertexBuffer(const D3D12_VERTEX_BUFFER_VIEW& _view) { vertexBuffers.push_back(_view); return uint32_t(vertexBuffers.size() - 1); }
+	uint32_t AddIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& _view) { indexBuffers.push_back(_view); return uint32_t(indexBuffers.size() - 1); }
+	void SetCommandList(ID3D12GraphicsCommandList* _commandList) { commandList = _commandList; }
+
+	void SetRootSignature(uint32_t _rootSignature) { commandList->SetGraphicsRootSignature(rootSignatures[_rootSignature]); }
+	void SetPipelineState(uint32_t _pipelineState) { commandList->SetPipelineState(pipelineStates[_pipelineState]); }
+	void SetVertexBuffer(uint32_t _vertexBuffer) { commandList->IASetVertexBuffers(0, 1, &vertexBuffers[_vertexBuffer]); }
+	void SetIndexBuffer(uint32_t _indexBuffer) { commandList->IASetIndexBuffer(&indexBuffers[_indexBuffer]); }
+	void SetConstantBuffer(uint32_t _rootParameter, uint64_t _address) { commandList->SetGraphicsRootConstantBufferView(_rootParameter, _address); }
+	void SetDescriptorTable(uint32_t _rootParameter, uint64_t _handle) { commandList->SetGraphicsRootDescriptorTable(_rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE{ _handle }); }
+	void SetShaderResource(uint32_t _rootParameter, uint64_t _address) { commandList->SetGraphicsRootShaderResourceView(_rootParameter, _address); }
+	void SetConstant(uint32_t _rootParameter, uint32_t _value) { commandList->SetGraphicsRoot32BitConstant(_rootParameter, _value, 0); }
+	void Draw(const DrawPacket& _packet)
+	{
+		if (_packet.indexBuffer == kRenderInvalidIndex)
+		{
+			commandList->DrawInstanced(_packet.count, _packet.instanceCount, 0, 0);
+		}
+		else
+		{
+			commandList->DrawIndexedInstanced(_packet.count, _packet.instanceCount, 0, 0, 0);
+		}
+	}
+
+private:
+	ID3D12GraphicsCommandList* commandList = nullptr;
+	std::vector<ID3D12PipelineState*> pipelineStates;
+	std::vector<ID3D12RootSignature*> rootSignatures;
+	std::vector<D3D12_VERTEX_BUFFER_VIEW> vertexBuffers;
+	std::vector<D3D12_INDEX_BUFFER_VIEW> indexBuffers;
+};
+
+ModelData LoadObjFile(const std::string& _directoryPath, const std::string& _filename, const Microsoft::WRL::ComPtr<ID3D12Device>& _device, UploadManager& _uploadManager, const  Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& _srvDescriptorHeap, uint32_t _srvSize);
 ModelData LoadObjFile(const std::string& _directoryPath, const std::string& _filename);
 
 /// <summary>
@@ -241,11 +338,11 @@ D3D12_GPU_DESCRIPTOR_HANDLE GetTextureHandle(uint32_t _textureHandle);
 /// </summary>
 /// <param name="_filePath">ファイルパス</param>
 /// <param name="_device">デバイス</param>
-/// <param name="_commandList">コマンドリスト</param>
+/// <param name="_uploadManager">転送を積む先 送るのは呼び出し側</param>
 /// <param name="_srvDescriptorHeap">ｓｒｖディスクリプタヒープ</param>
 /// <param name="_srvSize">srvのサイズ</param>
 /// <returns>テクスチャの登録番号</returns>
-uint32_t LoadTexture(const std::string& _filePath, const Microsoft::WRL::ComPtr<ID3D12Device>& _device, const  Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, const  Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& _srvDescriptorHeap, uint32_t _srvSize);
+uint32_t LoadTexture(const std::string& _filePath, const Microsoft::WRL::ComPtr<ID3D12Device>& _device, UploadManager& _uploadManager, const  Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& _srvDescriptorHeap, uint32_t _srvSize);
 
 /// <summary>
 /// 三角形のデータ作成
@@ -285,23 +382,33 @@ TransformationMatrix CalculateObjectWVPMat(const stTransform& _transform, const
 /// 三角形の描画
 /// </summary>
 /// <param name="_commandList">コマンドリスト</param>
+/// <param name="_allocator">定数バッファを書き込むフレームごとのアロケータ</param>
 /// <param name="_obj">三角形のデータ作成したObject変数</param>
 /// <param name="_textureHandle">テクスチャハンドル</param>
-void DrawTriangle(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, Object* _obj, Microsoft::WRL::ComPtr<ID3D12Resource> _light, uint32_t _textureHandle = 0);
+void DrawTriangle(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, LinearAllocator& _allocator, Object* _obj, D3D12_GPU_VIRTUAL_ADDRESS _light, uint32_t _textureHandle = 0);
 
 /// <summary>
 /// スプライトの描画
 /// </summary>
 /// <param name="_commandList">コマンドリスト</param>
+/// <param name="_allocator">定数バッファを書き込むフレームごとのアロケータ</param>
 /// <param name="_obj">スプライトのデータ作成したObject変数</param>
 /// <param name="_textureHandle">テクスチャハンドル</param>
-void DrawSprite(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, Object* _obj, Microsoft::WRL::ComPtr<ID3D12Resource> _light, uint32_t _textureHandle = 0);
-
-void DrawSphere(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, Object* _obj, uint32_t _textureHandle = 0);
+void DrawSprite(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, LinearAllocator& _allocator, Object* _obj, D3D12_GPU_VIRTUAL_ADDRESS _light, uint32_t _textureHandle = 0);
 
-Particle MakeNewParticle(std::mt19937& _randomEngine, const Emitter& _emitter);
+void DrawSphere(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, LinearAllocator& _allocator, Object* _obj, uint32_t _textureHandle = 0);
 
-std::list<Particle> Emit(const Emitter& _emitter, std::mt19937& _randomEngine);
+/// <summary>
+/// 定数バッファの中身をフレームごとのアロケータへ書き込む
+/// </summary>
+/// <returns>書き込んだ先のGPU仮想アドレス</returns>
+template <class T>
+D3D12_GPU_VIRTUAL_ADDRESS PushConstantBuffer(LinearAllocator& _allocator, const T& _data)
+{
+	LinearAllocation allocation = _allocator.Push(_data);
+	assert(allocation.cpuAddress != nullptr);
+	return allocation.gpuAddress;
+}
 
 enum class BlendMode
 {
@@ -315,7 +422,21 @@ enum class BlendMode
 
 void SetBlendMode(BlendMode _blendMode, D3D12_GRAPHICS_PIPELINE_STATE_DESC& _graphicsPipelineStateDesc);
 
-TransformationMatrix CalculateParticleWVPMat(const stTransform& _transform, const Matrix4x4& _cameraMatrix, const Matrix4x4& _VPmat, bool useBillborad);
+/// <summary>
+/// 描画順で結果が変わるブレンドモードか
+/// 加算・減算・乗算・スクリーンは順序に依存しないのでソート不要
+/// </summary>
+/// <param name="_blendMode">ブレンドモード</param>
+/// <returns>奥から描く必要があるならtrue</returns>
+bool RequiresDepthSort(BlendMode _blendMode);
+
+/// <summary>
+/// パーティクル用のビルボード行列の計算
+/// </summary>
+/// <param name="_cameraMatrix">カメラのワールド行列</param>
+/// <param name="useBillborad">ビルボードを使うか</param>
+/// <returns>平行移動成分を除いた回転行列</returns>
+Matrix4x4 CalculateBillboardMatrix(const Matrix4x4& _cameraMatrix, bool useBillborad);
 
 struct D3DResourceLeakChecker
 {
@@ -332,8 +453,138 @@ struct D3DResourceLeakChecker
 };
 
 // Windowsアプリでのエントリーポイント(main関数)
-int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
+int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR _commandLine, int)
 {
+	//-precompileShadersを付けて起動したら，シェーダーをキャッシュへコンパイルするだけで終わる (ビルド後などに使う)
+	if (std::string(_commandLine).find("-precompileShaders") != std::string::npos)
+	{
+		ThreadPool precompilePool;
+		ShaderCache precompileCache(kShaderCacheDirectory, CompileShaderWithDxc, GetShaderCompilerTag());
+		std::vector<std::vector<unsigned char>> bytecodes;
+		return CompileShaders(precompileCache, MakeShaderCompileRequests(), bytecodes, precompilePool) ? 0 : 1;
+	}
+	//-fuzzObbSatを付けて起動したら，投影半径によるOBBの分離軸判定を基準の判定と比べるだけで終わる
+	if (std::string(_commandLine).find("-fuzzObbSat") != std::string::npos)
+	{
+		const ObbSatFuzzResult fuzzResult = FuzzObbSat(7, 200);
+		Log(std::format("OBB SAT fuzz tested:{} hits:{} mismatches:{} borderline:{}\n", fuzzResult.tested, fuzzResult.hits, fuzzResult.mismatches, fuzzResult.borderline));
+		return fuzzResult.mismatches == 0 ? 0 : 1;
+	}
+	//-fuzzObbPrimitivesを付けて起動したら，obbと球・線分の判定を以前の逆行列による判定と10万組ずつ比べるだけで終わる
+	if (std::string(_commandLine).find("-fuzzObbPrimitives") != std::string::npos)
+	{
+		const ObbPrimitiveFuzzResult fuzzResult = FuzzObbPrimitives(7, 100);
+		Log(std::format("OBB primitive fuzz tested:{} sphereHits:{} segmentHits:{} mismatches:{} borderline:{}\n", fuzzResult.tested, fuzzResult.sphereHits, fuzzResult.segmentHits, fuzzResult.mismatches, fuzzResult.borderline));
+		return fuzzResult.mismatches == 0 ? 0 : 1;
+	}
+	//-benchRadixSortを付けて起動したら，パーティクル50万個分の深度の基数ソートの時間を測るだけで終わる (目標は1ms未満)
+	if (std::string(_commandLine).find("-benchRadixSort") != std::string::npos)
+	{
+		ThreadPool benchmarkPool;
+		const RadixSortBenchmarkResult benchmarkResult = BenchmarkRadixSort(500000, 100, &benchmarkPool);
+		Log(std::format("Radix sort count:{} threads:{} average:{:.3f}ms best:{:.3f}ms sorted:{}\n", benchmarkResult.count, benchmarkPool.GetThreadCount(), benchmarkResult.averageMilliseconds, benchmarkResult.bestMilliseconds, benchmarkResult.isSorted));
+		return benchmarkResult.isSorted ? 0 : 1;
+	}
+	//-benchBVHを付けて起動したら，1万・10万・100万個の球でBVHの構築・Refit・組の列挙・レイキャストの時間を測るだけで終わる
+	if (std::string(_commandLine).find("-benchBVH") != std::string::npos)
+	{
+		for (uint32_t count : { 10000u, 100000u, 1000000u })
+		{
+			const BVHBenchmarkResult benchmarkResult = BenchmarkBVH(count, 100000);
+			Log(std::format("BVH count:{} build:{:.2f}ms refit:{:.2f}ms pairs:{} contacts:{} ({:.2f}ms) rays:{} hits:{} ({:.2f}ms, {:.2f}M rays/s)\n",
+				benchmarkResult.count, benchmarkResult.buildMilliseconds, benchmarkResult.refitMilliseconds,
+				benchmarkResult.pairs, benchmarkResult.contacts, benchmarkResult.pairMilliseconds,
+				benchmarkResult.rays, benchmarkResult.rayHits, benchmarkResult.rayMilliseconds, benchmarkResult.rays / (benchmarkResult.rayMilliseconds * 1000.0f)));
+		}
+		return 0;
+	}
+
+	//-benchMeshBVHを付けて起動したら，起伏のある地面 (とterrain.objがあればそれ) でMeshBVHのレイキャストを測り，総当たりと比べるだけで終わる
+	if (std::string(_commandLine).find("-benchMeshBVH") != std::string::npos)
+	{
+		std::vector<std::pair<std::string, std::vector<Vector3>>> meshes;
+		meshes.emplace_back("heightfield", MakeHeightfieldTriangles(256, 1.0f));
+		if (std::filesystem::exists("resources/obj/terrain.obj"))
+		{
+			ModelData terrainData = LoadObjFile("resources/obj", "terrain.obj");
+			std::vector<Vector3> positions(terrainData.vertices.size());
+			for (size_t index = 0; index < positions.size(); index++)
+			{
+				const Vector4& position = terrainData.vertices[index].position;
+				positions[index] = { position.x, position.y, position.z };
+			}
+			meshes.emplace_back("terrain.obj", std::move(positions));
+		}
+
+		uint32_t mismatches = 0;
+		for (const auto& [name, positions] : meshes)
+		{
+			const MeshBVHBenchmarkResult benchmarkResult = BenchmarkMeshBVH(positions.data(), static_cast<uint32_t>(positions.size() / 3), 1000000, 2000);
+			Log(std::format("MeshBVH {} triangles:{} build:{:.2f}ms rays:{} hits:{} ({:.2f}ms, {:.2f}M rays/s) checked:{} mismatches:{}\n",
+				name, benchmarkResult.triangles, benchmarkResult.buildMilliseconds, benchmarkResult.rays, benchmarkResult.hits,
+				benchmarkResult.rayMilliseconds, benchmarkResult.rays / (benchmarkResult.rayMilliseconds * 1000.0f),
+				benchmarkResult.checkedRays, benchmarkResult.mismatches));
+			mismatches += benchmarkResult.mismatches;
+		}
+		return mismatches == 0 ? 0 : 1;
+	}
+	//-benchPhysicsを付けて起動したら，1万個のボールの山でPhysicsWorldの1ステップの時間を測るだけで終わる (目標は16.6ms未満)
+	if (std::string(_commandLine).find("-benchPhysics") != std::string::npos)
+	{
+		ThreadPool benchmarkPool;
+		const PhysicsBenchmarkResult benchmarkResult = BenchmarkPhysics(10000, 300, 300, &benchmarkPool);
+		Log(std::format("Physics balls:{} threads:{} steps:{} average:{:.2f}ms worst:{:.2f}ms contacts:{} islands:{} colors:{} escaped:{}\n",
+			benchmarkResult.balls, benchmarkPool.GetThreadCount(), benchmarkResult.steps, benchmarkResult.averageMilliseconds, benchmarkResult.worstMilliseconds,
+			benchmarkResult.contacts, benchmarkResult.islands, benchmarkResult.colors, benchmarkResult.escapedBalls));
+		return benchmarkResult.escapedBalls == 0 ? 0 : 1;
+	}
+	//-fuzzOcclusionを付けて起動したら，奇数の段ができる解像度を含めてHi-Zの判定を深度バッファの全画素と比べるだけで終わる
+	if (std::string(_commandLine).find("-fuzzOcclusion") != std::string::npos)
+	{
+		const OcclusionFuzzResult fuzzResult = FuzzOcclusionCulling(7, 40);
+		Log(std::format("Occlusion fuzz tested:{} occluded:{} referenceOccluded:{} violations:{}\n", fuzzResult.tested, fuzzResult.occluded, fuzzResult.referenceOccluded, fuzzResult.violations));
+		return fuzzResult.violations == 0 ? 0 : 1;
+	}
+	//-testRenderQueueChunksを付けて起動したら，範囲に分けて並列に積んだ描画がExecuteと同じになるか確かめるだけで終わる
+	//-testRenderQueueを含むので先に調べる
+	if (std::string(_commandLine).find("-testRenderQueueChunks") != std::string::npos)
+	{
+		//実際の分割数より多く分けても確かめる
+		ThreadPool testPool;
+		const RenderQueueChunkTestResult testResult = TestRenderQueueChunks(7, 100, kMaxRecordingChunks * 2, &testPool);
+		Log(std::format("RenderQueue chunk test executions:{} chunks:{} errors:{}\n", testResult.executions, testResult.chunks, testResult.errors));
+		return testResult.errors == 0 ? 0 : 1;
+	}
+	//-testRenderQueueを付けて起動したら，記録するだけのバックエンドで描画順と状態の設定を確かめるだけで終わる
+	if (std::string(_commandLine).find("-testRenderQueue") != std::string::npos)
+	{
+		const RenderQueueTestResult testResult = TestRenderQueue(7, 200);
+		Log(std::format("RenderQueue test packets:{} stateChanges:{} redundant:{} errors:{}\n", testResult.packets, testResult.stateChanges, testResult.redundantStateChanges, testResult.errors));
+		return testResult.errors == 0 ? 0 : 1;
+	}
+	//-testLinearAllocatorを付けて起動したら，遅れて終わるGPUを真似てLinearAllocatorの切り出しを確かめるだけで終わる
+	if (std::string(_commandLine).find("-testLinearAllocator") != std::string::npos)
+	{
+		const LinearAllocatorTestResult testResult = TestLinearAllocator(7, 100000);
+		Log(std::format("LinearAllocator test frames:{} allocations:{} failures:{} errors:{}\n", testResult.frames, testResult.allocations, testResult.failures, testResult.errors));
+		return testResult.errors == 0 ? 0 : 1;
+	}
+	//-testUploadRingを付けて起動したら，遅れて進むコピーキューを真似てUploadManagerのステージングの使い方を確かめるだけで終わる
+	if (std::string(_commandLine).find("-testUploadRing") != std::string::npos)
+	{
+		const UploadRingTestResult testResult = TestUploadRing(7, 100000);
+		Log(std::format("UploadRing test batches:{} uploads:{} empty batches:{} stalls:{} errors:{}\n", testResult.batches, testResult.uploads, testResult.emptyBatches, testResult.stalls, testResult.errors));
+		return testResult.errors == 0 ? 0 : 1;
+	}
+	//-testShaderCacheを付けて起動したら，一時ディレクトリのhlslと代わりのコンパイラでShaderCacheのキーを確かめるだけで終わる
+	if (std::string(_commandLine).find("-testShaderCache") != std::string::npos)
+	{
+		ThreadPool testPool;
+		const ShaderCacheTestResult testResult = TestShaderCache(std::filesystem::temp_directory_path() / "CG2ShaderCacheTest", &testPool);
+		Log(std::format("ShaderCache test requests:{} hits:{} compiles:{} errors:{}\n", testResult.requests, testResult.hits, testResult.compiles, testResult.errors));
+		return testResult.errors == 0 ? 0 : 1;
+	}
+
 	D3DResourceLeakChecker leakcheker;
 
 	std::random_device seedGenerator;
@@ -480,7 +731,12 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 		D3D12_MESSAGE_ID denyIds[] = {
 			//Windows11でのDXGIデバッグレイヤーとDX12デバッグレイヤーの相互作用バグによるエラーメッセージ
 			//URL省略
-			D3D12_MESSAGE_ID_RESOURCE_BARRIER_MISMATCHING_COMMAND_LIST_TYPE
+			D3D12_MESSAGE_ID_RESOURCE_BARRIER_MISMATCHING_COMMAND_LIST_TYPE,
+			//PipelineCacheはファイルのキャッシュが使えなければ作り直すので，ドライバやGPUが変わったときのエラーで止めない
+			D3D12_MESSAGE_ID_CREATEPIPELINESTATE_CACHEDBLOBADAPTERMISMATCH,
+			D3D12_MESSAGE_ID_CREATEPIPELINESTATE_CACHEDBLOBDRIVERVERSIONMISMATCH,
+			D3D12_MESSAGE_ID_CREATEPIPELINESTATE_CACHEDBLOBDESCMISMATCH,
+			D3D12_MESSAGE_ID_CREATEPIPELINESTATE_CACHEDBLOBIGNORED
 		};
 		//抑制するレベル
 		D3D12_MESSAGE_SEVERITY severities[] = { D3D12_MESSAGE_SEVERITY_INFO };
@@ -508,17 +764,44 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 
 	/// commandListを生成する
 	//コマンドアロケータを生成する
-	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator = nullptr; //命令保存用のメモリ管理機構 commandListとワンセット
-	hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator));
-	//コマンドアロケータの生成がうまくいかなかったので起動できない
-	assert(SUCCEEDED(hr));
+	//命令保存用のメモリ管理機構 GPUが前のフレームを実行している間に次のフレームを積めるようにフレームごとに持つ
+	FrameContext frameContexts[kMaxFramesInFlight] = {};
+	uint32_t frameIndex = 0;
+	for (FrameContext& frameContext : frameContexts)
+	{
+		hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&frameContext.commandAllocator));
+		//コマンドアロケータの生成がうまくいかなかったので起動できない
+		assert(SUCCEEDED(hr));
+		for (Microsoft::WRL::ComPtr<ID3D12CommandAllocator>& chunkAllocator : frameContext.chunkAllocators)
+		{
+			hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&chunkAllocator));
+			assert(SUCCEEDED(hr));
+		}
+		hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&frameContext.overlayAllocator));
+		assert(SUCCEEDED(hr));
+	}
 
-	//コマンドリストを生成する
+	//コマンドリストを生成する 積むときにそのフレームのコマンドアロケータでResetする
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList = nullptr;           //まとまった命令群
-	hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator.Get(), nullptr, IID_PPV_ARGS(&commandList));
+	hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, frameContexts[frameIndex].commandAllocator.Get(), nullptr, IID_PPV_ARGS(&commandList));
 	//コマンドリストの生成がうまくいかなかったので起動できない
 	assert(SUCCEEDED(hr));
 
+	//描画パケットを並列に積むコマンドリストとImGui用のコマンドリスト
+	//ExecuteCommandListsに渡した後ならすぐにResetできるので，アロケータだけフレームごとに持ち，コマンドリストは使い回す
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> chunkCommandLists[kMaxRecordingChunks];
+	for (Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& chunkCommandList : chunkCommandLists)
+	{
+		hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, frameContexts[frameIndex].chunkAllocators[0].Get(), nullptr, IID_PPV_ARGS(&chunkCommandList));
+		assert(SUCCEEDED(hr));
+		//積むときにResetするので閉じておく
+		chunkCommandList->Close();
+	}
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> overlayCommandList = nullptr;
+	hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, frameContexts[frameIndex].overlayAllocator.Get(), nullptr, IID_PPV_ARGS(&overlayCommandList));
+	assert(SUCCEEDED(hr));
+	overlayCommandList->Close();
+
 	/// SwapChainを生成する
 	//スワップチェーンを生成する
 	Microsoft::WRL::ComPtr<IDXGISwapChain4> swapChain = nullptr;
@@ -548,8 +831,25 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 
 
 	//imguiを使うためSRV用のが必要
-	//SRV用のヒープでディスクリプタの数は128。SRVはShader内で触るものなのでShaderVisivleはtrue
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> srvDescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 128, true);
+	//SRV用のヒープでディスクリプタの数はkSrvDescriptorCount。SRVはShader内で触るものなのでShaderVisivleはtrue
+	//どこに置くかはsrvAllocatorで決める
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> srvDescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, kSrvDescriptorCount, true);
+
+	//ImGuiのフォント用
+	const uint32_t imguiSrvIndex = srvAllocator.Allocate();
+	//テクスチャテーブル 読み込んでいない番号を引いても壊れないように空のSRVで埋めておく
+	textureTableIndex = srvAllocator.Allocate(kMaxTextures);
+	assert(textureTableIndex != kInvalidDescriptorIndex);
+	textureTableHandleGPU = GetGPUDescriptorHandle(srvDescriptorHeap, desriptorSizeSRV, textureTableIndex);
+	D3D12_SHADER_RESOURCE_VIEW_DESC nullSrvDesc{};
+	nullSrvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	nullSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	nullSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	nullSrvDesc.Texture2D.MipLevels = 1;
+	for (uint32_t index = 0; index < kMaxTextures; index++)
+	{
+		device->CreateShaderResourceView(nullptr, &nullSrvDesc, GetCPUDescriptorHandle(srvDescriptorHeap, desriptorSizeSRV, textureTableIndex + index));
+	}
 
 
 
@@ -588,20 +888,12 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	HANDLE fenceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
 	assert(fenceEvent != nullptr);
 
+	//テクスチャの転送はコピーキューで行い，描画のコマンドリストには積まない
+	UploadManager uploadManager(device.Get(), kUploadStagingSize, kMaxUploadBatchesInFlight);
 
-	/// DXCの初期化
-	// dxcCompilerを初期化
-	Microsoft::WRL::ComPtr<IDxcUtils> dxcUtils = nullptr;
-	Microsoft::WRL::ComPtr<IDxcCompiler3> dxcCompiler = nullptr;
-	hr = DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&dxcUtils));
-	assert(SUCCEEDED(hr));
-	hr = DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&dxcCompiler));
-	assert(SUCCEEDED(hr));
 
-	//現時点でinclideしないが,includeに対応するための設定を行っておく
-	Microsoft::WRL::ComPtr<IDxcIncludeHandler> includeHandler = nullptr;
-	hr = dxcUtils->CreateDefaultIncludeHandler(&includeHandler);
-	assert(SUCCEEDED(hr));
+	//シェーダーのコンパイル，PSOの事前生成，パーティクルのカーネル，カリング，描画パケットの記録などを並列に回すスレッド
+	ThreadPool threadPool;
 
 
 
@@ -632,8 +924,15 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	descriptorRange[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;//SRVを使う
 	descriptorRange[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;//ofsetを自動計算
 
+	//テクスチャテーブル全体 どれを使うかはルート定数の番号で選ぶ
+	D3D12_DESCRIPTOR_RANGE descriptorRangeForTextureTable[1] = {};
+	descriptorRangeForTextureTable[0].BaseShaderRegister = 0;
+	descriptorRangeForTextureTable[0].NumDescriptors = kMaxTextures;
+	descriptorRangeForTextureTable[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+	descriptorRangeForTextureTable[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
 	// RootParameter作成
-	D3D12_ROOT_PARAMETER rootParameters[6] = {};
+	D3D12_ROOT_PARAMETER rootParameters[7] = {};
 
 	//マテリアル
 	rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;           // CBVを使う
@@ -646,8 +945,8 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 
 	rootParameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;//DescriptorTableで使う
 	rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;			//pixelShaderで使う
-	rootParameters[2].DescriptorTable.pDescriptorRanges = descriptorRange;		//tableの中身の配列を指定
-	rootParameters[2].DescriptorTable.NumDescriptorRanges = _countof(descriptorRange);//tableで利用する数
+	rootParameters[2].DescriptorTable.pDescriptorRanges = descriptorRangeForTextureTable;		//tableの中身の配列を指定
+	rootParameters[2].DescriptorTable.NumDescriptorRanges = _countof(descriptorRangeForTextureTable);//tableで利用する数
 
 	//テクスチャの有無
 	rootParameters[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
@@ -664,10 +963,16 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	rootParameters[5].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 	rootParameters[5].Descriptor.ShaderRegister = 3;
 
+	//テクスチャテーブルの番号 (テクスチャハンドル)
+	rootParameters[6].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	rootParameters[6].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	rootParameters[6].Constants.ShaderRegister = 5;
+	rootParameters[6].Constants.Num32BitValues = 1;
+
 	////pointLight
-	//rootParameters[6].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-	//rootParameters[6].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
-	//rootParameters[6].Descriptor.ShaderRegister = 4;
+	//rootParameters[7].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+	//rootParameters[7].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	//rootParameters[7].Descriptor.ShaderRegister = 4;
 
 	descriptionRootSignature.pParameters = rootParameters;
 	descriptionRootSignature.NumParameters = _countof(rootParameters);         // 配列の長さ
@@ -689,6 +994,27 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	hr = device->CreateRootSignature(0, signatureBlob->GetBufferPointer(), signatureBlob->GetBufferSize(), IID_PPV_ARGS(&rootSignature));
 	assert(SUCCEEDED(hr));
 
+	//RenderQueueがまとめたObject3dのインスタンス描画用 行列だけをStructuredBuffer(ルートSRV)にする
+	D3D12_ROOT_PARAMETER rootParametersForObjectInstancing[_countof(rootParameters)] = {};
+	std::copy(std::begin(rootParameters), std::end(rootParameters), rootParametersForObjectInstancing);
+	rootParametersForObjectInstancing[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;    // SRVを使う
+	rootParametersForObjectInstancing[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;// VertexShaderで使う
+	rootParametersForObjectInstancing[1].Descriptor.ShaderRegister = 0;                    // レジスタ番号0を使う
+	D3D12_ROOT_SIGNATURE_DESC descriptionRootSignatureForObjectInstancing = descriptionRootSignature;
+	descriptionRootSignatureForObjectInstancing.pParameters = rootParametersForObjectInstancing;
+
+	Microsoft::WRL::ComPtr<ID3DBlob> signatureBlobForObjectInstancing = nullptr;
+	Microsoft::WRL::ComPtr<ID3DBlob> errorBlobForObjectInstancing = nullptr;
+	hr = D3D12SerializeRootSignature(&descriptionRootSignatureForObjectInstancing, D3D_ROOT_SIGNATURE_VERSION_1, &signatureBlobForObjectInstancing, &errorBlobForObjectInstancing);
+	if (FAILED(hr))
+	{
+		Log(reinterpret_cast<char*>(errorBlobForObjectInstancing->GetBufferPointer()));
+		assert(false);
+	}
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSignatureForObjectInstancing = nullptr;
+	hr = device->CreateRootSignature(0, signatureBlobForObjectInstancing->GetBufferPointer(), signatureBlobForObjectInstancing->GetBufferSize(), IID_PPV_ARGS(&rootSignatureForObjectInstancing));
+	assert(SUCCEEDED(hr));
+
 
 	D3D12_ROOT_SIGNATURE_DESC descriptionRootSignatureForInstancing{};
 	descriptionRootSignatureForInstancing.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
@@ -786,18 +1112,25 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	rasterizerDesc.FillMode = D3D12_FILL_MODE_SOLID;
 
 	/// shaderをコンパイルする
-	Microsoft::WRL::ComPtr<IDxcBlob> vertexShaderBlob = ComplieShader(L"Object3d.VS.hlsl", L"vs_6_0", dxcUtils, dxcCompiler, includeHandler);
-	assert(vertexShaderBlob != nullptr);
-
-	Microsoft::WRL::ComPtr<IDxcBlob>pixelShaderBlob = ComplieShader(L"Object3d.PS.hlsl", L"ps_6_0", dxcUtils, dxcCompiler, includeHandler);
-	assert(pixelShaderBlob != nullptr);
-
-	/// shaderをコンパイルする
-	Microsoft::WRL::ComPtr<IDxcBlob> particleVSBlob = ComplieShader(L"Particle.VS.hlsl", L"vs_6_0", dxcUtils, dxcCompiler, includeHandler);
-	assert(vertexShaderBlob != nullptr);
-
-	Microsoft::WRL::ComPtr<IDxcBlob> particlePSBlob = ComplieShader(L"Particle.PS.hlsl", L"ps_6_0", dxcUtils, dxcCompiler, includeHandler);
-	assert(pixelShaderBlob != nullptr);
+	//並列にコンパイルし，前回から変わっていないものはキャッシュから読む
+	ShaderCache shaderCache(kShaderCacheDirectory, CompileShaderWithDxc, GetShaderCompilerTag());
+	const std::vector<ShaderCompileRequest> shaderRequests = MakeShaderCompileRequests();
+	std::vector<std::vector<unsigned char>> shaderBytecodes;
+	bool isShaderCompiled = CompileShaders(shaderCache, shaderRequests, shaderBytecodes, threadPool);
+	//コンパイルできなかったので起動できない
+	assert(isShaderCompiled);
+	(void)isShaderCompiled;
+	//実行中はソースとincludeを見張り，保存されたらバックグラウンドでコンパイルし直す
+	ShaderHotReloader shaderHotReloader(&shaderCache, &threadPool);
+	for (uint32_t program = 0; program < kShaderCount; program++)
+	{
+		shaderHotReloader.AddProgram(shaderRequests[program], std::move(shaderBytecodes[program]));
+	}
+	auto getShaderBytecode = [&](ShaderProgram _program)
+		{
+			const std::vector<unsigned char>& bytecode = shaderHotReloader.GetBytecode(_program);
+			return D3D12_SHADER_BYTECODE{ bytecode.data(), bytecode.size() };
+		};
 
 
 	//DepthStencilStateの設定
@@ -819,12 +1152,20 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	//比較関数はLessEqeul つまり近ければ描画される
 	depthStencilDescForInstancing.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
 
+	//PSOは設定の中身をキーにしてキャッシュし，同じ設定なら作り直さない
+	//ルートシグネチャはポインタが起動ごとに変わるので，シリアライズした中身をキーに使う
+	PipelineCache pipelineCache(device.Get());
+	pipelineCache.RegisterRootSignature(rootSignature.Get(), signatureBlob->GetBufferPointer(), signatureBlob->GetBufferSize());
+	pipelineCache.RegisterRootSignature(rootSignatureForObjectInstancing.Get(), signatureBlobForObjectInstancing->GetBufferPointer(), signatureBlobForObjectInstancing->GetBufferSize());
+	pipelineCache.RegisterRootSignature(rootSignatureForInstancing.Get(), signatureBlobForInstancing->GetBufferPointer(), signatureBlobForInstancing->GetBufferSize());
+	pipelineCache.Load(kPipelineCachePath);
+
 	/// PSOを生成する
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC graphicsPipelineStateDesc{};
 	graphicsPipelineStateDesc.pRootSignature = rootSignature.Get();                                                 // RootSignature
 	graphicsPipelineStateDesc.InputLayout = inputLayoutDesc;                                                        // InputLayout
-	graphicsPipelineStateDesc.VS = { vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize() };	    // VertexShader
-	graphicsPipelineStateDesc.PS = { pixelShaderBlob->GetBufferPointer(), pixelShaderBlob->GetBufferSize() };       // PixelShader
+	graphicsPipelineStateDesc.VS = getShaderBytecode(kShaderObject3dVS);	    // VertexShader
+	graphicsPipelineStateDesc.PS = getShaderBytecode(kShaderObject3dPS);       // PixelShader
 	graphicsPipelineStateDesc.BlendState = blendDesc;                                                               // BlendState
 	graphicsPipelineStateDesc.RasterizerState = rasterizerDesc;                                                     // RasterizerState
 	// 追加の DRTV の情報
@@ -837,17 +1178,18 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	// どのように画面に色を打ち込むかの設定 (気にしなくて良い)
 	graphicsPipelineStateDesc.SampleDesc.Count = 1;
 	graphicsPipelineStateDesc.SampleMask = D3D12_DEFAULT_SAMPLE_MASK;
-	// 実際に生成
-	Microsoft::WRL::ComPtr<ID3D12PipelineState> graphicsPipelineState = nullptr;
-	hr = device->CreateGraphicsPipelineState(&graphicsPipelineStateDesc, IID_PPV_ARGS(&graphicsPipelineState));
-	assert(SUCCEEDED(hr));
+
+	//頂点シェーダーとルートシグネチャ以外はObject3dと同じ
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC graphicsPipelineStateDescForObjectInstancing = graphicsPipelineStateDesc;
+	graphicsPipelineStateDescForObjectInstancing.pRootSignature = rootSignatureForObjectInstancing.Get();
+	graphicsPipelineStateDescForObjectInstancing.VS = getShaderBytecode(kShaderObject3dInstancedVS);
 
 	/// PSOを生成する
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC graphicsPipelineStateDescForInstancing{};
 	graphicsPipelineStateDescForInstancing.pRootSignature = rootSignatureForInstancing.Get();                                                 // RootSignature
 	graphicsPipelineStateDescForInstancing.InputLayout = inputLayoutDesc;                                                        // InputLayout
-	graphicsPipelineStateDescForInstancing.VS = { particleVSBlob->GetBufferPointer(), particleVSBlob->GetBufferSize() };	        // VertexShader
-	graphicsPipelineStateDescForInstancing.PS = { particlePSBlob->GetBufferPointer(), particlePSBlob->GetBufferSize() };         // PixelShader
+	graphicsPipelineStateDescForInstancing.VS = getShaderBytecode(kShaderParticleVS);	        // VertexShader
+	graphicsPipelineStateDescForInstancing.PS = getShaderBytecode(kShaderParticlePS);         // PixelShader
 	//graphicsPipelineStateDescForInstancing.BlendState = blendDesc;                                                               // BlendState
 	SetBlendMode(BlendMode::kBlendModeNormal, graphicsPipelineStateDescForInstancing);
 	graphicsPipelineStateDescForInstancing.RasterizerState = rasterizerDesc;                                                     // RasterizerState
@@ -861,10 +1203,21 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	// どのように画面に色を打ち込むかの設定 (気にしなくて良い)
 	graphicsPipelineStateDescForInstancing.SampleDesc.Count = 1;
 	graphicsPipelineStateDescForInstancing.SampleMask = D3D12_DEFAULT_SAMPLE_MASK;
-	// 実際に生成
-	Microsoft::WRL::ComPtr<ID3D12PipelineState> graphicsPipelineStateForInstancing = nullptr;
-	hr = device->CreateGraphicsPipelineState(&graphicsPipelineStateDescForInstancing, IID_PPV_ARGS(&graphicsPipelineStateForInstancing));
-	assert(SUCCEEDED(hr));
+
+	//ImGuiで切り替えるパーティクルのブレンドモードも含めて，使うPSOをすべてワーカースレッドで作っておく
+	std::vector<D3D12_GRAPHICS_PIPELINE_STATE_DESC> precompileDescs = { graphicsPipelineStateDesc, graphicsPipelineStateDescForObjectInstancing };
+	for (BlendMode blendMode : { BlendMode::kBlendModeNormal, BlendMode::kBlendModeAdd, BlendMode::kBlendModeSub, BlendMode::kBlendModeMultiply, BlendMode::kBlendModeScreen })
+	{
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC blendModeDesc = graphicsPipelineStateDescForInstancing;
+		SetBlendMode(blendMode, blendModeDesc);
+		precompileDescs.push_back(blendModeDesc);
+	}
+	pipelineCache.Precompile(precompileDescs.data(), static_cast<uint32_t>(precompileDescs.size()), &threadPool);
+	// 実際に生成 (キャッシュから取り出す)
+	ID3D12PipelineState* graphicsPipelineState = pipelineCache.GetOrCreate(graphicsPipelineStateDesc);
+	ID3D12PipelineState* graphicsPipelineStateForObjectInstancing = pipelineCache.GetOrCreate(graphicsPipelineStateDescForObjectInstancing);
+	ID3D12PipelineState* graphicsPipelineStateForInstancing = pipelineCache.GetOrCreate(graphicsPipelineStateDescForInstancing);
+	assert(graphicsPipelineState != nullptr && graphicsPipelineStateForObjectInstancing != nullptr && graphicsPipelineStateForInstancing != nullptr);
 
 	///色の変更
 	Microsoft::WRL::ComPtr<ID3D12Resource> materialResource = CreateBufferResource(device, sizeof(VertexData) * 6);
@@ -874,14 +1227,12 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 
 
 #pragma region 平行光源
-	DirectionalLight* directionalLightData = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> directionalLightResource = CreateBufferResource(device, sizeof(DirectionalLight));
-	directionalLightResource->Map(0, nullptr, reinterpret_cast<void**>(&directionalLightData));
-
-	directionalLightData->color = { 1.0f,1.0f,1.0f,1.0f };
-	directionalLightData->direction = { 0.0f,-1.0f,0.0f };
-	directionalLightData->intensity = 1.0f;
-	directionalLightData->isHalf = true;
+	//GPUが前のフレームで読んでいる間に書き換えないように，フレームごとにframeAllocatorへ書き込む
+	DirectionalLight directionalLight{};
+	directionalLight.color = { 1.0f,1.0f,1.0f,1.0f };
+	directionalLight.direction = { 0.0f,-1.0f,0.0f };
+	directionalLight.intensity = 1.0f;
+	directionalLight.isHalf = true;
 
 #pragma endregion
 
@@ -899,7 +1250,7 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 #pragma region OBjの読み込み
 
 	////モデル読み込み
-	//ModelData objModelData = LoadObjFile("resources/obj", "fence.obj", device, commandList, srvDescriptorHeap, desriptorSizeSRV);
+	//ModelData objModelData = LoadObjFile("resources/obj", "fence.obj", device, uploadManager, srvDescriptorHeap, desriptorSizeSRV);
 	////頂点リソースを作る
 	//Microsoft::WRL::ComPtr<ID3D12Resource> vertexResourcePlane = CreateBufferResource(device, sizeof(VertexData) * objModelData.vertices.size());
 	////頂点バッファビューを作成する
@@ -980,11 +1331,11 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	ImGui_ImplWin32_Init(hwnd);
 	ImGui_ImplDX12_Init(
 		device.Get(),
-		swapChainDesc.BufferCount,
+		kMaxFramesInFlight,
 		rtvDesc.Format,
 		srvDescriptorHeap.Get(),
-		srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(),
-		srvDescriptorHeap->GetGPUDescriptorHandleForHeapStart()
+		GetCPUDescriptorHandle(srvDescriptorHeap, desriptorSizeSRV, imguiSrvIndex),
+		GetGPUDescriptorHandle(srvDescriptorHeap, desriptorSizeSRV, imguiSrvIndex)
 	);
 
 
@@ -996,16 +1347,8 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	MakeModelData(device, modelData, "resources/obj", "plane.obj");
 
 	const uint32_t kNumMaxInstance = 100;
-	Microsoft::WRL::ComPtr<ID3D12Resource> instancingResource = CreateBufferResource(device, sizeof(ParticleForGPU) * kNumMaxInstance);
-
-	ParticleForGPU* instancingData = nullptr;
-	instancingResource->Map(0, nullptr, reinterpret_cast<void**>(&instancingData));
-	for (uint32_t index = 0; index < kNumMaxInstance; index++)
-	{
-		instancingData->World = MakeIdentity4x4();
-		instancingData->WVP = MakeIdentity4x4();
-	}
 
+	//インスタンスのデータはGPUが前のフレームで読んでいる間に書き換えないように，フレームごとにframeAllocatorへ書き込む
 	D3D12_SHADER_RESOURCE_VIEW_DESC instancingSrvDesc{};
 	instancingSrvDesc.Format = DXGI_FORMAT_UNKNOWN;
 	instancingSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -1014,18 +1357,13 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	instancingSrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
 	instancingSrvDesc.Buffer.NumElements = kNumMaxInstance;
 	instancingSrvDesc.Buffer.StructureByteStride = sizeof(ParticleForGPU);
-
-	D3D12_CPU_DESCRIPTOR_HANDLE instancingSrvHandlerCPU = GetCPUDescriptorHandle(srvDescriptorHeap, desriptorSizeSRV, 2);
-	D3D12_GPU_DESCRIPTOR_HANDLE instancingSrvHandlerGPU = GetGPUDescriptorHandle(srvDescriptorHeap, desriptorSizeSRV, 2);
-	device->CreateShaderResourceView(instancingResource.Get(), &instancingSrvDesc, instancingSrvHandlerCPU);
+	//位置と要素数はフレームごとに変わるので，SRVは描くフレームでsrvAllocatorの一時的な領域に作る
 
 
 	///******************************************
 
-	///カメラ
-	CameraForGPU* cameraForGPU = nullptr;
-	Microsoft::WRL::ComPtr<ID3D12Resource> cameraResource = CreateBufferResource(device, sizeof(CameraForGPU));
-	cameraResource->Map(0, nullptr, reinterpret_cast<void**>(&cameraForGPU));
+	///カメラ 平行光源と同じくフレームごとに書き込む
+	CameraForGPU cameraForGPU{};
 
 	///
 	/// 変数宣言
@@ -1041,7 +1379,9 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	stTransform spriteTrans{ {1.0f,1.0f,1.0f},{0.0f,0.0f,0.0f} ,{0.0f,0.0f,0.0f} };
 	stTransform spriteUVTrans{ {1.0f,1.0f,1.0f},{0.0f,0.0f,0.0f} ,{0.0f,0.0f,0.0f} };
 
-	std::list <Particle> particles;
+	//パーティクルのカーネルを回すスレッド (PSOの事前生成と同じもの)
+	ComputeDispatcher computeDispatcher(&threadPool);
+	ParticleSystem particleSystem(&computeDispatcher, kNumMaxInstance);
 	bool useBillboard = false;
 
 	Emitter emitter{};
@@ -1054,12 +1394,39 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 		.translate = {0.0f,0.0f,0.0f}
 	};
 
+	EmitterSystem emitterSystem;
+	emitterSystem.SetParticleBudget(kNumMaxInstance);
+	uint32_t emitterHandle = emitterSystem.AddEmitter({
+		.translate = emitter.transform.translate,
+		.count = emitter.count,
+		.frequency = emitter.frequency,
+		.boundsRadius = 1.0f,
+		.priority = 0
+		});
+	std::vector<EmitRequest> emitRequests;
+
+	//描画とは切り離してサブシステムごとの頻度で固定ステップ更新する
+	//重いときは上限を超えたステップを捨てるので，処理落ちしてもフレームが詰まり続けない
+	FrameClock frameClock;
+	FixedTimestep particleTimestep(60.0f, 4);
+	FixedTimestep emitterTimestep(30.0f, 2);
+	int particleTickRate = 60;
+	int emitterTickRate = 30;
+	float timeScale = 1.0f;
+
 	AccelerationField accelerationField;
 	accelerationField.acceleration = { 15.0f,0.0f,0.0f };
 	accelerationField.area.min = { -1.0f ,-1.0f ,-1.0f };
 	accelerationField.area.max = { 1.0f , 1.0f , 1.0f };
 	bool enableAccelerationField = false;
 
+	std::vector<ForceField> forceFields;
+	forceFields.push_back({ ForceFieldType::kVortex, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, 3.0f, 10.0f });
+	forceFields.push_back({ ForceFieldType::kAttractor, { 0.0f, 2.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, 2.0f, 5.0f });
+	bool enableForceFields = false;
+	float repulsionRadius = 0.0f;
+	float repulsionStrength = 5.0f;
+
 
 	uint32_t currentTexture = 0;
 	const char* textureOption[] = { "uvChecker","cube","monsterBall" };
@@ -1071,12 +1438,12 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	bool useTexture[3] = { true ,true,true };
 
 
-	uint32_t uvGH = LoadTexture("resources/images/uvChecker.png", device, commandList, srvDescriptorHeap, desriptorSizeSRV);
-	uint32_t cubeGH = LoadTexture("resources/images/cube.jpg", device, commandList, srvDescriptorHeap, desriptorSizeSRV);
-	uint32_t ballGH = LoadTexture("resources/images/monsterBall.png", device, commandList, srvDescriptorHeap, desriptorSizeSRV);
-	uint32_t fenceGH = LoadTexture("resources/obj/fence.png", device, commandList, srvDescriptorHeap, desriptorSizeSRV);
+	uint32_t uvGH = LoadTexture("resources/images/uvChecker.png", device, uploadManager, srvDescriptorHeap, desriptorSizeSRV);
+	uint32_t cubeGH = LoadTexture("resources/images/cube.jpg", device, uploadManager, srvDescriptorHeap, desriptorSizeSRV);
+	uint32_t ballGH = LoadTexture("resources/images/monsterBall.png", device, uploadManager, srvDescriptorHeap, desriptorSizeSRV);
+	uint32_t fenceGH = LoadTexture("resources/obj/fence.png", device, uploadManager, srvDescriptorHeap, desriptorSizeSRV);
 
-	modelData->textureHandle = LoadTexture("./resources/images/circle.png", device, commandList, srvDescriptorHeap, desriptorSizeSRV);
+	modelData->textureHandle = LoadTexture("./resources/images/circle.png", device, uploadManager, srvDescriptorHeap, desriptorSizeSRV);
 
 
 	Object* sphere = new Object;
@@ -1087,10 +1454,199 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 	MakeSpriteData(device, sprite);
 
 	ModelData* terrianModel = new ModelData;
-	*terrianModel = LoadObjFile("resources/obj", "terrain.obj", device, commandList, srvDescriptorHeap, desriptorSizeSRV);
+	*terrianModel = LoadObjFile("resources/obj", "terrain.obj", device, uploadManager, srvDescriptorHeap, desriptorSizeSRV);
+	//読み込んだテクスチャの転送をまとめてコピーキューへ送る 描画は最初のフレームでGPU上だけ待つ
+	uploadManager.Flush();
 
 	stTransform terrainTrans{ {1.0f,1.0f,1.0f},{0.0f,0.0f,0.0f} ,{0.0f,0.0f,0.0f} };
 
+	//地形のレイキャスト用BVH 頂点は動かないので読み込み時に一度だけ作る
+	std::vector<Vector3> terrainPositions(terrianModel->vertices.size());
+	for (size_t index = 0; index < terrainPositions.size(); index++)
+	{
+		const Vector4& position = terrianModel->vertices[index].position;
+		terrainPositions[index] = { position.x, position.y, position.z };
+	}
+	MeshBVH terrainBVH;
+	terrainBVH.Build(terrainPositions.data(), static_cast<uint32_t>(terrainPositions.size() / 3));
+
+	//視錐台カリング 境界はInitializeMeshDataなどで読み込み時に求めてある
+	FrustumCuller frustumCuller(&threadPool);
+	MeshBoundsSoA cullingBounds;
+	std::vector<uint32_t> visibleMeshes;
+	enum CullingTarget : uint32_t
+	{
+		kCullingSphere,
+		kCullingTerrain,
+		kCullingTargetCount
+	};
+	bool isVisible[kCullingTargetCount] = {};
+	//地形を遮蔽物にして，その奥に隠れたものを描かない
+	OcclusionCuller occlusionCuller(256, 128, &threadPool);
+	bool enableOcclusionCulling = true;
+
+	//描画はパケットにしてRenderQueueで並べてから積む
+	RenderQueue renderQueue(&threadPool);
+	D3D12RenderBackend renderBackend;
+	const uint32_t objectRootSignature = renderBackend.AddRootSignature(rootSignature.Get());
+	const uint32_t objectPipelineState = renderBackend.AddPipelineState(graphicsPipelineState);
+	//同じメッシュ・マテリアル・テクスチャの描画はまとめてインスタンス描画にする
+	InstancingDesc objectInstancing{};
+	objectInstancing.pipelineState = renderBackend.AddPipelineState(graphicsPipelineStateForObjectInstancing);
+	objectInstancing.rootSignature = renderBackend.AddRootSignature(rootSignatureForObjectInstancing.Get());
+	objectInstancing.rootParameter = 1;
+	renderQueue.SetInstancing(objectPipelineState, objectInstancing);
+	const uint32_t sphereVertexBuffer = renderBackend.AddVertexBuffer(sphere->vertexBufferView);
+	const uint32_t terrainVertexBuffer = renderBackend.AddVertexBuffer(terrianModel->vertexBufferView);
+	//定数バッファやまとめた描画の行列はフレームごとにここから切り出す
+	//1つの大きなアップロードバッファをMapしたまま使い，GPUが終えたフレームの分から使い直す
+	const size_t kFrameUploadBufferSize = 8 * 1024 * 1024;
+	Microsoft::WRL::ComPtr<ID3D12Resource> frameUploadResource = CreateBufferResource(device, kFrameUploadBufferSize);
+	void* frameUploadData = nullptr;
+	frameUploadResource->Map(0, nullptr, &frameUploadData);
+	LinearAllocator frameAllocator(frameUploadData, frameUploadResource->GetGPUVirtualAddress(), kFrameUploadBufferSize, kMaxFramesInFlight, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	//球を並べた小物 (同じメッシュなので1回のインスタンス描画になる)
+	const int kMaxProps = 4096;
+	int propCount = 0;
+	float propSpacing = 1.5f;
+	std::vector<TransformationMatrix> propMatrices;
+	//描画パケットを並列に積むときのバックエンド 登録した表は同じで，積む先のコマンドリストだけが違う
+	//表の登録はここまでに済ませておく
+	D3D12RenderBackend chunkBackends[kMaxRecordingChunks];
+	for (uint32_t chunk = 0; chunk < kMaxRecordingChunks; chunk++)
+	{
+		chunkBackends[chunk] = renderBackend;
+		chunkBackends[chunk].SetCommandList(chunkCommandLists[chunk].Get());
+	}
+	//コンパイルし直したシェーダーでPSOを作り直し，フレームの区切りで差し替える
+	//前のPSOはキャッシュから外し，まだGPUで使っているフレームが終わるまでretiredPipelineStatesで持っておく
+	std::vector<uint32_t> reloadedShaders;
+	//差し替えで使わなくなったPSO GPUがfenceValueまで終えたら解放する
+	struct RetiredPipelineState
+	{
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+		uint64_t fenceValue;
+	};
+	std::vector<RetiredPipelineState> retiredPipelineStates;
+	//シェーダーを差し替えると変わるPSOの設定 パーティクルはブレンドモードの数だけある
+	auto makeReloadDescs = [&]()
+		{
+			std::vector<D3D12_GRAPHICS_PIPELINE_STATE_DESC> descs = { graphicsPipelineStateDesc, graphicsPipelineStateDescForObjectInstancing };
+			for (BlendMode blendMode : { BlendMode::kBlendModeNormal, BlendMode::kBlendModeAdd, BlendMode::kBlendModeSub, BlendMode::kBlendModeMultiply, BlendMode::kBlendModeScreen })
+			{
+				D3D12_GRAPHICS_PIPELINE_STATE_DESC blendModeDesc = graphicsPipelineStateDescForInstancing;
+				SetBlendMode(blendMode, blendModeDesc);
+				descs.push_back(blendModeDesc);
+			}
+			return descs;
+		};
+	//今使っているそれらのPSOのキー 前のバイトコードはUpdateで捨てられて後からキーを作れないので，作ったときに覚えておく
+	auto calculateReloadKeys = [&](const std::vector<D3D12_GRAPHICS_PIPELINE_STATE_DESC>& _descs)
+		{
+			std::vector<uint64_t> keys;
+			for (const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc : _descs)
+			{
+				keys.push_back(pipelineCache.CalculateKey(desc));
+			}
+			return keys;
+		};
+	std::vector<uint64_t> reloadKeys = calculateReloadKeys(makeReloadDescs());
+	auto assignShaderBytecodes = [&]()
+		{
+			graphicsPipelineStateDesc.VS = getShaderBytecode(kShaderObject3dVS);
+			graphicsPipelineStateDesc.PS = getShaderBytecode(kShaderObject3dPS);
+			graphicsPipelineStateDescForObjectInstancing.VS = getShaderBytecode(kShaderObject3dInstancedVS);
+			graphicsPipelineStateDescForObjectInstancing.PS = getShaderBytecode(kShaderObject3dPS);
+			graphicsPipelineStateDescForInstancing.VS = getShaderBytecode(kShaderParticleVS);
+			graphicsPipelineStateDescForInstancing.PS = getShaderBytecode(kShaderParticlePS);
+		};
+	auto applyReloadedShaders = [&](const std::vector<uint32_t>& _reloaded)
+		{
+			assignShaderBytecodes();
+
+			//変わっていないシェーダーの組み合わせはキャッシュにあるものが返るので，作り直すのは影響を受けたPSOだけ
+			const std::vector<D3D12_GRAPHICS_PIPELINE_STATE_DESC> reloadDescs = makeReloadDescs();
+			pipelineCache.Precompile(reloadDescs.data(), static_cast<uint32_t>(reloadDescs.size()), &threadPool);
+
+			//コンパイルは通ってもルートシグネチャや入力レイアウトと合わないとPSOが作れない
+			//1つでも作れなければ，作れたものも捨てて前のシェーダーとPSOのまま続ける
+			bool isAllCreated = true;
+			for (const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc : reloadDescs)
+			{
+				isAllCreated = isAllCreated && pipelineCache.GetOrCreate(desc) != nullptr;
+			}
+			if (!isAllCreated)
+			{
+				//今回作ったものはまだGPUに渡していないのですぐ消してよい
+				for (uint64_t key : calculateReloadKeys(reloadDescs))
+				{
+					if (std::find(reloadKeys.begin(), reloadKeys.end(), key) == reloadKeys.end())
+					{
+						pipelineCache.Remove(key);
+					}
+				}
+				shaderHotReloader.Revert(_reloaded);
+				assignShaderBytecodes();
+				Log("shader reload: failed to create pipeline states, keeping the previous shaders\n");
+				return;
+			}
+
+			const std::vector<uint64_t> previousKeys = std::move(reloadKeys);
+			reloadKeys = calculateReloadKeys(reloadDescs);
+
+			graphicsPipelineState = pipelineCache.GetOrCreate(graphicsPipelineStateDesc);
+			graphicsPipelineStateForObjectInstancing = pipelineCache.GetOrCreate(graphicsPipelineStateDescForObjectInstancing);
+			graphicsPipelineStateForInstancing = pipelineCache.GetOrCreate(graphicsPipelineStateDescForInstancing);
+			renderBackend.ReplacePipelineState(objectPipelineState, graphicsPipelineState);
+			renderBackend.ReplacePipelineState(objectInstancing.pipelineState, graphicsPipelineStateForObjectInstancing);
+			for (D3D12RenderBackend& chunkBackend : chunkBackends)
+			{
+				chunkBackend.ReplacePipelineState(objectPipelineState, graphicsPipelineState);
+				chunkBackend.ReplacePipelineState(objectInstancing.pipelineState, graphicsPipelineStateForObjectInstancing);
+			}
+
+			//作り直したPSOの前のものは，最後に送ったフレームまでGPUが終えたら解放する
+			for (uint64_t previousKey : previousKeys)
+			{
+				if (std::find(reloadKeys.begin(), reloadKeys.end(), previousKey) != reloadKeys.end())
+				{
+					continue;
+				}
+				Microsoft::WRL::ComPtr<ID3D12PipelineState> removed = pipelineCache.Remove(previousKey);
+				if (removed != nullptr)
+				{
+					retiredPipelineStates.push_back({ std::move(removed), fenceValue });
+				}
+			}
+		};
+
+	//このフレームの平行光源とカメラの定数バッファ
+	D3D12_GPU_VIRTUAL_ADDRESS directionalLightAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS cameraAddress = 0;
+
+	//Object3dのPSOで描くメッシュの描画パケット
+	//行列はSubmitに渡してインスタンス描画にまとめるので，ここでは定数バッファを設定しない
+	auto makeMeshPacket = [&](uint32_t _vertexBuffer, uint32_t _vertexCount, uint32_t _textureHandle, D3D12_GPU_VIRTUAL_ADDRESS _material, D3D12_GPU_VIRTUAL_ADDRESS _useTexture, float _viewDepth)
+		{
+			DrawPacket packet{};
+			packet.sortKey = MakeSortKey(RenderPass::kOpaque, objectPipelineState, objectRootSignature, _textureHandle, QuantizeDepth(_viewDepth, kNearClip, kFarClip));
+			packet.pipelineState = objectPipelineState;
+			packet.rootSignature = objectRootSignature;
+			packet.vertexBuffer = _vertexBuffer;
+			packet.indexBuffer = kRenderInvalidIndex;
+			packet.count = _vertexCount;
+			packet.instanceCount = 1;
+			packet.bindings[0] = { 0, RootBindingType::kConstantBuffer, _material };
+			packet.bindings[1] = { 1, RootBindingType::kConstantBuffer, 0 };
+			packet.bindings[2] = { 2, RootBindingType::kDescriptorTable, textureTableHandleGPU.ptr };
+			packet.bindings[3] = { 3, RootBindingType::kConstantBuffer, _useTexture };
+			packet.bindings[4] = { 4, RootBindingType::kConstantBuffer, directionalLightAddress };
+			packet.bindings[5] = { 5, RootBindingType::kConstantBuffer, cameraAddress };
+			packet.bindings[6] = { 6, RootBindingType::kConstant, _textureHandle };
+			packet.bindingCount = 7;
+			return packet;
+		};
+
 
 	///
 	/// メインループ
@@ -1111,6 +1667,18 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 			ImGui_ImplWin32_NewFrame();
 			ImGui::NewFrame();
 
+			frameClock.Tick();
+			//GPUが終えたフレームの定数バッファを使い直す
+			//前のフレームの終わりにこのフレームのコンテキストを待っているので，記録できるフレーム数を超えない
+			frameAllocator.BeginFrame(fence->GetCompletedValue());
+			srvAllocator.BeginFrame(fence->GetCompletedValue());
+			retiredPipelineStates.erase(std::remove_if(retiredPipelineStates.begin(), retiredPipelineStates.end(),
+				[&](const RetiredPipelineState& _retired) { return _retired.fenceValue <= fence->GetCompletedValue(); }), retiredPipelineStates.end());
+			//まだ何も積んでいないここでシェーダーを差し替えるので，1つのフレームの中で古いものと新しいものが混ざらない
+			if (shaderHotReloader.Update(reloadedShaders))
+			{
+				applyReloadedShaders(reloadedShaders);
+			}
 
 			///
 			/// 更新処理ここから
@@ -1132,7 +1700,7 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 			if (ImGui::TreeNode("Sphere"))
 			{
 				ImGui::ColorEdit4("color", &objColor1.x);
-				ImGui::SliderFloat("shininess", &sphere->materialData->shininess, 1.0f, 50.0f);
+				ImGui::SliderFloat("shininess", &sphere->materialData.shininess, 1.0f, 50.0f);
 				ImGui::DragFloat3("scale", &transform.scale.x, 0.01f);
 				ImGui::DragFloat3("rotate", &transform.rotate.x, 0.01f);
 				ImGui::DragFloat3("translate", &transform.translate.x, 0.01f);
@@ -1143,9 +1711,9 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 				{
 					sphere->textureHandle = static_cast<uint32_t> (currentTex);
 				}
-				sphere->materialData->color = objColor1;
-				sphere->materialData->enabledLighthig = enableLightting[0];
-				*sphere->useTexture = useTexture[0] ? 1.0f : 0.0f;
+				sphere->materialData.color = objColor1;
+				sphere->materialData.enabledLighthig = enableLightting[0];
+				sphere->useTexture = useTexture[0] ? 1.0f : 0.0f;
 				ImGui::TreePop();
 			}
 			if (ImGui::TreeNode("OBJ"))
@@ -1174,111 +1742,222 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 				{
 					sprite->textureHandle = static_cast<uint32_t> (currentTex);
 				}
-				sprite->materialData->color = objColor1;
+				sprite->materialData.color = objColor1;
 
 				if (ImGui::TreeNode("uvTransform"))
 				{
 					ImGui::DragFloat2("uvTranslate", &spriteUVTrans.translate.x, 0.01f, -10.0f, 10.0f);
 					ImGui::DragFloat2("uvScale", &spriteUVTrans.scale.x, 0.01f, -10.0f, 10.0f);
 					ImGui::SliderAngle("uvRotate", &spriteUVTrans.rotate.z);
-					sprite->materialData->uvTransform = MakeAffineMatrix(spriteUVTrans.scale, spriteUVTrans.rotate, spriteUVTrans.translate);
+					sprite->materialData.uvTransform = MakeAffineMatrix(spriteUVTrans.scale, spriteUVTrans.rotate, spriteUVTrans.translate);
 					ImGui::TreePop();
 				}
 				ImGui::TreePop();
 			}
 			if (ImGui::TreeNode("Terrain"))
 			{
-				ImGui::ColorEdit4("color", &terrianModel->materialData->color.x);
-				ImGui::SliderFloat("shininess", &terrianModel->materialData->shininess, 1.0f, 50.0f);
+				ImGui::ColorEdit4("color", &terrianModel->materialData.color.x);
+				ImGui::SliderFloat("shininess", &terrianModel->materialData.shininess, 1.0f, 50.0f);
 				ImGui::DragFloat3("scale", &terrainTrans.scale.x, 0.01f);
 				ImGui::DragFloat3("rotate", &terrainTrans.rotate.x, 0.01f);
 				ImGui::DragFloat3("translate", &terrainTrans.translate.x, 0.01f);
 				ImGui::Checkbox("Lighting", &enableLightting[2]);
 				ImGui::Checkbox("useTexture", &useTexture[2]);
-				terrianModel->materialData->enabledLighthig = enableLightting[2];
-				*terrianModel->useTexture = useTexture[1] ? 1.0f : 0.0f;
+				terrianModel->materialData.enabledLighthig = enableLightting[2];
+				terrianModel->useTexture = useTexture[1] ? 1.0f : 0.0f;
+
+				//カメラの正面へ飛ばしたレイを地形のローカル空間で判定する
+				Matrix4x4 cameraWorld = MakeAffineMatrix(cameraTransform.scale, cameraTransform.rotate, cameraTransform.translate);
+				Matrix4x4 terrainInverse = Inverse(MakeAffineMatrix(terrainTrans.scale, terrainTrans.rotate, terrainTrans.translate));
+				Vector3 forward = { cameraWorld.m[2][0], cameraWorld.m[2][1], cameraWorld.m[2][2] };
+				Vector3 rayOrigin = Transform(cameraTransform.translate, terrainInverse);
+				Vector3 rayEnd = Transform(cameraTransform.translate + forward * 1000.0f, terrainInverse);
+				RayHit terrainHit{};
+				if (terrainBVH.RayCast(Segment{ rayOrigin, rayEnd - rayOrigin }, terrainHit))
+				{
+					ImGui::Text("hit triangle:%u t:%.4f uv:(%.3f, %.3f)", terrainHit.triangle, terrainHit.t, terrainHit.u, terrainHit.v);
+				}
+				else
+				{
+					ImGui::Text("hit: none");
+				}
 				ImGui::TreePop();
 			}
 
 
 			if (ImGui::TreeNode("DirectionalLight"))
 			{
-				ImGui::ColorEdit3("color", &directionalLightData->color.x);
-				ImGui::DragFloat3("direction", &directionalLightData->direction.x, 0.01f);
-				ImGui::DragFloat("intensity", &directionalLightData->intensity, 0.01f);
+				ImGui::ColorEdit3("color", &directionalLight.color.x);
+				ImGui::DragFloat3("direction", &directionalLight.direction.x, 0.01f);
+				ImGui::DragFloat("intensity", &directionalLight.intensity, 0.01f);
 				ImGui::Checkbox("isHalf", &ishalf);
 
-				directionalLightData->isHalf = ishalf;
-				directionalLightData->direction = Normalize(directionalLightData->direction);
+				directionalLight.isHalf = ishalf;
+				directionalLight.direction = Normalize(directionalLight.direction);
 				ImGui::TreePop();
 			}
 
 			//}
 			if (ImGui::Button("Add Particles"))
 			{
-				particles.splice(particles.end(), Emit(emitter, randomEngine));
+				particleSystem.Emit(emitter, randomEngine());
 			}
 			ImGui::DragFloat3("EmitterTranslate", &emitter.transform.translate.x, 0.01f, -100.0f, 100.0f);
 			ImGui::Checkbox("enableField", &enableAccelerationField);
+			ImGui::Checkbox("enableForceFields", &enableForceFields);
+			ImGui::DragFloat("repulsionRadius", &repulsionRadius, 0.01f, 0.0f, 2.0f);
+			ImGui::DragFloat("repulsionStrength", &repulsionStrength, 0.1f, 0.0f, 50.0f);
 			if (ImGui::Combo("BlendMode", &currentBlendMode, blendModeOption, IM_ARRAYSIZE(blendModeOption)))
 			{
 				SetBlendMode(static_cast<BlendMode>(currentBlendMode), graphicsPipelineStateDescForInstancing);
-				device->CreateGraphicsPipelineState(&graphicsPipelineStateDescForInstancing, IID_PPV_ARGS(&graphicsPipelineStateForInstancing));
+				//作っておいたものを取り出すだけなのでフレームは止まらない
+				//ホットリロードで作れなかったシェーダーは戻してあるので，ここで作れないことはない
+				graphicsPipelineStateForInstancing = pipelineCache.GetOrCreate(graphicsPipelineStateDescForInstancing);
+				assert(graphicsPipelineStateForInstancing != nullptr);
 			}
+			const UploadStats uploadStats = uploadManager.GetStats();
+			ImGui::Text("uploads:%u batches:%u staging:%.1f/%.1fMB", uploadStats.copies, uploadStats.batches, uploadManager.GetStagingUsedSize() / (1024.0f * 1024.0f), uploadManager.GetStagingCapacity() / (1024.0f * 1024.0f));
+			const PipelineCacheStats pipelineCacheStats = pipelineCache.GetStats();
+			ImGui::Text("PSOs:%u (from disk:%u) reused:%u failed:%u", pipelineCache.GetCount(), pipelineCacheStats.diskHits, pipelineCacheStats.hits, pipelineCacheStats.failures);
+			const ShaderHotReloadStats shaderReloadStats = shaderHotReloader.GetStats();
+			ImGui::Text("shader reloads:%u failed:%u last:%.2fs%s", shaderReloadStats.reloads, shaderReloadStats.failures, shaderReloadStats.lastCompileTime, shaderHotReloader.IsCompiling() ? " (compiling)" : "");
 			ImGui::Checkbox("useBillboard", &useBillboard);
+			if (ImGui::TreeNode("Time"))
+			{
+				ImGui::Text("fps:%.1f frame:%.2fms", frameClock.GetFramesPerSecond(), frameClock.GetRawDeltaTime() * 1000.0f);
+				ImGui::SliderFloat("timeScale", &timeScale, 0.0f, 2.0f);
+				if (ImGui::SliderInt("particleTickRate", &particleTickRate, 10, 240))
+				{
+					particleTimestep.SetTickRate(float(particleTickRate));
+				}
+				if (ImGui::SliderInt("emitterTickRate", &emitterTickRate, 5, 120))
+				{
+					emitterTimestep.SetTickRate(float(emitterTickRate));
+				}
+				ImGui::Text("dropped steps particle:%llu emitter:%llu", particleTimestep.GetDroppedSteps(), emitterTimestep.GetDroppedSteps());
+				ImGui::TreePop();
+			}
+			if (ImGui::TreeNode("Culling"))
+			{
+				//前フレームの結果
+				const CullingStats& cullingStats = frustumCuller.GetStats();
+				ImGui::Text("tested:%u visible:%u", cullingStats.tested, cullingStats.visible);
+				ImGui::Checkbox("occlusion", &enableOcclusionCulling);
+				const OcclusionStats& occlusionStats = occlusionCuller.GetStats();
+				ImGui::Text("occluder triangles:%u tested:%u occluded:%u", occlusionStats.occluderTriangles, occlusionStats.tested, occlusionStats.occluded);
+				const RenderQueueStats& renderQueueStats = renderQueue.GetStats();
+				ImGui::Text("draws:%u state changes:%u skipped:%u", renderQueueStats.packets, renderQueueStats.stateChanges, renderQueueStats.redundantStateChanges);
+				ImGui::Text("instanced draws:%u (from %u)", renderQueueStats.instancedDraws, renderQueueStats.instancedPackets);
+				ImGui::Text("command lists:%u", renderQueueStats.chunks);
+				ImGui::TreePop();
+			}
+			if (ImGui::TreeNode("Props"))
+			{
+				ImGui::SliderInt("count", &propCount, 0, kMaxProps);
+				ImGui::DragFloat("spacing", &propSpacing, 0.01f, 0.5f, 5.0f);
+				ImGui::TreePop();
+			}
+			frameClock.SetTimeScale(timeScale);
 			ImGui::End();
 
 			Matrix4x4 cameraMatrix = MakeAffineMatrix(cameraTransform.scale, cameraTransform.rotate, cameraTransform.translate);
 			Matrix4x4 viewMatrix = Inverse(cameraMatrix);
-			Matrix4x4 projectionMatrix = MakePerspectiveFovMatrix(0.45f, float(kClientWidth) / float(kClientHeight), 0.1f, 100.0f);
+			Matrix4x4 projectionMatrix = MakePerspectiveFovMatrix(0.45f, float(kClientWidth) / float(kClientHeight), kNearClip, kFarClip);
 			Matrix4x4 viewProjectionMatrix = viewMatrix * projectionMatrix;
 
-			cameraForGPU->worldPosition = cameraTransform.translate;
+			cameraForGPU.worldPosition = cameraTransform.translate;
 
 			//pointLightData->position = Transform(pointLightPosition, viewProjectionMatrix);
 
 
-			emitter.frequencyTime += kDeltaTime;
-			if (emitter.frequency <= emitter.frequencyTime)
+			emitterSystem.SetTranslate(emitterHandle, emitter.transform.translate);
+			uint32_t emitterSteps = emitterTimestep.Advance(frameClock.GetDeltaTime());
+			for (uint32_t step = 0; step < emitterSteps; step++)
 			{
-				particles.splice(particles.end(), Emit(emitter, randomEngine));
-				emitter.frequencyTime -= emitter.frequency;
+				emitterSystem.Update(emitterTimestep.GetStepTime(), CalculateFrustum(viewProjectionMatrix), cameraTransform.translate, particleSystem.GetCount(), emitRequests);
+				for (const EmitRequest& request : emitRequests)
+				{
+					Emitter requestEmitter = emitter;
+					requestEmitter.transform.translate = emitterSystem.GetTranslate(request.emitter);
+					requestEmitter.count = request.count;
+					particleSystem.Emit(requestEmitter, randomEngine());
+				}
 			}
 
+			particleSystem.SetForceFields(enableForceFields ? forceFields : std::vector<ForceField>());
+			particleSystem.SetRepulsion(repulsionRadius, repulsionStrength);
+			uint32_t particleSteps = particleTimestep.Advance(frameClock.GetDeltaTime());
+			for (uint32_t step = 0; step < particleSteps; step++)
+			{
+				particleSystem.Update(particleTimestep.GetStepTime(), enableAccelerationField ? &accelerationField : nullptr);
+			}
+			ParticleDrawDesc particleDrawDesc{};
+			particleDrawDesc.viewMatrix = viewMatrix;
+			particleDrawDesc.viewProjection = viewProjectionMatrix;
+			particleDrawDesc.billboard = CalculateBillboardMatrix(cameraMatrix, useBillboard);
+			particleDrawDesc.sortBackToFront = RequiresDepthSort(static_cast<BlendMode>(currentBlendMode));
+			particleDrawDesc.interpolationTime = (1.0f - particleTimestep.GetAlpha()) * particleTimestep.GetStepTime();
+			//構造化バッファのSRVは要素単位でしか始点をずらせないので，1要素分多く切り出して要素の境目から書く
+			const uint32_t maxParticleInstances = (std::min)(particleSystem.GetCount(), kNumMaxInstance);
 			uint32_t numInstance = 0;
-			for (auto particleIterator = particles.begin(); particleIterator != particles.end();)
+			uint64_t particleFirstElement = 0;
+			if (0 < maxParticleInstances)
 			{
-				if ((*particleIterator).lifeTime <= (*particleIterator).currentTime) {
-					particleIterator = particles.erase(particleIterator);
-					continue;
-				}
-				if (numInstance < kNumMaxInstance)
-				{
-					float  alpha = 1.0f - ((*particleIterator).currentTime / (*particleIterator).lifeTime);
-
-					if (enableAccelerationField && IsCollision(accelerationField.area, (*particleIterator).transform.translate))
-					{
-						(*particleIterator).velocity += accelerationField.acceleration * kDeltaTime;
-					}
-
-					(*particleIterator).transform.translate += (*particleIterator).velocity * kDeltaTime;
-					(*particleIterator).currentTime += kDeltaTime;
-					instancingData[numInstance].WVP = CalculateParticleWVPMat((*particleIterator).transform, cameraMatrix, viewProjectionMatrix, useBillboard).WVP;
-					instancingData[numInstance].World = CalculateParticleWVPMat((*particleIterator).transform, cameraMatrix, viewProjectionMatrix, useBillboard).World;
-					(*particleIterator).color.w = alpha;
-					instancingData[numInstance].color = (*particleIterator).color;
-					numInstance++;
-				}
-
-				particleIterator++;
+				LinearAllocation particleAllocation = frameAllocator.Allocate(sizeof(ParticleForGPU) * (maxParticleInstances + 1));
+				assert(particleAllocation.cpuAddress != nullptr);
+				const uint64_t particleOffset = particleAllocation.gpuAddress - frameUploadResource->GetGPUVirtualAddress();
+				particleFirstElement = (particleOffset + sizeof(ParticleForGPU) - 1) / sizeof(ParticleForGPU);
+				ParticleForGPU* particleInstances = reinterpret_cast<ParticleForGPU*>(static_cast<unsigned char*>(frameUploadData) + particleFirstElement * sizeof(ParticleForGPU));
+				numInstance = particleSystem.WriteInstances(particleDrawDesc, particleInstances, maxParticleInstances);
 			}
 
 			//*WvpMatrixDataPlane = CalculateObjectWVPMat(transformObj, viewProjectionMatrix);
 
-			*sphere->transformMat = CalculateObjectWVPMat(transform, viewProjectionMatrix);
+			//RenderQueueにも渡すので，アップロードヒープから読み戻さないように手元に残す
+			TransformationMatrix sphereMatrix = CalculateObjectWVPMat(transform, viewProjectionMatrix);
+			sphere->transformMat = sphereMatrix;
+
+			sprite->transformMat = CalculateSpriteWVPMat(spriteTrans);
+			TransformationMatrix terrainMatrix = CalculateObjectWVPMat(terrainTrans, viewProjectionMatrix);
+			terrianModel->transformMat = terrainMatrix;
+
+			//CullingTargetの順に積む
+			const Matrix4x4& terrainWorld = terrainMatrix.World;
+			MeshBounds sphereBounds = TransformMeshBounds(sphere->bounds, sphereMatrix.World);
+			MeshBounds terrainBounds = TransformMeshBounds(terrianModel->bounds, terrainWorld);
+			cullingBounds.Clear();
+			cullingBounds.Push(sphereBounds);
+			cullingBounds.Push(terrainBounds);
+			//小物はCullingTargetの後ろに積む 地面の上に正方形に並べる
+			const int propColumns = int(std::ceil(std::sqrt(float(propCount))));
+			propMatrices.resize(propCount);
+			for (int index = 0; index < propCount; index++)
+			{
+				stTransform propTransform{ {0.25f,0.25f,0.25f},{0.0f,0.0f,0.0f},
+					{(float(index % propColumns) - float(propColumns - 1) * 0.5f) * propSpacing, 0.25f, (float(index / propColumns) - float(propColumns - 1) * 0.5f) * propSpacing} };
+				propMatrices[index] = CalculateObjectWVPMat(propTransform, viewProjectionMatrix);
+				cullingBounds.Push(TransformMeshBounds(sphere->bounds, propMatrices[index].World));
+			}
+			frustumCuller.Cull(CalculateFrustum(viewProjectionMatrix), cullingBounds, visibleMeshes);
+			std::fill(std::begin(isVisible), std::end(isVisible), false);
+			for (uint32_t index : visibleMeshes)
+			{
+				if (index < kCullingTargetCount)
+				{
+					isVisible[index] = true;
+				}
+			}
 
-			*sprite->transformMat = CalculateSpriteWVPMat(spriteTrans);
-			*terrianModel->transformMat = CalculateObjectWVPMat(terrainTrans, viewProjectionMatrix);
+			//地形そのものは判定せず，視錐台に残った球だけを判定する
+			if (enableOcclusionCulling && isVisible[kCullingSphere])
+			{
+				occlusionCuller.BeginFrame(viewProjectionMatrix);
+				occlusionCuller.AddOccluder(terrainPositions.data(), static_cast<uint32_t>(terrainPositions.size() / 3), terrainWorld);
+				occlusionCuller.RenderOccluders();
+				bool isUnoccluded = true;
+				occlusionCuller.IsVisible(&sphereBounds.aabb, 1, &isUnoccluded);
+				isVisible[kCullingSphere] = isUnoccluded;
+			}
 
 			///
 			/// 更新処理ここまで
@@ -1336,26 +2015,69 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 
 
 
-			commandList->SetGraphicsRootSignature(rootSignature.Get());
-			commandList->SetPipelineState(graphicsPipelineState.Get());                 // PSOを設定
-
-			commandList->SetGraphicsRootConstantBufferView(4, directionalLightResource->GetGPUVirtualAddress());
-			commandList->SetGraphicsRootConstantBufferView(5, cameraResource->GetGPUVirtualAddress());
-
-			//DrawSprite(commandList, sprite, directionalLightResource, sprite->textureHandle);
-			DrawSphere(commandList, sphere, sphere->textureHandle);
+			directionalLightAddress = PushConstantBuffer(frameAllocator, directionalLight);
+			cameraAddress = PushConstantBuffer(frameAllocator, cameraForGPU);
 
+			//DrawSprite(commandList, frameAllocator, sprite, directionalLightAddress, sprite->textureHandle);
 
+			//マテリアルはオブジェクトごとに1回だけ書き込み，球と小物で同じアドレスを使う (まとめられるように)
+			D3D12_GPU_VIRTUAL_ADDRESS sphereMaterial = PushConstantBuffer(frameAllocator, sphere->materialData);
+			D3D12_GPU_VIRTUAL_ADDRESS sphereUseTexture = PushConstantBuffer(frameAllocator, sphere->useTexture);
 
-			//commandList->SetGraphicsRootSignature(rootSignatureForInstancing.Get());
-			//commandList->SetPipelineState(graphicsPipelineStateForInstancing.Get());                 // PSOを設定
+			//見えているものだけ積み，同じものをまとめ，状態がそろうように並べてから描く
+			renderQueue.Clear();
+			if (isVisible[kCullingSphere])
+			{
+				renderQueue.Submit(makeMeshPacket(sphereVertexBuffer, sphere->vertexNum, sphere->textureHandle,
+					sphereMaterial, sphereUseTexture, Transform(sphereBounds.sphere.center, viewMatrix).z),
+					1, &sphereMatrix, sizeof(TransformationMatrix));
+			}
+			if (isVisible[kCullingTerrain])
+			{
+				renderQueue.Submit(makeMeshPacket(terrainVertexBuffer, UINT(terrianModel->vertices.size()), terrianModel->textureHandle,
+					PushConstantBuffer(frameAllocator, terrianModel->materialData), PushConstantBuffer(frameAllocator, terrianModel->useTexture), Transform(terrainBounds.sphere.center, viewMatrix).z),
+					1, &terrainMatrix, sizeof(TransformationMatrix));
+			}
+			for (uint32_t index : visibleMeshes)
+			{
+				if (kCullingTargetCount <= index)
+				{
+					const TransformationMatrix& propMatrix = propMatrices[index - kCullingTargetCount];
+					Vector3 propPosition = { propMatrix.World.m[3][0], propMatrix.World.m[3][1], propMatrix.World.m[3][2] };
+					renderQueue.Submit(makeMeshPacket(sphereVertexBuffer, sphere->vertexNum, sphere->textureHandle,
+						sphereMaterial, sphereUseTexture, Transform(propPosition, viewMatrix).z),
+						1, &propMatrix, sizeof(TransformationMatrix));
+				}
+			}
+			renderQueue.BuildInstanceBatches([&](size_t _size) { return frameAllocator.Allocate(_size); });
+			renderQueue.Sort();
 
-			commandList->IASetVertexBuffers(0, 1, &terrianModel->vertexBufferView);
-			commandList->SetGraphicsRootConstantBufferView(0, terrianModel->materialResource->GetGPUVirtualAddress());
-			commandList->SetGraphicsRootConstantBufferView(1, terrianModel->wvpResource->GetGPUVirtualAddress());
-			commandList->SetGraphicsRootDescriptorTable(2, GetTextureHandle(terrianModel->textureHandle));
-			commandList->SetGraphicsRootConstantBufferView(3, terrianModel->useTextureResource->GetGPUVirtualAddress());
-			commandList->DrawInstanced(UINT(terrianModel->vertices.size()), 1, 0, 0);
+			//ここまでのクリアなどを積んだコマンドリストは先に閉じ，描画パケットは範囲に分けて別のコマンドリストへ並列に積む
+			hr = commandList->Close();
+			assert(SUCCEEDED(hr));
+			FrameContext& currentFrame = frameContexts[frameIndex];
+			//コマンドリストは状態を引き継がないので，描画先などはコマンドリストごとに設定し直す
+			auto beginCommandList = [&](ID3D12GraphicsCommandList* _commandList, ID3D12CommandAllocator* _allocator)
+				{
+					hr = _commandList->Reset(_allocator, nullptr);
+					assert(SUCCEEDED(hr));
+					_commandList->SetDescriptorHeaps(1, descriptorHeaps->GetAddressOf());
+					_commandList->OMSetRenderTargets(1, &rtVHandles[backBufferIndex], false, &dsvHandle);
+					_commandList->RSSetViewports(1, &viewport);
+					_commandList->RSSetScissorRects(1, &scissorRect);
+					_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+				};
+			const uint32_t chunkCount = renderQueue.CalculateChunkCount((std::min)(kMaxRecordingChunks, threadPool.GetThreadCount()), kMinDrawsPerChunk);
+			for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				beginCommandList(chunkCommandLists[chunk].Get(), currentFrame.chunkAllocators[chunk].Get());
+			}
+			renderQueue.ExecuteParallel(chunkBackends, chunkCount);
+			for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				hr = chunkCommandLists[chunk]->Close();
+				assert(SUCCEEDED(hr));
+			}
 
 			///
 			/// 描画ここまで
@@ -1363,23 +2085,53 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 
 			ImGui::Render();
 
-			ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), commandList.Get());
+			beginCommandList(overlayCommandList.Get(), currentFrame.overlayAllocator.Get());
+			//パーティクルは半透明なので描画パケットの後に描く
+			//SRVはこのフレームで書き込んだ範囲に作り直すので，GPUが前のフレームで読んでいるディスクリプタは書き換えない
+			if (0 < numInstance)
+			{
+				const uint32_t particleSrvIndex = srvAllocator.AllocateTransient();
+				assert(particleSrvIndex != kInvalidDescriptorIndex);
+				instancingSrvDesc.Buffer.FirstElement = particleFirstElement;
+				instancingSrvDesc.Buffer.NumElements = numInstance;
+				device->CreateShaderResourceView(frameUploadResource.Get(), &instancingSrvDesc, GetCPUDescriptorHandle(srvDescriptorHeap, desriptorSizeSRV, particleSrvIndex));
+
+				overlayCommandList->SetGraphicsRootSignature(rootSignatureForInstancing.Get());
+				overlayCommandList->SetPipelineState(graphicsPipelineStateForInstancing);
+				overlayCommandList->IASetVertexBuffers(0, 1, &modelData->vertexBufferView);
+				overlayCommandList->SetGraphicsRootConstantBufferView(0, PushConstantBuffer(frameAllocator, modelData->materialData));
+				overlayCommandList->SetGraphicsRootDescriptorTable(1, GetGPUDescriptorHandle(srvDescriptorHeap, desriptorSizeSRV, particleSrvIndex));
+				overlayCommandList->SetGraphicsRootDescriptorTable(2, GetTextureHandle(modelData->textureHandle));
+				overlayCommandList->SetGraphicsRootConstantBufferView(3, PushConstantBuffer(frameAllocator, modelData->useTexture));
+				overlayCommandList->DrawInstanced(UINT(modelData->vertices.size()), numInstance, 0, 0);
+			}
+			ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), overlayCommandList.Get());
 
 			//画面に書く処理はすべて終わり，画面に移すので状態を遷移
 			//今回はRenderTargetからPresentにする
 			barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
 			barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
 			//TransitionBarrierを張る
-			commandList->ResourceBarrier(1, &barrier);
+			overlayCommandList->ResourceBarrier(1, &barrier);
 
 			//コマンドリストの内容を確立させる。すべてのコマンドを積んでからcloseすること
-			hr = commandList->Close();
+			hr = overlayCommandList->Close();
 			assert(SUCCEEDED(hr));
 
 			/// コマンドをキックする
-			//GPUにコマンドリストの実行を行わせる
-			Microsoft::WRL::ComPtr<ID3D12CommandList> commandLists[] = { commandList.Get() };
-			commandQueue->ExecuteCommandLists(1, commandLists->GetAddressOf());
+			//GPUにコマンドリストの実行を行わせる 積んだ順 (クリア，描画パケットの範囲順，ImGui) に1回で渡す
+			ID3D12CommandList* commandLists[kMaxRecordingChunks + 2] = {};
+			uint32_t commandListCount = 0;
+			commandLists[commandListCount++] = commandList.Get();
+			for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				commandLists[commandListCount++] = chunkCommandLists[chunk].Get();
+			}
+			commandLists[commandListCount++] = overlayCommandList.Get();
+			//このフレームで積んだ転送を送り，描画はそれが終わってから始める (CPUは待たない)
+			uploadManager.Flush();
+			uploadManager.WaitOnQueue(commandQueue.Get());
+			commandQueue->ExecuteCommandLists(commandListCount, commandLists);
 			//GPUとOSに画面の交換を行うように通知する
 			swapChain->Present(1, 0);			//	画面が切り替わる
 
@@ -1388,27 +2140,54 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
 			fenceValue++;
 			//GPUがここまでたどり着いたときに，Fenceの値を指定した値に代入するようにSignalを送る
 			commandQueue->Signal(fence.Get(), fenceValue);
-
-			//Fenceの値が指定したSignal値にたどり着いているか確認する
+			frameContexts[frameIndex].fenceValue = fenceValue;
+			frameAllocator.EndFrame(fenceValue);
+			srvAllocator.EndFrame(fenceValue);
+
+			//次のフレームのコンテキストへ進む GPUはこのフレームを実行したまま，CPUは次のフレームを準備する
+			frameIndex = (frameIndex + 1) % kMaxFramesInFlight;
+			FrameContext& nextFrame = frameContexts[frameIndex];
+			//Fenceの値がこのコンテキストを前に使ったフレームのSignal値にたどり着いているか確認する
 			//GetCompleteValueの初期値はFence作成時に渡した初期値
-			if (fence->GetCompletedValue() < fenceValue)
+			if (fence->GetCompletedValue() < nextFrame.fenceValue)
 			{
 				//指定したSignalにたどり着いていないので，たどり着くまで待つようにイベントを設定する
-				fence->SetEventOnCompletion(fenceValue, fenceEvent);
+				fence->SetEventOnCompletion(nextFrame.fenceValue, fenceEvent);
 				//イベント待つ
 				WaitForSingleObject(fenceEvent, INFINITE);
 			}
 
 			//次のフレーム用のコマンドリストを準備
-			hr = commandAllocator->Reset();
+			hr = nextFrame.commandAllocator->Reset();
 			assert(SUCCEEDED(hr));
-			hr = commandList->Reset(commandAllocator.Get(), nullptr);
+			for (Microsoft::WRL::ComPtr<ID3D12CommandAllocator>& chunkAllocator : nextFrame.chunkAllocators)
+			{
+				hr = chunkAllocator->Reset();
+				assert(SUCCEEDED(hr));
+			}
+			hr = nextFrame.overlayAllocator->Reset();
+			assert(SUCCEEDED(hr));
+			hr = commandList->Reset(nextFrame.commandAllocator.Get(), nullptr);
 			assert(SUCCEEDED(hr));
 
 
 		}
 	}
 
+	//GPUが処理中のフレームを終えてから解放する
+	fenceValue++;
+	commandQueue->Signal(fence.Get(), fenceValue);
+	if (fence->GetCompletedValue() < fenceValue)
+	{
+		fence->SetEventOnCompletion(fenceValue, fenceEvent);
+		WaitForSingleObject(fenceEvent, INFINITE);
+	}
+	CloseHandle(fenceEvent);
+	uploadManager.WaitIdle();
+
+	//次に起動したときにPSOをキャッシュから作れるように保存する
+	pipelineCache.Save(kPipelineCachePath);
+
 	ImGui_ImplDX12_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
@@ -1488,7 +2267,7 @@ std::string ConvertString(const std::wstring& str) {
 	return result;
 }
 
-Microsoft::WRL::ComPtr<IDxcBlob> ComplieShader(const std::wstring& _filePath, const wchar_t* _profile, Microsoft::WRL::ComPtr<IDxcUtils>& _dxcUtils, Microsoft::WRL::ComPtr<IDxcCompiler3>& _dxcCompiler, Microsoft::WRL::ComPtr<IDxcIncludeHandler>& _includeHandler)
+Microsoft::WRL::ComPtr<IDxcBlob> ComplieShader(const std::wstring& _filePath, const wchar_t* _profile, const std::vector<std::wstring>& _options, Microsoft::WRL::ComPtr<IDxcUtils>& _dxcUtils, Microsoft::WRL::ComPtr<IDxcCompiler3>& _dxcCompiler, Microsoft::WRL::ComPtr<IDxcIncludeHandler>& _includeHandler)
 {
 	//hlslファイルを読み込む
 	//これからシェーダーをコンパイルする旨をログに出す
@@ -1496,8 +2275,12 @@ Microsoft::WRL::ComPtr<IDxcBlob> ComplieShader(const std::wstring& _filePath, co
 	//hlslファイルを読む
 	Microsoft::WRL::ComPtr<IDxcBlobEncoding> shaderSource = nullptr;
 	HRESULT hr = _dxcUtils->LoadFile(_filePath.c_str(), nullptr, &shaderSource);
-	//読めなかったら止める
-	assert(SUCCEEDED(hr));
+	//読めなかったら失敗にする (エディタが保存している途中などもある)
+	if (FAILED(hr))
+	{
+		Log(ConvertString(std::format(L"Failed to load shader, path:{}\n", _filePath)));
+		return nullptr;
+	}
 	//読み込んだ内容を設定する
 	DxcBuffer shaderSourceBuffer;
 	shaderSourceBuffer.Ptr = shaderSource->GetBufferPointer();
@@ -1505,20 +2288,20 @@ Microsoft::WRL::ComPtr<IDxcBlob> ComplieShader(const std::wstring& _filePath, co
 	shaderSourceBuffer.Encoding = DXC_CP_UTF8;
 
 	//Cmpileする
-	LPCWSTR arguments[] = {
+	std::vector<LPCWSTR> arguments = {
 		_filePath.c_str(),      //コンパイル対象のhlslファイル名
-		L"-E",L"main",          //エントリーポイントの指定。基本的にmain以外にはしない
 		L"-T",_profile,         // shaderprofilerの設定
-		L"-Zi",L"^Qembed_debug" // デバッグ用の情報を埋め込む
-		L"-Od",                 // 最適化外しておく
-		L"-Zpr",                // メモリレイアウトは行優先
 	};
+	for (const std::wstring& option : _options)
+	{
+		arguments.push_back(option.c_str());
+	}
 	//実際にshaderをコンパイルする
 	Microsoft::WRL::ComPtr<IDxcResult> shaderResult = nullptr;
 	hr = _dxcCompiler->Compile(
 		&shaderSourceBuffer,            // 読み込んだファイル
-		arguments,			            // コンパイルオプション
-		_countof(arguments),            // コンパイルオプションの数
+		arguments.data(),	            // コンパイルオプション
+		UINT(arguments.size()),         // コンパイルオプションの数
 		_includeHandler.Get(),	        // includeが含まれた諸々
 		IID_PPV_ARGS(&shaderResult)     // コンパイル結果
 	);
@@ -1530,7 +2313,13 @@ Microsoft::WRL::ComPtr<IDxcBlob> ComplieShader(const std::wstring& _filePath, co
 	if (shaderError != nullptr && shaderError->GetStringLength() != 0)
 	{
 		Log(shaderError->GetStringPointer());
-		assert(false);
+	}
+	//コンパイルエラーは呼び出し元で扱う (起動時なら止め，再読み込みなら前のシェーダーのまま続ける)
+	HRESULT status = S_OK;
+	shaderResult->GetStatus(&status);
+	if (FAILED(status))
+	{
+		return nullptr;
 	}
 
 	//コンパイル結果から実行用のバイナリ部分を取得
@@ -1548,6 +2337,75 @@ Microsoft::WRL::ComPtr<IDxcBlob> ComplieShader(const std::wstring& _filePath, co
 	return shaderBlob;
 }
 
+bool CompileShaderWithDxc(const ShaderCompileRequest& _request, std::vector<unsigned char>& _bytecode)
+{
+	Microsoft::WRL::ComPtr<IDxcUtils> dxcUtils = nullptr;
+	Microsoft::WRL::ComPtr<IDxcCompiler3> dxcCompiler = nullptr;
+	HRESULT hr = DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&dxcUtils));
+	assert(SUCCEEDED(hr));
+	hr = DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&dxcCompiler));
+	assert(SUCCEEDED(hr));
+	//Object3d.hlsliなどのincludeに対応するための設定を行っておく
+	Microsoft::WRL::ComPtr<IDxcIncludeHandler> includeHandler = nullptr;
+	hr = dxcUtils->CreateDefaultIncludeHandler(&includeHandler);
+	assert(SUCCEEDED(hr));
+
+	Microsoft::WRL::ComPtr<IDxcBlob> shaderBlob = ComplieShader(_request.path, _request.profile.c_str(), _request.arguments, dxcUtils, dxcCompiler, includeHandler);
+	if (shaderBlob == nullptr)
+	{
+		return false;
+	}
+	const unsigned char* bytes = static_cast<const unsigned char*>(shaderBlob->GetBufferPointer());
+	_bytecode.assign(bytes, bytes + shaderBlob->GetBufferSize());
+	return true;
+}
+
+std::wstring GetShaderCompilerTag()
+{
+	//DXCの版が変わったらコンパイルし直す
+	std::wstring compilerTag = L"dxc";
+	Microsoft::WRL::ComPtr<IDxcVersionInfo> versionInfo = nullptr;
+	if (SUCCEEDED(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&versionInfo))))
+	{
+		UINT32 major = 0;
+		UINT32 minor = 0;
+		versionInfo->GetVersion(&major, &minor);
+		compilerTag += std::format(L" {}.{}", major, minor);
+	}
+	return compilerTag;
+}
+
+std::vector<ShaderCompileRequest> MakeShaderCompileRequests()
+{
+	//すべてのシェーダーに共通のオプション オプションはキャッシュのキーに入るので，構成ごとに別のバイトコードになる
+	const std::vector<std::wstring> options = {
+		L"-E",L"main",              //エントリーポイントの指定。基本的にmain以外にはしない
+#ifdef _DEBUG
+		L"-Zi",L"-Qembed_debug",    // デバッグ用の情報を埋め込む
+		L"-Od",                     // 最適化外しておく
+#else
+		L"-O3",                     // Releaseでは最適化する
+#endif // _DEBUG
+		L"-Zpr",                    // メモリレイアウトは行優先
+	};
+	std::vector<ShaderCompileRequest> requests(kShaderCount);
+	requests[kShaderObject3dVS] = { L"Object3d.VS.hlsl", L"vs_6_0", options };
+	requests[kShaderObject3dPS] = { L"Object3d.PS.hlsl", L"ps_6_0", options };
+	requests[kShaderObject3dInstancedVS] = { L"Object3dInstanced.VS.hlsl", L"vs_6_0", options };
+	requests[kShaderParticleVS] = { L"Particle.VS.hlsl", L"vs_6_0", options };
+	requests[kShaderParticlePS] = { L"Particle.PS.hlsl", L"ps_6_0", options };
+	return requests;
+}
+
+bool CompileShaders(ShaderCache& _shaderCache, const std::vector<ShaderCompileRequest>& _requests, std::vector<std::vector<unsigned char>>& _bytecodes, ThreadPool& _threadPool)
+{
+	_bytecodes.assign(_requests.size(), {});
+	bool isSucceeded = _shaderCache.CompileAll(_requests.data(), static_cast<uint32_t>(_requests.size()), _bytecodes.data(), &_threadPool);
+	const ShaderCacheStats stats = _shaderCache.GetStats();
+	Log(std::format("Shader cache hits:{} compiles:{} failures:{}\n", stats.hits, stats.compiles, stats.failures));
+	return isSucceeded;
+}
+
 Microsoft::WRL::ComPtr<ID3D12Resource> CreateBufferResource(const Microsoft::WRL::ComPtr<ID3D12Device>& _device, size_t _sizeInBytes)
 {
 	// 頂点リソース用のヒープの設定
@@ -1678,24 +2536,13 @@ Microsoft::WRL::ComPtr<ID3D12Resource> CreateTextureResource(const Microsoft::WR
 	return resource;
 }
 
-[[nodiscard]]
-Microsoft::WRL::ComPtr<ID3D12Resource> UploadTextureData(const Microsoft::WRL::ComPtr<ID3D12Resource>& texture, const DirectX::ScratchImage& mipImages, const Microsoft::WRL::ComPtr<ID3D12Device>& device, const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& commandList)
+void UploadTextureData(const Microsoft::WRL::ComPtr<ID3D12Resource>& texture, const DirectX::ScratchImage& mipImages, const Microsoft::WRL::ComPtr<ID3D12Device>& device, UploadManager& uploadManager)
 {
 	std::vector<D3D12_SUBRESOURCE_DATA> subresources;
 	DirectX::PrepareUpload(device.Get(), mipImages.GetImages(), mipImages.GetImageCount(), mipImages.GetMetadata(), subresources);
-	uint64_t intermediateSize = GetRequiredIntermediateSize(texture.Get(), 0, UINT(subresources.size()));
-	Microsoft::WRL::ComPtr<ID3D12Resource> intermediateResource = CreateBufferResource(device.Get(), intermediateSize);
-	UpdateSubresources(commandList.Get(), texture.Get(), intermediateResource.Get(), 0, 0, UINT(subresources.size()), subresources.data());
-	//Tetureへの転送後は利用できるよう、D3D12_RESOURCE_STATE_COPY_DESTからD3D12_RESOURCE_STATE_GENERIC_READへResourceStateを変更する
-	D3D12_RESOURCE_BARRIER barrier{};
-	barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-	barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-	barrier.Transition.pResource = texture.Get();
-	barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-	barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-	barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_GENERIC_READ;
-	commandList->ResourceBarrier(1, &barrier);
-	return intermediateResource;
+	//全ミップをステージングへ写して今のバッチに積む
+	//コピーキューではシェーダーで読む状態へ遷移できないが，転送後はCOMMONに戻り，描画で読むときに暗黙に昇格するのでバリアはいらない
+	uploadManager.UploadTexture(texture.Get(), subresources.data(), UINT(subresources.size()));
 }
 
 D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandle(const Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& _descriptorHeap, uint32_t _descriptorSize, uint32_t _index)
@@ -1718,7 +2565,7 @@ void DeleteTextures()
 	textures.clear();
 }
 
-ModelData LoadObjFile(const std::string& _directoryPath, const std::string& _filename, const Microsoft::WRL::ComPtr<ID3D12Device>& _device, const  Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, const  Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& _srvDescriptorHeap, uint32_t _srvSize)
+ModelData LoadObjFile(const std::string& _directoryPath, const std::string& _filename, const Microsoft::WRL::ComPtr<ID3D12Device>& _device, UploadManager& _uploadManager, const  Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& _srvDescriptorHeap, uint32_t _srvSize)
 {
 	ModelData modelData;				//構築するmodelData
 	std::vector<Vector4> positions;		//位置
@@ -1797,7 +2644,7 @@ ModelData LoadObjFile(const std::string& _directoryPath, const std::string& _fil
 					mtls >> texturePath;
 
 					modelData.textureHandlePath = _directoryPath + '/' + texturePath;
-					modelData.textureHandle = LoadTexture(modelData.textureHandlePath, _device, _commandList, _srvDescriptorHeap, _srvSize);
+					modelData.textureHandle = LoadTexture(modelData.textureHandlePath, _device, _uploadManager, _srvDescriptorHeap, _srvSize);
 				}
 			}
 		}
@@ -1888,7 +2735,7 @@ D3D12_GPU_DESCRIPTOR_HANDLE GetTextureHandle(uint32_t _textureHandle)
 	return textures[_textureHandle].srvHandlerGPU;
 }
 
-uint32_t LoadTexture(const std::string& _filePath, const  Microsoft::WRL::ComPtr<ID3D12Device>& _device, const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, const Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& _srvDescriptorHeap, uint32_t _srvSize)
+uint32_t LoadTexture(const std::string& _filePath, const  Microsoft::WRL::ComPtr<ID3D12Device>& _device, UploadManager& _uploadManager, const Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& _srvDescriptorHeap, uint32_t _srvSize)
 {
 
 	auto it = std::find_if(textures.begin(), textures.end(), [&](const auto& texture) {
@@ -1903,12 +2750,13 @@ uint32_t LoadTexture(const std::string& _filePath, const  Microsoft::WRL::ComPtr
 	textures.push_back(Texture());
 
 	size_t index = textures.size() - 1;
+	assert(index < kMaxTextures);
 	textures[index].name = _filePath;
 
 	DirectX::ScratchImage mipImages = LoadTexture(_filePath);
 	const DirectX::TexMetadata& metadata = mipImages.GetMetadata();
 	textures[index].resource = CreateTextureResource(_device, metadata);
-	textures[index].intermediateResource = UploadTextureData(textures[index].resource, mipImages, _device, _commandList);
+	UploadTextureData(textures[index].resource, mipImages, _device, _uploadManager);
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
 	srvDesc.Format = metadata.format;
@@ -1916,8 +2764,9 @@ uint32_t LoadTexture(const std::string& _filePath, const  Microsoft::WRL::ComPtr
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;//2Dテクスチャ
 	srvDesc.Texture2D.MipLevels = UINT(metadata.mipLevels);
 
-	textures[index].srvHandlerCPU = GetCPUDescriptorHandle(_srvDescriptorHeap, _srvSize, (uint32_t)index + 3);
-	textures[index].srvHandlerGPU = GetGPUDescriptorHandle(_srvDescriptorHeap, _srvSize, (uint32_t)index + 3);
+	//テクスチャテーブルのハンドルと同じ番号に置く
+	textures[index].srvHandlerCPU = GetCPUDescriptorHandle(_srvDescriptorHeap, _srvSize, textureTableIndex + (uint32_t)index);
+	textures[index].srvHandlerGPU = GetGPUDescriptorHandle(_srvDescriptorHeap, _srvSize, textureTableIndex + (uint32_t)index);
 	_device->CreateShaderResourceView(textures[index].resource.Get(), &srvDesc, textures[index].srvHandlerCPU);
 
 	return (uint32_t)index;
@@ -1941,27 +2790,17 @@ void MakeTriangleData(const Microsoft::WRL::ComPtr<ID3D12Device>& _device, Objec
 
 
 	///色の変更
-	_obj->materialResource = CreateBufferResource(_device, sizeof(Vector4) * 3);
-	_obj->materialData = nullptr;
-	_obj->materialResource->Map(0, nullptr, reinterpret_cast<void**>(&_obj->materialData));
-	_obj->materialData->color = Vector4{ 1.0f, 1.0f, 1.0f, 1.0f };
-	_obj->materialData->enabledLighthig = true;
-	_obj->materialData->uvTransform = MakeIdentity4x4();
-	_obj->materialData->shininess = 40.0f;
-
-	//wvp用のリソースを作る。Matrix4x4 1つ分のサイズをサイズを用意する
-	_obj->wvpResource = CreateBufferResource(_device, sizeof(TransformationMatrix));
-	//データを書き込む
-	_obj->transformMat = nullptr;
-	//書き込むためのアドレスを取得
-	_obj->wvpResource->Map(0, nullptr, reinterpret_cast<void**>(&_obj->transformMat));
+	_obj->materialData.color = Vector4{ 1.0f, 1.0f, 1.0f, 1.0f };
+	_obj->materialData.enabledLighthig = true;
+	_obj->materialData.uvTransform = MakeIdentity4x4();
+	_obj->materialData.shininess = 40.0f;
+
 	//単位行列を書き込んでおく
-	_obj->transformMat->World = MakeIdentity4x4();
+	_obj->transformMat.WVP = MakeIdentity4x4();
+	_obj->transformMat.World = MakeIdentity4x4();
+	_obj->transformMat.worldInverseTranspose = MakeIdentity4x4();
 
-	_obj->useTextureResource = CreateBufferResource(_device, sizeof(float));
-	_obj->useTexture = nullptr;
-	_obj->useTextureResource->Map(0, nullptr, reinterpret_cast<void**>(&_obj->useTexture));
-	*_obj->useTexture = 1.0f;
+	_obj->useTexture = 1.0f;
 
 	/// Resourceにデータを書き込む
 	// 頂点バッファーフォーマットが定義されて
@@ -1989,6 +2828,7 @@ void MakeTriangleData(const Microsoft::WRL::ComPtr<ID3D12Device>& _device, Objec
 
 	_obj->vertexNum = 3;
 	_obj->textureHandle = -1;
+	_obj->bounds = CalculateMeshBounds(&_obj->vertexData[0].position, _obj->vertexNum, sizeof(VertexData));
 
 }
 
@@ -2009,28 +2849,18 @@ void MakeSphereData(const Microsoft::WRL::ComPtr<ID3D12Device>& _device, Object*
 	// 1頂点あたりのサイズ
 	_obj->vertexBufferView.StrideInBytes = sizeof(VertexData);
 
-	// Sprite用のTransformationMatrix用のリソースを作る。Matrix4x4 1つ分のサイズを用意する
-	_obj->wvpResource = CreateBufferResource(_device, sizeof(TransformationMatrix));
-	// データを書き込む
-	_obj->transformMat = nullptr;
-	// 書き込むためのアドレスを取得
-	_obj->wvpResource->Map(0, nullptr, reinterpret_cast<void**>(&_obj->transformMat));
 	// 単位行列を書きこんでおく
-	_obj->transformMat->World = MakeIdentity4x4();
+	_obj->transformMat.WVP = MakeIdentity4x4();
+	_obj->transformMat.World = MakeIdentity4x4();
+	_obj->transformMat.worldInverseTranspose = MakeIdentity4x4();
 
-
-	_obj->useTextureResource = CreateBufferResource(_device, sizeof(float));
-	_obj->useTexture = nullptr;
-	_obj->useTextureResource->Map(0, nullptr, reinterpret_cast<void**>(&_obj->useTexture));
-	*_obj->useTexture = 1.0f;
+	_obj->useTexture = 1.0f;
 
 	///色の変更
-	_obj->materialResource = CreateBufferResource(_device, sizeof(Material) * sphereVertexNum);
-	_obj->materialResource->Map(0, nullptr, reinterpret_cast<void**>(&_obj->materialData));
-	_obj->materialData->color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
-	_obj->materialData->enabledLighthig = true;
-	_obj->materialData->uvTransform = MakeIdentity4x4();
-	_obj->materialData->shininess = 40.0f;
+	_obj->materialData.color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
+	_obj->materialData.enabledLighthig = true;
+	_obj->materialData.uvTransform = MakeIdentity4x4();
+	_obj->materialData.shininess = 40.0f;
 
 	_obj->vertexResource->Map(0, nullptr, reinterpret_cast<void**>(&_obj->vertexData));
 
@@ -2108,6 +2938,7 @@ void MakeSphereData(const Microsoft::WRL::ComPtr<ID3D12Device>& _device, Object*
 	}
 	_obj->vertexNum = sphereVertexNum;
 	_obj->textureHandle = 0;
+	_obj->bounds = CalculateMeshBounds(&_obj->vertexData[0].position, _obj->vertexNum, sizeof(VertexData));
 
 }
 
@@ -2156,30 +2987,17 @@ void MakeSpriteData(const Microsoft::WRL::ComPtr<ID3D12Device>& _device, Object*
 	_obj->indexData[4] = 3;
 	_obj->indexData[5] = 2;
 
-	_obj->materialResource = CreateBufferResource(_device, sizeof(Material));
-
-	_obj->materialData = new Material;
-	_obj->materialResource->Map(0, nullptr, reinterpret_cast<void**>(&_obj->materialData));
-	_obj->materialData->color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
-	_obj->materialData->enabledLighthig = false;
-	_obj->materialData->uvTransform = MakeIdentity4x4();
-	_obj->materialData->shininess = 40.0f;
+	_obj->materialData.color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
+	_obj->materialData.enabledLighthig = false;
+	_obj->materialData.uvTransform = MakeIdentity4x4();
+	_obj->materialData.shininess = 40.0f;
 
+	_obj->useTexture = 1.0f;
 
-	_obj->useTextureResource = CreateBufferResource(_device, sizeof(float));
-	_obj->useTexture = nullptr;
-	_obj->useTextureResource->Map(0, nullptr, reinterpret_cast<void**>(&_obj->useTexture));
-	*_obj->useTexture = 1.0f;
-
-	// Sprite用のTransformationMatrix用のリソースを作る。Matrix4x4 1つ分のサイズを用意する
-	_obj->wvpResource = CreateBufferResource(_device, sizeof(TransformationMatrix));
-	// データを書き込む
-	_obj->transformMat = nullptr;
-	// 書き込むためのアドレスを取得
-	_obj->wvpResource->Map(0, nullptr, reinterpret_cast<void**>(&_obj->transformMat));
 	// 単位行列を書きこんでおく
-	_obj->transformMat->World = MakeIdentity4x4();
-	_obj->transformMat->WVP = MakeIdentity4x4();
+	_obj->transformMat.World = MakeIdentity4x4();
+	_obj->transformMat.WVP = MakeIdentity4x4();
+	_obj->transformMat.worldInverseTranspose = MakeIdentity4x4();
 
 	_obj->textureHandle = 0;
 }
@@ -2203,25 +3021,20 @@ void InitializeMeshData(const Microsoft::WRL::ComPtr<ID3D12Device>& _device, Mod
 	//頂点リソースにデータを書き込む
 	_model->vertexResource->Map(0, nullptr, reinterpret_cast<void**>(&_model->vertexData)); //書き込むためのアドレスを取得
 	std::memcpy(_model->vertexData, _model->vertices.data(), sizeof(VertexData) * _model->vertices.size());//頂点データをリソースにコピー
+	//カリング用の境界
+	_model->bounds = CalculateMeshBounds(&_model->vertices[0].position, uint32_t(_model->vertices.size()), sizeof(VertexData));
+
+	_model->materialData.color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
+	_model->materialData.enabledLighthig = true;
+	_model->materialData.uvTransform = MakeIdentity4x4();
+	_model->materialData.shininess = 40.0f;
 
-	_model->materialResource = CreateBufferResource(_device, sizeof(Material));
-	_model->materialResource->Map(0, nullptr, reinterpret_cast<void**>(&_model->materialData));
-	_model->materialData->color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
-	_model->materialData->enabledLighthig = true;
-	_model->materialData->uvTransform = MakeIdentity4x4();
-	_model->materialData->shininess = 40.0f;
-
-	// Sprite用のTransformationMatrix用のリソースを作る。Matrix4x4 1つ分のサイズを用意する
-	_model->wvpResource = CreateBufferResource(_device, sizeof(TransformationMatrix));
-	// 書き込むためのアドレスを取得
-	_model->wvpResource->Map(0, nullptr, reinterpret_cast<void**>(&_model->transformMat));
 	// 単位行列を書きこんでおく
-	_model->transformMat->World = MakeIdentity4x4();
+	_model->transformMat.WVP = MakeIdentity4x4();
+	_model->transformMat.World = MakeIdentity4x4();
+	_model->transformMat.worldInverseTranspose = MakeIdentity4x4();
 
-	_model->useTextureResource = CreateBufferResource(_device, sizeof(float));
-	_model->useTexture = nullptr;
-	_model->useTextureResource->Map(0, nullptr, reinterpret_cast<void**>(&_model->useTexture));
-	*_model->useTexture = 1.0f;
+	_model->useTexture = 1.0f;
 }
 
 
@@ -2246,89 +3059,48 @@ TransformationMatrix CalculateObjectWVPMat(const stTransform& _transform, const
 	return TransformationMatrix(transMat);
 }
 
-void DrawTriangle(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, Object* _obj, Microsoft::WRL::ComPtr<ID3D12Resource> _light, uint32_t _textureHandle)
+void DrawTriangle(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, LinearAllocator& _allocator, Object* _obj, D3D12_GPU_VIRTUAL_ADDRESS _light, uint32_t _textureHandle)
 {
 	_commandList->IASetVertexBuffers(0, 1, &_obj->vertexBufferView);
 
-	_commandList->SetGraphicsRootConstantBufferView(0, _obj->materialResource->GetGPUVirtualAddress());
-	_commandList->SetGraphicsRootConstantBufferView(1, _obj->wvpResource->GetGPUVirtualAddress());
-	if (_textureHandle == -1)
-	{
-		*_obj->useTexture = 0.0f;
-		_commandList->SetGraphicsRootDescriptorTable(2, GetTextureHandle(0));
-	}
-	else
-	{
-		*_obj->useTexture = 1.0f;
-		_commandList->SetGraphicsRootDescriptorTable(2, GetTextureHandle(_obj->textureHandle));
-	}
-	_commandList->SetGraphicsRootDescriptorTable(2, GetTextureHandle(_textureHandle));
-	_commandList->SetGraphicsRootConstantBufferView(3, _obj->useTextureResource->GetGPUVirtualAddress());
+	_commandList->SetGraphicsRootConstantBufferView(0, PushConstantBuffer(_allocator, _obj->materialData));
+	_commandList->SetGraphicsRootConstantBufferView(1, PushConstantBuffer(_allocator, _obj->transformMat));
+	_obj->useTexture = _textureHandle == -1 ? 0.0f : 1.0f;
+	_commandList->SetGraphicsRootDescriptorTable(2, textureTableHandleGPU);
+	_commandList->SetGraphicsRoot32BitConstant(6, _textureHandle == -1 ? 0 : _textureHandle, 0);
+	_commandList->SetGraphicsRootConstantBufferView(3, PushConstantBuffer(_allocator, _obj->useTexture));
 
 	_commandList->DrawInstanced(3, 1, 0, 0);
 }
 
-void DrawSprite(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, Object* _obj, Microsoft::WRL::ComPtr<ID3D12Resource> _light, uint32_t _textureHandle)
+void DrawSprite(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, LinearAllocator& _allocator, Object* _obj, D3D12_GPU_VIRTUAL_ADDRESS _light, uint32_t _textureHandle)
 {
 	_commandList->IASetVertexBuffers(0, 1, &_obj->vertexBufferView);
 	_commandList->IASetIndexBuffer(&_obj->indexBufferView);
 
-	_commandList->SetGraphicsRootConstantBufferView(0, _obj->materialResource->GetGPUVirtualAddress());
-	_commandList->SetGraphicsRootConstantBufferView(1, _obj->wvpResource->GetGPUVirtualAddress());
+	_commandList->SetGraphicsRootConstantBufferView(0, PushConstantBuffer(_allocator, _obj->materialData));
+	_commandList->SetGraphicsRootConstantBufferView(1, PushConstantBuffer(_allocator, _obj->transformMat));
 
-	_commandList->SetGraphicsRootDescriptorTable(2, GetTextureHandle(_obj->textureHandle));
-	_commandList->SetGraphicsRootConstantBufferView(3, _obj->useTextureResource->GetGPUVirtualAddress());
+	_commandList->SetGraphicsRootDescriptorTable(2, textureTableHandleGPU);
+	_commandList->SetGraphicsRoot32BitConstant(6, _obj->textureHandle, 0);
+	_commandList->SetGraphicsRootConstantBufferView(3, PushConstantBuffer(_allocator, _obj->useTexture));
 
 	_commandList->DrawIndexedInstanced(6, 1, 0, 0, 0);
 }
 
-void DrawSphere(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, Object* _obj, uint32_t _textureHandle)
+void DrawSphere(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& _commandList, LinearAllocator& _allocator, Object* _obj, uint32_t _textureHandle)
 {
 	_commandList->IASetVertexBuffers(0, 1, &_obj->vertexBufferView);
 
-	_commandList->SetGraphicsRootConstantBufferView(0, _obj->materialResource->GetGPUVirtualAddress());
-	_commandList->SetGraphicsRootConstantBufferView(1, _obj->wvpResource->GetGPUVirtualAddress());
-	_commandList->SetGraphicsRootDescriptorTable(2, GetTextureHandle(_obj->textureHandle));
-	_commandList->SetGraphicsRootConstantBufferView(3, _obj->useTextureResource->GetGPUVirtualAddress());
+	_commandList->SetGraphicsRootConstantBufferView(0, PushConstantBuffer(_allocator, _obj->materialData));
+	_commandList->SetGraphicsRootConstantBufferView(1, PushConstantBuffer(_allocator, _obj->transformMat));
+	_commandList->SetGraphicsRootDescriptorTable(2, textureTableHandleGPU);
+	_commandList->SetGraphicsRoot32BitConstant(6, _obj->textureHandle, 0);
+	_commandList->SetGraphicsRootConstantBufferView(3, PushConstantBuffer(_allocator, _obj->useTexture));
 
 	_commandList->DrawInstanced(_obj->vertexNum, 1, 0, 0);
 }
 
-Particle MakeNewParticle(std::mt19937& _randomEngine, const Emitter& _emitter)
-{
-
-	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
-	Particle particle;
-	particle.transform.scale = { 1.0f, 1.0f, 1.0f };
-	particle.transform.rotate = { 0.0f, 0.0f, 0.0f };
-	Vector3 randomTranslate{ distribution(_randomEngine), distribution(_randomEngine), distribution(_randomEngine) };
-	particle.transform.translate = _emitter.transform.translate + randomTranslate;
-
-	particle.velocity = { distribution(_randomEngine), distribution(_randomEngine), distribution(_randomEngine) };
-
-
-
-	std::uniform_real_distribution<float> distColor(0.0f, 1.0f);
-	particle.color = { distColor(_randomEngine), distColor(_randomEngine), distColor(_randomEngine),1.0f };
-
-	std::uniform_real_distribution<float> distTime(1.0f, 3.0f);
-	particle.lifeTime = distTime(_randomEngine);
-	particle.currentTime = 0;
-
-
-	return particle;
-}
-
-std::list<Particle> Emit(const Emitter& _emitter, std::mt19937& _randomEngine)
-{
-	std::list<Particle> particles;
-	for (uint32_t count = 0; count < _emitter.count; count++)
-	{
-		particles.push_back(MakeNewParticle(_randomEngine, _emitter));
-	}
-	return particles;
-}
-
 void SetBlendMode(BlendMode _blendMode, D3D12_GRAPHICS_PIPELINE_STATE_DESC& _graphicsPipelineStateDesc)
 {
 	D3D12_BLEND_DESC blendDesc{};
@@ -2375,11 +3147,13 @@ void SetBlendMode(BlendMode _blendMode, D3D12_GRAPHICS_PIPELINE_STATE_DESC& _gra
 
 }
 
-TransformationMatrix CalculateParticleWVPMat(const stTransform& _transform, const Matrix4x4& _cameraMatrix, const Matrix4x4& _VPmat, bool useBillborad)
+bool RequiresDepthSort(BlendMode _blendMode)
 {
-	TransformationMatrix transMat;
-
+	return _blendMode == BlendMode::kBlendModeNormal;
+}
 
+Matrix4x4 CalculateBillboardMatrix(const Matrix4x4& _cameraMatrix, bool useBillborad)
+{
 	Matrix4x4 billboardatrix;
 	if (useBillborad)
 	{
@@ -2391,11 +3165,5 @@ TransformationMatrix CalculateParticleWVPMat(const stTransform& _transform, cons
 	else
 		billboardatrix = MakeIdentity4x4();
 
-	Matrix4x4 scaleMatrix = MakeScaleMatrix(_transform.scale);
-	Matrix4x4 translateMatrix = MakeTranslateMatrix(_transform.translate);
-
-	transMat.World = scaleMatrix * billboardatrix * translateMatrix;
-	transMat.WVP = transMat.World * _VPmat;
-
-	return TransformationMatrix(transMat);
+	return billboardatrix;
 }
@@ -0,0 +1,243 @@
+#include "BVH.h"
+#include <cassert>
+#include <numeric>
+
+namespace
+{
+	AABB Union(const AABB& _a, const AABB& _b)
+	{
+		return {
+			{ (std::min)(_a.min.x, _b.min.x), (std::min)(_a.min.y, _b.min.y), (std::min)(_a.min.z, _b.min.z) },
+			{ (std::max)(_a.max.x, _b.max.x), (std::max)(_a.max.y, _b.max.y), (std::max)(_a.max.z, _b.max.z) }
+		};
+	}
+
+	float SurfaceArea(const AABB& _aabb)
+	{
+		Vector3 extent = _aabb.max - _aabb.min;
+		return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	//空のAABB 何とUnionしても相手がそのまま残る
+	const AABB kEmptyAABB = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+
+	float GetAxis(const Vector3& _v, uint32_t _axis)
+	{
+		return _axis == 0 ? _v.x : (_axis == 1 ? _v.y : _v.z);
+	}
+}
+
+void BVH::Build(const AABB* _bounds, uint32_t _count)
+{
+	nodes.clear();
+	elements.resize(_count);
+	std::iota(elements.begin(), elements.end(), 0u);
+	elementBounds.resize(_count);
+	if (_count == 0)
+	{
+		return;
+	}
+
+	//分割で並べ替えるときに連続したメモリを読むよう，要素番号とAABBと重心をまとめて持つ
+	std::vector<BuildElement> buildElements(_count);
+	for (uint32_t index = 0; index < _count; index++)
+	{
+		buildElements[index].bounds = _bounds[index];
+		buildElements[index].centroid = (_bounds[index].min + _bounds[index].max) * 0.5f;
+		buildElements[index].element = index;
+	}
+
+	//ノード数は最大で要素数の2倍-1 途中で再確保されないように先に確保する
+	nodes.reserve(_count * 2 - 1);
+	Node root{};
+	root.bounds = kEmptyAABB;
+	root.leftOrFirst = 0;
+	root.count = _count;
+	for (const BuildElement& buildElement : buildElements)
+	{
+		root.bounds = Union(root.bounds, buildElement.bounds);
+	}
+	nodes.push_back(root);
+
+	struct BuildEntry
+	{
+		uint32_t node;
+		uint32_t depth;
+	};
+	std::vector<BuildEntry> stack;
+	stack.push_back({ 0, 0 });
+	while (!stack.empty())
+	{
+		BuildEntry entry = stack.back();
+		stack.pop_back();
+		//深すぎるとたどるときのスタックに収まらないので葉にする
+		if (kStackSize - 1 <= entry.depth + 1 || !Split(entry.node, buildElements))
+		{
+			continue;
+		}
+		stack.push_back({ nodes[entry.node].leftOrFirst, entry.depth + 1 });
+		stack.push_back({ nodes[entry.node].leftOrFirst + 1, entry.depth + 1 });
+	}
+
+	for (uint32_t index = 0; index < _count; index++)
+	{
+		elements[index] = buildElements[index].element;
+		elementBounds[index] = buildElements[index].bounds;
+	}
+}
+
+void BVH::Refit(const AABB* _bounds)
+{
+	for (uint32_t index = 0; index < elements.size(); index++)
+	{
+		elementBounds[index] = _bounds[elements[index]];
+	}
+	//子は親より後ろにあるので後ろから更新すれば子が先に終わる
+	for (size_t index = nodes.size(); index-- > 0;)
+	{
+		Node& node = nodes[index];
+		if (node.IsLeaf())
+		{
+			node.bounds = kEmptyAABB;
+			for (uint32_t element = node.leftOrFirst; element < node.leftOrFirst + node.count; element++)
+			{
+				node.bounds = Union(node.bounds, elementBounds[element]);
+			}
+		}
+		else
+		{
+			node.bounds = Union(nodes[node.leftOrFirst].bounds, nodes[node.leftOrFirst + 1].bounds);
+		}
+	}
+}
+
+bool BVH::Split(uint32_t _node, std::vector<BuildElement>& _buildElements)
+{
+	const uint32_t first = nodes[_node].leftOrFirst;
+	const uint32_t count = nodes[_node].count;
+	if (count <= 1)
+	{
+		return false;
+	}
+	BuildElement* begin = _buildElements.data() + first;
+	BuildElement* end = begin + count;
+
+	//重心の範囲で分割候補を作る
+	AABB centroidBounds = kEmptyAABB;
+	for (const BuildElement* element = begin; element != end; element++)
+	{
+		centroidBounds = Union(centroidBounds, { element->centroid, element->centroid });
+	}
+
+	struct Bin
+	{
+		AABB bounds;
+		uint32_t count;
+	};
+
+	//要素が少ないノードではビンを減らす
+	const uint32_t binCount = (std::min)(kBinCount, count);
+
+	//3軸分のビンを1回の走査で埋める
+	Bin bins[3][kBinCount];
+	float minCentroids[3];
+	float binScales[3];
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		for (uint32_t bin = 0; bin < binCount; bin++)
+		{
+			bins[axis][bin] = { kEmptyAABB, 0 };
+		}
+		minCentroids[axis] = GetAxis(centroidBounds.min, axis);
+		float extent = GetAxis(centroidBounds.max, axis) - minCentroids[axis];
+		binScales[axis] = 0.0f < extent ? float(binCount) / extent : 0.0f;
+	}
+	for (const BuildElement* element = begin; element != end; element++)
+	{
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			uint32_t binIndex = (std::min)(binCount - 1, static_cast<uint32_t>((GetAxis(element->centroid, axis) - minCentroids[axis]) * binScales[axis]));
+			Bin& bin = bins[axis][binIndex];
+			bin.bounds = Union(bin.bounds, element->bounds);
+			bin.count++;
+		}
+	}
+
+	float bestCost = FLT_MAX;
+	uint32_t bestAxis = 0;
+	uint32_t bestSplit = 0;
+	AABB bestLeftBounds{};
+	AABB bestRightBounds{};
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		if (binScales[axis] == 0.0f)
+		{
+			continue;
+		}
+
+		//右から累積したAABBと数
+		AABB rightBounds[kBinCount];
+		uint32_t rightCounts[kBinCount];
+		AABB accumulated = kEmptyAABB;
+		uint32_t accumulatedCount = 0;
+		for (uint32_t bin = binCount - 1; bin > 0; bin--)
+		{
+			accumulated = Union(accumulated, bins[axis][bin].bounds);
+			accumulatedCount += bins[axis][bin].count;
+			rightBounds[bin] = accumulated;
+			rightCounts[bin] = accumulatedCount;
+		}
+
+		//split番目より左のビンを左の子にする
+		AABB leftBounds = kEmptyAABB;
+		uint32_t leftCount = 0;
+		for (uint32_t split = 1; split < binCount; split++)
+		{
+			leftBounds = Union(leftBounds, bins[axis][split - 1].bounds);
+			leftCount += bins[axis][split - 1].count;
+			if (leftCount == 0 || rightCounts[split] == 0)
+			{
+				continue;
+			}
+			float cost = leftCount * SurfaceArea(leftBounds) + rightCounts[split] * SurfaceArea(rightBounds[split]);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+				bestLeftBounds = leftBounds;
+				bestRightBounds = rightBounds[split];
+			}
+		}
+	}
+
+	if (bestCost == FLT_MAX)
+	{
+		//重心がすべて同じ点にある
+		return false;
+	}
+	//分割するとノードを1つ多くたどることになる
+	float nodeArea = SurfaceArea(nodes[_node].bounds);
+	float splitCost = kTraversalCost * nodeArea + bestCost;
+	float leafCost = count * nodeArea;
+	if (count <= kMaxLeafElements && leafCost <= splitCost)
+	{
+		return false;
+	}
+
+	BuildElement* middle = std::partition(begin, end, [&](const BuildElement& _element)
+		{
+			uint32_t binIndex = (std::min)(binCount - 1, static_cast<uint32_t>((GetAxis(_element.centroid, bestAxis) - minCentroids[bestAxis]) * binScales[bestAxis]));
+			return binIndex < bestSplit;
+		});
+	uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+	assert(0 < leftCount && leftCount < count);
+
+	Node left{ bestLeftBounds, first, leftCount };
+	Node right{ bestRightBounds, first + leftCount, count - leftCount };
+	nodes[_node].leftOrFirst = static_cast<uint32_t>(nodes.size());
+	nodes[_node].count = 0;
+	nodes.push_back(left);
+	nodes.push_back(right);
+	return true;
+}
@@ -0,0 +1,476 @@
+#pragma once
+#include "MyLib.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// AABBの二分木 (Bounding Volume Hierarchy)
+/// 要素は番号とAABBだけで管理するので，球・OBB・三角形など任意の形状に使える
+/// 細かい判定は呼び出し側でIsCollisionを呼ぶ (CollectOverlapsを参照)
+/// </summary>
+class BVH
+{
+public:
+	struct Node
+	{
+		AABB bounds;
+		uint32_t leftOrFirst;	//内部ノードなら左の子 (右の子はその次) 葉なら最初の要素の位置
+		uint32_t count;			//葉の要素数 0なら内部ノード
+
+		bool IsLeaf() const { return count != 0; }
+	};
+
+	/// <summary>
+	/// SAH(表面積ヒューリスティック)で構築する
+	/// </summary>
+	/// <param name="_bounds">要素ごとのAABB 要素番号は配列の添字</param>
+	/// <param name="_count">要素数</param>
+	void Build(const AABB* _bounds, uint32_t _count);
+
+	/// <summary>
+	/// 木の形は変えずにAABBだけを更新する 動く物体用
+	/// 大きく動いて木の質が落ちたらBuildし直す
+	/// </summary>
+	/// <param name="_bounds">Buildと同じ要素数のAABB</param>
+	void Refit(const AABB* _bounds);
+
+	/// <summary>
+	/// AABBが重なっている要素の組をすべて列挙する (同じ組は1回だけ)
+	/// </summary>
+	/// <param name="_func">void(uint32_t a, uint32_t b)</param>
+	template <class Func>
+	void QueryPairs(const Func& _func) const;
+
+	/// <summary>
+	/// AABBが重なる要素を列挙する
+	/// </summary>
+	/// <param name="_func">void(uint32_t element)</param>
+	template <class Func>
+	void QueryAABB(const AABB& _aabb, const Func& _func) const;
+
+	/// <summary>
+	/// AABBが球に重なる要素を列挙する
+	/// </summary>
+	/// <param name="_func">void(uint32_t element)</param>
+	template <class Func>
+	void QuerySphere(const Sphere& _sphere, const Func& _func) const;
+
+	/// <summary>
+	/// AABBが線分に交差する要素を列挙する
+	/// </summary>
+	/// <param name="_func">void(uint32_t element)</param>
+	template <class Func>
+	void QuerySegment(const Segment& _segment, const Func& _func) const;
+
+	/// <summary>
+	/// 線分上で最も近い交差を探す 近いノードから順にたどり，見つかった交差より遠いノードは飛ばす
+	/// </summary>
+	/// <param name="_segment">線分 t=0が始点 t=1が終点</param>
+	/// <param name="_func">float(uint32_t element) 交差するtを返す 交差しなければINFINITY (tの上限より大きい値ならよい)</param>
+	/// <param name="_hitElement">最も近い要素 交差しなければ変更しない</param>
+	/// <param name="_t">最も近い交差のt 交差しなければ変更しない</param>
+	/// <returns>交差しているか</returns>
+	template <class Func>
+	bool RayCast(const Segment& _segment, const Func& _func, uint32_t& _hitElement, float& _t) const;
+	/// <summary>
+	/// 半直線版 tの上限がない (FLT_MAXの交差も交差として扱う)
+	/// </summary>
+	template <class Func>
+	bool RayCast(const Ray& _ray, const Func& _func, uint32_t& _hitElement, float& _t) const;
+
+	const std::vector<Node>& GetNodes() const { return nodes; }
+	/// <summary>
+	/// 葉が参照する要素番号 葉の[leftOrFirst, leftOrFirst + count)が範囲
+	/// </summary>
+	const std::vector<uint32_t>& GetElements() const { return elements; }
+	uint32_t GetElementCount() const { return static_cast<uint32_t>(elements.size()); }
+
+private:
+	//SAHの分割候補数の上限
+	static const uint32_t kBinCount = 16;
+	//これ以下の要素数ならSAHの結果によらず葉にしてよい
+	static const uint32_t kMaxLeafElements = 4;
+	//たどるときのスタックの深さ 木の深さはこれ未満に抑える
+	static const uint32_t kStackSize = 64;
+
+	//要素1つを調べる手間に対する，ノードを1つたどる手間の比
+	static constexpr float kTraversalCost = 1.0f;
+
+	struct BuildElement
+	{
+		AABB bounds;
+		Vector3 centroid;
+		uint32_t element;
+	};
+
+	/// <summary>
+	/// ノードを分割する 分割しないほうが安ければfalse
+	/// </summary>
+	bool Split(uint32_t _node, std::vector<BuildElement>& _buildElements);
+
+	/// <summary>
+	/// _isNearestなら[0, _tMax]で最も近い交差を_hitElementと_tに入れてtrueを返す
+	/// </summary>
+	template <class Func>
+	bool Traverse(const Vector3& _origin, const Vector3& _diff, float _tMax, bool _isNearest, const Func& _func, uint32_t& _hitElement, float& _t) const;
+
+	std::vector<Node> nodes;			//0番が根 子は必ず親より後ろにある
+	std::vector<uint32_t> elements;		//葉が参照する要素番号
+	std::vector<AABB> elementBounds;	//elementsと同じ並びの要素のAABB
+};
+
+/// <summary>
+/// 2つのAABBが重なっているか (境界で接するものも含む)
+/// </summary>
+inline bool IsOverlap(const AABB& _a, const AABB& _b)
+{
+	return _a.min.x <= _b.max.x && _b.min.x <= _a.max.x &&
+		_a.min.y <= _b.max.y && _b.min.y <= _a.max.y &&
+		_a.min.z <= _b.max.z && _b.min.z <= _a.max.z;
+}
+
+//方向の成分が0のときに逆数の代わりに使う値 これ以上の逆数は軸に平行とみなす
+const float kParallelInverse = 1.0e20f;
+
+/// <summary>
+/// スラブ判定用に方向の各成分の逆数を求める 0の成分はkParallelInverseにする
+/// </summary>
+inline Vector3 CalculateInverseDiff(const Vector3& _diff)
+{
+	auto inverse = [](float _value)
+		{
+			return std::fabs(_value) < 1.0f / kParallelInverse ? (_value < 0.0f ? -kParallelInverse : kParallelInverse) : 1.0f / _value;
+		};
+	return { inverse(_diff.x), inverse(_diff.y), inverse(_diff.z) };
+}
+
+//スラブの出るtに掛ける値 逆数と引き算の丸めで出るtが小さくなり，境界の上を通るレイが箱を外れないようにする (Ize 2013)
+const float kSlabExitScale = 1.0f + 2.0f * (3.0f * FLT_EPSILON * 0.5f) / (1.0f - 3.0f * FLT_EPSILON * 0.5f);
+
+/// <summary>
+/// スラブ1枚分 [_tmin, _tmax] を狭める
+/// 軸に平行なときは始点が境界上にあっても内側として扱う
+/// </summary>
+inline void ClipSlab(float _min, float _max, float _origin, float _inverseDiff, float& _tmin, float& _tmax)
+{
+	if (kParallelInverse <= std::fabs(_inverseDiff))
+	{
+		if (_origin < _min || _max < _origin)
+		{
+			_tmin = FLT_MAX;
+		}
+		return;
+	}
+	float t1 = (_min - _origin) * _inverseDiff;
+	float t2 = (_max - _origin) * _inverseDiff;
+	_tmin = (std::max)(_tmin, (std::min)(t1, t2));
+	_tmax = (std::min)(_tmax, (std::max)(t1, t2) * kSlabExitScale);
+}
+
+/// <summary>
+/// 線分とAABBのスラブ判定 IsCollision(AABB, Segment)と違い逆数を使い回し，入る時刻を返す
+/// </summary>
+/// <param name="_inverseDiff">CalculateInverseDiffで求めた方向の逆数</param>
+/// <param name="_tMax">tの上限</param>
+/// <param name="_tEnter">交差するならAABBに入るt (始点が中にあれば0)</param>
+inline bool IntersectSlab(const AABB& _aabb, const Vector3& _origin, const Vector3& _inverseDiff, float _tMax, float& _tEnter)
+{
+	float tmin = 0.0f;
+	float tmax = _tMax;
+	ClipSlab(_aabb.min.x, _aabb.max.x, _origin.x, _inverseDiff.x, tmin, tmax);
+	ClipSlab(_aabb.min.y, _aabb.max.y, _origin.y, _inverseDiff.y, tmin, tmax);
+	ClipSlab(_aabb.min.z, _aabb.max.z, _origin.z, _inverseDiff.z, tmin, tmax);
+
+	_tEnter = tmin;
+	return tmin <= tmax;
+}
+
+/// <summary>
+/// BVHで候補を絞り，IsCollision(形状, 球)で判定して重なる要素を集める
+/// </summary>
+/// <param name="_shapes">BVHの要素番号で引ける形状の配列 (Sphere, AABB, OBB)</param>
+template <class Shape>
+void CollectOverlaps(const BVH& _bvh, const Shape* _shapes, const Sphere& _sphere, std::vector<uint32_t>& _result)
+{
+	_bvh.QuerySphere(_sphere, [&](uint32_t _element)
+		{
+			if (IsCollision(_shapes[_element], _sphere))
+			{
+				_result.push_back(_element);
+			}
+		});
+}
+
+/// <summary>
+/// BVHで候補を絞り，IsCollision(形状, 線分)で判定して交差する要素を集める
+/// </summary>
+/// <param name="_shapes">BVHの要素番号で引ける形状の配列 (AABB, OBB, Triangle)</param>
+template <class Shape>
+void CollectOverlaps(const BVH& _bvh, const Shape* _shapes, const Segment& _segment, std::vector<uint32_t>& _result)
+{
+	_bvh.QuerySegment(_segment, [&](uint32_t _element)
+		{
+			if (IsCollision(_shapes[_element], _segment))
+			{
+				_result.push_back(_element);
+			}
+		});
+}
+
+template <class Func>
+void BVH::QueryPairs(const Func& _func) const
+{
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	struct NodePair
+	{
+		uint32_t a, b;
+	};
+	std::vector<NodePair> stack;
+	stack.push_back({ 0, 0 });
+	while (!stack.empty())
+	{
+		NodePair pair = stack.back();
+		stack.pop_back();
+		const Node& a = nodes[pair.a];
+		const Node& b = nodes[pair.b];
+
+		if (pair.a == pair.b)
+		{
+			//同じノードの中の組
+			if (a.IsLeaf())
+			{
+				for (uint32_t i = a.leftOrFirst; i < a.leftOrFirst + a.count; i++)
+				{
+					for (uint32_t j = i + 1; j < a.leftOrFirst + a.count; j++)
+					{
+						if (IsOverlap(elementBounds[i], elementBounds[j]))
+						{
+							_func(elements[i], elements[j]);
+						}
+					}
+				}
+			}
+			else
+			{
+				stack.push_back({ a.leftOrFirst, a.leftOrFirst });
+				stack.push_back({ a.leftOrFirst + 1, a.leftOrFirst + 1 });
+				stack.push_back({ a.leftOrFirst, a.leftOrFirst + 1 });
+			}
+			continue;
+		}
+
+		if (!IsOverlap(a.bounds, b.bounds))
+		{
+			continue;
+		}
+		if (a.IsLeaf() && b.IsLeaf())
+		{
+			//葉のAABBは要素をまとめたものなので要素ごとにも調べる
+			for (uint32_t i = a.leftOrFirst; i < a.leftOrFirst + a.count; i++)
+			{
+				for (uint32_t j = b.leftOrFirst; j < b.leftOrFirst + b.count; j++)
+				{
+					if (IsOverlap(elementBounds[i], elementBounds[j]))
+					{
+						_func(elements[i], elements[j]);
+					}
+				}
+			}
+		}
+		else if (b.IsLeaf() || (!a.IsLeaf() && pair.a < pair.b))
+		{
+			//番号の小さいほうが根に近いので先に下る
+			stack.push_back({ a.leftOrFirst, pair.b });
+			stack.push_back({ a.leftOrFirst + 1, pair.b });
+		}
+		else
+		{
+			stack.push_back({ pair.a, b.leftOrFirst });
+			stack.push_back({ pair.a, b.leftOrFirst + 1 });
+		}
+	}
+}
+
+template <class Func>
+void BVH::QueryAABB(const AABB& _aabb, const Func& _func) const
+{
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	uint32_t stack[kStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize != 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		if (!IsOverlap(node.bounds, _aabb))
+		{
+			continue;
+		}
+		if (node.IsLeaf())
+		{
+			for (uint32_t index = node.leftOrFirst; index < node.leftOrFirst + node.count; index++)
+			{
+				if (IsOverlap(elementBounds[index], _aabb))
+				{
+					_func(elements[index]);
+				}
+			}
+			continue;
+		}
+		stack[stackSize++] = node.leftOrFirst;
+		stack[stackSize++] = node.leftOrFirst + 1;
+	}
+}
+
+template <class Func>
+void BVH::QuerySphere(const Sphere& _sphere, const Func& _func) const
+{
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	uint32_t stack[kStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize != 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		if (!IsCollision(node.bounds, _sphere))
+		{
+			continue;
+		}
+		if (node.IsLeaf())
+		{
+			for (uint32_t index = node.leftOrFirst; index < node.leftOrFirst + node.count; index++)
+			{
+				if (IsCollision(elementBounds[index], _sphere))
+				{
+					_func(elements[index]);
+				}
+			}
+			continue;
+		}
+		stack[stackSize++] = node.leftOrFirst;
+		stack[stackSize++] = node.leftOrFirst + 1;
+	}
+}
+
+template <class Func>
+void BVH::QuerySegment(const Segment& _segment, const Func& _func) const
+{
+	uint32_t hitElement = 0;
+	float t = 0.0f;
+	Traverse(_segment.origin, _segment.diff, 1.0f, false, [&](uint32_t _element)
+		{
+			_func(_element);
+			return INFINITY;
+		}, hitElement, t);
+}
+
+template <class Func>
+bool BVH::RayCast(const Segment& _segment, const Func& _func, uint32_t& _hitElement, float& _t) const
+{
+	return Traverse(_segment.origin, _segment.diff, 1.0f, true, _func, _hitElement, _t);
+}
+
+template <class Func>
+bool BVH::RayCast(const Ray& _ray, const Func& _func, uint32_t& _hitElement, float& _t) const
+{
+	return Traverse(_ray.origin, _ray.diff, FLT_MAX, true, _func, _hitElement, _t);
+}
+
+template <class Func>
+bool BVH::Traverse(const Vector3& _origin, const Vector3& _diff, float _tMax, bool _isNearest, const Func& _func, uint32_t& _hitElement, float& _t) const
+{
+	//交差したかは値ではなくフラグで持つ (半直線ではtの上限がないので，値で交差なしを表せない)
+	bool isHit = false;
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	const Vector3 inverseDiff = CalculateInverseDiff(_diff);
+
+	float tLimit = _tMax;
+	float tEnter;
+	if (!IntersectSlab(nodes[0].bounds, _origin, inverseDiff, tLimit, tEnter))
+	{
+		return false;
+	}
+
+	struct StackEntry
+	{
+		uint32_t node;
+		float tEnter;
+	};
+	StackEntry stack[kStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { 0, tEnter };
+	while (stackSize != 0)
+	{
+		StackEntry entry = stack[--stackSize];
+		//積んだ後により近い交差が見つかっていれば調べなくてよい
+		if (tLimit < entry.tEnter)
+		{
+			continue;
+		}
+		const Node& node = nodes[entry.node];
+		if (node.IsLeaf())
+		{
+			for (uint32_t index = node.leftOrFirst; index < node.leftOrFirst + node.count; index++)
+			{
+				float tElement;
+				if (!IntersectSlab(elementBounds[index], _origin, inverseDiff, tLimit, tElement))
+				{
+					continue;
+				}
+				float t = _func(elements[index]);
+				if (_isNearest && t <= tLimit && (!isHit || t < tLimit))
+				{
+					isHit = true;
+					tLimit = t;
+					_hitElement = elements[index];
+				}
+			}
+			continue;
+		}
+
+		StackEntry left = { node.leftOrFirst, 0.0f };
+		StackEntry right = { node.leftOrFirst + 1, 0.0f };
+		bool hitLeft = IntersectSlab(nodes[left.node].bounds, _origin, inverseDiff, tLimit, left.tEnter);
+		bool hitRight = IntersectSlab(nodes[right.node].bounds, _origin, inverseDiff, tLimit, right.tEnter);
+		if (hitLeft && hitRight)
+		{
+			//近いほうを先に取り出すので後に積む
+			if (left.tEnter < right.tEnter)
+			{
+				std::swap(left, right);
+			}
+			stack[stackSize++] = left;
+			stack[stackSize++] = right;
+		}
+		else if (hitLeft)
+		{
+			stack[stackSize++] = left;
+		}
+		else if (hitRight)
+		{
+			stack[stackSize++] = right;
+		}
+	}
+	if (isHit)
+	{
+		_t = tLimit;
+	}
+	return isHit;
+}
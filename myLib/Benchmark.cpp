@@ -0,0 +1,400 @@
+#include "Benchmark.h"
+#include "BVH.h"
+#include "MeshBVH.h"
+#include "PhysicsWorld.h"
+#include "RadixSort.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+	float ElapsedMilliseconds(std::chrono::steady_clock::time_point _start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - _start).count();
+	}
+
+	/// <summary>
+	/// 線分と球が最初に交わるt 交わらなければINFINITY
+	/// </summary>
+	float IntersectSegmentSphere(const Segment& _segment, const Sphere& _sphere)
+	{
+		const Vector3 offset = _segment.origin - _sphere.center;
+		const float a = Dot(_segment.diff, _segment.diff);
+		const float b = Dot(offset, _segment.diff);
+		const float c = Dot(offset, offset) - _sphere.radius * _sphere.radius;
+		const float discriminant = b * b - a * c;
+		if (a == 0.0f || discriminant < 0.0f)
+		{
+			return INFINITY;
+		}
+		//始点が球の中にあるときは0で当たったことにする
+		const float t = c <= 0.0f ? 0.0f : (-b - std::sqrt(discriminant)) / a;
+		return 0.0f <= t && t <= 1.0f ? t : INFINITY;
+	}
+
+	/// <summary>
+	/// 全三角形を倍精度で調べて，線分上で最も近い交差のtを返す 交わらなければINFINITY
+	/// 重心座標が-_toleranceまでなら当たりとみなす (負の値なら内側に余裕のあるものだけ)
+	/// </summary>
+	float RayCastBruteForce(const Vector3* _positions, uint32_t _triangleCount, const Segment& _segment, double _tolerance)
+	{
+		auto toArray = [](const Vector3& _v) { return std::array<double, 3>{ _v.x, _v.y, _v.z }; };
+		auto subtract = [](const std::array<double, 3>& _a, const std::array<double, 3>& _b) { return std::array<double, 3>{ _a[0] - _b[0], _a[1] - _b[1], _a[2] - _b[2] }; };
+		auto cross = [](const std::array<double, 3>& _a, const std::array<double, 3>& _b) { return std::array<double, 3>{ _a[1] * _b[2] - _a[2] * _b[1], _a[2] * _b[0] - _a[0] * _b[2], _a[0] * _b[1] - _a[1] * _b[0] }; };
+		auto dot = [](const std::array<double, 3>& _a, const std::array<double, 3>& _b) { return _a[0] * _b[0] + _a[1] * _b[1] + _a[2] * _b[2]; };
+
+		const std::array<double, 3> origin = toArray(_segment.origin);
+		const std::array<double, 3> diff = toArray(_segment.diff);
+		double nearest = INFINITY;
+		for (uint32_t triangle = 0; triangle < _triangleCount; triangle++)
+		{
+			//Möller–Trumbore (両面)
+			const std::array<double, 3> v0 = toArray(_positions[triangle * 3]);
+			const std::array<double, 3> edge1 = subtract(toArray(_positions[triangle * 3 + 1]), v0);
+			const std::array<double, 3> edge2 = subtract(toArray(_positions[triangle * 3 + 2]), v0);
+			const std::array<double, 3> p = cross(diff, edge2);
+			const double determinant = dot(edge1, p);
+			if (determinant == 0.0)
+			{
+				continue;
+			}
+			const std::array<double, 3> offset = subtract(origin, v0);
+			const double u = dot(offset, p) / determinant;
+			const std::array<double, 3> q = cross(offset, edge1);
+			const double v = dot(diff, q) / determinant;
+			const double t = dot(edge2, q) / determinant;
+			if (u < -_tolerance || v < -_tolerance || 1.0 + _tolerance < u + v || t < 0.0 || 1.0 < t)
+			{
+				continue;
+			}
+			nearest = (std::min)(nearest, t);
+		}
+		return static_cast<float>(nearest);
+	}
+}
+
+RadixSortBenchmarkResult BenchmarkRadixSort(uint32_t _count, uint32_t _iterations, ThreadPool* _threadPool)
+{
+	std::mt19937 randomEngine(7);
+	std::uniform_real_distribution<float> depth(0.1f, 100.0f);
+	std::vector<uint32_t> sourceKeys(_count);
+	for (uint32_t& key : sourceKeys)
+	{
+		key = FloatToSortableKey(depth(randomEngine));
+	}
+
+	std::vector<uint32_t> keys(_count);
+	std::vector<uint32_t> values(_count);
+	std::vector<uint32_t> keysTemp(_count);
+	std::vector<uint32_t> valuesTemp(_count);
+	std::vector<uint32_t> histograms;
+
+	RadixSortBenchmarkResult result{ _count, 0.0f, 0.0f, true };
+	float totalMilliseconds = 0.0f;
+	//最初の1回はスレッドの起動やキャッシュの影響が大きいので数えない
+	for (uint32_t iteration = 0; iteration <= _iterations; iteration++)
+	{
+		keys = sourceKeys;
+		for (uint32_t index = 0; index < _count; index++)
+		{
+			values[index] = index;
+		}
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		RadixSort(keys.data(), values.data(), keysTemp.data(), valuesTemp.data(), histograms, _count, _threadPool);
+		const float milliseconds = ElapsedMilliseconds(start);
+
+		result.isSorted = result.isSorted && std::is_sorted(keys.begin(), keys.end());
+		for (uint32_t index = 0; index < _count && result.isSorted; index++)
+		{
+			result.isSorted = sourceKeys[values[index]] == keys[index];
+		}
+		if (iteration == 0)
+		{
+			continue;
+		}
+		totalMilliseconds += milliseconds;
+		result.bestMilliseconds = iteration == 1 ? milliseconds : (std::min)(result.bestMilliseconds, milliseconds);
+	}
+	result.averageMilliseconds = 0 < _iterations ? totalMilliseconds / _iterations : 0.0f;
+	return result;
+}
+
+BVHBenchmarkResult BenchmarkBVH(uint32_t _count, uint32_t _rays)
+{
+	//半径0.5の球を1辺2の立方体に1つの密度で置く
+	const float kRadius = 0.5f;
+	const float extent = std::cbrt(static_cast<float>(_count)) * 2.0f;
+	std::mt19937 randomEngine(_count);
+	std::uniform_real_distribution<float> position(0.0f, extent);
+	std::uniform_real_distribution<float> velocity(-0.1f, 0.1f);
+	std::vector<Sphere> spheres(_count);
+	std::vector<AABB> bounds(_count);
+	auto updateBounds = [&]()
+		{
+			for (uint32_t index = 0; index < _count; index++)
+			{
+				const Vector3 radius = { spheres[index].radius, spheres[index].radius, spheres[index].radius };
+				bounds[index] = { spheres[index].center - radius, spheres[index].center + radius };
+			}
+		};
+	for (Sphere& sphere : spheres)
+	{
+		sphere = { { position(randomEngine), position(randomEngine), position(randomEngine) }, kRadius };
+	}
+	updateBounds();
+
+	BVHBenchmarkResult result{};
+	result.count = _count;
+	BVH bvh;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bvh.Build(bounds.data(), _count);
+	result.buildMilliseconds = ElapsedMilliseconds(start);
+
+	//動く物体のように全体を少しずつ動かしてから測る
+	for (Sphere& sphere : spheres)
+	{
+		sphere.center = sphere.center + Vector3{ velocity(randomEngine), velocity(randomEngine), velocity(randomEngine) };
+	}
+	updateBounds();
+	start = std::chrono::steady_clock::now();
+	bvh.Refit(bounds.data());
+	result.refitMilliseconds = ElapsedMilliseconds(start);
+
+	start = std::chrono::steady_clock::now();
+	bvh.QueryPairs([&](uint32_t _a, uint32_t _b)
+		{
+			result.pairs++;
+			result.contacts += IsCollision(spheres[_a], spheres[_b]) ? 1 : 0;
+		});
+	result.pairMilliseconds = ElapsedMilliseconds(start);
+
+	//空間の中の2点を結ぶ線分を飛ばす
+	std::vector<Segment> segments(_rays);
+	for (Segment& segment : segments)
+	{
+		const Vector3 origin = { position(randomEngine), position(randomEngine), position(randomEngine) };
+		const Vector3 end = { position(randomEngine), position(randomEngine), position(randomEngine) };
+		segment = { origin, end - origin };
+	}
+	start = std::chrono::steady_clock::now();
+	for (const Segment& segment : segments)
+	{
+		uint32_t hitElement = 0;
+		float t = 0.0f;
+		const bool isHit = bvh.RayCast(segment, [&](uint32_t _element) { return IntersectSegmentSphere(segment, spheres[_element]); }, hitElement, t);
+		result.rayHits += isHit ? 1 : 0;
+	}
+	result.rayMilliseconds = ElapsedMilliseconds(start);
+	result.rays = _rays;
+	return result;
+}
+
+MeshBVHBenchmarkResult BenchmarkMeshBVH(const Vector3* _positions, uint32_t _triangleCount, uint32_t _rays, uint32_t _checkedRays)
+{
+	MeshBVHBenchmarkResult result{};
+	result.triangles = _triangleCount;
+	if (_triangleCount == 0)
+	{
+		return result;
+	}
+
+	MeshBVH meshBVH;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	meshBVH.Build(_positions, _triangleCount);
+	result.buildMilliseconds = ElapsedMilliseconds(start);
+
+	AABB bounds{ _positions[0], _positions[0] };
+	for (uint32_t vertex = 1; vertex < _triangleCount * 3; vertex++)
+	{
+		bounds.min = { (std::min)(bounds.min.x, _positions[vertex].x), (std::min)(bounds.min.y, _positions[vertex].y), (std::min)(bounds.min.z, _positions[vertex].z) };
+		bounds.max = { (std::max)(bounds.max.x, _positions[vertex].x), (std::max)(bounds.max.y, _positions[vertex].y), (std::max)(bounds.max.z, _positions[vertex].z) };
+	}
+	//メッシュの上の点から，メッシュの範囲の底の点へ向かう線分
+	std::mt19937 randomEngine(_triangleCount);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float height = (bounds.max.y - bounds.min.y) + 1.0f;
+	auto makeSegment = [&]()
+		{
+			const Vector3 origin = { bounds.min.x + (bounds.max.x - bounds.min.x) * unit(randomEngine), bounds.max.y + height, bounds.min.z + (bounds.max.z - bounds.min.z) * unit(randomEngine) };
+			const Vector3 end = { bounds.min.x + (bounds.max.x - bounds.min.x) * unit(randomEngine), bounds.min.y - 1.0f, bounds.min.z + (bounds.max.z - bounds.min.z) * unit(randomEngine) };
+			return Segment{ origin, end - origin };
+		};
+
+	std::vector<Segment> segments(_rays);
+	for (Segment& segment : segments)
+	{
+		segment = makeSegment();
+	}
+	start = std::chrono::steady_clock::now();
+	for (const Segment& segment : segments)
+	{
+		RayHit hit{};
+		result.hits += meshBVH.RayCast(segment, hit) ? 1 : 0;
+	}
+	result.rayMilliseconds = ElapsedMilliseconds(start);
+	result.rays = _rays;
+
+	//他の三角形と共有している辺の中点と，そういう辺だけに囲まれた頂点を狙う先にする (メッシュの縁は外れてよいので除く)
+	std::map<std::array<float, 6>, uint32_t> edgeCounts;
+	auto makeEdgeKey = [](const Vector3& _a, const Vector3& _b)
+		{
+			std::array<float, 3> a = { _a.x, _a.y, _a.z };
+			std::array<float, 3> b = { _b.x, _b.y, _b.z };
+			if (b < a)
+			{
+				std::swap(a, b);
+			}
+			return std::array<float, 6>{ a[0], a[1], a[2], b[0], b[1], b[2] };
+		};
+	for (uint32_t vertex = 0; vertex < _triangleCount * 3; vertex++)
+	{
+		const uint32_t next = vertex / 3 * 3 + (vertex + 1) % 3;
+		edgeCounts[makeEdgeKey(_positions[vertex], _positions[next])]++;
+	}
+	std::map<std::array<float, 3>, bool> isBoundaryVertex;
+	for (uint32_t vertex = 0; vertex < _triangleCount * 3; vertex++)
+	{
+		const uint32_t next = vertex / 3 * 3 + (vertex + 1) % 3;
+		const bool isBoundary = edgeCounts[makeEdgeKey(_positions[vertex], _positions[next])] < 2;
+		for (const Vector3& end : { _positions[vertex], _positions[next] })
+		{
+			bool& flag = isBoundaryVertex[{ end.x, end.y, end.z }];
+			flag = flag || isBoundary;
+		}
+	}
+	std::vector<Vector3> targets;
+	for (uint32_t vertex = 0; vertex < _triangleCount * 3; vertex++)
+	{
+		const Vector3& position = _positions[vertex];
+		const Vector3& nextPosition = _positions[vertex / 3 * 3 + (vertex + 1) % 3];
+		if (1 < edgeCounts[makeEdgeKey(position, nextPosition)])
+		{
+			targets.push_back((position + nextPosition) * 0.5f);
+		}
+		if (!isBoundaryVertex[{ position.x, position.y, position.z }])
+		{
+			targets.push_back(position);
+		}
+	}
+
+	//半分は乱数の線分，残りは狙う先へ上からほぼ真下に向かう線分で，隣り合う三角形の隙間をすり抜けないか調べる
+	std::uniform_real_distribution<float> slope(-0.1f, 0.1f);
+	const float tolerance = 1.0e-4f;
+	for (uint32_t index = 0; index < _checkedRays; index++)
+	{
+		const bool isTargeted = index % 2 == 1 && !targets.empty();
+		Segment segment = makeSegment();
+		if (isTargeted)
+		{
+			const Vector3 target = targets[randomEngine() % targets.size()];
+			segment.origin = target + Vector3{ slope(randomEngine) * height, height, slope(randomEngine) * height };
+			//狙った先がt=2/3になるように通り越して伸ばす
+			segment.diff = (target - segment.origin) * 1.5f;
+		}
+
+		RayHit hit{};
+		const bool isHit = meshBVH.RayCast(segment, hit);
+		//辺の上は誤差でどちらの三角形にもなりうるので，重心座標に余裕を持たせた判定と内側に限った判定の間に入っていればよい
+		const float looseT = RayCastBruteForce(_positions, _triangleCount, segment, tolerance);
+		bool isMatched = true;
+		if (isTargeted)
+		{
+			//狙った先より手前で当たるか，狙った先で当たらなければすり抜けている
+			isMatched = isHit && looseT - tolerance <= hit.t && hit.t <= 2.0f / 3.0f + tolerance;
+		}
+		else
+		{
+			const float strictT = RayCastBruteForce(_positions, _triangleCount, segment, -tolerance);
+			isMatched = isHit ? looseT - tolerance <= hit.t && hit.t <= strictT + tolerance : strictT == INFINITY;
+		}
+		result.checkedRays++;
+		result.mismatches += isMatched ? 0 : 1;
+	}
+	return result;
+}
+
+std::vector<Vector3> MakeHeightfieldTriangles(uint32_t _resolution, float _cellSize)
+{
+	auto vertex = [&](uint32_t _x, uint32_t _z)
+		{
+			const float x = _x * _cellSize;
+			const float z = _z * _cellSize;
+			return Vector3{ x, std::sin(x * 0.37f) * 2.0f + std::cos(z * 0.23f) * 3.0f + std::sin((x + z) * 0.11f), z };
+		};
+	std::vector<Vector3> positions;
+	positions.reserve(_resolution * _resolution * 6);
+	for (uint32_t z = 0; z < _resolution; z++)
+	{
+		for (uint32_t x = 0; x < _resolution; x++)
+		{
+			const Vector3 v00 = vertex(x, z);
+			const Vector3 v10 = vertex(x + 1, z);
+			const Vector3 v01 = vertex(x, z + 1);
+			const Vector3 v11 = vertex(x + 1, z + 1);
+			positions.insert(positions.end(), { v00, v01, v10, v10, v01, v11 });
+		}
+	}
+	return positions;
+}
+
+PhysicsBenchmarkResult BenchmarkPhysics(uint32_t _ballCount, uint32_t _settleSteps, uint32_t _steps, ThreadPool* _threadPool)
+{
+	const float kHalfWidth = 10.0f;
+	PhysicsWorld world(_threadPool);
+	world.AddStaticPlane({ { 0.0f, 1.0f, 0.0f }, 0.0f });
+	world.AddStaticPlane({ { 1.0f, 0.0f, 0.0f }, -kHalfWidth });
+	world.AddStaticPlane({ { -1.0f, 0.0f, 0.0f }, -kHalfWidth });
+	world.AddStaticPlane({ { 0.0f, 0.0f, 1.0f }, -kHalfWidth });
+	world.AddStaticPlane({ { 0.0f, 0.0f, -1.0f }, -kHalfWidth });
+
+	//半径0.2から0.3のボールを高さ30までばらまく
+	std::mt19937 randomEngine(37);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (uint32_t index = 0; index < _ballCount; index++)
+	{
+		Ball ball{};
+		ball.position = { (unit(randomEngine) * 2.0f - 1.0f) * (kHalfWidth - 0.5f), 1.0f + unit(randomEngine) * 30.0f, (unit(randomEngine) * 2.0f - 1.0f) * (kHalfWidth - 0.5f) };
+		ball.velocity = { 0.0f, -unit(randomEngine) * 5.0f, 0.0f };
+		ball.mass = 1.0f;
+		ball.radius = 0.2f + 0.1f * unit(randomEngine);
+		world.AddBall(ball);
+	}
+
+	const float kDeltaTime = 1.0f / 60.0f;
+	for (uint32_t step = 0; step < _settleSteps; step++)
+	{
+		world.Step(kDeltaTime);
+	}
+
+	PhysicsBenchmarkResult result{ _ballCount, _steps, 0.0f, 0.0f, 0, 0, 0, 0 };
+	float totalMilliseconds = 0.0f;
+	for (uint32_t step = 0; step < _steps; step++)
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		world.Step(kDeltaTime);
+		const float milliseconds = ElapsedMilliseconds(start);
+		totalMilliseconds += milliseconds;
+		result.worstMilliseconds = (std::max)(result.worstMilliseconds, milliseconds);
+	}
+	result.averageMilliseconds = 0 < _steps ? totalMilliseconds / _steps : 0.0f;
+	result.contacts = world.GetContactCount();
+	result.islands = world.GetIslandCount();
+	result.colors = world.GetColorCount();
+
+	//中心が箱の外に出たものをすり抜けとみなす
+	for (const Vector3& position : world.GetBallPositions())
+	{
+		if (position.y < 0.0f || kHalfWidth < std::fabs(position.x) || kHalfWidth < std::fabs(position.z))
+		{
+			result.escapedBalls++;
+		}
+	}
+	return result;
+}
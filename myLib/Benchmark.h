@@ -0,0 +1,97 @@
+#pragma once
+#include "Vector3.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/// <summary>
+/// BenchmarkRadixSortの結果
+/// </summary>
+struct RadixSortBenchmarkResult
+{
+	uint32_t count;				//並べた要素数
+	float averageMilliseconds;	//1回の平均
+	float bestMilliseconds;		//最も速かった1回
+	bool isSorted;				//すべての回で正しく並んだか
+};
+
+/// <summary>
+/// パーティクルの深度のような乱数のfloatをキーにして，_count要素の32bit基数ソートを_iterations回測る
+/// 作業用のバッファは使い回すので，毎フレームのソートと同じく確保の時間は含まない
+/// </summary>
+/// <param name="_threadPool">並列化に使うスレッドプール nullptrなら単一スレッド</param>
+RadixSortBenchmarkResult BenchmarkRadixSort(uint32_t _count, uint32_t _iterations, ThreadPool* _threadPool);
+
+/// <summary>
+/// BenchmarkBVHの結果
+/// </summary>
+struct BVHBenchmarkResult
+{
+	uint32_t count;				//要素 (球) の数
+	float buildMilliseconds;	//SAHでの構築
+	float refitMilliseconds;	//全要素を少し動かした後のRefit
+	float pairMilliseconds;		//重なる組の列挙と球どうしの判定
+	uint32_t pairs;				//AABBが重なった組の数
+	uint32_t contacts;			//そのうち球どうしも衝突していた数
+	float rayMilliseconds;		//最も近い交差を探すレイキャスト全体
+	uint32_t rays;				//飛ばしたレイの数
+	uint32_t rayHits;			//何かに当たったレイの数
+};
+
+/// <summary>
+/// 乱数で置いた_count個の球 (1つあたりの近くの球の数が要素数によらないように空間を広げる) でBVHの各処理を測る
+/// 同じ_countなら同じ配置になる
+/// </summary>
+/// <param name="_rays">最も近い交差を探すレイの数</param>
+BVHBenchmarkResult BenchmarkBVH(uint32_t _count, uint32_t _rays);
+
+/// <summary>
+/// BenchmarkMeshBVHの結果
+/// </summary>
+struct MeshBVHBenchmarkResult
+{
+	uint32_t triangles;			//三角形の数
+	float buildMilliseconds;	//構築
+	uint32_t rays;				//速さを測ったレイの数
+	uint32_t hits;				//そのうち当たった数
+	float rayMilliseconds;		//そのレイキャスト全体
+	uint32_t checkedRays;		//全三角形との総当たりと比べたレイの数 (半分は辺と頂点を狙う)
+	uint32_t mismatches;		//総当たりと結果が違った数 (辺の上の誤差の範囲は数えない)
+};
+
+/// <summary>
+/// _positions (三角形ごとに3頂点) のMeshBVHを作り，上からメッシュへ向かう線分で最も近い交点を求める速さを測る
+/// 一部のレイは全三角形を倍精度で調べた結果と比べ，辺や頂点を狙ったレイがすり抜けないかも調べる
+/// </summary>
+/// <param name="_rays">速さを測るレイの数</param>
+/// <param name="_checkedRays">総当たりと比べるレイの数</param>
+MeshBVHBenchmarkResult BenchmarkMeshBVH(const Vector3* _positions, uint32_t _triangleCount, uint32_t _rays, uint32_t _checkedRays);
+
+/// <summary>
+/// 起伏のある地面の三角形を作る (_resolution x _resolutionのマスを2つの三角形に分ける)
+/// </summary>
+/// <returns>三角形ごとに3頂点ずつ並んだ座標</returns>
+std::vector<Vector3> MakeHeightfieldTriangles(uint32_t _resolution, float _cellSize);
+
+/// <summary>
+/// BenchmarkPhysicsの結果
+/// </summary>
+struct PhysicsBenchmarkResult
+{
+	uint32_t balls;				//ボールの数
+	uint32_t steps;				//測ったステップ数
+	float averageMilliseconds;	//1ステップの平均
+	float worstMilliseconds;	//最も遅かった1ステップ
+	uint32_t contacts;			//最後のステップの接触の数
+	uint32_t islands;			//最後のステップのアイランドの数
+	uint32_t colors;			//最後のステップの塗り分けの色の数
+	uint32_t escapedBalls;		//箱の外へすり抜けたボールの数
+};
+
+/// <summary>
+/// 1辺20の箱に_ballCount個のボールを落とし，_settleSteps進めて山になってから_stepsの1/60秒のステップを測る
+/// 山は接触でつながった1つの大きなアイランドになる
+/// </summary>
+/// <param name="_threadPool">並列化に使うスレッドプール nullptrなら単一スレッド</param>
+PhysicsBenchmarkResult BenchmarkPhysics(uint32_t _ballCount, uint32_t _settleSteps, uint32_t _steps, ThreadPool* _threadPool);
@@ -0,0 +1,191 @@
+#include "CollisionBatch.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//線分の向きが軸に平行なときに0除算の代わりに使う逆数
+	const float kLargeInverse = 1.0e30f;
+
+	float SafeInverse(float _value)
+	{
+		return std::fabs(_value) < 1.0e-8f ? std::copysign(kLargeInverse, _value) : 1.0f / _value;
+	}
+
+	float SquaredOutside(float _local, float _extent)
+	{
+		float outside = _local - std::clamp(_local, -_extent, _extent);
+		return outside * outside;
+	}
+
+	/// <summary>
+	/// スラブ1枚分 [_tmin, _tmax] を狭める
+	/// 平行で範囲外なら tmin, tmax がともに非常に大きい同符号になり，交差しない扱いになる
+	/// </summary>
+	void ClipSlab(float _origin, float _inverseDiff, float _extent, float& _tmin, float& _tmax)
+	{
+		float t1 = (-_extent - _origin) * _inverseDiff;
+		float t2 = (_extent - _origin) * _inverseDiff;
+		_tmin = (std::max)(_tmin, (std::min)(t1, t2));
+		_tmax = (std::min)(_tmax, (std::max)(t1, t2));
+	}
+}
+
+void SphereSoA::Push(const Sphere& _sphere)
+{
+	center[0].push_back(_sphere.center.x);
+	center[1].push_back(_sphere.center.y);
+	center[2].push_back(_sphere.center.z);
+	radius.push_back(_sphere.radius);
+}
+
+void SphereSoA::Clear()
+{
+	for (std::vector<float>& component : center)
+	{
+		component.clear();
+	}
+	radius.clear();
+}
+
+void SegmentSoA::Push(const Segment& _segment)
+{
+	origin[0].push_back(_segment.origin.x);
+	origin[1].push_back(_segment.origin.y);
+	origin[2].push_back(_segment.origin.z);
+	diff[0].push_back(_segment.diff.x);
+	diff[1].push_back(_segment.diff.y);
+	diff[2].push_back(_segment.diff.z);
+}
+
+void SegmentSoA::Clear()
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		origin[axis].clear();
+		diff[axis].clear();
+	}
+}
+
+void OBBSoA::Push(const OBB& _obb)
+{
+	center[0].push_back(_obb.center.x);
+	center[1].push_back(_obb.center.y);
+	center[2].push_back(_obb.center.z);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		orientations[axis][0].push_back(_obb.orientations[axis].x);
+		orientations[axis][1].push_back(_obb.orientations[axis].y);
+		orientations[axis][2].push_back(_obb.orientations[axis].z);
+	}
+	size[0].push_back(_obb.size.x);
+	size[1].push_back(_obb.size.y);
+	size[2].push_back(_obb.size.z);
+}
+
+void OBBSoA::Clear()
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		center[axis].clear();
+		size[axis].clear();
+		for (std::vector<float>& component : orientations[axis])
+		{
+			component.clear();
+		}
+	}
+}
+
+void IsCollision(const OBB& _obb, const SphereSoA& _spheres, bool* _results)
+{
+	const Vector3 o[3] = { _obb.orientations[0], _obb.orientations[1], _obb.orientations[2] };
+	const float extents[3] = { _obb.size.x, _obb.size.y, _obb.size.z };
+	const float* centerX = _spheres.center[0].data();
+	const float* centerY = _spheres.center[1].data();
+	const float* centerZ = _spheres.center[2].data();
+	const float* radius = _spheres.radius.data();
+
+	const uint32_t count = _spheres.GetCount();
+	for (uint32_t index = 0; index < count; index++)
+	{
+		float dx = centerX[index] - _obb.center.x;
+		float dy = centerY[index] - _obb.center.y;
+		float dz = centerZ[index] - _obb.center.z;
+		float squaredDistance = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float local = dx * o[axis].x + dy * o[axis].y + dz * o[axis].z;
+			squaredDistance += SquaredOutside(local, extents[axis]);
+		}
+		_results[index] = squaredDistance <= radius[index] * radius[index];
+	}
+}
+
+void IsCollision(const OBB& _obb, const SegmentSoA& _segments, bool* _results)
+{
+	const Vector3 o[3] = { _obb.orientations[0], _obb.orientations[1], _obb.orientations[2] };
+	const float extents[3] = { _obb.size.x, _obb.size.y, _obb.size.z };
+
+	const uint32_t count = _segments.GetCount();
+	for (uint32_t index = 0; index < count; index++)
+	{
+		float dx = _segments.origin[0][index] - _obb.center.x;
+		float dy = _segments.origin[1][index] - _obb.center.y;
+		float dz = _segments.origin[2][index] - _obb.center.z;
+		float vx = _segments.diff[0][index];
+		float vy = _segments.diff[1][index];
+		float vz = _segments.diff[2][index];
+
+		float tmin = 0.0f;
+		float tmax = 1.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float origin = dx * o[axis].x + dy * o[axis].y + dz * o[axis].z;
+			float diff = vx * o[axis].x + vy * o[axis].y + vz * o[axis].z;
+			ClipSlab(origin, SafeInverse(diff), extents[axis], tmin, tmax);
+		}
+		_results[index] = tmin <= tmax;
+	}
+}
+
+void IsCollision(const OBBSoA& _obbs, const Sphere& _sphere, bool* _results)
+{
+	const uint32_t count = _obbs.GetCount();
+	for (uint32_t index = 0; index < count; index++)
+	{
+		float dx = _sphere.center.x - _obbs.center[0][index];
+		float dy = _sphere.center.y - _obbs.center[1][index];
+		float dz = _sphere.center.z - _obbs.center[2][index];
+		float squaredDistance = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float local = dx * _obbs.orientations[axis][0][index] + dy * _obbs.orientations[axis][1][index] + dz * _obbs.orientations[axis][2][index];
+			squaredDistance += SquaredOutside(local, _obbs.size[axis][index]);
+		}
+		_results[index] = squaredDistance <= _sphere.radius * _sphere.radius;
+	}
+}
+
+void IsCollision(const OBBSoA& _obbs, const Segment& _segment, bool* _results)
+{
+	const uint32_t count = _obbs.GetCount();
+	for (uint32_t index = 0; index < count; index++)
+	{
+		float dx = _segment.origin.x - _obbs.center[0][index];
+		float dy = _segment.origin.y - _obbs.center[1][index];
+		float dz = _segment.origin.z - _obbs.center[2][index];
+
+		float tmin = 0.0f;
+		float tmax = 1.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float ox = _obbs.orientations[axis][0][index];
+			float oy = _obbs.orientations[axis][1][index];
+			float oz = _obbs.orientations[axis][2][index];
+			float origin = dx * ox + dy * oy + dz * oz;
+			float diff = _segment.diff.x * ox + _segment.diff.y * oy + _segment.diff.z * oz;
+			ClipSlab(origin, SafeInverse(diff), _obbs.size[axis][index], tmin, tmax);
+		}
+		_results[index] = tmin <= tmax;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "MyLib.h"
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// 球のSoA 成分ごとに連続しているのでまとめて判定するループがSIMD化されやすい
+/// </summary>
+struct SphereSoA
+{
+	std::vector<float> center[3];	//x y z
+	std::vector<float> radius;
+
+public:
+	void Push(const Sphere& _sphere);
+	void Clear();
+	uint32_t GetCount() const { return static_cast<uint32_t>(radius.size()); }
+};
+
+/// <summary>
+/// 線分のSoA
+/// </summary>
+struct SegmentSoA
+{
+	std::vector<float> origin[3];	//x y z
+	std::vector<float> diff[3];		//x y z
+
+public:
+	void Push(const Segment& _segment);
+	void Clear();
+	uint32_t GetCount() const { return static_cast<uint32_t>(origin[0].size()); }
+};
+
+/// <summary>
+/// OBBのSoA (トリガー領域など)
+/// </summary>
+struct OBBSoA
+{
+	std::vector<float> center[3];			//x y z
+	std::vector<float> orientations[3][3];	//[軸][x y z]
+	std::vector<float> size[3];				//x y z
+
+public:
+	void Push(const OBB& _obb);
+	void Clear();
+	uint32_t GetCount() const { return static_cast<uint32_t>(center[0].size()); }
+};
+
+//1つのobbと複数の球の衝突判定 _resultsは球の数だけ書き込む
+void IsCollision(const OBB& _obb, const SphereSoA& _spheres, bool* _results);
+
+//1つのobbと複数の線分の衝突判定 _resultsは線分の数だけ書き込む
+void IsCollision(const OBB& _obb, const SegmentSoA& _segments, bool* _results);
+
+//複数のobbと1つの球の衝突判定 _resultsはobbの数だけ書き込む
+void IsCollision(const OBBSoA& _obbs, const Sphere& _sphere, bool* _results);
+
+//複数のobbと1つの線分の衝突判定 _resultsはobbの数だけ書き込む
+void IsCollision(const OBBSoA& _obbs, const Segment& _segment, bool* _results);
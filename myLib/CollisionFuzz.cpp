@@ -0,0 +1,191 @@
+#include "CollisionFuzz.h"
+#include "CollisionBatch.h"
+#include "MyLib.h"
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+	//以前のobbと球の判定 rotateから作ったワールド行列の逆行列で球の中心をobbのローカルへ移す
+	bool IsCollisionByInverse(const OBB& _obb, const Sphere& _sphere)
+	{
+		Matrix4x4 obbWorldMatInv = Inverse(MakeAffineMatrix({ 1.0f, 1.0f, 1.0f }, _obb.rotate, _obb.center));
+		AABB aabbOBBLocal{ .min = -_obb.size, .max = _obb.size };
+		Sphere sphereOBBLocal{ Transform(_sphere.center, obbWorldMatInv), _sphere.radius };
+		return IsCollision(aabbOBBLocal, sphereOBBLocal);
+	}
+
+	//以前のobbと線分の判定
+	bool IsCollisionByInverse(const OBB& _obb, const Segment& _segment)
+	{
+		Matrix4x4 obbWorldMatInv = Inverse(MakeAffineMatrix({ 1.0f, 1.0f, 1.0f }, _obb.rotate, _obb.center));
+		Vector3 localOrigin = Transform(_segment.origin, obbWorldMatInv);
+		Vector3 localEnd = Transform(_segment.origin + _segment.diff, obbWorldMatInv);
+		AABB localAABB{ -_obb.size, _obb.size };
+		Segment localSegment{ localOrigin, localEnd - localOrigin };
+		return IsCollision(localAABB, localSegment);
+	}
+}
+
+ObbSatFuzzResult FuzzObbSat(uint32_t _seed, uint32_t _rounds)
+{
+	const uint32_t kOthers = 1000;
+	std::mt19937 randomEngine(_seed);
+	std::uniform_real_distribution<float> position(-3.0f, 3.0f);
+	std::uniform_real_distribution<float> rotation(-3.14f, 3.14f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	auto makeObb = [&](bool _isAxisAligned)
+		{
+			OBB obb{};
+			obb.center = { position(randomEngine), position(randomEngine), position(randomEngine) };
+			obb.size = { size(randomEngine), size(randomEngine), size(randomEngine) };
+			obb.rotate = _isAxisAligned ? Vector3{ 0.0f, 0.0f, 0.0f } : Vector3{ rotation(randomEngine), rotation(randomEngine), rotation(randomEngine) };
+			obb.CalculateOrientations();
+			return obb;
+		};
+
+	ObbSatFuzzResult result{};
+	std::vector<OBB> others(kOthers);
+	std::unique_ptr<bool[]> batchResults = std::make_unique<bool[]>(kOthers);
+	for (uint32_t round = 0; round < _rounds; round++)
+	{
+		//4回に1回は回転なし，8回に1回は相手の回転をそろえる
+		const bool isAxisAligned = round % 4 == 0;
+		const bool isParallel = round % 8 == 1;
+		OBB obb = makeObb(isAxisAligned);
+		for (OBB& other : others)
+		{
+			other = makeObb(isAxisAligned && randomEngine() % 2 == 0);
+			if (isParallel)
+			{
+				other.rotate = obb.rotate;
+				other.CalculateOrientations();
+			}
+		}
+		IsCollision(obb, others.data(), kOthers, batchResults.get());
+
+		for (uint32_t index = 0; index < kOthers; index++)
+		{
+			const bool reference = IsCollision(obb, others[index]);
+			const bool sat = IsCollisionSAT(obb, others[index]);
+			const bool batch = batchResults[index];
+			result.tested++;
+			result.hits += reference ? 1 : 0;
+			if (reference == sat && sat == batch)
+			{
+				continue;
+			}
+			//接している組は誤差でどちらにもなりうるので，少し大きさを変えて基準の判定が変わるなら数えない
+			OBB grown = others[index];
+			grown.size = grown.size * 1.001f;
+			OBB shrunk = others[index];
+			shrunk.size = shrunk.size * 0.999f;
+			if (IsCollision(obb, grown) != IsCollision(obb, shrunk))
+			{
+				result.borderline++;
+			}
+			else
+			{
+				result.mismatches++;
+			}
+		}
+	}
+	return result;
+}
+
+ObbPrimitiveFuzzResult FuzzObbPrimitives(uint32_t _seed, uint32_t _rounds)
+{
+	const uint32_t kOthers = 1000;
+	std::mt19937 randomEngine(_seed);
+	std::uniform_real_distribution<float> position(-3.0f, 3.0f);
+	std::uniform_real_distribution<float> rotation(-3.14f, 3.14f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	auto makeObb = [&](bool _isAxisAligned)
+		{
+			OBB obb{};
+			obb.center = { position(randomEngine), position(randomEngine), position(randomEngine) };
+			obb.size = { size(randomEngine), size(randomEngine), size(randomEngine) };
+			obb.rotate = _isAxisAligned ? Vector3{ 0.0f, 0.0f, 0.0f } : Vector3{ rotation(randomEngine), rotation(randomEngine), rotation(randomEngine) };
+			obb.CalculateOrientations();
+			return obb;
+		};
+
+	ObbPrimitiveFuzzResult result{};
+	std::vector<Sphere> spheres(kOthers);
+	std::vector<Segment> segments(kOthers);
+	SphereSoA sphereSoA;
+	SegmentSoA segmentSoA;
+	std::vector<OBB> obbs(kOthers);
+	OBBSoA obbSoA;
+	std::unique_ptr<bool[]> sphereResults = std::make_unique<bool[]>(kOthers);
+	std::unique_ptr<bool[]> segmentResults = std::make_unique<bool[]>(kOthers);
+	std::unique_ptr<bool[]> obbSphereResults = std::make_unique<bool[]>(kOthers);
+	std::unique_ptr<bool[]> obbSegmentResults = std::make_unique<bool[]>(kOthers);
+	for (uint32_t round = 0; round < _rounds; round++)
+	{
+		//4回に1回は回転なし 8回に1回は軸に平行な線分を混ぜる
+		const OBB obb = makeObb(round % 4 == 0);
+		sphereSoA.Clear();
+		segmentSoA.Clear();
+		obbSoA.Clear();
+		for (uint32_t index = 0; index < kOthers; index++)
+		{
+			spheres[index] = { { position(randomEngine), position(randomEngine), position(randomEngine) }, size(randomEngine) };
+			Vector3 diff = { position(randomEngine), position(randomEngine), position(randomEngine) };
+			if (round % 8 == 1)
+			{
+				diff = { diff.x, 0.0f, 0.0f };
+			}
+			segments[index] = { { position(randomEngine), position(randomEngine), position(randomEngine) }, diff };
+			obbs[index] = makeObb(index % 4 == 0);
+			sphereSoA.Push(spheres[index]);
+			segmentSoA.Push(segments[index]);
+			obbSoA.Push(obbs[index]);
+		}
+		IsCollision(obb, sphereSoA, sphereResults.get());
+		IsCollision(obb, segmentSoA, segmentResults.get());
+		//1対多の向きを逆にした判定は，0番目の球と線分をすべてのobbと比べる
+		IsCollision(obbSoA, spheres[0], obbSphereResults.get());
+		IsCollision(obbSoA, segments[0], obbSegmentResults.get());
+
+		//基準と結果が違ったら，接している組 (大きさを少し変えると基準も変わる) かどうかで数え分ける
+		auto check = [&](bool _reference, bool _scalar, bool _batch, auto _referenceWithObb, const OBB& _target)
+			{
+				result.tested++;
+				if (_reference == _scalar && _scalar == _batch)
+				{
+					return;
+				}
+				OBB grown = _target;
+				grown.size = grown.size * 1.001f;
+				OBB shrunk = _target;
+				shrunk.size = shrunk.size * 0.999f;
+				if (_referenceWithObb(grown) != _referenceWithObb(shrunk))
+				{
+					result.borderline++;
+				}
+				else
+				{
+					result.mismatches++;
+				}
+			};
+		for (uint32_t index = 0; index < kOthers; index++)
+		{
+			const Sphere& sphere = spheres[index];
+			const bool sphereReference = IsCollisionByInverse(obb, sphere);
+			result.sphereHits += sphereReference ? 1 : 0;
+			check(sphereReference, IsCollision(obb, sphere), sphereResults[index], [&](const OBB& _obb) { return IsCollisionByInverse(_obb, sphere); }, obb);
+
+			const Segment& segment = segments[index];
+			const bool segmentReference = IsCollisionByInverse(obb, segment);
+			result.segmentHits += segmentReference ? 1 : 0;
+			check(segmentReference, IsCollision(obb, segment), segmentResults[index], [&](const OBB& _obb) { return IsCollisionByInverse(_obb, segment); }, obb);
+
+			const OBB& other = obbs[index];
+			check(IsCollisionByInverse(other, spheres[0]), IsCollision(other, spheres[0]), obbSphereResults[index], [&](const OBB& _obb) { return IsCollisionByInverse(_obb, spheres[0]); }, other);
+			check(IsCollisionByInverse(other, segments[0]), IsCollision(other, segments[0]), obbSegmentResults[index], [&](const OBB& _obb) { return IsCollisionByInverse(_obb, segments[0]); }, other);
+		}
+	}
+	return result;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+
+/// <summary>
+/// FuzzObbSatの結果
+/// </summary>
+struct ObbSatFuzzResult
+{
+	uint32_t tested;		//調べた組の数
+	uint32_t hits;			//基準の判定で衝突していた数
+	uint32_t mismatches;	//基準と結果が違った数
+	uint32_t borderline;	//結果が違ったが，大きさを0.1%変えると基準の判定も変わる (接している) ので数えなかった数
+};
+
+/// <summary>
+/// IsCollisionSATと1対多のIsCollisionを，基準のIsCollision(OBB, OBB)と乱数で作った組で比べる
+/// 回転なし・回転をそろえた組 (平行な辺の外積軸) も混ぜる 同じ_seedなら同じ組を調べる
+/// </summary>
+/// <param name="_rounds">1回に1つのobbと1000個のobbを比べる回数</param>
+ObbSatFuzzResult FuzzObbSat(uint32_t _seed, uint32_t _rounds);
+
+/// <summary>
+/// FuzzObbPrimitivesの結果
+/// </summary>
+struct ObbPrimitiveFuzzResult
+{
+	uint32_t tested;		//調べた組の数 (球と線分の合計)
+	uint32_t sphereHits;	//基準の判定で球と衝突していた数
+	uint32_t segmentHits;	//基準の判定で線分と衝突していた数
+	uint32_t mismatches;	//基準と結果が違った数
+	uint32_t borderline;	//結果が違ったが，obbの大きさを0.1%変えると基準の判定も変わるので数えなかった数
+};
+
+/// <summary>
+/// orientationsを使うobbと球・線分のIsCollisionとSoAの1対多の判定を，
+/// rotateからアフィン行列の逆行列を作って変換する以前の判定と乱数で作った組で比べる
+/// </summary>
+/// <param name="_rounds">1つのobbと1000個の球・1000本の線分を比べる回数</param>
+ObbPrimitiveFuzzResult FuzzObbPrimitives(uint32_t _seed, uint32_t _rounds);
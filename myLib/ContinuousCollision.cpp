@@ -0,0 +1,601 @@
+#include "ContinuousCollision.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+	//この長さ以下の移動量・辺は0とみなす
+	const float kEpsilon = 1.0e-8f;
+	//カプセル同士の探索の反復回数
+	const uint32_t kMinimumSearchIterations = 32;
+	const uint32_t kRootSearchIterations = 24;
+
+	float GetAxis(const Vector3& _v, uint32_t _axis)
+	{
+		return _axis == 0 ? _v.x : (_axis == 1 ? _v.y : _v.z);
+	}
+
+	void SetAxis(Vector3& _v, uint32_t _axis, float _value)
+	{
+		(_axis == 0 ? _v.x : (_axis == 1 ? _v.y : _v.z)) = _value;
+	}
+
+	Vector3 Clamp(const Vector3& _point, const AABB& _aabb)
+	{
+		return {
+			std::clamp(_point.x, _aabb.min.x, _aabb.max.x),
+			std::clamp(_point.y, _aabb.min.y, _aabb.max.y),
+			std::clamp(_point.z, _aabb.min.z, _aabb.max.z)
+		};
+	}
+
+	/// <summary>
+	/// 移動する点 (_origin + _diff * t) と球の最初の交差時刻
+	/// </summary>
+	bool IntersectSphere(const Vector3& _origin, const Vector3& _diff, const Vector3& _center, float _radius, float& _t)
+	{
+		Vector3 m = _origin - _center;
+		float b = Dot(m, _diff);
+		float c = Dot(m, m) - _radius * _radius;
+		if (c <= 0.0f)
+		{
+			_t = 0.0f;
+			return true;
+		}
+		float a = Dot(_diff, _diff);
+		//離れていく・止まっている
+		if (0.0f <= b || a < kEpsilon)
+		{
+			return false;
+		}
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+		{
+			return false;
+		}
+		_t = (-b - std::sqrt(discriminant)) / a;
+		return _t <= 1.0f;
+	}
+
+	/// <summary>
+	/// 移動する点とカプセル (_start-_endを軸とする) の最初の交差時刻
+	/// 円柱部分を解いてから両端の球を調べる
+	/// </summary>
+	bool IntersectCapsule(const Vector3& _origin, const Vector3& _diff, const Vector3& _start, const Vector3& _end, float _radius, float& _t)
+	{
+		float bestT = FLT_MAX;
+		Vector3 axis = _end - _start;
+		Vector3 m = _origin - _start;
+		float axisLength2 = Dot(axis, axis);
+		float md = Dot(m, axis);
+		float nd = Dot(_diff, axis);
+
+		//軸に垂直な成分についての二次方程式 a t^2 + 2b t + c = 0
+		float a = axisLength2 * Dot(_diff, _diff) - nd * nd;
+		float b = axisLength2 * Dot(m, _diff) - nd * md;
+		float c = axisLength2 * (Dot(m, m) - _radius * _radius) - md * md;
+		//軸と平行に動くときや，すでに無限円柱の内側にいるときは両端の球で決まる
+		if (kEpsilon < a && 0.0f < c && b < 0.0f)
+		{
+			float discriminant = b * b - a * c;
+			if (0.0f <= discriminant)
+			{
+				float t = (-b - std::sqrt(discriminant)) / a;
+				float s = md + t * nd;
+				if (t <= 1.0f && 0.0f <= s && s <= axisLength2)
+				{
+					bestT = t;
+				}
+			}
+		}
+
+		float t;
+		if (IntersectSphere(_origin, _diff, _start, _radius, t))
+		{
+			bestT = (std::min)(bestT, t);
+		}
+		if (IntersectSphere(_origin, _diff, _end, _radius, t))
+		{
+			bestT = (std::min)(bestT, t);
+		}
+		if (bestT == FLT_MAX)
+		{
+			return false;
+		}
+		_t = bestT;
+		return true;
+	}
+
+	/// <summary>
+	/// 三角形上の最近点 (領域ごとに場合分け)
+	/// </summary>
+	Vector3 ClosestPoint(const Vector3& _point, const Triangle& _triangle)
+	{
+		const Vector3& a = _triangle.vertices[0];
+		const Vector3& b = _triangle.vertices[1];
+		const Vector3& c = _triangle.vertices[2];
+		Vector3 ab = b - a;
+		Vector3 ac = c - a;
+		Vector3 ap = _point - a;
+		float d1 = Dot(ab, ap);
+		float d2 = Dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+		{
+			return a;
+		}
+		Vector3 bp = _point - b;
+		float d3 = Dot(ab, bp);
+		float d4 = Dot(ac, bp);
+		if (0.0f <= d3 && d4 <= d3)
+		{
+			return b;
+		}
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && 0.0f <= d1 && d3 <= 0.0f)
+		{
+			return a + ab * (d1 / (d1 - d3));
+		}
+		Vector3 cp = _point - c;
+		float d5 = Dot(ab, cp);
+		float d6 = Dot(ac, cp);
+		if (0.0f <= d6 && d5 <= d6)
+		{
+			return c;
+		}
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && 0.0f <= d2 && d6 <= 0.0f)
+		{
+			return a + ac * (d2 / (d2 - d6));
+		}
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && 0.0f <= d4 - d3 && 0.0f <= d5 - d6)
+		{
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		}
+		float denominator = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	/// <summary>
+	/// 2線分間の最近点の組
+	/// </summary>
+	void ClosestPoints(const Segment& _a, const Segment& _b, Vector3& _pointA, Vector3& _pointB)
+	{
+		Vector3 r = _a.origin - _b.origin;
+		float a = Dot(_a.diff, _a.diff);
+		float e = Dot(_b.diff, _b.diff);
+		float f = Dot(_b.diff, r);
+		float s = 0.0f;
+		float t = 0.0f;
+		if (a <= kEpsilon && e <= kEpsilon)
+		{
+			//両方とも点
+		}
+		else if (a <= kEpsilon)
+		{
+			t = std::clamp(f / e, 0.0f, 1.0f);
+		}
+		else
+		{
+			float c = Dot(_a.diff, r);
+			if (e <= kEpsilon)
+			{
+				s = std::clamp(-c / a, 0.0f, 1.0f);
+			}
+			else
+			{
+				float b = Dot(_a.diff, _b.diff);
+				float denominator = a * e - b * b;
+				//平行なら_aの始点から始める
+				s = 0.0f < denominator ? std::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+				t = (b * s + f) / e;
+				if (t < 0.0f)
+				{
+					t = 0.0f;
+					s = std::clamp(-c / a, 0.0f, 1.0f);
+				}
+				else if (1.0f < t)
+				{
+					t = 1.0f;
+					s = std::clamp((b - c) / a, 0.0f, 1.0f);
+				}
+			}
+		}
+		_pointA = _a.origin + _a.diff * s;
+		_pointB = _b.origin + _b.diff * t;
+	}
+
+	/// <summary>
+	/// AABBの外側の点なら最近点からの向き，内側の点なら最も浅い面の向き
+	/// </summary>
+	Vector3 CalculateNormal(const Vector3& _point, const AABB& _aabb)
+	{
+		Vector3 closest = Clamp(_point, _aabb);
+		if (Dot(_point - closest, _point - closest) > kEpsilon)
+		{
+			return Normalize(_point - closest);
+		}
+		Vector3 normal{};
+		float minDepth = FLT_MAX;
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			float toMin = GetAxis(_point, axis) - GetAxis(_aabb.min, axis);
+			float toMax = GetAxis(_aabb.max, axis) - GetAxis(_point, axis);
+			if (toMin < minDepth)
+			{
+				minDepth = toMin;
+				normal = {};
+				SetAxis(normal, axis, -1.0f);
+			}
+			if (toMax < minDepth)
+			{
+				minDepth = toMax;
+				normal = {};
+				SetAxis(normal, axis, 1.0f);
+			}
+		}
+		return normal;
+	}
+
+	/// <summary>
+	/// 頂点番号 (ビットが立っている軸はmax) の座標
+	/// </summary>
+	Vector3 Corner(const AABB& _aabb, uint32_t _corner)
+	{
+		return {
+			(_corner & 1) ? _aabb.max.x : _aabb.min.x,
+			(_corner & 2) ? _aabb.max.y : _aabb.min.y,
+			(_corner & 4) ? _aabb.max.z : _aabb.min.z
+		};
+	}
+
+	/// <summary>
+	/// 移動する点と半径だけ広げたAABBの交差時刻 (AABB同士の線分判定と同じスラブ法)
+	/// </summary>
+	bool IntersectExpandedAABB(const Vector3& _origin, const Vector3& _diff, const AABB& _aabb, float _radius, float& _t)
+	{
+		float tmin = 0.0f;
+		float tmax = 1.0f;
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			float origin = GetAxis(_origin, axis);
+			float diff = GetAxis(_diff, axis);
+			float min = GetAxis(_aabb.min, axis) - _radius;
+			float max = GetAxis(_aabb.max, axis) + _radius;
+			if (std::abs(diff) < kEpsilon)
+			{
+				if (origin < min || max < origin)
+				{
+					return false;
+				}
+				continue;
+			}
+			float inverse = 1.0f / diff;
+			float t1 = (min - origin) * inverse;
+			float t2 = (max - origin) * inverse;
+			tmin = (std::max)(tmin, (std::min)(t1, t2));
+			tmax = (std::min)(tmax, (std::max)(t1, t2));
+			if (tmax < tmin)
+			{
+				return false;
+			}
+		}
+		_t = tmin;
+		return true;
+	}
+
+	/// <summary>
+	/// ローカル空間のAABBとの衝突時刻 AABBとOBBで共通
+	/// </summary>
+	bool SweepSphereAABB(const Vector3& _center, const Vector3& _displacement, float _radius, const AABB& _aabb, ImpactResult& _result)
+	{
+		Vector3 closest = Clamp(_center, _aabb);
+		if (Dot(closest - _center, closest - _center) <= _radius * _radius)
+		{
+			_result.t = 0.0f;
+			_result.normal = CalculateNormal(_center, _aabb);
+			_result.point = closest;
+			return true;
+		}
+
+		float t;
+		if (!IntersectExpandedAABB(_center, _displacement, _aabb, _radius, t))
+		{
+			return false;
+		}
+
+		//広げた箱に当たった点が元の箱のどの軸の外側にあるか
+		Vector3 point = _center + _displacement * t;
+		uint32_t belowMask = 0;
+		uint32_t aboveMask = 0;
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			if (GetAxis(point, axis) < GetAxis(_aabb.min, axis))
+			{
+				belowMask |= 1 << axis;
+			}
+			if (GetAxis(_aabb.max, axis) < GetAxis(point, axis))
+			{
+				aboveMask |= 1 << axis;
+			}
+		}
+		uint32_t outsideMask = belowMask | aboveMask;
+		uint32_t outsideCount = (outsideMask & 1) + ((outsideMask >> 1) & 1) + ((outsideMask >> 2) & 1);
+
+		if (2 <= outsideCount)
+		{
+			//辺か頂点の領域では広げた箱の角は丸いので，辺のカプセルで調べ直す
+			//頂点領域ならその頂点から出る3辺，辺領域ならその1辺
+			uint32_t corner = aboveMask;
+			float bestT = FLT_MAX;
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				uint32_t bit = 1u << axis;
+				if (outsideCount == 2 && (outsideMask & bit))
+				{
+					continue;
+				}
+				float edgeT;
+				if (IntersectCapsule(_center, _displacement, Corner(_aabb, corner & ~bit), Corner(_aabb, corner | bit), _radius, edgeT))
+				{
+					bestT = (std::min)(bestT, edgeT);
+				}
+			}
+			if (bestT == FLT_MAX)
+			{
+				return false;
+			}
+			t = bestT;
+		}
+
+		Vector3 center = _center + _displacement * t;
+		_result.t = t;
+		_result.point = Clamp(center, _aabb);
+		_result.normal = Normalize(center - _result.point);
+		return true;
+	}
+
+	/// <summary>
+	/// 平行移動する2線分間の距離 - 半径の和
+	/// </summary>
+	float CalculateSeparation(const SweptCapsule& _a, const SweptCapsule& _b, float _t, Vector3& _pointA, Vector3& _pointB)
+	{
+		Segment a = _a.capsule.segment;
+		Segment b = _b.capsule.segment;
+		a.origin += _a.displacement * _t;
+		b.origin += _b.displacement * _t;
+		ClosestPoints(a, b, _pointA, _pointB);
+		return Length(_pointA - _pointB) - (_a.capsule.radius + _b.capsule.radius);
+	}
+}
+
+AABB CalculateSweptBounds(const SweptSphere& _swept)
+{
+	Vector3 start = _swept.sphere.center;
+	Vector3 end = _swept.sphere.center + _swept.displacement;
+	Vector3 extent = { _swept.sphere.radius, _swept.sphere.radius, _swept.sphere.radius };
+	return {
+		Vector3{ (std::min)(start.x, end.x), (std::min)(start.y, end.y), (std::min)(start.z, end.z) } - extent,
+		Vector3{ (std::max)(start.x, end.x), (std::max)(start.y, end.y), (std::max)(start.z, end.z) } + extent
+	};
+}
+
+AABB CalculateSweptBounds(const SweptCapsule& _swept)
+{
+	//線分の両端の移動範囲を合わせたもの
+	const Segment& segment = _swept.capsule.segment;
+	AABB start = CalculateSweptBounds(SweptSphere{ { segment.origin, _swept.capsule.radius }, _swept.displacement });
+	AABB end = CalculateSweptBounds(SweptSphere{ { segment.origin + segment.diff, _swept.capsule.radius }, _swept.displacement });
+	return {
+		{ (std::min)(start.min.x, end.min.x), (std::min)(start.min.y, end.min.y), (std::min)(start.min.z, end.min.z) },
+		{ (std::max)(start.max.x, end.max.x), (std::max)(start.max.y, end.max.y), (std::max)(start.max.z, end.max.z) }
+	};
+}
+
+bool CalculateTimeOfImpact(const SweptSphere& _swept, const Plane& _plane, ImpactResult& _result)
+{
+	const Sphere& sphere = _swept.sphere;
+	float distance = Dot(_plane.normal, sphere.center) - _plane.distance;
+	//球のいる側の法線
+	Vector3 normal = distance < 0.0f ? -_plane.normal : _plane.normal;
+	if (std::abs(distance) <= sphere.radius)
+	{
+		_result.t = 0.0f;
+		_result.normal = normal;
+		_result.point = sphere.center - _plane.normal * distance;
+		return true;
+	}
+
+	//平面へ近づく速さ
+	float approach = -Dot(normal, _swept.displacement);
+	float gap = std::abs(distance) - sphere.radius;
+	if (approach <= 0.0f || approach < gap)
+	{
+		return false;
+	}
+	_result.t = gap / approach;
+	_result.normal = normal;
+	_result.point = sphere.center + _swept.displacement * _result.t - normal * sphere.radius;
+	return true;
+}
+
+bool CalculateTimeOfImpact(const SweptSphere& _swept, const Triangle& _triangle, ImpactResult& _result)
+{
+	const Sphere& sphere = _swept.sphere;
+	Vector3 closest = ClosestPoint(sphere.center, _triangle);
+	if (Dot(closest - sphere.center, closest - sphere.center) <= sphere.radius * sphere.radius)
+	{
+		Plane plane = CalculatePlane(_triangle);
+		Vector3 normal = Normalize(sphere.center - closest);
+		if (Length(normal) == 0.0f)
+		{
+			//中心が三角形上にあるときは進んでくる側を表にする
+			normal = Dot(plane.normal, _swept.displacement) <= 0.0f ? plane.normal : -plane.normal;
+		}
+		_result.t = 0.0f;
+		_result.normal = normal;
+		_result.point = closest;
+		return true;
+	}
+
+	float bestT = FLT_MAX;
+
+	//面の内側に接する時刻
+	Plane plane = CalculatePlane(_triangle);
+	ImpactResult planeResult{};
+	if (CalculateTimeOfImpact(_swept, plane, planeResult) && 0.0f < planeResult.t)
+	{
+		//接触点が三角形の内側なら最近点は接触点のまま
+		Vector3 contact = planeResult.point;
+		Vector3 onTriangle = ClosestPoint(contact, _triangle);
+		if (Dot(onTriangle - contact, onTriangle - contact) <= kEpsilon * Dot(_triangle.vertices[1] - _triangle.vertices[0], _triangle.vertices[1] - _triangle.vertices[0]))
+		{
+			bestT = planeResult.t;
+		}
+	}
+
+	//辺と頂点はカプセルとして調べる
+	if (bestT == FLT_MAX)
+	{
+		for (uint32_t edge = 0; edge < 3; edge++)
+		{
+			float t;
+			if (IntersectCapsule(sphere.center, _swept.displacement, _triangle.vertices[edge], _triangle.vertices[(edge + 1) % 3], sphere.radius, t))
+			{
+				bestT = (std::min)(bestT, t);
+			}
+		}
+	}
+	if (bestT == FLT_MAX)
+	{
+		return false;
+	}
+
+	Vector3 center = sphere.center + _swept.displacement * bestT;
+	_result.t = bestT;
+	_result.point = ClosestPoint(center, _triangle);
+	_result.normal = Normalize(center - _result.point);
+	return true;
+}
+
+bool CalculateTimeOfImpact(const SweptSphere& _swept, const AABB& _aabb, ImpactResult& _result)
+{
+	return SweepSphereAABB(_swept.sphere.center, _swept.displacement, _swept.sphere.radius, _aabb, _result);
+}
+
+bool CalculateTimeOfImpact(const SweptSphere& _swept, const OBB& _obb, ImpactResult& _result)
+{
+	//obbの座標軸で表したローカル空間へ移す
+	Vector3 offset = _swept.sphere.center - _obb.center;
+	Vector3 localCenter{};
+	Vector3 localDisplacement{};
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		SetAxis(localCenter, axis, Dot(offset, _obb.orientations[axis]));
+		SetAxis(localDisplacement, axis, Dot(_swept.displacement, _obb.orientations[axis]));
+	}
+	AABB localBounds = { -_obb.size, _obb.size };
+	if (!SweepSphereAABB(localCenter, localDisplacement, _swept.sphere.radius, localBounds, _result))
+	{
+		return false;
+	}
+
+	Vector3 normal = _obb.orientations[0] * _result.normal.x + _obb.orientations[1] * _result.normal.y + _obb.orientations[2] * _result.normal.z;
+	Vector3 point = _obb.center + _obb.orientations[0] * _result.point.x + _obb.orientations[1] * _result.point.y + _obb.orientations[2] * _result.point.z;
+	_result.normal = normal;
+	_result.point = point;
+	return true;
+}
+
+bool CalculateTimeOfImpact(const SweptSphere& _a, const SweptSphere& _b, ImpactResult& _result)
+{
+	//_bから見た相対移動で，半径の和の球に点が入る時刻
+	Vector3 relative = _a.displacement - _b.displacement;
+	float t;
+	if (!IntersectSphere(_a.sphere.center, relative, _b.sphere.center, _a.sphere.radius + _b.sphere.radius, t))
+	{
+		return false;
+	}
+	Vector3 centerA = _a.sphere.center + _a.displacement * t;
+	Vector3 centerB = _b.sphere.center + _b.displacement * t;
+	_result.t = t;
+	_result.normal = Normalize(centerA - centerB);
+	_result.point = centerB + _result.normal * _b.sphere.radius;
+	return true;
+}
+
+bool CalculateTimeOfImpact(const SweptCapsule& _a, const SweptCapsule& _b, ImpactResult& _result)
+{
+	Vector3 pointA;
+	Vector3 pointB;
+	float t = 0.0f;
+	if (0.0f < CalculateSeparation(_a, _b, 0.0f, pointA, pointB))
+	{
+		//距離は下に凸なので，最小になる時刻を黄金分割探索で求める
+		const float kGolden = 0.618034f;
+		float low = 0.0f;
+		float high = 1.0f;
+		float middleLow = high - (high - low) * kGolden;
+		float middleHigh = low + (high - low) * kGolden;
+		float separationLow = CalculateSeparation(_a, _b, middleLow, pointA, pointB);
+		float separationHigh = CalculateSeparation(_a, _b, middleHigh, pointA, pointB);
+		for (uint32_t iteration = 0; iteration < kMinimumSearchIterations; iteration++)
+		{
+			if (separationLow < separationHigh)
+			{
+				high = middleHigh;
+				middleHigh = middleLow;
+				separationHigh = separationLow;
+				middleLow = high - (high - low) * kGolden;
+				separationLow = CalculateSeparation(_a, _b, middleLow, pointA, pointB);
+			}
+			else
+			{
+				low = middleLow;
+				middleLow = middleHigh;
+				separationLow = separationHigh;
+				middleHigh = low + (high - low) * kGolden;
+				separationHigh = CalculateSeparation(_a, _b, middleHigh, pointA, pointB);
+			}
+		}
+		//端で最小になる場合は探索区間に入らないので端も調べる
+		float minimumT = separationLow < separationHigh ? middleLow : middleHigh;
+		if (0.0f < (std::min)(separationLow, separationHigh))
+		{
+			minimumT = 1.0f;
+			if (0.0f < CalculateSeparation(_a, _b, 1.0f, pointA, pointB))
+			{
+				return false;
+			}
+		}
+
+		//最小までは単調に減るので，離れている時刻を下限にして二分探索する
+		float separated = 0.0f;
+		float touching = minimumT;
+		for (uint32_t iteration = 0; iteration < kRootSearchIterations; iteration++)
+		{
+			float middle = (separated + touching) * 0.5f;
+			if (0.0f < CalculateSeparation(_a, _b, middle, pointA, pointB))
+			{
+				separated = middle;
+			}
+			else
+			{
+				touching = middle;
+			}
+		}
+		t = separated;
+	}
+
+	CalculateSeparation(_a, _b, t, pointA, pointB);
+	Vector3 normal = Normalize(pointA - pointB);
+	if (Length(normal) == 0.0f)
+	{
+		//軸が交差しているときは相対移動の逆向きにする
+		normal = Normalize(_b.displacement - _a.displacement);
+	}
+	_result.t = t;
+	_result.normal = normal;
+	_result.point = pointB + normal * _b.capsule.radius;
+	return true;
+}
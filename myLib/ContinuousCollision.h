@@ -0,0 +1,102 @@
+#pragma once
+#include "MyLib.h"
+#include "SweepAndPrune.h"
+
+/// <summary>
+/// 1ステップの間に_displacementだけ平行移動する球
+/// </summary>
+struct SweptSphere
+{
+	Sphere sphere;			//ステップ開始時の球
+	Vector3 displacement;	//ステップ中の移動量 (速度 * 経過時間)
+};
+
+/// <summary>
+/// 1ステップの間に_displacementだけ平行移動するカプセル
+/// </summary>
+struct SweptCapsule
+{
+	Capsule capsule;		//ステップ開始時のカプセル
+	Vector3 displacement;	//ステップ中の移動量
+};
+
+/// <summary>
+/// 衝突時刻の結果
+/// </summary>
+struct ImpactResult
+{
+	float t;			//移動量に対する割合 [0,1] 開始時に重なっていれば0
+	Vector3 normal;		//相手からこちらへ向かう接触法線
+	Vector3 point;		//時刻tでの接触点 (相手の表面上)
+};
+
+/// <summary>
+/// 移動範囲全体を囲むAABB
+/// ブロードフェーズ (SweepAndPrune, BVH) へはこれを登録すると速い物体もすり抜けずに組が見つかる
+/// </summary>
+AABB CalculateSweptBounds(const SweptSphere& _swept);
+AABB CalculateSweptBounds(const SweptCapsule& _swept);
+
+//移動する球と平面の衝突時刻 平面は両面
+bool CalculateTimeOfImpact(const SweptSphere& _swept, const Plane& _plane, ImpactResult& _result);
+
+//移動する球と三角形の衝突時刻 面・辺・頂点のうち最も早いもの
+bool CalculateTimeOfImpact(const SweptSphere& _swept, const Triangle& _triangle, ImpactResult& _result);
+
+//移動する球とAABBの衝突時刻 AABBを半径だけ広げた箱との交差から面・辺・頂点を判別する
+bool CalculateTimeOfImpact(const SweptSphere& _swept, const AABB& _aabb, ImpactResult& _result);
+
+//移動する球とobbの衝突時刻 obbのローカル空間でAABBとして判定する
+bool CalculateTimeOfImpact(const SweptSphere& _swept, const OBB& _obb, ImpactResult& _result);
+
+//移動する球同士の衝突時刻
+bool CalculateTimeOfImpact(const SweptSphere& _a, const SweptSphere& _b, ImpactResult& _result);
+
+/// <summary>
+/// 移動するカプセル同士の衝突時刻
+/// 平行移動だけなら線分間の距離は時刻について下に凸なので，最小になる時刻を求めてからその手前で二分探索する
+/// 返す時刻は接触の直前 (まだ重なっていない側) になる
+/// </summary>
+bool CalculateTimeOfImpact(const SweptCapsule& _a, const SweptCapsule& _b, ImpactResult& _result);
+
+/// <summary>
+/// 引数の順番を気にせず衝突時刻を求める 逆順で呼んだときは法線を反転する
+/// 接触点は接している2つの表面で同じ点になるのでそのまま使える
+/// </summary>
+template <class ShapeA, class ShapeB>
+bool CalculateTimeOfImpactAnyOrder(const ShapeA& _a, const ShapeB& _b, ImpactResult& _result)
+{
+	if constexpr (requires { CalculateTimeOfImpact(_a, _b, _result); })
+	{
+		return CalculateTimeOfImpact(_a, _b, _result);
+	}
+	else
+	{
+		if (!CalculateTimeOfImpact(_b, _a, _result))
+		{
+			return false;
+		}
+		_result.normal = -_result.normal;
+		return true;
+	}
+}
+
+/// <summary>
+/// 移動範囲のAABBで見つかった組の衝突時刻をまとめて求める
+/// CollidePairsの連続判定版 プロキシにはCalculateSweptBoundsの結果を登録しておく
+/// </summary>
+/// <param name="_shapesA">_groupAのプロキシのユーザー番号で引ける形状の配列 (SweptSphere, AABB, OBB など)</param>
+/// <param name="_shapesB">_groupBのプロキシのユーザー番号で引ける形状の配列</param>
+/// <param name="_func">void(const ProxyPair&, const ImpactResult&) 移動中に衝突する組ごとに呼ぶ</param>
+template <class ShapeA, class ShapeB, class Func>
+void SweepPairs(const SweepAndPrune& _broadPhase, uint32_t _groupA, const ShapeA* _shapesA, uint32_t _groupB, const ShapeB* _shapesB, const Func& _func)
+{
+	ImpactResult result{};
+	for (const ProxyPair& pair : _broadPhase.GetPairs(_groupA, _groupB))
+	{
+		if (CalculateTimeOfImpactAnyOrder(_shapesA[_broadPhase.GetUserIndex(pair.proxyA)], _shapesB[_broadPhase.GetUserIndex(pair.proxyB)], result))
+		{
+			_func(pair, result);
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#include "FrameClock.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	//表示用のフレームレートを平滑化する割合
+	const float kSmoothingFactor = 0.1f;
+}
+
+FrameClock::FrameClock(float _maxFrameTime) :
+	previousTime(std::chrono::steady_clock::now()),
+	maxFrameTime(_maxFrameTime),
+	timeScale(1.0f),
+	rawDeltaTime(0.0f),
+	unscaledDeltaTime(0.0f),
+	smoothedDeltaTime(0.0f)
+{
+	assert(0.0f < _maxFrameTime);
+}
+
+void FrameClock::Tick()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	rawDeltaTime = std::chrono::duration<float>(now - previousTime).count();
+	previousTime = now;
+
+	//ブレークポイントやウィンドウのドラッグで止まっていた分を一度に進めない
+	unscaledDeltaTime = (std::min)(rawDeltaTime, maxFrameTime);
+	smoothedDeltaTime = smoothedDeltaTime == 0.0f ? unscaledDeltaTime : smoothedDeltaTime + (unscaledDeltaTime - smoothedDeltaTime) * kSmoothingFactor;
+}
+
+void FrameClock::SetTimeScale(float _timeScale)
+{
+	assert(0.0f <= _timeScale);
+	timeScale = _timeScale;
+}
+
+FixedTimestep::FixedTimestep(float _tickRate, uint32_t _maxStepsPerFrame) :
+	accumulatedTime(0.0f),
+	maxStepsPerFrame(_maxStepsPerFrame),
+	droppedSteps(0)
+{
+	assert(0 < _maxStepsPerFrame);
+	SetTickRate(_tickRate);
+}
+
+uint32_t FixedTimestep::Advance(float _deltaTime)
+{
+	accumulatedTime += _deltaTime;
+	uint32_t stepCount = static_cast<uint32_t>(accumulatedTime / stepTime);
+	accumulatedTime -= float(stepCount) * stepTime;
+	//誤差で負や1ステップ分を超えないように
+	accumulatedTime = std::clamp(accumulatedTime, 0.0f, stepTime * 0.9999f);
+
+	//更新が重くて追いつかないときにステップ数が増え続けないよう，上限を超えた分は捨てる
+	if (maxStepsPerFrame < stepCount)
+	{
+		droppedSteps += stepCount - maxStepsPerFrame;
+		stepCount = maxStepsPerFrame;
+	}
+	return stepCount;
+}
+
+void FixedTimestep::SetTickRate(float _tickRate)
+{
+	assert(0.0f < _tickRate);
+	stepTime = 1.0f / _tickRate;
+	accumulatedTime = (std::min)(accumulatedTime, stepTime * 0.9999f);
+}
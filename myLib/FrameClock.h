@@ -0,0 +1,94 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+/// <summary>
+/// フレーム間の経過時間を高精度タイマーで測る
+/// 止まっていた後などに大きな経過時間がそのまま流れないよう上限で抑える
+/// </summary>
+class FrameClock
+{
+public:
+	/// <param name="_maxFrameTime">1フレームとして扱う経過時間の上限 (秒)</param>
+	explicit FrameClock(float _maxFrameTime = 0.25f);
+
+	/// <summary>
+	/// 前回のTickからの経過時間を測る 毎フレーム1回呼ぶ
+	/// </summary>
+	void Tick();
+
+	/// <summary>
+	/// 時間倍率をかけた経過時間 シミュレーションにはこれを渡す
+	/// </summary>
+	float GetDeltaTime() const { return unscaledDeltaTime * timeScale; }
+	/// <summary>
+	/// 時間倍率をかけない経過時間 (上限で抑えたもの)
+	/// </summary>
+	float GetUnscaledDeltaTime() const { return unscaledDeltaTime; }
+	/// <summary>
+	/// 実際に測った経過時間 (上限で抑える前)
+	/// </summary>
+	float GetRawDeltaTime() const { return rawDeltaTime; }
+	/// <summary>
+	/// 経過時間の指数移動平均から求めたフレームレート (表示用)
+	/// </summary>
+	float GetFramesPerSecond() const { return 0.0f < smoothedDeltaTime ? 1.0f / smoothedDeltaTime : 0.0f; }
+
+	/// <summary>
+	/// 時間倍率 0で一時停止，1未満でスロー
+	/// </summary>
+	void SetTimeScale(float _timeScale);
+	float GetTimeScale() const { return timeScale; }
+	void SetMaxFrameTime(float _maxFrameTime) { maxFrameTime = _maxFrameTime; }
+
+private:
+	std::chrono::steady_clock::time_point previousTime;
+	float maxFrameTime;
+	float timeScale;
+	float rawDeltaTime;
+	float unscaledDeltaTime;
+	float smoothedDeltaTime;
+};
+
+/// <summary>
+/// 固定ステップでの進行 サブシステムごとに持ち，それぞれの更新頻度で回す
+/// 経過時間を貯めて1ステップ分たまるごとに更新させ，余りは描画の補間に使う
+/// </summary>
+class FixedTimestep
+{
+public:
+	/// <param name="_tickRate">1秒あたりの更新回数</param>
+	/// <param name="_maxStepsPerFrame">1フレームで回す最大ステップ数 超えた分は捨てて処理落ち (スロー) にする</param>
+	FixedTimestep(float _tickRate, uint32_t _maxStepsPerFrame);
+
+	/// <summary>
+	/// 経過時間を貯め，このフレームで回すステップ数を返す
+	/// </summary>
+	/// <param name="_deltaTime">経過時間 (FrameClock::GetDeltaTime)</param>
+	uint32_t Advance(float _deltaTime);
+
+	/// <summary>
+	/// 1ステップの時間 更新にはこれを渡す
+	/// </summary>
+	float GetStepTime() const { return stepTime; }
+	/// <summary>
+	/// 最後のステップから次のステップまでの進み具合 [0, 1)
+	/// 前回と今回のステップの状態をこの割合で補間して描画する
+	/// </summary>
+	float GetAlpha() const { return accumulatedTime / stepTime; }
+	/// <summary>
+	/// 処理が追いつかず捨てたステップ数の累計
+	/// </summary>
+	uint64_t GetDroppedSteps() const { return droppedSteps; }
+
+	void SetTickRate(float _tickRate);
+	float GetTickRate() const { return 1.0f / stepTime; }
+	void SetMaxStepsPerFrame(uint32_t _maxStepsPerFrame) { maxStepsPerFrame = _maxStepsPerFrame; }
+	uint32_t GetMaxStepsPerFrame() const { return maxStepsPerFrame; }
+
+private:
+	float stepTime;
+	float accumulatedTime;
+	uint32_t maxStepsPerFrame;
+	uint64_t droppedSteps;
+};
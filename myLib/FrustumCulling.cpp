@@ -0,0 +1,201 @@
+#include "FrustumCulling.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <xmmintrin.h>
+
+namespace
+{
+	//並列化の単位 4の倍数にしてチャンクの途中で端数が出ないようにする
+	const uint32_t kChunkSize = 1024;
+
+	/// <summary>
+	/// 1要素分の判定 4つに満たない端数に使う
+	/// </summary>
+	bool IsVisible(const Frustum& _frustum, const MeshBoundsSoA& _bounds, uint32_t _index)
+	{
+		for (const Plane& plane : _frustum.planes)
+		{
+			float distance = plane.normal.x * _bounds.center[0][_index] + plane.normal.y * _bounds.center[1][_index] + plane.normal.z * _bounds.center[2][_index] - plane.distance;
+			float boxRadius = std::fabs(plane.normal.x) * _bounds.extent[0][_index] + std::fabs(plane.normal.y) * _bounds.extent[1][_index] + std::fabs(plane.normal.z) * _bounds.extent[2][_index];
+			if (distance + (std::min)(_bounds.radius[_index], boxRadius) < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+MeshBounds CalculateMeshBounds(const void* _positions, uint32_t _count, uint32_t _stride)
+{
+	assert(0 < _count);
+	const unsigned char* bytes = static_cast<const unsigned char*>(_positions);
+	auto load = [&](uint32_t _index)
+		{
+			Vector3 position;
+			std::memcpy(&position, bytes + size_t(_index) * _stride, sizeof(Vector3));
+			return position;
+		};
+
+	MeshBounds result{};
+	result.aabb.min = load(0);
+	result.aabb.max = result.aabb.min;
+	for (uint32_t index = 1; index < _count; index++)
+	{
+		Vector3 position = load(index);
+		result.aabb.min = { (std::min)(result.aabb.min.x, position.x), (std::min)(result.aabb.min.y, position.y), (std::min)(result.aabb.min.z, position.z) };
+		result.aabb.max = { (std::max)(result.aabb.max.x, position.x), (std::max)(result.aabb.max.y, position.y), (std::max)(result.aabb.max.z, position.z) };
+	}
+
+	//AABBの角までの半径より小さくなることが多いので，実際の頂点までの距離で半径を決める
+	result.sphere.center = (result.aabb.min + result.aabb.max) * 0.5f;
+	float squaredRadius = 0.0f;
+	for (uint32_t index = 0; index < _count; index++)
+	{
+		Vector3 diff = load(index) - result.sphere.center;
+		squaredRadius = (std::max)(squaredRadius, Dot(diff, diff));
+	}
+	result.sphere.radius = std::sqrt(squaredRadius);
+	return result;
+}
+
+MeshBounds TransformMeshBounds(const MeshBounds& _bounds, const Matrix4x4& _world)
+{
+	Vector3 center = (_bounds.aabb.min + _bounds.aabb.max) * 0.5f;
+	Vector3 extent = (_bounds.aabb.max - _bounds.aabb.min) * 0.5f;
+	const float extents[3] = { extent.x, extent.y, extent.z };
+
+	//行ベクトル形式なので各行が軸 半分の大きさを行の絶対値で重ねると移した箱を包む
+	Vector3 worldCenter = Transform(center, _world);
+	Vector3 worldExtent = { 0.0f, 0.0f, 0.0f };
+	float maxScale = 0.0f;
+	for (int row = 0; row < 3; row++)
+	{
+		Vector3 axis = { _world.m[row][0], _world.m[row][1], _world.m[row][2] };
+		worldExtent.x += std::fabs(axis.x) * extents[row];
+		worldExtent.y += std::fabs(axis.y) * extents[row];
+		worldExtent.z += std::fabs(axis.z) * extents[row];
+		maxScale = (std::max)(maxScale, Length(axis));
+	}
+
+	MeshBounds result{};
+	result.aabb.min = worldCenter - worldExtent;
+	result.aabb.max = worldCenter + worldExtent;
+	result.sphere.center = Transform(_bounds.sphere.center, _world);
+	result.sphere.radius = _bounds.sphere.radius * maxScale;
+	return result;
+}
+
+void MeshBoundsSoA::Push(const MeshBounds& _bounds)
+{
+	//カリングでは中心を共有するのでAABBの中心を使う
+	Vector3 boxCenter = (_bounds.aabb.min + _bounds.aabb.max) * 0.5f;
+	Vector3 boxExtent = (_bounds.aabb.max - _bounds.aabb.min) * 0.5f;
+	center[0].push_back(boxCenter.x);
+	center[1].push_back(boxCenter.y);
+	center[2].push_back(boxCenter.z);
+	radius.push_back(_bounds.sphere.radius);
+	extent[0].push_back(boxExtent.x);
+	extent[1].push_back(boxExtent.y);
+	extent[2].push_back(boxExtent.z);
+}
+
+void MeshBoundsSoA::Clear()
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		center[axis].clear();
+		extent[axis].clear();
+	}
+	radius.clear();
+}
+
+FrustumCuller::FrustumCuller(ThreadPool* _threadPool) :
+	threadPool(_threadPool),
+	stats{}
+{
+}
+
+void FrustumCuller::Cull(const Frustum& _frustum, const MeshBoundsSoA& _bounds, std::vector<uint32_t>& _visible)
+{
+	const uint32_t count = _bounds.GetCount();
+	const uint32_t chunkCount = (count + kChunkSize - 1) / kChunkSize;
+	chunkVisible.resize(chunkCount);
+
+	auto cullChunk = [&](uint32_t _chunk)
+		{
+			std::vector<uint32_t>& output = chunkVisible[_chunk];
+			output.clear();
+			const uint32_t begin = _chunk * kChunkSize;
+			const uint32_t end = (std::min)(begin + kChunkSize, count);
+			const __m128 zero = _mm_setzero_ps();
+
+			uint32_t index = begin;
+			for (; index + 4 <= end; index += 4)
+			{
+				__m128 centerX = _mm_loadu_ps(&_bounds.center[0][index]);
+				__m128 centerY = _mm_loadu_ps(&_bounds.center[1][index]);
+				__m128 centerZ = _mm_loadu_ps(&_bounds.center[2][index]);
+				__m128 radius = _mm_loadu_ps(&_bounds.radius[index]);
+				__m128 extentX = _mm_loadu_ps(&_bounds.extent[0][index]);
+				__m128 extentY = _mm_loadu_ps(&_bounds.extent[1][index]);
+				__m128 extentZ = _mm_loadu_ps(&_bounds.extent[2][index]);
+
+				//外側に出ている組のビットが立つ
+				__m128 outside = zero;
+				for (const Plane& plane : _frustum.planes)
+				{
+					__m128 distance = _mm_sub_ps(
+						_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.normal.x), centerX), _mm_mul_ps(_mm_set1_ps(plane.normal.y), centerY)), _mm_mul_ps(_mm_set1_ps(plane.normal.z), centerZ)),
+						_mm_set1_ps(plane.distance));
+					__m128 boxRadius = _mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(_mm_set1_ps(std::fabs(plane.normal.x)), extentX),
+						_mm_mul_ps(_mm_set1_ps(std::fabs(plane.normal.y)), extentY)),
+						_mm_mul_ps(_mm_set1_ps(std::fabs(plane.normal.z)), extentZ));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, _mm_min_ps(radius, boxRadius)), zero));
+				}
+
+				int mask = ~_mm_movemask_ps(outside) & 0xF;
+				while (mask != 0)
+				{
+					int lane = 0;
+					while ((mask & (1 << lane)) == 0)
+					{
+						lane++;
+					}
+					output.push_back(index + lane);
+					mask &= mask - 1;
+				}
+			}
+			for (; index < end; index++)
+			{
+				if (IsVisible(_frustum, _bounds, index))
+				{
+					output.push_back(index);
+				}
+			}
+		};
+
+	if (threadPool != nullptr && 1 < chunkCount)
+	{
+		threadPool->ParallelFor(chunkCount, cullChunk);
+	}
+	else
+	{
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			cullChunk(chunk);
+		}
+	}
+
+	_visible.clear();
+	for (const std::vector<uint32_t>& chunk : chunkVisible)
+	{
+		_visible.insert(_visible.end(), chunk.begin(), chunk.end());
+	}
+	stats.tested = count;
+	stats.visible = static_cast<uint32_t>(_visible.size());
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "MyLib.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/// <summary>
+/// メッシュの境界 球の中心はAABBの中心にそろえる
+/// ワールドへ移しても中心が一致したままなので，カリングでは中心を共有して両方を判定できる
+/// </summary>
+struct MeshBounds
+{
+	Sphere sphere;
+	AABB aabb;
+};
+
+/// <summary>
+/// 頂点位置から境界を求める 読み込み時に一度だけ呼ぶ
+/// </summary>
+/// <param name="_positions">先頭の頂点のx座標 (x, y, zが並んでいること)</param>
+/// <param name="_count">頂点数</param>
+/// <param name="_stride">頂点間のバイト数</param>
+MeshBounds CalculateMeshBounds(const void* _positions, uint32_t _count, uint32_t _stride);
+
+/// <summary>
+/// 境界をワールド空間へ移す AABBは移した箱を包むもの，球の半径は最大の拡大率で広げる
+/// </summary>
+MeshBounds TransformMeshBounds(const MeshBounds& _bounds, const Matrix4x4& _world);
+
+/// <summary>
+/// カリング対象の境界のSoA 4つずつまとめて判定する
+/// </summary>
+struct MeshBoundsSoA
+{
+	std::vector<float> center[3];	//x y z
+	std::vector<float> radius;
+	std::vector<float> extent[3];	//AABBの半分の大きさ
+
+public:
+	void Push(const MeshBounds& _bounds);
+	void Clear();
+	uint32_t GetCount() const { return static_cast<uint32_t>(radius.size()); }
+};
+
+/// <summary>
+/// カリングの統計 (デバッグ表示用)
+/// </summary>
+struct CullingStats
+{
+	uint32_t tested;	//判定した数
+	uint32_t visible;	//視錐台に入っていた数
+};
+
+/// <summary>
+/// 視錐台カリング
+/// 球かAABBのどちらかが1つの平面の外側に完全に出ていれば見えないものとする
+/// </summary>
+class FrustumCuller
+{
+public:
+	/// <param name="_threadPool">並列化に使う nullptrなら単一スレッド</param>
+	explicit FrustumCuller(ThreadPool* _threadPool);
+
+	/// <summary>
+	/// 視錐台に一部でも入っている要素の番号を昇順に集める
+	/// </summary>
+	/// <param name="_visible">出力先 (クリアしてから詰める)</param>
+	void Cull(const Frustum& _frustum, const MeshBoundsSoA& _bounds, std::vector<uint32_t>& _visible);
+
+	const CullingStats& GetStats() const { return stats; }
+
+private:
+	ThreadPool* threadPool;
+	std::vector<std::vector<uint32_t>> chunkVisible;	//チャンクごとの結果
+	CullingStats stats;
+};
@@ -0,0 +1,659 @@
+#include "GJK.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+namespace
+{
+	//これ以下の距離の2乗は原点に触れているとみなす
+	const float kIntersectEpsilon = 1.0e-10f;
+	//距離の下限と上限の差がこの割合を下回ったら収束とみなす
+	const float kRelativeTolerance = 1.0e-6f;
+	const uint32_t kMaxIterations = 32;
+	//体積が辺の長さの積のこの割合以下の四面体は平らとみなす
+	const float kFlatTolerance = 1.0e-5f;
+
+	//EPAの打ち切り 曲面の形状は多面体で近似するので許容誤差で止める
+	const float kEPATolerance = 1.0e-4f;
+	const uint32_t kMaxEPAIterations = 64;
+	const uint32_t kMaxEPAVertices = 64;
+	const uint32_t kMaxEPAFaces = 128;
+	const uint32_t kMaxEPAEdges = 64;
+	const float kEPAVisibleEpsilon = 1.0e-6f;
+
+	SimplexVertex CalculateVertex(const SupportFunction& _a, const SupportFunction& _b, const Vector3& _direction)
+	{
+		SimplexVertex vertex;
+		vertex.supportA = _a(_direction);
+		vertex.supportB = _b(-_direction);
+		vertex.point = vertex.supportA - vertex.supportB;
+		vertex.direction = _direction;
+		return vertex;
+	}
+
+	/// <summary>
+	/// 重みが0の頂点を取り除いて前に詰める
+	/// </summary>
+	void Compact(Simplex& _simplex, float* _weights)
+	{
+		uint32_t count = 0;
+		for (uint32_t index = 0; index < _simplex.count; index++)
+		{
+			if (0.0f < _weights[index])
+			{
+				_simplex.vertices[count] = _simplex.vertices[index];
+				_weights[count] = _weights[index];
+				count++;
+			}
+		}
+		_simplex.count = count;
+	}
+
+	/// <summary>
+	/// 線分上の原点の最近点の重み
+	/// </summary>
+	void ClosestOnSegment(const Vector3& _a, const Vector3& _b, float* _weights)
+	{
+		Vector3 ab = _b - _a;
+		float lengthSquared = Dot(ab, ab);
+		float t = kIntersectEpsilon < lengthSquared ? -Dot(_a, ab) / lengthSquared : 0.0f;
+		t = std::clamp(t, 0.0f, 1.0f);
+		_weights[0] = 1.0f - t;
+		_weights[1] = t;
+	}
+
+	/// <summary>
+	/// 三角形上の原点の最近点の重み (領域ごとに場合分け)
+	/// </summary>
+	void ClosestOnTriangle(const Vector3& _a, const Vector3& _b, const Vector3& _c, float* _weights)
+	{
+		_weights[0] = _weights[1] = _weights[2] = 0.0f;
+		Vector3 ab = _b - _a;
+		Vector3 ac = _c - _a;
+		Vector3 ap = -_a;
+		float d1 = Dot(ab, ap);
+		float d2 = Dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+		{
+			_weights[0] = 1.0f;
+			return;
+		}
+		Vector3 bp = -_b;
+		float d3 = Dot(ab, bp);
+		float d4 = Dot(ac, bp);
+		if (0.0f <= d3 && d4 <= d3)
+		{
+			_weights[1] = 1.0f;
+			return;
+		}
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && 0.0f <= d1 && d3 <= 0.0f)
+		{
+			float t = d1 / (d1 - d3);
+			_weights[0] = 1.0f - t;
+			_weights[1] = t;
+			return;
+		}
+		Vector3 cp = -_c;
+		float d5 = Dot(ab, cp);
+		float d6 = Dot(ac, cp);
+		if (0.0f <= d6 && d5 <= d6)
+		{
+			_weights[2] = 1.0f;
+			return;
+		}
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && 0.0f <= d2 && d6 <= 0.0f)
+		{
+			float t = d2 / (d2 - d6);
+			_weights[0] = 1.0f - t;
+			_weights[2] = t;
+			return;
+		}
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && 0.0f <= d4 - d3 && 0.0f <= d5 - d6)
+		{
+			float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			_weights[1] = 1.0f - t;
+			_weights[2] = t;
+			return;
+		}
+		float sum = va + vb + vc;
+		if (sum <= 0.0f)
+		{
+			//つぶれた三角形は辺で代用する
+			ClosestOnSegment(_a, _b, _weights);
+			return;
+		}
+		_weights[0] = va / sum;
+		_weights[1] = vb / sum;
+		_weights[2] = vc / sum;
+	}
+
+	/// <summary>
+	/// 単体上の原点の最近点を求め，最近点に関わらない頂点を取り除く
+	/// </summary>
+	/// <returns>最近点</returns>
+	Vector3 ReduceSimplex(Simplex& _simplex, float* _weights)
+	{
+		SimplexVertex* vertices = _simplex.vertices;
+		switch (_simplex.count)
+		{
+		case 1:
+			_weights[0] = 1.0f;
+			break;
+		case 2:
+			ClosestOnSegment(vertices[0].point, vertices[1].point, _weights);
+			break;
+		case 3:
+			ClosestOnTriangle(vertices[0].point, vertices[1].point, vertices[2].point, _weights);
+			break;
+		case 4:
+		{
+			//原点が外側にある面のうち最も近いもの どの面の外側でもなければ内側
+			static const uint32_t kFaces[4][4] = { { 0, 1, 2, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 1, 3, 2, 0 } };
+			//平らな四面体は面の向きの判定が丸め誤差で決まってしまうので，すべての面を調べる
+			Vector3 edges[3] = { vertices[1].point - vertices[0].point, vertices[2].point - vertices[0].point, vertices[3].point - vertices[0].point };
+			float volume = Dot(edges[0], Cross(edges[1], edges[2]));
+			bool isFlat = std::abs(volume) <= kFlatTolerance * Length(edges[0]) * Length(edges[1]) * Length(edges[2]);
+			float bestDistance = FLT_MAX;
+			float bestWeights[4] = {};
+			bool isInside = true;
+			for (const uint32_t* face : kFaces)
+			{
+				const Vector3& a = vertices[face[0]].point;
+				const Vector3& b = vertices[face[1]].point;
+				const Vector3& c = vertices[face[2]].point;
+				Vector3 normal = Cross(b - a, c - a);
+				float originSide = Dot(-a, normal);
+				float oppositeSide = Dot(vertices[face[3]].point - a, normal);
+				if (!isFlat && 0.0f <= originSide * oppositeSide)
+				{
+					continue;
+				}
+				isInside = false;
+				float faceWeights[3];
+				ClosestOnTriangle(a, b, c, faceWeights);
+				Vector3 closest = a * faceWeights[0] + b * faceWeights[1] + c * faceWeights[2];
+				float distance = Dot(closest, closest);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestWeights[face[0]] = faceWeights[0];
+					bestWeights[face[1]] = faceWeights[1];
+					bestWeights[face[2]] = faceWeights[2];
+					bestWeights[face[3]] = 0.0f;
+				}
+			}
+			if (isInside)
+			{
+				_weights[0] = _weights[1] = _weights[2] = _weights[3] = 0.25f;
+				return {};
+			}
+			std::copy(bestWeights, bestWeights + 4, _weights);
+			break;
+		}
+		default:
+			return {};
+		}
+
+		Compact(_simplex, _weights);
+		Vector3 closest{};
+		for (uint32_t index = 0; index < _simplex.count; index++)
+		{
+			closest += vertices[index].point * _weights[index];
+		}
+		return closest;
+	}
+
+	/// <summary>
+	/// 原点を含む単体を4頂点の四面体に広げる 平らで広げられなければfalse
+	/// </summary>
+	bool ExpandToTetrahedron(const SupportFunction& _a, const SupportFunction& _b, Simplex& _simplex)
+	{
+		static const Vector3 kAxes[3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+		const float kMinSeparation = 1.0e-6f;
+		SimplexVertex* vertices = _simplex.vertices;
+
+		if (_simplex.count == 1)
+		{
+			for (uint32_t axis = 0; axis < 6 && _simplex.count == 1; axis++)
+			{
+				Vector3 direction = axis < 3 ? kAxes[axis] : -kAxes[axis - 3];
+				SimplexVertex vertex = CalculateVertex(_a, _b, direction);
+				if (kMinSeparation < Length(vertex.point - vertices[0].point))
+				{
+					vertices[_simplex.count++] = vertex;
+				}
+			}
+		}
+		if (_simplex.count == 2)
+		{
+			Vector3 line = vertices[1].point - vertices[0].point;
+			for (uint32_t axis = 0; axis < 6 && _simplex.count == 2; axis++)
+			{
+				Vector3 direction = Cross(line, axis < 3 ? kAxes[axis] : -kAxes[axis - 3]);
+				if (Length(direction) == 0.0f)
+				{
+					continue;
+				}
+				SimplexVertex vertex = CalculateVertex(_a, _b, direction);
+				if (kMinSeparation < Length(Cross(vertex.point - vertices[0].point, line)) / Length(line))
+				{
+					vertices[_simplex.count++] = vertex;
+				}
+			}
+		}
+		if (_simplex.count == 3)
+		{
+			Vector3 normal = Normalize(Cross(vertices[1].point - vertices[0].point, vertices[2].point - vertices[0].point));
+			for (float sign : { 1.0f, -1.0f })
+			{
+				SimplexVertex vertex = CalculateVertex(_a, _b, normal * sign);
+				if (kMinSeparation < std::abs(Dot(vertex.point - vertices[0].point, normal)))
+				{
+					vertices[_simplex.count++] = vertex;
+					break;
+				}
+			}
+		}
+		return _simplex.count == 4;
+	}
+
+	enum class CoreState
+	{
+		kIntersect,		//中心の形状どうしが重なっている
+		kNearest,		//離れていて最近点が求まった
+		kSeparated,		//丸みを含めても離れていると分かった時点で打ち切った
+	};
+
+	void CalculateWitnessPoints(const Simplex& _simplex, const float* _weights, Vector3& _pointA, Vector3& _pointB)
+	{
+		for (uint32_t index = 0; index < _simplex.count; index++)
+		{
+			_pointA += _simplex.vertices[index].supportA * _weights[index];
+			_pointB += _simplex.vertices[index].supportB * _weights[index];
+		}
+	}
+
+	/// <summary>
+	/// 丸みを除いた中心の形状どうしでGJKを行う
+	/// </summary>
+	/// <param name="_simplex">開始する単体 頂点があれば探索方向から作り直す 結果の単体を書き戻す</param>
+	/// <param name="_isBooleanOnly">丸みを含めて重なるかだけ分かればよいとき</param>
+	CoreState SolveCore(const SupportFunction& _a, const SupportFunction& _b, Simplex& _simplex, bool _isBooleanOnly, float* _weights, Vector3& _closest, uint32_t& _iterations)
+	{
+		if (0 < _simplex.count)
+		{
+			//前回の探索方向で頂点を作り直す
+			for (uint32_t index = 0; index < _simplex.count; index++)
+			{
+				_simplex.vertices[index] = CalculateVertex(_a, _b, _simplex.vertices[index].direction);
+			}
+		}
+		else
+		{
+			_simplex.vertices[0] = CalculateVertex(_a, _b, { 1.0f, 0.0f, 0.0f });
+			_simplex.count = 1;
+		}
+
+		float margin = _a.radius + _b.radius;
+		float previousDistanceSquared = FLT_MAX;
+		for (;;)
+		{
+			Simplex previous = _simplex;
+			_closest = ReduceSimplex(_simplex, _weights);
+			float distanceSquared = Dot(_closest, _closest);
+			if (_simplex.count == 4 || distanceSquared <= kIntersectEpsilon)
+			{
+				return CoreState::kIntersect;
+			}
+			//丸め誤差で距離が縮まらなくなったら1つ前の単体を答えにする
+			if (previousDistanceSquared <= distanceSquared)
+			{
+				_simplex = previous;
+				_simplex.count--;
+				_closest = ReduceSimplex(_simplex, _weights);
+				return CoreState::kNearest;
+			}
+			previousDistanceSquared = distanceSquared;
+			//距離の上限が丸みより小さければ重なっている
+			if (_isBooleanOnly && distanceSquared <= margin * margin)
+			{
+				return CoreState::kNearest;
+			}
+			if (kMaxIterations <= _iterations)
+			{
+				return CoreState::kNearest;
+			}
+
+			Vector3 direction = -_closest;
+			SimplexVertex vertex = CalculateVertex(_a, _b, direction);
+			_iterations++;
+			float progress = Dot(vertex.point, direction);
+			//その向きの分離平面までの距離 (距離の下限) が丸みより大きければ離れている
+			if (_isBooleanOnly && progress < 0.0f && margin * margin * distanceSquared < progress * progress)
+			{
+				return CoreState::kSeparated;
+			}
+			//距離の上限 |closest| と下限の差が縮まらなくなった
+			if (distanceSquared + progress <= kRelativeTolerance * distanceSquared)
+			{
+				return CoreState::kNearest;
+			}
+			bool isDuplicate = false;
+			for (uint32_t index = 0; index < _simplex.count; index++)
+			{
+				isDuplicate |= Length(_simplex.vertices[index].point - vertex.point) <= 0.0f;
+			}
+			if (isDuplicate)
+			{
+				return CoreState::kNearest;
+			}
+			_simplex.vertices[_simplex.count++] = vertex;
+		}
+	}
+
+	struct EPAFace
+	{
+		uint32_t vertices[3];
+		Vector3 normal;		//外向き
+		float distance;		//原点から面までの距離
+	};
+
+	struct EPAEdge
+	{
+		uint32_t start;
+		uint32_t end;
+	};
+
+	bool MakeFace(const SimplexVertex* _vertices, uint32_t _a, uint32_t _b, uint32_t _c, const Vector3& _interior, EPAFace& _face)
+	{
+		Vector3 normal = Normalize(Cross(_vertices[_b].point - _vertices[_a].point, _vertices[_c].point - _vertices[_a].point));
+		if (Length(normal) == 0.0f)
+		{
+			return false;
+		}
+		//内部の点と反対を向くようにそろえる
+		if (Dot(normal, _vertices[_a].point - _interior) < 0.0f)
+		{
+			normal = -normal;
+			std::swap(_b, _c);
+		}
+		_face = { { _a, _b, _c }, normal, Dot(normal, _vertices[_a].point) };
+		return true;
+	}
+}
+
+Vector3 Support(const Sphere& _sphere, const Vector3& _direction)
+{
+	return _sphere.center + Normalize(_direction) * _sphere.radius;
+}
+
+Vector3 Support(const AABB& _aabb, const Vector3& _direction)
+{
+	return {
+		0.0f <= _direction.x ? _aabb.max.x : _aabb.min.x,
+		0.0f <= _direction.y ? _aabb.max.y : _aabb.min.y,
+		0.0f <= _direction.z ? _aabb.max.z : _aabb.min.z
+	};
+}
+
+Vector3 Support(const OBB& _obb, const Vector3& _direction)
+{
+	float sizes[3] = { _obb.size.x, _obb.size.y, _obb.size.z };
+	Vector3 result = _obb.center;
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		float sign = 0.0f <= Dot(_direction, _obb.orientations[axis]) ? 1.0f : -1.0f;
+		result += _obb.orientations[axis] * (sizes[axis] * sign);
+	}
+	return result;
+}
+
+Vector3 Support(const Segment& _segment, const Vector3& _direction)
+{
+	return 0.0f <= Dot(_direction, _segment.diff) ? _segment.origin + _segment.diff : _segment.origin;
+}
+
+Vector3 Support(const Capsule& _capsule, const Vector3& _direction)
+{
+	return Support(_capsule.segment, _direction) + Normalize(_direction) * _capsule.radius;
+}
+
+Vector3 Support(const Triangle& _triangle, const Vector3& _direction)
+{
+	const Vector3* best = &_triangle.vertices[0];
+	for (const Vector3& vertex : _triangle.vertices)
+	{
+		if (Dot(*best, _direction) < Dot(vertex, _direction))
+		{
+			best = &vertex;
+		}
+	}
+	return *best;
+}
+
+Vector3 Support(const ConvexHull& _hull, const Vector3& _direction)
+{
+	assert(!_hull.vertices.empty());
+	const Vector3* best = &_hull.vertices[0];
+	float bestDot = Dot(*best, _direction);
+	for (const Vector3& vertex : _hull.vertices)
+	{
+		float dot = Dot(vertex, _direction);
+		if (bestDot < dot)
+		{
+			bestDot = dot;
+			best = &vertex;
+		}
+	}
+	return *best;
+}
+
+GJKResult SolveGJK(const SupportFunction& _a, const SupportFunction& _b, Simplex* _cache, bool _isBooleanOnly)
+{
+	GJKResult result{};
+	Simplex simplex = _cache ? *_cache : Simplex{};
+	float weights[4] = {};
+	Vector3 closest{};
+	CoreState state = SolveCore(_a, _b, simplex, _isBooleanOnly, weights, closest, result.iterations);
+	if (_cache)
+	{
+		*_cache = simplex;
+	}
+
+	float margin = _a.radius + _b.radius;
+	if (state == CoreState::kIntersect)
+	{
+		result.isIntersect = true;
+		return result;
+	}
+	if (state == CoreState::kSeparated)
+	{
+		return result;
+	}
+
+	//中心の形状どうしの最近点から丸みの分だけ表面へ寄せる
+	float coreDistance = Length(closest);
+	result.isIntersect = coreDistance <= margin;
+	Vector3 coreA{};
+	Vector3 coreB{};
+	CalculateWitnessPoints(simplex, weights, coreA, coreB);
+	Vector3 normal = 0.0f < coreDistance ? closest / -coreDistance : Vector3{};
+	result.distance = result.isIntersect ? 0.0f : coreDistance - margin;
+	result.pointA = coreA + normal * _a.radius;
+	result.pointB = coreB - normal * _b.radius;
+	return result;
+}
+
+bool SolveEPA(const SupportFunction& _a, const SupportFunction& _b, Simplex* _cache, PenetrationResult& _result)
+{
+	Simplex simplex = _cache ? *_cache : Simplex{};
+	float weights[4] = {};
+	Vector3 closest{};
+	uint32_t iterations = 0;
+	//丸みがあるときは中心の形状どうしの距離が要るので最後まで求める
+	float margin = _a.radius + _b.radius;
+	CoreState state = SolveCore(_a, _b, simplex, margin == 0.0f, weights, closest, iterations);
+	if (_cache)
+	{
+		*_cache = simplex;
+	}
+	if (state == CoreState::kSeparated)
+	{
+		return false;
+	}
+	if (state == CoreState::kNearest)
+	{
+		//中心の形状は離れていて丸みの分だけ重なっている
+		float coreDistance = Length(closest);
+		if (margin < coreDistance || coreDistance == 0.0f)
+		{
+			return false;
+		}
+		Vector3 coreA{};
+		Vector3 coreB{};
+		CalculateWitnessPoints(simplex, weights, coreA, coreB);
+		_result.normal = closest / coreDistance;
+		_result.depth = margin - coreDistance;
+		_result.pointA = coreA - _result.normal * _a.radius;
+		_result.pointB = coreB + _result.normal * _b.radius;
+		return true;
+	}
+
+	if (!ExpandToTetrahedron(_a, _b, simplex))
+	{
+		//ミンコフスキー差が平らなので中心の形状は接しているだけとみなす (線分どうしが交差しているときなど)
+		_result.normal = Normalize(simplex.vertices[0].direction);
+		if (simplex.count == 3)
+		{
+			_result.normal = Normalize(Cross(simplex.vertices[1].point - simplex.vertices[0].point, simplex.vertices[2].point - simplex.vertices[0].point));
+		}
+		_result.depth = margin;
+		_result.pointA = simplex.vertices[0].supportA - _result.normal * _a.radius;
+		_result.pointB = simplex.vertices[0].supportB + _result.normal * _b.radius;
+		return true;
+	}
+
+	SimplexVertex vertices[kMaxEPAVertices];
+	uint32_t vertexCount = 4;
+	std::copy(simplex.vertices, simplex.vertices + 4, vertices);
+	Vector3 interior = (vertices[0].point + vertices[1].point + vertices[2].point + vertices[3].point) * 0.25f;
+
+	EPAFace faces[kMaxEPAFaces];
+	uint32_t faceCount = 0;
+	static const uint32_t kTetrahedronFaces[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } };
+	for (const uint32_t* face : kTetrahedronFaces)
+	{
+		if (MakeFace(vertices, face[0], face[1], face[2], interior, faces[faceCount]))
+		{
+			faceCount++;
+		}
+	}
+
+	uint32_t closestFace = 0;
+	for (uint32_t iteration = 0; iteration < kMaxEPAIterations && 0 < faceCount; iteration++)
+	{
+		closestFace = 0;
+		for (uint32_t face = 1; face < faceCount; face++)
+		{
+			if (faces[face].distance < faces[closestFace].distance)
+			{
+				closestFace = face;
+			}
+		}
+
+		//最も近い面の向きにこれ以上広がらなければ，その面までの距離が深さ
+		const EPAFace& nearest = faces[closestFace];
+		SimplexVertex vertex = CalculateVertex(_a, _b, nearest.normal);
+		if (Dot(vertex.point, nearest.normal) - nearest.distance < kEPATolerance || vertexCount == kMaxEPAVertices)
+		{
+			break;
+		}
+
+		//新しい頂点から見える面を取り除き，その境界の辺と新しい頂点で面を張る
+		EPAEdge edges[kMaxEPAEdges];
+		uint32_t edgeCount = 0;
+		bool isOverflow = false;
+		for (uint32_t face = 0; face < faceCount;)
+		{
+			//同一平面上の面まで消すと境界がねじれるので，許容誤差より外側にある面だけを消す
+			if (Dot(faces[face].normal, vertex.point - vertices[faces[face].vertices[0]].point) <= kEPAVisibleEpsilon)
+			{
+				face++;
+				continue;
+			}
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				EPAEdge edge = { faces[face].vertices[corner], faces[face].vertices[(corner + 1) % 3] };
+				//隣の面と共有している辺は境界ではない
+				EPAEdge* shared = std::find_if(edges, edges + edgeCount, [&](const EPAEdge& _edge) { return _edge.start == edge.end && _edge.end == edge.start; });
+				if (shared != edges + edgeCount)
+				{
+					*shared = edges[--edgeCount];
+				}
+				else if (edgeCount < kMaxEPAEdges)
+				{
+					edges[edgeCount++] = edge;
+				}
+				else
+				{
+					isOverflow = true;
+				}
+			}
+			faces[face] = faces[--faceCount];
+		}
+		if (isOverflow || kMaxEPAFaces < faceCount + edgeCount)
+		{
+			break;
+		}
+
+		uint32_t newVertex = vertexCount++;
+		vertices[newVertex] = vertex;
+		for (uint32_t edge = 0; edge < edgeCount; edge++)
+		{
+			if (MakeFace(vertices, edges[edge].start, edges[edge].end, newVertex, interior, faces[faceCount]))
+			{
+				faceCount++;
+			}
+		}
+	}
+
+	if (faceCount == 0)
+	{
+		return false;
+	}
+	//一番近い面へ原点を射影した点の重心座標から，それぞれの形状上の点を求める
+	closestFace = 0;
+	for (uint32_t face = 1; face < faceCount; face++)
+	{
+		if (faces[face].distance < faces[closestFace].distance)
+		{
+			closestFace = face;
+		}
+	}
+	const EPAFace& face = faces[closestFace];
+	const SimplexVertex& a = vertices[face.vertices[0]];
+	const SimplexVertex& b = vertices[face.vertices[1]];
+	const SimplexVertex& c = vertices[face.vertices[2]];
+	Vector3 projected = face.normal * face.distance;
+	Vector3 v0 = b.point - a.point;
+	Vector3 v1 = c.point - a.point;
+	Vector3 v2 = projected - a.point;
+	float d00 = Dot(v0, v0);
+	float d01 = Dot(v0, v1);
+	float d11 = Dot(v1, v1);
+	float d20 = Dot(v2, v0);
+	float d21 = Dot(v2, v1);
+	float denominator = d00 * d11 - d01 * d01;
+	float v = 0.0f < denominator ? (d11 * d20 - d01 * d21) / denominator : 0.0f;
+	float w = 0.0f < denominator ? (d00 * d21 - d01 * d20) / denominator : 0.0f;
+	float u = 1.0f - v - w;
+
+	_result.normal = -face.normal;
+	_result.depth = face.distance + margin;
+	_result.pointA = a.supportA * u + b.supportA * v + c.supportA * w - _result.normal * _a.radius;
+	_result.pointB = a.supportB * u + b.supportB * v + c.supportB * w + _result.normal * _b.radius;
+	return true;
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "MyLib.h"
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/// <summary>
+/// 凸包 頂点の並びは自由 (面の情報は使わない)
+/// </summary>
+struct ConvexHull
+{
+	std::vector<Vector3> vertices;
+};
+
+//_directionの向きに最も遠い点 (サポート写像)
+Vector3 Support(const Sphere& _sphere, const Vector3& _direction);
+Vector3 Support(const AABB& _aabb, const Vector3& _direction);
+Vector3 Support(const OBB& _obb, const Vector3& _direction);
+Vector3 Support(const Segment& _segment, const Vector3& _direction);
+Vector3 Support(const Capsule& _capsule, const Vector3& _direction);
+Vector3 Support(const Triangle& _triangle, const Vector3& _direction);
+Vector3 Support(const ConvexHull& _hull, const Vector3& _direction);
+
+/// <summary>
+/// 形状を型に依らずサポート写像として扱うための参照
+/// 球とカプセルは中心の点・線分と半径に分ける 曲面のままだとEPAの多面体がなかなか収束しない
+/// </summary>
+struct SupportFunction
+{
+	const void* shape;
+	Vector3(*function)(const void*, const Vector3&);	//丸みを除いた形状のサポート写像
+	float radius;										//丸みの半径
+
+public:
+	Vector3 operator()(const Vector3& _direction) const { return function(shape, _direction); }
+};
+
+template <class Shape>
+SupportFunction MakeSupportFunction(const Shape& _shape)
+{
+	if constexpr (std::is_same_v<Shape, Sphere>)
+	{
+		return { &_shape, [](const void* _pointer, const Vector3&) { return static_cast<const Sphere*>(_pointer)->center; }, _shape.radius };
+	}
+	else if constexpr (std::is_same_v<Shape, Capsule>)
+	{
+		return { &_shape, [](const void* _pointer, const Vector3& _direction) { return Support(static_cast<const Capsule*>(_pointer)->segment, _direction); }, _shape.radius };
+	}
+	else
+	{
+		return { &_shape, [](const void* _pointer, const Vector3& _direction) { return Support(*static_cast<const Shape*>(_pointer), _direction); }, 0.0f };
+	}
+}
+
+/// <summary>
+/// ミンコフスキー差 A - B 上の頂点
+/// </summary>
+struct SimplexVertex
+{
+	Vector3 point;		//supportA - supportB
+	Vector3 supportA;	//Aのサポート点
+	Vector3 supportB;	//Bのサポート点
+	Vector3 direction;	//求めたときの探索方向 ウォームスタートで頂点を作り直すのに使う
+};
+
+/// <summary>
+/// GJKの単体 組ごとに保持して次のフレームへ渡すとウォームスタートになる
+/// 形状が少ししか動かなければ前回の探索方向から作り直した単体がほぼ答えになっている
+/// </summary>
+struct Simplex
+{
+	SimplexVertex vertices[4];
+	uint32_t count = 0;
+};
+
+/// <summary>
+/// GJKの結果
+/// </summary>
+struct GJKResult
+{
+	bool isIntersect;
+	float distance;			//離れているときの最短距離 (_isBooleanOnlyのときは求めない)
+	Vector3 pointA;			//Aの最近点 (中心の形状どうしが重なっているときは求めない)
+	Vector3 pointB;			//Bの最近点
+	uint32_t iterations;	//探索方向を更新した回数 (ウォームスタートで作り直した分は含まない)
+};
+
+/// <summary>
+/// 重なりの深さ (EPAの結果)
+/// </summary>
+struct PenetrationResult
+{
+	Vector3 normal;		//BからAへ押し出す向き
+	float depth;		//normalの向きに押し出す量
+	Vector3 pointA;		//Aの最も深い点
+	Vector3 pointB;		//Bの最も深い点
+};
+
+/// <summary>
+/// GJKで2形状の最短距離を求める
+/// </summary>
+/// <param name="_cache">前回の単体 nullptrでなければ開始に使い，結果の単体を書き戻す</param>
+/// <param name="_isBooleanOnly">交差するかだけ分かればよいとき 分離軸が見つかった時点で打ち切る</param>
+GJKResult SolveGJK(const SupportFunction& _a, const SupportFunction& _b, Simplex* _cache, bool _isBooleanOnly);
+
+/// <summary>
+/// EPAで重なりの深さを求める 交差していなければfalse
+/// </summary>
+/// <param name="_cache">GJKと同じく前回の単体</param>
+bool SolveEPA(const SupportFunction& _a, const SupportFunction& _b, Simplex* _cache, PenetrationResult& _result);
+
+/// <summary>
+/// サポート写像を持つ任意の凸形状同士の衝突判定
+/// 専用のIsCollisionがない組み合わせ (OBBと三角形, カプセルとOBB など) にも使える
+/// </summary>
+template <class ShapeA, class ShapeB>
+bool IsCollisionGJK(const ShapeA& _a, const ShapeB& _b, Simplex* _cache = nullptr)
+{
+	return SolveGJK(MakeSupportFunction(_a), MakeSupportFunction(_b), _cache, true).isIntersect;
+}
+
+/// <summary>
+/// 任意の凸形状同士の最短距離と最近点
+/// </summary>
+template <class ShapeA, class ShapeB>
+GJKResult CalculateDistance(const ShapeA& _a, const ShapeB& _b, Simplex* _cache = nullptr)
+{
+	return SolveGJK(MakeSupportFunction(_a), MakeSupportFunction(_b), _cache, false);
+}
+
+/// <summary>
+/// 任意の凸形状同士の重なりの深さと押し出す向き
+/// </summary>
+template <class ShapeA, class ShapeB>
+bool CalculatePenetration(const ShapeA& _a, const ShapeB& _b, PenetrationResult& _result, Simplex* _cache = nullptr)
+{
+	return SolveEPA(MakeSupportFunction(_a), MakeSupportFunction(_b), _cache, _result);
+}
@@ -0,0 +1,234 @@
+#include "MeshBVH.h"
+#include "BVH.h"
+#include <xmmintrin.h>
+
+void MeshBVH::Build(const Vector3* _positions, uint32_t _triangleCount)
+{
+	triangleCount = _triangleCount;
+	nodes.clear();
+	packets.clear();
+	if (_triangleCount == 0)
+	{
+		return;
+	}
+
+	std::vector<AABB> bounds(_triangleCount);
+	for (uint32_t triangle = 0; triangle < _triangleCount; triangle++)
+	{
+		const Vector3* vertices = _positions + triangle * 3;
+		bounds[triangle].min = {
+			(std::min)({ vertices[0].x, vertices[1].x, vertices[2].x }),
+			(std::min)({ vertices[0].y, vertices[1].y, vertices[2].y }),
+			(std::min)({ vertices[0].z, vertices[1].z, vertices[2].z }) };
+		bounds[triangle].max = {
+			(std::max)({ vertices[0].x, vertices[1].x, vertices[2].x }),
+			(std::max)({ vertices[0].y, vertices[1].y, vertices[2].y }),
+			(std::max)({ vertices[0].z, vertices[1].z, vertices[2].z }) };
+	}
+
+	//木の形はBVHに任せ，葉の三角形をパケットに詰め替える
+	BVH bvh;
+	bvh.Build(bounds.data(), _triangleCount);
+	const std::vector<BVH::Node>& bvhNodes = bvh.GetNodes();
+	const std::vector<uint32_t>& elements = bvh.GetElements();
+
+	nodes.resize(bvhNodes.size());
+	for (size_t index = 0; index < bvhNodes.size(); index++)
+	{
+		const BVH::Node& bvhNode = bvhNodes[index];
+		Node& node = nodes[index];
+		node.bounds = bvhNode.bounds;
+		if (!bvhNode.IsLeaf())
+		{
+			node.leftOrFirst = bvhNode.leftOrFirst;
+			node.packetCount = 0;
+			continue;
+		}
+
+		node.leftOrFirst = static_cast<uint32_t>(packets.size());
+		node.packetCount = (bvhNode.count + kPacketWidth - 1) / kPacketWidth;
+		for (uint32_t first = 0; first < bvhNode.count; first += kPacketWidth)
+		{
+			//余った枠は全頂点0の退化三角形にしておくと判定で必ず外れる
+			TrianglePacket packet{};
+			for (uint32_t lane = 0; lane < kPacketWidth; lane++)
+			{
+				packet.triangles[lane] = UINT32_MAX;
+				if (bvhNode.count <= first + lane)
+				{
+					continue;
+				}
+				uint32_t triangle = elements[bvhNode.leftOrFirst + first + lane];
+				const Vector3* vertices = _positions + triangle * 3;
+				for (int vertex = 0; vertex < 3; vertex++)
+				{
+					packet.vertices[vertex][0][lane] = vertices[vertex].x;
+					packet.vertices[vertex][1][lane] = vertices[vertex].y;
+					packet.vertices[vertex][2][lane] = vertices[vertex].z;
+				}
+				packet.triangles[lane] = triangle;
+			}
+			packets.push_back(packet);
+		}
+	}
+}
+
+bool MeshBVH::RayCast(const Segment& _segment, RayHit& _hit) const
+{
+	return Traverse(_segment.origin, _segment.diff, 1.0f, _hit);
+}
+
+bool MeshBVH::RayCast(const Ray& _ray, RayHit& _hit) const
+{
+	return Traverse(_ray.origin, _ray.diff, FLT_MAX, _hit);
+}
+
+bool MeshBVH::Traverse(const Vector3& _origin, const Vector3& _diff, float _tMax, RayHit& _hit) const
+{
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	const float origin[3] = { _origin.x, _origin.y, _origin.z };
+	const float diff[3] = { _diff.x, _diff.y, _diff.z };
+
+	//方向の成分が最大の軸をz軸とみなし，レイがz軸に沿うように座標をせん断する
+	int kz = 0;
+	if (std::fabs(diff[kz]) < std::fabs(diff[1])) { kz = 1; }
+	if (std::fabs(diff[kz]) < std::fabs(diff[2])) { kz = 2; }
+	if (diff[kz] == 0.0f)
+	{
+		return false;
+	}
+	int kx = (kz + 1) % 3;
+	int ky = (kx + 1) % 3;
+	//三角形の向きの判定が反転しないように入れ替える
+	if (diff[kz] < 0.0f)
+	{
+		std::swap(kx, ky);
+	}
+	const __m128 shearX = _mm_set1_ps(diff[kx] / diff[kz]);
+	const __m128 shearY = _mm_set1_ps(diff[ky] / diff[kz]);
+	const __m128 shearZ = _mm_set1_ps(1.0f / diff[kz]);
+	const __m128 originX = _mm_set1_ps(origin[kx]);
+	const __m128 originY = _mm_set1_ps(origin[ky]);
+	const __m128 originZ = _mm_set1_ps(origin[kz]);
+	const __m128 zero = _mm_setzero_ps();
+
+	const Vector3 inverseDiff = CalculateInverseDiff(_diff);
+
+	float nearest = _tMax;
+	bool isHit = false;
+
+	struct StackEntry
+	{
+		uint32_t node;
+		float tEnter;
+	};
+	StackEntry stack[kStackSize];
+	uint32_t stackSize = 0;
+	float tEnter;
+	if (!IntersectSlab(nodes[0].bounds, _origin, inverseDiff, nearest, tEnter))
+	{
+		return false;
+	}
+	stack[stackSize++] = { 0, tEnter };
+
+	while (stackSize != 0)
+	{
+		StackEntry entry = stack[--stackSize];
+		if (nearest < entry.tEnter)
+		{
+			continue;
+		}
+		const Node& node = nodes[entry.node];
+		if (node.packetCount == 0)
+		{
+			StackEntry left = { node.leftOrFirst, 0.0f };
+			StackEntry right = { node.leftOrFirst + 1, 0.0f };
+			bool hitLeft = IntersectSlab(nodes[left.node].bounds, _origin, inverseDiff, nearest, left.tEnter);
+			bool hitRight = IntersectSlab(nodes[right.node].bounds, _origin, inverseDiff, nearest, right.tEnter);
+			if (hitLeft && hitRight)
+			{
+				//近いほうを先に取り出すので後に積む
+				if (left.tEnter < right.tEnter)
+				{
+					std::swap(left, right);
+				}
+				stack[stackSize++] = left;
+				stack[stackSize++] = right;
+			}
+			else if (hitLeft)
+			{
+				stack[stackSize++] = left;
+			}
+			else if (hitRight)
+			{
+				stack[stackSize++] = right;
+			}
+			continue;
+		}
+
+		for (uint32_t packetIndex = node.leftOrFirst; packetIndex < node.leftOrFirst + node.packetCount; packetIndex++)
+		{
+			const TrianglePacket& packet = packets[packetIndex];
+
+			//レイの始点を原点にした頂点
+			__m128 az = _mm_sub_ps(_mm_load_ps(packet.vertices[0][kz]), originZ);
+			__m128 bz = _mm_sub_ps(_mm_load_ps(packet.vertices[1][kz]), originZ);
+			__m128 cz = _mm_sub_ps(_mm_load_ps(packet.vertices[2][kz]), originZ);
+			__m128 ax = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.vertices[0][kx]), originX), _mm_mul_ps(shearX, az));
+			__m128 ay = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.vertices[0][ky]), originY), _mm_mul_ps(shearY, az));
+			__m128 bx = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.vertices[1][kx]), originX), _mm_mul_ps(shearX, bz));
+			__m128 by = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.vertices[1][ky]), originY), _mm_mul_ps(shearY, bz));
+			__m128 cx = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.vertices[2][kx]), originX), _mm_mul_ps(shearX, cz));
+			__m128 cy = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.vertices[2][ky]), originY), _mm_mul_ps(shearY, cz));
+
+			//レイから見た各辺の符号付き面積 すべて同符号ならレイが三角形の内側を通る
+			__m128 u = _mm_sub_ps(_mm_mul_ps(cx, by), _mm_mul_ps(cy, bx));
+			__m128 v = _mm_sub_ps(_mm_mul_ps(ax, cy), _mm_mul_ps(ay, cx));
+			__m128 w = _mm_sub_ps(_mm_mul_ps(bx, ay), _mm_mul_ps(by, ax));
+			__m128 hasNegative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmplt_ps(v, zero)), _mm_cmplt_ps(w, zero));
+			__m128 hasPositive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_cmpgt_ps(v, zero)), _mm_cmpgt_ps(w, zero));
+			__m128 determinant = _mm_add_ps(_mm_add_ps(u, v), w);
+			__m128 valid = _mm_andnot_ps(_mm_and_ps(hasNegative, hasPositive), _mm_cmpneq_ps(determinant, zero));
+			if (_mm_movemask_ps(valid) == 0)
+			{
+				continue;
+			}
+
+			__m128 scaledT = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, _mm_mul_ps(shearZ, az)), _mm_mul_ps(v, _mm_mul_ps(shearZ, bz))), _mm_mul_ps(w, _mm_mul_ps(shearZ, cz)));
+			__m128 t = _mm_div_ps(scaledT, determinant);
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmple_ps(t, _mm_set1_ps(nearest))));
+			int mask = _mm_movemask_ps(valid);
+			if (mask == 0)
+			{
+				continue;
+			}
+
+			alignas(16) float ts[kPacketWidth];
+			alignas(16) float vs[kPacketWidth];
+			alignas(16) float ws[kPacketWidth];
+			alignas(16) float determinants[kPacketWidth];
+			_mm_store_ps(ts, t);
+			_mm_store_ps(vs, v);
+			_mm_store_ps(ws, w);
+			_mm_store_ps(determinants, determinant);
+			for (uint32_t lane = 0; lane < kPacketWidth; lane++)
+			{
+				if ((mask & (1 << lane)) == 0 || nearest < ts[lane] || (isHit && nearest == ts[lane]))
+				{
+					continue;
+				}
+				nearest = ts[lane];
+				isHit = true;
+				_hit.t = ts[lane];
+				_hit.triangle = packet.triangles[lane];
+				_hit.u = vs[lane] / determinants[lane];
+				_hit.v = ws[lane] / determinants[lane];
+			}
+		}
+	}
+	return isHit;
+}
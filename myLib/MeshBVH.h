@@ -0,0 +1,75 @@
+#pragma once
+#include "MyLib.h"
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// レイと三角形メッシュの交差結果
+/// 交点 = (1 - u - v) * v0 + u * v1 + v * v2
+/// </summary>
+struct RayHit
+{
+	float t;			//交点までの距離 (方向ベクトルの長さ単位)
+	uint32_t triangle;	//三角形番号
+	float u;			//v1の重み
+	float v;			//v2の重み
+};
+
+/// <summary>
+/// 静的な三角形メッシュ用のBVH
+/// 葉の三角形は4つずつSoAにまとめ，SSEで4つ同時にレイと判定する
+/// 判定は辺を共有する三角形の隙間をすり抜けない方式 (watertight)
+/// </summary>
+class MeshBVH
+{
+public:
+	/// <summary>
+	/// 構築する 読み込み時に1回だけ行う
+	/// </summary>
+	/// <param name="_positions">三角形ごとに3頂点ずつ並んだ座標</param>
+	/// <param name="_triangleCount">三角形の数</param>
+	void Build(const Vector3* _positions, uint32_t _triangleCount);
+
+	/// <summary>
+	/// 線分と最も近い交点を求める
+	/// </summary>
+	/// <param name="_segment">線分 t=0が始点 t=1が終点</param>
+	/// <param name="_hit">交差していれば最も近い交点</param>
+	/// <returns>交差しているか</returns>
+	bool RayCast(const Segment& _segment, RayHit& _hit) const;
+	/// <summary>
+	/// 半直線と最も近い交点を求める
+	/// </summary>
+	bool RayCast(const Ray& _ray, RayHit& _hit) const;
+
+	uint32_t GetTriangleCount() const { return triangleCount; }
+
+private:
+	//たどるときのスタックの深さ (BVHと同じ)
+	static const uint32_t kStackSize = 64;
+	//1パケットの三角形数
+	static const uint32_t kPacketWidth = 4;
+
+	struct Node
+	{
+		AABB bounds;
+		uint32_t leftOrFirst;	//内部ノードなら左の子 葉なら最初のパケット
+		uint32_t packetCount;	//葉のパケット数 0なら内部ノード
+	};
+
+	/// <summary>
+	/// 4つの三角形の頂点を成分ごとにまとめたもの
+	/// 余りは退化三角形で埋める
+	/// </summary>
+	struct alignas(16) TrianglePacket
+	{
+		float vertices[3][3][kPacketWidth];	//[頂点][成分][三角形]
+		uint32_t triangles[kPacketWidth];
+	};
+
+	bool Traverse(const Vector3& _origin, const Vector3& _diff, float _tMax, RayHit& _hit) const;
+
+	std::vector<Node> nodes;
+	std::vector<TrianglePacket> packets;
+	uint32_t triangleCount = 0;
+};
@@ -1,6 +1,7 @@
 #define NOMINMAX
 #include "MyLib.h"
 #include <algorithm>
+#include <cassert>
 #include <limits>
 
 void DrawGrid(const Matrix4x4& _viewProjectionMatrix, const Matrix4x4& _viewportMatrix)
@@ -514,33 +515,55 @@ bool IsCollision(const AABB& _aabb, const Segment& _segment)
 
 bool IsCollision(const OBB& _obb, const Sphere& _sphere)
 {
-	Matrix4x4 obbWolrdMat = MakeAffineMatrix({ 1.0f,1.0f ,1.0f }, _obb.rotate, _obb.center);
-	Matrix4x4 obbWorldMatInv = Inverse(obbWolrdMat);
+	//座標軸は正規直交なのでローカル座標は内積だけで求まる
+	Vector3 distance = _sphere.center - _obb.center;
+	const float extents[3] = { _obb.size.x, _obb.size.y, _obb.size.z };
 
-	Vector3  centerInOBBLocalSphere = Transform(_sphere.center, obbWorldMatInv);
-	AABB aabbOBBLocal{ .min = -_obb.size,.max = _obb.size };
-	Sphere sphereOBBLocal{ centerInOBBLocalSphere,_sphere.radius };
-
-	return IsCollision(aabbOBBLocal, sphereOBBLocal);
+	float squaredDistance = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		//CalculateOrientationsを呼んでいない (0のまま) obbを見つける
+		assert(std::fabs(Dot(_obb.orientations[axis], _obb.orientations[axis]) - 1.0f) < 1.0e-3f);
+		float local = Dot(distance, _obb.orientations[axis]);
+		float outside = local - std::clamp(local, -extents[axis], extents[axis]);
+		squaredDistance += outside * outside;
+	}
 
+	return squaredDistance <= _sphere.radius * _sphere.radius;
 }
 
 bool IsCollision(const OBB& _obb, const Segment& _segment)
 {
-	Matrix4x4 obbWolrdMat = MakeAffineMatrix({ 1.0f,1.0f ,1.0f }, _obb.rotate, _obb.center);
-	Matrix4x4 obbWorldMatInv = Inverse(obbWolrdMat);
-	Vector3 localOrigin = Transform(_segment.origin, obbWorldMatInv);
-	Vector3 localEnd = Transform(_segment.origin + _segment.diff, obbWorldMatInv);
-
-	AABB localAABB{
-		{-_obb.size.x, -_obb.size.y, -_obb.size.z},
-		{+_obb.size.x, +_obb.size.y, +_obb.size.z},
-	};
-	Segment localSegment;
-	localSegment.origin = localOrigin;
-	localSegment.diff = localEnd - localOrigin;
+	//座標軸は正規直交なのでローカル座標は内積だけで求まる
+	Vector3 distance = _segment.origin - _obb.center;
+	const float extents[3] = { _obb.size.x, _obb.size.y, _obb.size.z };
 
-	return IsCollision(localAABB, localSegment);
+	float tmin = 0.0f;
+	float tmax = 1.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		assert(std::fabs(Dot(_obb.orientations[axis], _obb.orientations[axis]) - 1.0f) < 1.0e-3f);
+		float origin = Dot(distance, _obb.orientations[axis]);
+		float diff = Dot(_segment.diff, _obb.orientations[axis]);
+		if (std::fabs(diff) < 1.0e-8f)
+		{
+			//軸に平行 範囲外なら交わらない
+			if (origin < -extents[axis] || extents[axis] < origin)
+			{
+				return false;
+			}
+			continue;
+		}
+		float t1 = (-extents[axis] - origin) / diff;
+		float t2 = (extents[axis] - origin) / diff;
+		tmin = std::max(tmin, std::min(t1, t2));
+		tmax = std::min(tmax, std::max(t1, t2));
+		if (tmax < tmin)
+		{
+			return false;
+		}
+	}
+	return true;
 }
 
 bool IsCollision(const OBB& _obb1, const OBB& _obb2)
@@ -588,6 +611,113 @@ bool IsCollision(const OBB& _obb1, const OBB& _obb2)
 	return true;
 }
 
+namespace
+{
+	//IsCollisionSATで使う，相手によらないobbの値
+	struct OBBAxes
+	{
+		Vector3 center;
+		Vector3 orientations[3];
+		float extents[3];
+	};
+
+	OBBAxes MakeOBBAxes(const OBB& _obb)
+	{
+		return { _obb.center, { _obb.orientations[0], _obb.orientations[1], _obb.orientations[2] }, { _obb.size.x, _obb.size.y, _obb.size.z } };
+	}
+
+	bool IsCollisionSAT(const OBBAxes& _a, const OBB& _b)
+	{
+		//平行な辺の外積が0に近いときに分離と判定しないための余裕
+		const float kEpsilon = 1.0e-6f;
+		const float b[3] = { _b.size.x, _b.size.y, _b.size.z };
+
+		//bの軸をaの座標系で表した回転行列
+		float r[3][3];
+		float absR[3][3];
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				r[i][j] = Dot(_a.orientations[i], _b.orientations[j]);
+				absR[i][j] = std::fabs(r[i][j]) + kEpsilon;
+			}
+		}
+
+		//中心間のベクトルをaの座標系で表したもの
+		Vector3 distance = _b.center - _a.center;
+		const float t[3] = { Dot(distance, _a.orientations[0]), Dot(distance, _a.orientations[1]), Dot(distance, _a.orientations[2]) };
+
+		//aの軸
+		for (int i = 0; i < 3; i++)
+		{
+			float rb = b[0] * absR[i][0] + b[1] * absR[i][1] + b[2] * absR[i][2];
+			if (_a.extents[i] + rb < std::fabs(t[i]))
+			{
+				return false;
+			}
+		}
+
+		//bの軸
+		for (int j = 0; j < 3; j++)
+		{
+			float ra = _a.extents[0] * absR[0][j] + _a.extents[1] * absR[1][j] + _a.extents[2] * absR[2][j];
+			float projection = t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j];
+			if (ra + b[j] < std::fabs(projection))
+			{
+				return false;
+			}
+		}
+
+		//aの軸iとbの軸jの外積
+		for (int i = 0; i < 3; i++)
+		{
+			int i1 = (i + 1) % 3;
+			int i2 = (i + 2) % 3;
+			for (int j = 0; j < 3; j++)
+			{
+				int j1 = (j + 1) % 3;
+				int j2 = (j + 2) % 3;
+				float ra = _a.extents[i1] * absR[i2][j] + _a.extents[i2] * absR[i1][j];
+				float rb = b[j1] * absR[i][j2] + b[j2] * absR[i][j1];
+				float projection = t[i2] * r[i1][j] - t[i1] * r[i2][j];
+				if (ra + rb < std::fabs(projection))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+bool IsCollisionSAT(const OBB& _obb1, const OBB& _obb2)
+{
+	return IsCollisionSAT(MakeOBBAxes(_obb1), _obb2);
+}
+
+void IsCollision(const OBB& _obb, const OBB* _others, uint32_t _count, bool* _results)
+{
+	const OBBAxes axes = MakeOBBAxes(_obb);
+	for (uint32_t index = 0; index < _count; index++)
+	{
+		_results[index] = IsCollisionSAT(axes, _others[index]);
+	}
+}
+
+bool IsCollision(const Frustum& _frustum, const Sphere& _sphere)
+{
+	for (const Plane& plane : _frustum.planes)
+	{
+		//平面の外側に半径以上離れていれば見えない
+		if (Dot(plane.normal, _sphere.center) - plane.distance < -_sphere.radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 Plane CalculatePlane(const Triangle& _triangle)
 {
 	Plane result{};
@@ -606,6 +736,31 @@ Plane CalculatePlane(const Triangle& _triangle)
 	return result;
 }
 
+Frustum CalculateFrustum(const Matrix4x4& _viewProjectionMatrix)
+{
+	const Matrix4x4& m = _viewProjectionMatrix;
+	//行ベクトル形式なのでクリップ座標の各成分は列との内積になる
+	//ax+by+cz+d>=0 が内側
+	const float planes[6][4] = {
+		{ m.m[0][3] + m.m[0][0], m.m[1][3] + m.m[1][0], m.m[2][3] + m.m[2][0], m.m[3][3] + m.m[3][0] },	//左   -w <= x
+		{ m.m[0][3] - m.m[0][0], m.m[1][3] - m.m[1][0], m.m[2][3] - m.m[2][0], m.m[3][3] - m.m[3][0] },	//右    x <= w
+		{ m.m[0][3] + m.m[0][1], m.m[1][3] + m.m[1][1], m.m[2][3] + m.m[2][1], m.m[3][3] + m.m[3][1] },	//下   -w <= y
+		{ m.m[0][3] - m.m[0][1], m.m[1][3] - m.m[1][1], m.m[2][3] - m.m[2][1], m.m[3][3] - m.m[3][1] },	//上    y <= w
+		{ m.m[0][2],             m.m[1][2],             m.m[2][2],             m.m[3][2] },					//近    0 <= z
+		{ m.m[0][3] - m.m[0][2], m.m[1][3] - m.m[1][2], m.m[2][3] - m.m[2][2], m.m[3][3] - m.m[3][2] },	//遠    z <= w
+	};
+
+	Frustum result{};
+	for (int i = 0; i < 6; i++)
+	{
+		Vector3 normal = { planes[i][0], planes[i][1], planes[i][2] };
+		float length = Length(normal);
+		result.planes[i].normal = normal / length;
+		result.planes[i].distance = -planes[i][3] / length;
+	}
+	return result;
+}
+
 void CalculateProjectionRange(const OBB& _obb, const Vector3& _axis, float& _min, float& _max)
 {
 	Vector3 verties[8];
@@ -7,6 +7,7 @@
 #include "Transform.h"
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <cstdint>
 
 
 struct Sphere
@@ -60,9 +61,12 @@ struct OBB
 	Vector3 center;				//中心座標
 	Vector3 orientations[3];	//座標軸 正規化・直行必須
 	Vector3 size;				//サイズ
-	Vector3 rotate;				//回転角
+	Vector3 rotate;				//回転角 衝突判定はorientationsを使う
 
 public:
+	/// <summary>
+	/// rotateからorientationsを求める rotateを変えたら衝突判定の前に呼ぶ
+	/// </summary>
 	void CalculateOrientations();
 	/// <summary>
 	/// 頂点の計算
@@ -125,6 +129,12 @@ struct Capsule
 	float radius;
 };
 
+//視錐台 法線はすべて内側向き
+struct Frustum
+{
+	Plane planes[6];	//左 右 下 上 近 遠
+};
+
 //グリッドの描画
 void DrawGrid(const Matrix4x4& _viewProjectionMatrix, const Matrix4x4& _viewportMatrix);
 //球体の描画
@@ -194,17 +204,46 @@ bool IsCollision(const AABB& _a, const Sphere& _s);
 bool IsCollision(const AABB& _aabb, const Segment& _segment);
 
 //obbと球の衝突判定
+//rotateは見ずにorientationsを使うので，rotateを変えたらCalculateOrientationsを呼んでおくこと
 bool IsCollision(const OBB& _obb, const Sphere& _sphere);
 
 //obbと線分の衝突判定
+//rotateは見ずにorientationsを使うので，rotateを変えたらCalculateOrientationsを呼んでおくこと
 bool IsCollision(const OBB& _obb, const Segment& _segment);
 
 //obbとobbの衝突判定
 bool IsCollision(const OBB& _obb1, const OBB& _obb2);
 
+/// <summary>
+/// obbとobbの衝突判定 (投影半径による分離軸判定)
+/// 頂点を求めずに，_obb1から見た_obb2の回転行列と中心間ベクトルだけで15軸を調べる
+/// 平行な辺どうしの外積軸は回転行列にイプシロンを足して誤判定しないようにする
+/// IsCollision(OBB, OBB)を結果の基準として残している
+/// </summary>
+bool IsCollisionSAT(const OBB& _obb1, const OBB& _obb2);
+
+/// <summary>
+/// 1つのobbと複数のobbの衝突判定
+/// </summary>
+/// <param name="_obb">判定するobb</param>
+/// <param name="_others">相手のobbの配列</param>
+/// <param name="_count">相手の数</param>
+/// <param name="_results">相手ごとの結果の書き込み先</param>
+void IsCollision(const OBB& _obb, const OBB* _others, uint32_t _count, bool* _results);
+
+//視錐台と球の衝突判定 (一部でも内側にあればtrue)
+bool IsCollision(const Frustum& _frustum, const Sphere& _sphere);
+
 //三角形のある平面を計算
 Plane CalculatePlane(const Triangle& _triangle);
 
+/// <summary>
+/// ビュープロジェクション行列から視錐台の6平面を求める
+/// </summary>
+/// <param name="_viewProjectionMatrix">ビュープロジェクション行列</param>
+/// <returns>内側向きの法線を持つ視錐台</returns>
+Frustum CalculateFrustum(const Matrix4x4& _viewProjectionMatrix);
+
 /// <summary>
 /// 射影ベクトルのminとmaxを返す
 /// </summary>
@@ -0,0 +1,397 @@
+#include "OcclusionCulling.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <xmmintrin.h>
+
+namespace
+{
+	//ラスタライズの並列化の単位 幅は4画素ずつ処理するので4の倍数
+	const uint32_t kTileWidth = 32;
+	const uint32_t kTileHeight = 32;
+	//三角形の設定・AABBの判定の並列化の単位
+	const uint32_t kChunkSize = 256;
+	//これより面積の小さい三角形は描かない (画素の中心にかからない)
+	const float kMinArea = 1.0e-6f;
+
+	/// <summary>
+	/// 行ベクトル形式で w=1 の点をクリップ空間へ移す
+	/// </summary>
+	Vector4 TransformToClip(const Vector3& _point, const Matrix4x4& _matrix)
+	{
+		const Matrix4x4& m = _matrix;
+		return {
+			_point.x * m.m[0][0] + _point.y * m.m[1][0] + _point.z * m.m[2][0] + m.m[3][0],
+			_point.x * m.m[0][1] + _point.y * m.m[1][1] + _point.z * m.m[2][1] + m.m[3][1],
+			_point.x * m.m[0][2] + _point.y * m.m[1][2] + _point.z * m.m[2][2] + m.m[3][2],
+			_point.x * m.m[0][3] + _point.y * m.m[1][3] + _point.z * m.m[2][3] + m.m[3][3] };
+	}
+
+	/// <summary>
+	/// クリップ空間の点が近クリップ面の手前 (またはカメラの後ろ) にあるか
+	/// </summary>
+	bool IsBehindNear(const Vector4& _clip)
+	{
+		return _clip.w <= 0.0f || _clip.z < 0.0f;
+	}
+
+	/// <summary>
+	/// [0, _count) をkChunkSizeずつに分けて実行する
+	/// </summary>
+	template <class Func>
+	void ForEachChunk(ThreadPool* _threadPool, uint32_t _count, const Func& _func)
+	{
+		const uint32_t chunkCount = (_count + kChunkSize - 1) / kChunkSize;
+		auto runChunk = [&](uint32_t _chunk)
+			{
+				const uint32_t begin = _chunk * kChunkSize;
+				_func(begin, (std::min)(begin + kChunkSize, _count));
+			};
+		if (_threadPool != nullptr && 1 < chunkCount)
+		{
+			_threadPool->ParallelFor(chunkCount, runChunk);
+		}
+		else
+		{
+			for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				runChunk(chunk);
+			}
+		}
+	}
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t _width, uint32_t _height, ThreadPool* _threadPool) :
+	threadPool(_threadPool),
+	width(_width),
+	height(_height),
+	tileCountX(_width / kTileWidth),
+	tileCountY(_height / kTileHeight),
+	viewProjection(MakeIdentity4x4()),
+	viewport(MakeViewportMatrix(0.0f, 0.0f, float(_width), float(_height), 0.0f, 1.0f)),
+	stats{}
+{
+	assert(0 < _width && _width % kTileWidth == 0);
+	assert(0 < _height && _height % kTileHeight == 0);
+	tileBins.resize(tileCountX * tileCountY);
+
+	//1x1になるまで縦横半分ずつ縮める
+	uint32_t levelWidth = _width;
+	uint32_t levelHeight = _height;
+	while (true)
+	{
+		hiZ.emplace_back(size_t(levelWidth) * levelHeight, 1.0f);
+		hiZWidths.push_back(levelWidth);
+		hiZHeights.push_back(levelHeight);
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+		levelWidth = (std::max)(levelWidth / 2, 1u);
+		levelHeight = (std::max)(levelHeight / 2, 1u);
+	}
+}
+
+void OcclusionCuller::BeginFrame(const Matrix4x4& _viewProjectionMatrix)
+{
+	viewProjection = _viewProjectionMatrix;
+	occluders.clear();
+}
+
+void OcclusionCuller::AddOccluder(const Vector3* _positions, uint32_t _triangleCount, const Matrix4x4& _worldMatrix)
+{
+	uint32_t firstTriangle = occluders.empty() ? 0 : occluders.back().firstTriangle + occluders.back().triangleCount;
+	occluders.push_back({ _positions, _triangleCount, firstTriangle, Multiply(_worldMatrix, viewProjection) });
+}
+
+void OcclusionCuller::RenderOccluders()
+{
+	SetupTriangles();
+
+	//三角形をタイルへ振り分ける 番号順に積むのでタイル内の描画順は登録順のまま
+	for (std::vector<uint32_t>& bin : tileBins)
+	{
+		bin.clear();
+	}
+	stats.occluderTriangles = 0;
+	for (uint32_t index = 0; index < triangles.size(); index++)
+	{
+		const ScreenTriangle& triangle = triangles[index];
+		if (!triangle.isValid)
+		{
+			continue;
+		}
+		stats.occluderTriangles++;
+		for (int32_t tileY = triangle.minY / int32_t(kTileHeight); tileY <= triangle.maxY / int32_t(kTileHeight); tileY++)
+		{
+			for (int32_t tileX = triangle.minX / int32_t(kTileWidth); tileX <= triangle.maxX / int32_t(kTileWidth); tileX++)
+			{
+				tileBins[tileY * tileCountX + tileX].push_back(index);
+			}
+		}
+	}
+
+	std::fill(hiZ[0].begin(), hiZ[0].end(), 1.0f);
+	const uint32_t tileCount = tileCountX * tileCountY;
+	if (threadPool != nullptr)
+	{
+		threadPool->ParallelFor(tileCount, [this](uint32_t _tile) { RasterizeTile(_tile); });
+	}
+	else
+	{
+		for (uint32_t tile = 0; tile < tileCount; tile++)
+		{
+			RasterizeTile(tile);
+		}
+	}
+
+	BuildHiZ();
+}
+
+void OcclusionCuller::SetupTriangles()
+{
+	const uint32_t triangleCount = occluders.empty() ? 0 : occluders.back().firstTriangle + occluders.back().triangleCount;
+	triangles.resize(triangleCount);
+
+	ForEachChunk(threadPool, triangleCount, [&](uint32_t _begin, uint32_t _end)
+		{
+			//チャンクの先頭の三角形を含む遮蔽物から順に進める
+			auto occluder = std::upper_bound(occluders.begin(), occluders.end(), _begin, [](uint32_t _index, const Occluder& _occluder)
+				{
+					return _index < _occluder.firstTriangle;
+				}) - 1;
+
+			for (uint32_t index = _begin; index < _end; index++)
+			{
+				while (occluder->firstTriangle + occluder->triangleCount <= index)
+				{
+					++occluder;
+				}
+				ScreenTriangle& triangle = triangles[index];
+				triangle.isValid = false;
+
+				const Vector3* positions = occluder->positions + size_t(index - occluder->firstTriangle) * 3;
+				Vector3 screen[3];
+				bool isClipped = false;
+				for (int vertex = 0; vertex < 3; vertex++)
+				{
+					Vector4 clip = TransformToClip(positions[vertex], occluder->worldViewProjection);
+					//近クリップ面をまたぐ三角形は切らずに捨てる 遮蔽物が減るだけなので判定は保守的なまま
+					if (IsBehindNear(clip))
+					{
+						isClipped = true;
+						break;
+					}
+					screen[vertex] = Transform(Vector3{ clip.x / clip.w, clip.y / clip.w, clip.z / clip.w }, viewport);
+				}
+				if (isClipped)
+				{
+					continue;
+				}
+
+				float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+				if (std::fabs(area) < kMinArea)
+				{
+					continue;
+				}
+
+				float minX = (std::min)({ screen[0].x, screen[1].x, screen[2].x });
+				float maxX = (std::max)({ screen[0].x, screen[1].x, screen[2].x });
+				float minY = (std::min)({ screen[0].y, screen[1].y, screen[2].y });
+				float maxY = (std::max)({ screen[0].y, screen[1].y, screen[2].y });
+				if (maxX < 0.0f || float(width) <= minX || maxY < 0.0f || float(height) <= minY)
+				{
+					continue;
+				}
+				triangle.minX = (std::max)(int32_t(std::floor(minX)), 0);
+				triangle.maxX = (std::min)(int32_t(std::floor(maxX)), int32_t(width) - 1);
+				triangle.minY = (std::max)(int32_t(std::floor(minY)), 0);
+				triangle.maxY = (std::min)(int32_t(std::floor(maxY)), int32_t(height) - 1);
+
+				//裏向きでも内側が正になるように面積の符号をかける
+				const float sign = 0.0f < area ? 1.0f : -1.0f;
+				for (int edge = 0; edge < 3; edge++)
+				{
+					const Vector3& from = screen[edge];
+					const Vector3& to = screen[(edge + 1) % 3];
+					triangle.edge[edge][0] = (from.y - to.y) * sign;
+					triangle.edge[edge][1] = (to.x - from.x) * sign;
+					triangle.edge[edge][2] = (from.x * to.y - to.x * from.y) * sign;
+				}
+
+				float depthX = ((screen[1].z - screen[0].z) * (screen[2].y - screen[0].y) - (screen[2].z - screen[0].z) * (screen[1].y - screen[0].y)) / area;
+				float depthY = ((screen[2].z - screen[0].z) * (screen[1].x - screen[0].x) - (screen[1].z - screen[0].z) * (screen[2].x - screen[0].x)) / area;
+				triangle.depth[0] = depthX;
+				triangle.depth[1] = depthY;
+				triangle.depth[2] = screen[0].z - depthX * screen[0].x - depthY * screen[0].y;
+				triangle.isValid = true;
+			}
+		});
+}
+
+void OcclusionCuller::RasterizeTile(uint32_t _tile)
+{
+	const int32_t tileMinX = int32_t((_tile % tileCountX) * kTileWidth);
+	const int32_t tileMinY = int32_t((_tile / tileCountX) * kTileHeight);
+	const int32_t tileMaxX = tileMinX + int32_t(kTileWidth) - 1;
+	const int32_t tileMaxY = tileMinY + int32_t(kTileHeight) - 1;
+	float* depthBuffer = hiZ[0].data();
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (uint32_t index : tileBins[_tile])
+	{
+		const ScreenTriangle& triangle = triangles[index];
+		//4画素単位で処理するので左端を4の倍数にそろえる タイル幅も4の倍数なのではみ出さない
+		const int32_t minX = (std::max)(triangle.minX, tileMinX) & ~3;
+		const int32_t maxX = (std::min)(triangle.maxX, tileMaxX);
+		const int32_t minY = (std::max)(triangle.minY, tileMinY);
+		const int32_t maxY = (std::min)(triangle.maxY, tileMaxY);
+
+		const __m128 edgeA[3] = { _mm_set1_ps(triangle.edge[0][0]), _mm_set1_ps(triangle.edge[1][0]), _mm_set1_ps(triangle.edge[2][0]) };
+		const __m128 depthA = _mm_set1_ps(triangle.depth[0]);
+
+		for (int32_t y = minY; y <= maxY; y++)
+		{
+			//画素の中心で評価する
+			const float centerY = float(y) + 0.5f;
+			__m128 edgeRow[3];
+			for (int edge = 0; edge < 3; edge++)
+			{
+				edgeRow[edge] = _mm_set1_ps(triangle.edge[edge][1] * centerY + triangle.edge[edge][2]);
+			}
+			const __m128 depthRow = _mm_set1_ps(triangle.depth[1] * centerY + triangle.depth[2]);
+			float* row = depthBuffer + size_t(y) * width;
+
+			for (int32_t x = minX; x <= maxX; x += 4)
+			{
+				__m128 centerX = _mm_add_ps(_mm_set1_ps(float(x)), laneOffsets);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], centerX), edgeRow[0]), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], centerX), edgeRow[1]), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], centerX), edgeRow[2]), zero));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				__m128 depth = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(depthA, centerX), depthRow), zero), one);
+				__m128 previous = _mm_loadu_ps(row + x);
+				__m128 nearer = _mm_min_ps(previous, depth);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, previous)));
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildHiZ()
+{
+	for (size_t level = 1; level < hiZ.size(); level++)
+	{
+		const std::vector<float>& source = hiZ[level - 1];
+		const uint32_t sourceWidth = hiZWidths[level - 1];
+		const uint32_t sourceHeight = hiZHeights[level - 1];
+		const uint32_t levelWidth = hiZWidths[level];
+		const uint32_t levelHeight = hiZHeights[level];
+		std::vector<float>& destination = hiZ[level];
+		for (uint32_t y = 0; y < levelHeight; y++)
+		{
+			//元が奇数の大きさなら最後のテクセルが余りの1行も受け持つ 落とすと隠れる側に振れる
+			const uint32_t y0 = y * 2;
+			const uint32_t y1 = y + 1 == levelHeight ? sourceHeight - 1 : y0 + 1;
+			for (uint32_t x = 0; x < levelWidth; x++)
+			{
+				const uint32_t x0 = x * 2;
+				const uint32_t x1 = x + 1 == levelWidth ? sourceWidth - 1 : x0 + 1;
+				float maxDepth = 0.0f;
+				for (uint32_t sourceY = y0; sourceY <= y1; sourceY++)
+				{
+					for (uint32_t sourceX = x0; sourceX <= x1; sourceX++)
+					{
+						maxDepth = (std::max)(maxDepth, source[size_t(sourceY) * sourceWidth + sourceX]);
+					}
+				}
+				destination[size_t(y) * levelWidth + x] = maxDepth;
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const AABB& _aabb) const
+{
+	float minX = float(width);
+	float maxX = -1.0f;
+	float minY = float(height);
+	float maxY = -1.0f;
+	float minDepth = 1.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		Vector3 point = {
+			(corner & 1) ? _aabb.max.x : _aabb.min.x,
+			(corner & 2) ? _aabb.max.y : _aabb.min.y,
+			(corner & 4) ? _aabb.max.z : _aabb.min.z };
+		Vector4 clip = TransformToClip(point, viewProjection);
+		if (IsBehindNear(clip))
+		{
+			return true;
+		}
+		Vector3 screen = Transform(Vector3{ clip.x / clip.w, clip.y / clip.w, clip.z / clip.w }, viewport);
+		minX = (std::min)(minX, screen.x);
+		maxX = (std::max)(maxX, screen.x);
+		minY = (std::min)(minY, screen.y);
+		maxY = (std::max)(maxY, screen.y);
+		minDepth = (std::min)(minDepth, screen.z);
+	}
+	//画面外のものは視錐台カリングに任せる
+	if (maxX < 0.0f || float(width) <= minX || maxY < 0.0f || float(height) <= minY)
+	{
+		return true;
+	}
+	//遮蔽物は画素の中心で塗っているので，縁の画素は半分までしか覆われていないことがある
+	//1画素広げて覆われていない隣の画素も見る
+	minX = (std::max)(minX - 1.0f, 0.0f);
+	minY = (std::max)(minY - 1.0f, 0.0f);
+	maxX = (std::min)(maxX + 1.0f, float(width - 1));
+	maxY = (std::min)(maxY + 1.0f, float(height - 1));
+
+	//矩形が縦横3テクセル以内に収まる段を選ぶ
+	uint32_t level = 0;
+	const float size = (std::max)(maxX - minX, maxY - minY);
+	while (level + 1 < hiZ.size() && float(2u << level) < size)
+	{
+		level++;
+	}
+	const uint32_t levelWidth = hiZWidths[level];
+	const uint32_t levelHeight = hiZHeights[level];
+	//段の外にはみ出した画素は，余りを受け持つ最後のテクセルに含まれている
+	const uint32_t texelMinX = (std::min)(uint32_t(minX) >> level, levelWidth - 1);
+	const uint32_t texelMaxX = (std::min)(uint32_t(maxX) >> level, levelWidth - 1);
+	const uint32_t texelMinY = (std::min)(uint32_t(minY) >> level, levelHeight - 1);
+	const uint32_t texelMaxY = (std::min)(uint32_t(maxY) >> level, levelHeight - 1);
+
+	float maxDepth = 0.0f;
+	for (uint32_t y = texelMinY; y <= texelMaxY; y++)
+	{
+		for (uint32_t x = texelMinX; x <= texelMaxX; x++)
+		{
+			maxDepth = (std::max)(maxDepth, hiZ[level][size_t(y) * levelWidth + x]);
+		}
+	}
+	//最も手前の点が遮蔽物の最も奥より奥なら隠れている
+	return minDepth <= maxDepth;
+}
+
+void OcclusionCuller::IsVisible(const AABB* _aabbs, uint32_t _count, bool* _results)
+{
+	ForEachChunk(threadPool, _count, [&](uint32_t _begin, uint32_t _end)
+		{
+			for (uint32_t index = _begin; index < _end; index++)
+			{
+				_results[index] = IsVisible(_aabbs[index]);
+			}
+		});
+	stats.tested = _count;
+	stats.occluded = static_cast<uint32_t>(std::count(_results, _results + _count, false));
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "MyLib.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/// <summary>
+/// オクルージョンカリングの統計 (デバッグ表示用)
+/// </summary>
+struct OcclusionStats
+{
+	uint32_t occluderTriangles;	//深度バッファに描いた三角形数 (近クリップ面をまたぐものは除く)
+	uint32_t tested;			//判定した数
+	uint32_t occluded;			//隠れていた数
+};
+
+/// <summary>
+/// 低解像度の深度バッファをCPUで描くオクルージョンカリング
+/// 遮蔽物 (簡略化したメッシュ) をタイルごとにSSEで4画素ずつラスタライズし，
+/// 奥側の深度を残して縮小したピラミッド (Hi-Z) で対象のAABBの矩形を1回で判定する
+/// 深度は0が手前，1が奥 (D3Dと同じ)
+/// </summary>
+class OcclusionCuller
+{
+public:
+	/// <param name="_width">深度バッファの幅 タイル幅の倍数</param>
+	/// <param name="_height">深度バッファの高さ タイル高さの倍数</param>
+	/// <param name="_threadPool">並列化に使う nullptrなら単一スレッド</param>
+	OcclusionCuller(uint32_t _width, uint32_t _height, ThreadPool* _threadPool);
+
+	/// <summary>
+	/// 遮蔽物を登録し直す準備をする
+	/// </summary>
+	void BeginFrame(const Matrix4x4& _viewProjectionMatrix);
+	/// <summary>
+	/// 遮蔽物を登録する 向きは問わない (裏面も遮る)
+	/// </summary>
+	/// <param name="_positions">三角形リストの頂点 RenderOccludersまで保持すること</param>
+	/// <param name="_triangleCount">三角形数</param>
+	/// <param name="_worldMatrix">ワールド行列</param>
+	void AddOccluder(const Vector3* _positions, uint32_t _triangleCount, const Matrix4x4& _worldMatrix);
+	/// <summary>
+	/// 登録した遮蔽物を深度バッファに描き，Hi-Zを作る
+	/// </summary>
+	void RenderOccluders();
+
+	/// <summary>
+	/// AABBが見えている可能性があるか 近クリップ面をまたぐものや画面外のものは見えている扱いにする
+	/// </summary>
+	bool IsVisible(const AABB& _aabb) const;
+	/// <summary>
+	/// 複数のAABBをまとめて判定する 統計はここで数える
+	/// </summary>
+	/// <param name="_results">AABBの数だけ書き込む</param>
+	void IsVisible(const AABB* _aabbs, uint32_t _count, bool* _results);
+
+	uint32_t GetWidth() const { return width; }
+	uint32_t GetHeight() const { return height; }
+	/// <summary>
+	/// 描いた深度バッファ (デバッグ表示用)
+	/// </summary>
+	const std::vector<float>& GetDepthBuffer() const { return hiZ[0]; }
+	const OcclusionStats& GetStats() const { return stats; }
+
+private:
+	/// <summary>
+	/// スクリーン空間の三角形 辺関数と深度の平面の係数を持つ
+	/// </summary>
+	struct ScreenTriangle
+	{
+		float edge[3][3];	//辺ごとの a, b, c (ax + by + c >= 0 が内側)
+		float depth[3];		//z = a x + b y + c
+		int32_t minX, minY, maxX, maxY;
+		bool isValid;
+	};
+
+	struct Occluder
+	{
+		const Vector3* positions;
+		uint32_t triangleCount;
+		uint32_t firstTriangle;
+		Matrix4x4 worldViewProjection;
+	};
+
+	void SetupTriangles();
+	void RasterizeTile(uint32_t _tile);
+	void BuildHiZ();
+
+	ThreadPool* threadPool;
+	uint32_t width;
+	uint32_t height;
+	uint32_t tileCountX;
+	uint32_t tileCountY;
+
+	Matrix4x4 viewProjection;
+	Matrix4x4 viewport;
+	std::vector<Occluder> occluders;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<uint32_t>> tileBins;	//タイルごとに重なる三角形番号
+
+	std::vector<std::vector<float>> hiZ;			//[0]が深度バッファ 段が上がるごとに縦横半分で，4画素 (奇数の端は余りも含む) の最も奥の深度
+	std::vector<uint32_t> hiZWidths;
+	std::vector<uint32_t> hiZHeights;
+
+	OcclusionStats stats;
+};
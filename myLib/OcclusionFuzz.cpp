@@ -0,0 +1,176 @@
+#include "OcclusionFuzz.h"
+#include "OcclusionCulling.h"
+#include "MyLib.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const float kFovY = 0.8f;
+	const float kNearClip = 0.1f;
+	const float kFarClip = 100.0f;
+	//場面ごとの遮蔽物の四角形とAABBの数
+	const uint32_t kQuads = 8;
+	const uint32_t kBoxes = 500;
+
+	/// <summary>
+	/// 深度バッファの矩形の全画素の最も奥の深度で判定する IsVisibleと同じく矩形を1画素広げる
+	/// </summary>
+	bool IsVisibleByDepthBuffer(const OcclusionCuller& _culler, const Matrix4x4& _viewProjection, const AABB& _aabb)
+	{
+		const uint32_t width = _culler.GetWidth();
+		const uint32_t height = _culler.GetHeight();
+		const Matrix4x4 viewport = MakeViewportMatrix(0.0f, 0.0f, float(width), float(height), 0.0f, 1.0f);
+		const Matrix4x4& m = _viewProjection;
+		float minX = float(width);
+		float maxX = -1.0f;
+		float minY = float(height);
+		float maxY = -1.0f;
+		float minDepth = 1.0f;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			Vector3 point = {
+				(corner & 1) ? _aabb.max.x : _aabb.min.x,
+				(corner & 2) ? _aabb.max.y : _aabb.min.y,
+				(corner & 4) ? _aabb.max.z : _aabb.min.z };
+			float w = point.x * m.m[0][3] + point.y * m.m[1][3] + point.z * m.m[2][3] + m.m[3][3];
+			if (w <= 0.0f)
+			{
+				return true;
+			}
+			Vector3 screen = Transform(Transform(point, _viewProjection), viewport);
+			if (screen.z < 0.0f)
+			{
+				return true;
+			}
+			minX = (std::min)(minX, screen.x);
+			maxX = (std::max)(maxX, screen.x);
+			minY = (std::min)(minY, screen.y);
+			maxY = (std::max)(maxY, screen.y);
+			minDepth = (std::min)(minDepth, screen.z);
+		}
+		if (maxX < 0.0f || float(width) <= minX || maxY < 0.0f || float(height) <= minY)
+		{
+			return true;
+		}
+		const uint32_t pixelMinX = uint32_t((std::max)(minX - 1.0f, 0.0f));
+		const uint32_t pixelMinY = uint32_t((std::max)(minY - 1.0f, 0.0f));
+		const uint32_t pixelMaxX = uint32_t((std::min)(maxX + 1.0f, float(width - 1)));
+		const uint32_t pixelMaxY = uint32_t((std::min)(maxY + 1.0f, float(height - 1)));
+
+		const std::vector<float>& depthBuffer = _culler.GetDepthBuffer();
+		float maxDepth = 0.0f;
+		for (uint32_t y = pixelMinY; y <= pixelMaxY; y++)
+		{
+			for (uint32_t x = pixelMinX; x <= pixelMaxX; x++)
+			{
+				maxDepth = (std::max)(maxDepth, depthBuffer[size_t(y) * width + x]);
+			}
+		}
+		return minDepth <= maxDepth;
+	}
+}
+
+OcclusionFuzzResult FuzzOcclusionCulling(uint32_t _seed, uint32_t _scenes)
+{
+	//96は3から1，160は5から2，224は7から3と3から1へ縮めるときに奇数になる
+	const uint32_t kSizes[][2] = { { 96, 64 }, { 160, 96 }, { 224, 160 }, { 256, 128 } };
+	std::mt19937 randomEngine(_seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	OcclusionFuzzResult result{};
+	std::vector<Vector3> quads;
+	std::vector<AABB> boxes(kBoxes);
+	std::unique_ptr<bool[]> results = std::make_unique<bool[]>(kBoxes);
+	for (const auto& size : kSizes)
+	{
+		const uint32_t width = size[0];
+		const uint32_t height = size[1];
+		const float aspectRatio = float(width) / float(height);
+		const float tanHalfFov = std::tan(kFovY * 0.5f);
+		const Matrix4x4 viewProjection = MakePerspectiveFovMatrix(kFovY, aspectRatio, kNearClip, kFarClip);
+		OcclusionCuller culler(width, height, nullptr);
+
+		//画素の座標と奥行きからワールドの点を作る カメラは原点から+zを向く
+		auto unproject = [&](float _pixelX, float _pixelY, float _z)
+			{
+				float ndcX = _pixelX / float(width) * 2.0f - 1.0f;
+				float ndcY = 1.0f - _pixelY / float(height) * 2.0f;
+				return Vector3{ ndcX * _z * tanHalfFov * aspectRatio, ndcY * _z * tanHalfFov, _z };
+			};
+		auto addQuad = [&](float _left, float _top, float _right, float _bottom, float _z)
+			{
+				Vector3 topLeft = unproject(_left, _top, _z);
+				Vector3 topRight = unproject(_right, _top, _z);
+				Vector3 bottomLeft = unproject(_left, _bottom, _z);
+				Vector3 bottomRight = unproject(_right, _bottom, _z);
+				quads.insert(quads.end(), { topLeft, topRight, bottomRight, topLeft, bottomRight, bottomLeft });
+			};
+
+		for (uint32_t scene = 0; scene < _scenes; scene++)
+		{
+			quads.clear();
+			//画面全体を覆い，右端か下端だけ数画素残す壁
+			const float wallZ = 5.0f + unit(randomEngine) * 5.0f;
+			const float gap = 1.0f + float(randomEngine() % 8);
+			if (scene % 2 == 0)
+			{
+				addQuad(-8.0f, -8.0f, float(width) - gap, float(height) + 8.0f, wallZ);
+			}
+			else
+			{
+				addQuad(-8.0f, -8.0f, float(width) + 8.0f, float(height) - gap, wallZ);
+			}
+			for (uint32_t quad = 0; quad < kQuads; quad++)
+			{
+				float left = unit(randomEngine) * float(width);
+				float top = unit(randomEngine) * float(height);
+				float quadWidth = 4.0f + unit(randomEngine) * float(width) * 0.5f;
+				float quadHeight = 4.0f + unit(randomEngine) * float(height) * 0.5f;
+				addQuad(left, top, left + quadWidth, top + quadHeight, 2.0f + unit(randomEngine) * 20.0f);
+			}
+			culler.BeginFrame(viewProjection);
+			culler.AddOccluder(quads.data(), static_cast<uint32_t>(quads.size() / 3), MakeIdentity4x4());
+			culler.RenderOccluders();
+
+			//半分は右端か下端に寄せる 大きさは最上段まで選ばれるように画面の大きさまで振る
+			for (AABB& box : boxes)
+			{
+				float boxSize = 1.0f + unit(randomEngine) * float((std::max)(width, height));
+				float centerX = unit(randomEngine) * float(width);
+				float centerY = unit(randomEngine) * float(height);
+				if (randomEngine() % 2 == 0)
+				{
+					if (scene % 2 == 0)
+					{
+						centerX = float(width) - unit(randomEngine) * boxSize * 0.5f;
+					}
+					else
+					{
+						centerY = float(height) - unit(randomEngine) * boxSize * 0.5f;
+					}
+				}
+				float z = 1.0f + unit(randomEngine) * 40.0f;
+				float depth = 0.1f + unit(randomEngine) * 2.0f;
+				Vector3 nearMin = unproject(centerX - boxSize * 0.5f, centerY + boxSize * 0.5f, z);
+				Vector3 nearMax = unproject(centerX + boxSize * 0.5f, centerY - boxSize * 0.5f, z);
+				box.min = { nearMin.x, nearMin.y, z };
+				box.max = { nearMax.x, nearMax.y, z + depth };
+			}
+			culler.IsVisible(boxes.data(), kBoxes, results.get());
+
+			for (uint32_t index = 0; index < kBoxes; index++)
+			{
+				const bool reference = IsVisibleByDepthBuffer(culler, viewProjection, boxes[index]);
+				result.tested++;
+				result.occluded += results[index] ? 0 : 1;
+				result.referenceOccluded += reference ? 0 : 1;
+				result.violations += (reference && !results[index]) ? 1 : 0;
+			}
+		}
+	}
+	return result;
+}
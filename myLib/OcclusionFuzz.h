@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+/// <summary>
+/// FuzzOcclusionCullingの結果
+/// </summary>
+struct OcclusionFuzzResult
+{
+	uint32_t tested;			//判定したAABBの数
+	uint32_t occluded;			//Hi-Zで隠れていると判定した数
+	uint32_t referenceOccluded;	//深度バッファの矩形の全画素と比べて隠れていた数
+	uint32_t violations;		//深度バッファでは見えているのにHi-Zで隠れていると判定した数 (保守的でない)
+};
+
+/// <summary>
+/// 乱数の遮蔽物とAABBの場面を作り，OcclusionCullerのHi-Zの判定を深度バッファの矩形の全画素と比べる
+/// 縮小の途中で奇数の大きさになる解像度 (96や160など) と，画面の右端・下端だけ覆われていない壁を含める
+/// 同じ_seedなら同じ場面を調べる
+/// </summary>
+/// <param name="_scenes">解像度ごとの場面の数</param>
+OcclusionFuzzResult FuzzOcclusionCulling(uint32_t _seed, uint32_t _scenes);
@@ -0,0 +1,673 @@
+#include "PhysicsWorld.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace
+{
+	//これより遅く近づく接触では跳ね返らせない (静止した物体が震えないように)
+	const float kRestitutionThreshold = 1.0f;
+	//ボール同士の探索に使うグリッドのセルの大きさ (最大半径に対する倍率)
+	//探索半径は 自分の半径 + 移動量 + 相手の最大半径 + 相手の最大移動量 + 組の余裕 なので
+	//移動量を最大半径の1/4，余裕を半分までにすれば最大半径の3倍に収まる それより速いボールは広い範囲を別に調べる
+	const float kCellSizeScale = 3.0f;
+	const float kReachScale = 0.25f;
+	const float kPairSkinScale = 0.5f;
+
+	uint32_t FindRoot(std::vector<uint32_t>& _parents, uint32_t _index)
+	{
+		while (_parents[_index] != _index)
+		{
+			//経路を半分に縮める
+			_parents[_index] = _parents[_parents[_index]];
+			_index = _parents[_index];
+		}
+		return _index;
+	}
+}
+
+PhysicsWorld::PhysicsWorld(ThreadPool* _threadPool) :
+	threadPool(_threadPool),
+	grid(1.0f, 1024),
+	maxRadius(0.0f),
+	pairSkin(0.0f),
+	arePairsDirty(true),
+	islandCount(0),
+	coloredBegin(0),
+	colorCount(0)
+{
+}
+
+uint32_t PhysicsWorld::AddBall(const Ball& _ball)
+{
+	balls.position.push_back(_ball.position);
+	balls.velocity.push_back(_ball.velocity);
+	balls.force.push_back({});
+	balls.inverseMass.push_back(0.0f < _ball.mass ? 1.0f / _ball.mass : 0.0f);
+	balls.radius.push_back(_ball.radius);
+	balls.color.push_back(_ball.color);
+	maxRadius = (std::max)(maxRadius, _ball.radius);
+	arePairsDirty = true;
+	return static_cast<uint32_t>(balls.position.size() - 1);
+}
+
+uint32_t PhysicsWorld::AddSpring(const Spring& _spring, uint32_t _ball)
+{
+	assert(_ball < GetBallCount());
+	springs.anchor.push_back(_spring.anchor);
+	springs.naturalLength.push_back(_spring.naturalLength);
+	springs.stiffness.push_back(_spring.stiffness);
+	springs.dampingCoefficient.push_back(_spring.dampingCoefficient);
+	springs.ball.push_back(_ball);
+	return static_cast<uint32_t>(springs.ball.size() - 1);
+}
+
+uint32_t PhysicsWorld::AddPendulum(const Pendulum& _pendulum)
+{
+	pendulums.anchor.push_back(_pendulum.anchor);
+	pendulums.length.push_back(_pendulum.length);
+	pendulums.angle.push_back(_pendulum.angle);
+	pendulums.angularVelocity.push_back(_pendulum.angularVelocity);
+	pendulums.angularAcceleration.push_back(_pendulum.angularAcceleration);
+	return static_cast<uint32_t>(pendulums.angle.size() - 1);
+}
+
+uint32_t PhysicsWorld::AddConicalPendulum(const ConicalPendulum& _pendulum)
+{
+	conicalPendulums.anchor.push_back(_pendulum.anchor);
+	conicalPendulums.length.push_back(_pendulum.length);
+	conicalPendulums.halfApexAngle.push_back(_pendulum.halfApexAngle);
+	conicalPendulums.angle.push_back(_pendulum.angle);
+	conicalPendulums.angularVelocity.push_back(_pendulum.angularVelocity);
+	return static_cast<uint32_t>(conicalPendulums.angle.size() - 1);
+}
+
+void PhysicsWorld::AddStaticPlane(const Plane& _plane)
+{
+	planes.push_back(_plane);
+}
+
+void PhysicsWorld::Clear()
+{
+	balls = {};
+	springs = {};
+	pendulums = {};
+	conicalPendulums = {};
+	planes.clear();
+	contacts.clear();
+	pairs.clear();
+	arePairsDirty = true;
+	islandStarts.clear();
+	colorStarts.clear();
+	islandCount = 0;
+	coloredBegin = 0;
+	colorCount = 0;
+	maxRadius = 0.0f;
+}
+
+Ball PhysicsWorld::GetBall(uint32_t _ball) const
+{
+	Ball ball{};
+	ball.position = balls.position[_ball];
+	ball.velocity = balls.velocity[_ball];
+	ball.mass = 0.0f < balls.inverseMass[_ball] ? 1.0f / balls.inverseMass[_ball] : 0.0f;
+	ball.radius = balls.radius[_ball];
+	ball.color = balls.color[_ball];
+	return ball;
+}
+
+Pendulum PhysicsWorld::GetPendulum(uint32_t _pendulum) const
+{
+	return { pendulums.anchor[_pendulum], pendulums.length[_pendulum], pendulums.angle[_pendulum], pendulums.angularVelocity[_pendulum], pendulums.angularAcceleration[_pendulum] };
+}
+
+ConicalPendulum PhysicsWorld::GetConicalPendulum(uint32_t _pendulum) const
+{
+	return { conicalPendulums.anchor[_pendulum], conicalPendulums.length[_pendulum], conicalPendulums.halfApexAngle[_pendulum], conicalPendulums.angle[_pendulum], conicalPendulums.angularVelocity[_pendulum] };
+}
+
+template <class Func>
+void PhysicsWorld::ForEachChunk(uint32_t _count, const Func& _func)
+{
+	uint32_t chunkCount = (_count + kChunkSize - 1) / kChunkSize;
+	auto runChunk = [&](uint32_t _chunk)
+		{
+			_func(_chunk, _chunk * kChunkSize, (std::min)((_chunk + 1) * kChunkSize, _count));
+		};
+	if (threadPool != nullptr && 1 < chunkCount)
+	{
+		threadPool->ParallelFor(chunkCount, runChunk);
+	}
+	else
+	{
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			runChunk(chunk);
+		}
+	}
+}
+
+void PhysicsWorld::Step(float _deltaTime)
+{
+	assert(0.0f < _deltaTime);
+	ApplyForces(_deltaTime);
+	FindContacts(_deltaTime);
+	BuildIslands();
+
+	//小さいアイランドはそれぞれ1スレッドで反復まで解き切る
+	uint32_t smallIslandCount = static_cast<uint32_t>(islandStarts.size() - 1);
+	if (threadPool != nullptr && 1 < smallIslandCount)
+	{
+		threadPool->ParallelFor(smallIslandCount, [&](uint32_t _island) { SolveIsland(_island); });
+	}
+	else
+	{
+		for (uint32_t island = 0; island < smallIslandCount; island++)
+		{
+			SolveIsland(island);
+		}
+	}
+	SolveColoredContacts();
+
+	IntegratePositions(_deltaTime);
+	StepPendulums(_deltaTime);
+}
+
+void PhysicsWorld::ApplyForces(float _deltaTime)
+{
+	//ばねは同じボールにつながることがあるので順に足す
+	for (uint32_t spring = 0; spring < springs.ball.size(); spring++)
+	{
+		uint32_t ball = springs.ball[spring];
+		Vector3 diff = balls.position[ball] - springs.anchor[spring];
+		float length = Length(diff);
+		if (length != 0.0f)
+		{
+			//自然長の位置からのずれに比例して引き戻す
+			Vector3 restPosition = springs.anchor[spring] + diff * (springs.naturalLength[spring] / length);
+			balls.force[ball] += -springs.stiffness[spring] * (balls.position[ball] - restPosition);
+		}
+		balls.force[ball] += -springs.dampingCoefficient[spring] * balls.velocity[ball];
+	}
+
+	//速度を先に更新する (半陰的オイラー)
+	ForEachChunk(GetBallCount(), [&](uint32_t, uint32_t _begin, uint32_t _end)
+		{
+			for (uint32_t ball = _begin; ball < _end; ball++)
+			{
+				float inverseMass = balls.inverseMass[ball];
+				if (inverseMass == 0.0f)
+				{
+					continue;
+				}
+				balls.velocity[ball] += (settings.gravity + balls.force[ball] * inverseMass) * _deltaTime;
+				balls.force[ball] = {};
+			}
+		});
+}
+
+void PhysicsWorld::FindContacts(float _deltaTime)
+{
+	const uint32_t ballCount = GetBallCount();
+
+	//1ステップで動ける距離
+	reaches.resize(ballCount);
+	ForEachChunk(ballCount, [&](uint32_t, uint32_t _begin, uint32_t _end)
+		{
+			for (uint32_t ball = _begin; ball < _end; ball++)
+			{
+				reaches[ball] = Length(balls.velocity[ball]) * _deltaTime;
+			}
+		});
+
+	//組を作ってから動いた距離と今の移動量の和が，組を作ったときの移動量 + 余裕の半分 に収まっていれば
+	//組に入っていないボール同士はこのステップで触れない
+	uint32_t chunkCount = (ballCount + kChunkSize - 1) / kChunkSize;
+	bool isPairsExpired = arePairsDirty;
+	if (!isPairsExpired)
+	{
+		chunkExpired.assign(chunkCount, 0);
+		const float margin = (pairSkin - settings.penetrationSlop) * 0.5f;
+		ForEachChunk(ballCount, [&](uint32_t _chunk, uint32_t _begin, uint32_t _end)
+			{
+				for (uint32_t ball = _begin; ball < _end; ball++)
+				{
+					if (pairReaches[ball] + margin < Length(balls.position[ball] - pairPositions[ball]) + reaches[ball])
+					{
+						chunkExpired[_chunk] = 1;
+						return;
+					}
+				}
+			});
+		isPairsExpired = std::find(chunkExpired.begin(), chunkExpired.end(), 1) != chunkExpired.end();
+	}
+	if (isPairsExpired)
+	{
+		BuildPairs();
+	}
+
+	auto prepareContact = [&](BallContact& _contact)
+		{
+			float inverseMassA = balls.inverseMass[_contact.ballA];
+			float inverseMassB = _contact.ballB == kStaticBody ? 0.0f : balls.inverseMass[_contact.ballB];
+			Vector3 velocityB = _contact.ballB == kStaticBody ? Vector3{} : balls.velocity[_contact.ballB];
+			float normalVelocity = Dot(balls.velocity[_contact.ballA] - velocityB, _contact.normal);
+
+			_contact.normalMass = 1.0f / (inverseMassA + inverseMassB);
+			_contact.accumulatedImpulse = 0.0f;
+			if (0.0f < _contact.separation)
+			{
+				//離れている分だけは近づいてよい
+				_contact.targetVelocity = -_contact.separation / _deltaTime;
+			}
+			else
+			{
+				//めり込みを少しずつ戻す
+				_contact.targetVelocity = settings.baumgarte * (std::max)(-_contact.separation - settings.penetrationSlop, 0.0f) / _deltaTime;
+			}
+			//触れているときだけ跳ね返す 離れているうちに跳ね返すと手前で止まって見える
+			if (_contact.separation <= settings.penetrationSlop && normalVelocity < -kRestitutionThreshold)
+			{
+				_contact.targetVelocity = (std::max)(_contact.targetVelocity, -settings.restitution * normalVelocity);
+			}
+		};
+
+	//平面との接触
+	chunkContacts.resize(chunkCount);
+	ForEachChunk(ballCount, [&](uint32_t _chunk, uint32_t _begin, uint32_t _end)
+		{
+			std::vector<BallContact>& output = chunkContacts[_chunk];
+			output.clear();
+			for (uint32_t ball = _begin; ball < _end; ball++)
+			{
+				if (balls.inverseMass[ball] == 0.0f)
+				{
+					continue;
+				}
+				const Vector3& position = balls.position[ball];
+				for (const Plane& plane : planes)
+				{
+					float separation = Dot(plane.normal, position) - plane.distance - balls.radius[ball];
+					float approach = (std::max)(-Dot(plane.normal, balls.velocity[ball]) * _deltaTime, 0.0f);
+					if (separation < approach + settings.penetrationSlop)
+					{
+						BallContact contact{ ball, kStaticBody, plane.normal, separation, 0.0f, 0.0f, 0.0f };
+						prepareContact(contact);
+						output.push_back(contact);
+					}
+				}
+			}
+		});
+
+	//ボール同士の接触は組の候補から選ぶ
+	const uint32_t pairCount = static_cast<uint32_t>(pairs.size());
+	uint32_t pairChunkCount = (pairCount + kChunkSize - 1) / kChunkSize;
+	chunkPairContacts.resize(pairChunkCount);
+	ForEachChunk(pairCount, [&](uint32_t _chunk, uint32_t _begin, uint32_t _end)
+		{
+			std::vector<BallContact>& output = chunkPairContacts[_chunk];
+			output.clear();
+			for (uint32_t index = _begin; index < _end; index++)
+			{
+				const BallPair& pair = pairs[index];
+				//ほとんどの組は接触しないので平方根を取る前に2乗の距離で弾く
+				Vector3 diff = balls.position[pair.ballA] - balls.position[pair.ballB];
+				float radius = balls.radius[pair.ballA] + balls.radius[pair.ballB];
+				float limit = radius + reaches[pair.ballA] + reaches[pair.ballB] + settings.penetrationSlop;
+				if (limit * limit <= Dot(diff, diff))
+				{
+					continue;
+				}
+				float distance = Length(diff);
+				//中心が重なっているときは適当な向きに押し出す
+				Vector3 normal = 0.0f < distance ? diff / distance : Vector3{ 0.0f, 1.0f, 0.0f };
+				BallContact contact{ pair.ballA, pair.ballB, normal, distance - radius, 0.0f, 0.0f, 0.0f };
+				prepareContact(contact);
+				output.push_back(contact);
+			}
+		});
+
+	contacts.clear();
+	for (const std::vector<BallContact>& chunk : chunkContacts)
+	{
+		contacts.insert(contacts.end(), chunk.begin(), chunk.end());
+	}
+	for (const std::vector<BallContact>& chunk : chunkPairContacts)
+	{
+		contacts.insert(contacts.end(), chunk.begin(), chunk.end());
+	}
+}
+
+void PhysicsWorld::BuildPairs()
+{
+	const uint32_t ballCount = GetBallCount();
+	const float cellSize = (std::max)(maxRadius * kCellSizeScale, 1.0e-3f);
+	if (grid.GetCellSize() != cellSize || grid.GetTableSize() < ballCount)
+	{
+		grid = SpatialHashGrid(cellSize, (std::max)(ballCount, 1024u));
+	}
+	grid.BuildPoints(balls.position.data(), ballCount, threadPool);
+
+	//reachLimitを超える速いボールは探索範囲がセルに収まらない
+	const float reachLimit = maxRadius * kReachScale;
+	float maxReach = 0.0f;
+	for (float reach : reaches)
+	{
+		maxReach = reach <= reachLimit ? (std::max)(maxReach, reach) : maxReach;
+	}
+	pairSkin = maxRadius * kPairSkinScale;
+
+	uint32_t chunkCount = (ballCount + kChunkSize - 1) / kChunkSize;
+	chunkPairs.resize(chunkCount);
+	chunkKeys.resize(chunkCount);
+	ForEachChunk(ballCount, [&](uint32_t _chunk, uint32_t _begin, uint32_t _end)
+		{
+			std::vector<BallPair>& output = chunkPairs[_chunk];
+			output.clear();
+			//グリッドのセル順に調べると，続くボールの近傍がキャッシュに残っている
+			for (uint32_t order = _begin; order < _end; order++)
+			{
+				const uint32_t ball = grid.GetSortedElements()[order];
+				const Vector3& position = balls.position[ball];
+				const float radius = balls.radius[ball];
+				const bool isStatic = balls.inverseMass[ball] == 0.0f;
+				const float reach = reaches[ball];
+
+				auto addPair = [&](uint32_t _other, const Vector3& _otherPosition)
+					{
+						Vector3 diff = position - _otherPosition;
+						float limit = radius + balls.radius[_other] + reach + reaches[_other] + pairSkin;
+						if (Dot(diff, diff) < limit * limit)
+						{
+							output.push_back({ ball, _other });
+						}
+					};
+
+				if (reach <= reachLimit)
+				{
+					//組は番号の小さい方からだけ作る 速いボールとの組はそちらから作る
+					Sphere range = { position, radius + reach + maxRadius + maxReach + pairSkin };
+					grid.ForEachNeighbor(range, [&](uint32_t _other, const Vector3& _otherPosition)
+						{
+							if (_other <= ball || (isStatic && balls.inverseMass[_other] == 0.0f) || reachLimit < reaches[_other])
+							{
+								return;
+							}
+							addPair(_other, _otherPosition);
+						});
+				}
+				else
+				{
+					//速いボールは探索範囲がセルに収まらないので，重なるセルをすべて調べる
+					//速いボール同士の組は移動量の大きい方 (同じなら番号の小さい方) から作るので，相手の移動量は自分以下になる
+					Sphere range = { position, radius + maxRadius + 2.0f * reach + pairSkin };
+					grid.ForEachNeighborInRange(range, chunkKeys[_chunk], [&](uint32_t _other, const Vector3& _otherPosition)
+						{
+							const float otherReach = reaches[_other];
+							if (_other == ball || (isStatic && balls.inverseMass[_other] == 0.0f) ||
+								reach < otherReach || (reach == otherReach && _other < ball))
+							{
+								return;
+							}
+							addPair(_other, _otherPosition);
+						});
+				}
+			}
+		});
+
+	pairs.clear();
+	for (const std::vector<BallPair>& chunk : chunkPairs)
+	{
+		pairs.insert(pairs.end(), chunk.begin(), chunk.end());
+	}
+	pairPositions = balls.position;
+	pairReaches = reaches;
+	arePairsDirty = false;
+}
+
+void PhysicsWorld::BuildIslands()
+{
+	const uint32_t ballCount = GetBallCount();
+	islandParents.resize(ballCount);
+	for (uint32_t ball = 0; ball < ballCount; ball++)
+	{
+		islandParents[ball] = ball;
+	}
+	//動かないボールは速度が変わらないので，アイランドをつながない
+	for (const BallContact& contact : contacts)
+	{
+		if (contact.ballB == kStaticBody || balls.inverseMass[contact.ballA] == 0.0f || balls.inverseMass[contact.ballB] == 0.0f)
+		{
+			continue;
+		}
+		uint32_t rootA = FindRoot(islandParents, contact.ballA);
+		uint32_t rootB = FindRoot(islandParents, contact.ballB);
+		if (rootA != rootB)
+		{
+			islandParents[rootB] = rootA;
+		}
+	}
+
+	//根ごとに番号を振り，アイランドごとの接触を数える
+	islandIndices.assign(ballCount, UINT32_MAX);
+	contactKeys.resize(contacts.size());
+	islandOffsets.clear();
+	for (size_t index = 0; index < contacts.size(); index++)
+	{
+		const BallContact& contact = contacts[index];
+		uint32_t dynamicBall = balls.inverseMass[contact.ballA] != 0.0f ? contact.ballA : contact.ballB;
+		uint32_t root = FindRoot(islandParents, dynamicBall);
+		if (islandIndices[root] == UINT32_MAX)
+		{
+			islandIndices[root] = static_cast<uint32_t>(islandOffsets.size());
+			islandOffsets.push_back(0);
+		}
+		contactKeys[index] = islandIndices[root];
+		islandOffsets[contactKeys[index]]++;
+	}
+	islandCount = static_cast<uint32_t>(islandOffsets.size());
+
+	//計数ソートの書き込み先 小さいアイランドを前に詰め，大きいアイランドは後ろにまとめる
+	uint32_t coloredCount = 0;
+	for (uint32_t island = 0; island < islandCount; island++)
+	{
+		coloredCount += kColoringThreshold <= islandOffsets[island] ? islandOffsets[island] : 0;
+	}
+	coloredBegin = static_cast<uint32_t>(contacts.size()) - coloredCount;
+	uint32_t smallOffset = 0;
+	uint32_t coloredOffset = coloredBegin;
+	islandStarts.assign(1, 0);
+	for (uint32_t island = 0; island < islandCount; island++)
+	{
+		uint32_t count = islandOffsets[island];
+		if (count < kColoringThreshold)
+		{
+			islandOffsets[island] = smallOffset;
+			smallOffset += count;
+			islandStarts.push_back(smallOffset);
+		}
+		else
+		{
+			islandOffsets[island] = coloredOffset;
+			coloredOffset += count;
+		}
+	}
+
+	sortedContacts.resize(contacts.size());
+	for (size_t index = 0; index < contacts.size(); index++)
+	{
+		sortedContacts[islandOffsets[contactKeys[index]]++] = contacts[index];
+	}
+	contacts.swap(sortedContacts);
+
+	ColorContacts();
+}
+
+void PhysicsWorld::ColorContacts()
+{
+	const uint32_t contactCount = static_cast<uint32_t>(contacts.size());
+	colorStarts.clear();
+	colorCount = 0;
+	if (coloredBegin == contactCount)
+	{
+		return;
+	}
+
+	//貪欲に塗る ボールごとに使った色をビットで覚え，両端のボールで使っていない最小の色にする
+	//動かないボールには書き込まないので，色が同じでも構わない
+	const uint32_t overflowColor = kMaxColors - 1;
+	const uint32_t colorMask = (1u << overflowColor) - 1;
+	ballColors.assign(GetBallCount(), 0);
+	colorStarts.assign(kMaxColors + 1, 0);
+	for (uint32_t index = coloredBegin; index < contactCount; index++)
+	{
+		const BallContact& contact = contacts[index];
+		const bool isDynamicA = balls.inverseMass[contact.ballA] != 0.0f;
+		const bool isDynamicB = contact.ballB != kStaticBody && balls.inverseMass[contact.ballB] != 0.0f;
+		uint32_t used = (isDynamicA ? ballColors[contact.ballA] : 0) | (isDynamicB ? ballColors[contact.ballB] : 0);
+		uint32_t available = ~used & colorMask;
+		uint32_t color = overflowColor;
+		if (available != 0)
+		{
+			color = static_cast<uint32_t>(std::countr_zero(available));
+			if (isDynamicA)
+			{
+				ballColors[contact.ballA] |= 1u << color;
+			}
+			if (isDynamicB)
+			{
+				ballColors[contact.ballB] |= 1u << color;
+			}
+		}
+		contactKeys[index] = color;
+		colorStarts[color + 1]++;
+	}
+
+	//色順に計数ソートする
+	colorStarts[0] = coloredBegin;
+	for (uint32_t color = 0; color < kMaxColors; color++)
+	{
+		colorCount += colorStarts[color + 1] != 0 ? 1 : 0;
+		colorStarts[color + 1] += colorStarts[color];
+	}
+	std::vector<uint32_t>& offsets = islandOffsets;
+	offsets.assign(colorStarts.begin(), colorStarts.end() - 1);
+	for (uint32_t index = coloredBegin; index < contactCount; index++)
+	{
+		sortedContacts[offsets[contactKeys[index]]++] = contacts[index];
+	}
+	std::copy(sortedContacts.begin() + coloredBegin, sortedContacts.end(), contacts.begin() + coloredBegin);
+}
+
+void PhysicsWorld::SolveIsland(uint32_t _island)
+{
+	BallContact* begin = contacts.data() + islandStarts[_island];
+	BallContact* end = contacts.data() + islandStarts[_island + 1];
+	for (uint32_t iteration = 0; iteration < settings.solverIterations; iteration++)
+	{
+		SolveContacts(begin, end);
+	}
+}
+
+void PhysicsWorld::SolveColoredContacts()
+{
+	if (colorStarts.empty())
+	{
+		return;
+	}
+	//同じ色の接触はボールを共有しないので，順番を気にせず並列に解ける
+	for (uint32_t iteration = 0; iteration < settings.solverIterations; iteration++)
+	{
+		for (uint32_t color = 0; color < kMaxColors; color++)
+		{
+			BallContact* begin = contacts.data() + colorStarts[color];
+			uint32_t count = colorStarts[color + 1] - colorStarts[color];
+			if (color == kMaxColors - 1)
+			{
+				SolveContacts(begin, begin + count);
+				continue;
+			}
+			ForEachChunk(count, [&](uint32_t, uint32_t _begin, uint32_t _end)
+				{
+					SolveContacts(begin + _begin, begin + _end);
+				});
+		}
+	}
+}
+
+void PhysicsWorld::SolveContacts(BallContact* _begin, BallContact* _end)
+{
+	for (BallContact* contact = _begin; contact != _end; contact++)
+	{
+		const bool isStaticB = contact->ballB == kStaticBody;
+		float inverseMassA = balls.inverseMass[contact->ballA];
+		float inverseMassB = isStaticB ? 0.0f : balls.inverseMass[contact->ballB];
+		Vector3 velocityB = isStaticB ? Vector3{} : balls.velocity[contact->ballB];
+		float normalVelocity = Dot(balls.velocity[contact->ballA] - velocityB, contact->normal);
+
+		//累積インパルスが負 (引き寄せ) にならないようにクランプして差分だけ加える
+		float impulse = contact->normalMass * (contact->targetVelocity - normalVelocity);
+		float accumulated = (std::max)(contact->accumulatedImpulse + impulse, 0.0f);
+		impulse = accumulated - contact->accumulatedImpulse;
+		contact->accumulatedImpulse = accumulated;
+
+		//動かないボールは他のアイランドと共有しているので書き込まない
+		if (inverseMassA != 0.0f)
+		{
+			balls.velocity[contact->ballA] += contact->normal * (impulse * inverseMassA);
+		}
+		if (inverseMassB != 0.0f)
+		{
+			balls.velocity[contact->ballB] -= contact->normal * (impulse * inverseMassB);
+		}
+	}
+}
+
+void PhysicsWorld::IntegratePositions(float _deltaTime)
+{
+	ForEachChunk(GetBallCount(), [&](uint32_t, uint32_t _begin, uint32_t _end)
+		{
+			for (uint32_t ball = _begin; ball < _end; ball++)
+			{
+				balls.position[ball] += balls.velocity[ball] * _deltaTime;
+			}
+		});
+}
+
+void PhysicsWorld::StepPendulums(float _deltaTime)
+{
+	float gravity = Length(settings.gravity);
+	for (uint32_t pendulum = 0; pendulum < pendulums.angle.size(); pendulum++)
+	{
+		pendulums.angularAcceleration[pendulum] = -(gravity / pendulums.length[pendulum]) * std::sin(pendulums.angle[pendulum]);
+		pendulums.angularVelocity[pendulum] += pendulums.angularAcceleration[pendulum] * _deltaTime;
+		pendulums.angle[pendulum] += pendulums.angularVelocity[pendulum] * _deltaTime;
+	}
+	for (uint32_t pendulum = 0; pendulum < conicalPendulums.angle.size(); pendulum++)
+	{
+		//重力と張力の合力が向心力になる角速度で回る
+		conicalPendulums.angularVelocity[pendulum] = std::sqrt(gravity / (conicalPendulums.length[pendulum] * std::cos(conicalPendulums.halfApexAngle[pendulum])));
+		conicalPendulums.angle[pendulum] += conicalPendulums.angularVelocity[pendulum] * _deltaTime;
+	}
+}
+
+Vector3 CalculatePendulumPosition(const Pendulum& _pendulum)
+{
+	return {
+		_pendulum.anchor.x + std::sin(_pendulum.angle) * _pendulum.length,
+		_pendulum.anchor.y - std::cos(_pendulum.angle) * _pendulum.length,
+		_pendulum.anchor.z
+	};
+}
+
+Vector3 CalculatePendulumPosition(const ConicalPendulum& _pendulum)
+{
+	float radius = std::sin(_pendulum.halfApexAngle) * _pendulum.length;
+	float height = std::cos(_pendulum.halfApexAngle) * _pendulum.length;
+	return {
+		_pendulum.anchor.x + std::cos(_pendulum.angle) * radius,
+		_pendulum.anchor.y - height,
+		_pendulum.anchor.z - std::sin(_pendulum.angle) * radius
+	};
+}
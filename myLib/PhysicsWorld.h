@@ -0,0 +1,214 @@
+#pragma once
+#include "MyLib.h"
+#include "SpatialHashGrid.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/// <summary>
+/// 物理ワールドの設定
+/// </summary>
+struct PhysicsSettings
+{
+	Vector3 gravity = { 0.0f, -9.8f, 0.0f };
+	float restitution = 0.5f;			//反発係数
+	uint32_t solverIterations = 8;		//逐次インパルスの反復回数
+	float baumgarte = 0.2f;				//めり込みを1ステップで戻す割合
+	float penetrationSlop = 0.005f;		//許容するめり込み
+};
+
+/// <summary>
+/// ボール同士・ボールと平面の接触
+/// 離れていても1ステップ以内に触れうる距離なら作る (スペキュラティブ接触) ので，速いボールも平面をすり抜けない
+/// </summary>
+struct BallContact
+{
+	uint32_t ballA;
+	uint32_t ballB;				//平面との接触ならkStaticBody
+	Vector3 normal;				//BからAへ向かう法線
+	float separation;			//表面間の距離 重なっていれば負
+	float normalMass;			//法線方向の有効質量
+	float targetVelocity;		//法線方向の相対速度の下限
+	float accumulatedImpulse;	//累積インパルス 負にならないようにクランプする
+};
+
+/// <summary>
+/// Ball, Spring, Pendulum, ConicalPendulumをSoAで持ち，固定ステップで進める物理ワールド
+/// 積分は半陰的オイラー法 (速度を更新してから位置を更新する)
+/// ボール同士の接触は余裕を持たせて集めた組の候補から選び，候補はボールが余裕の半分動いたら作り直す
+/// 接触は逐次インパルスで解き，接触でつながったボールの組 (アイランド) ごとにスレッドへ分ける
+/// 接触の多いアイランドは1スレッドでは間に合わないので，ボールを共有しない接触の組に塗り分けて色ごとに並列に解く
+/// </summary>
+class PhysicsWorld
+{
+public:
+	//平面など動かない相手を表すボール番号
+	static const uint32_t kStaticBody = UINT32_MAX;
+
+	/// <param name="_threadPool">並列化に使う nullptrなら単一スレッド</param>
+	explicit PhysicsWorld(ThreadPool* _threadPool);
+
+	/// <summary>
+	/// ボールを追加する massが0以下なら動かないボールになる
+	/// </summary>
+	/// <returns>ボール番号</returns>
+	uint32_t AddBall(const Ball& _ball);
+	/// <summary>
+	/// ボールをつなぐばねを追加する anchorは動かない
+	/// </summary>
+	/// <param name="_ball">ばねの先のボール番号</param>
+	uint32_t AddSpring(const Spring& _spring, uint32_t _ball);
+	uint32_t AddPendulum(const Pendulum& _pendulum);
+	uint32_t AddConicalPendulum(const ConicalPendulum& _pendulum);
+	/// <summary>
+	/// 動かない平面を追加する ボールは法線の向いている側にいるものとする
+	/// </summary>
+	void AddStaticPlane(const Plane& _plane);
+	void Clear();
+
+	/// <summary>
+	/// 1ステップ進める 固定ステップで呼ぶこと
+	/// </summary>
+	void Step(float _deltaTime);
+
+	Ball GetBall(uint32_t _ball) const;
+	void SetBallPosition(uint32_t _ball, const Vector3& _position) { balls.position[_ball] = _position; }
+	void SetBallVelocity(uint32_t _ball, const Vector3& _velocity) { balls.velocity[_ball] = _velocity; }
+	uint32_t GetBallCount() const { return static_cast<uint32_t>(balls.position.size()); }
+	const std::vector<Vector3>& GetBallPositions() const { return balls.position; }
+	Pendulum GetPendulum(uint32_t _pendulum) const;
+	ConicalPendulum GetConicalPendulum(uint32_t _pendulum) const;
+
+	PhysicsSettings& GetSettings() { return settings; }
+	uint32_t GetContactCount() const { return static_cast<uint32_t>(contacts.size()); }
+	uint32_t GetIslandCount() const { return islandCount; }
+	/// <summary>
+	/// 接触の多いアイランドを塗り分けた色の数
+	/// </summary>
+	uint32_t GetColorCount() const { return colorCount; }
+
+private:
+	//接触探索の並列化の単位
+	static const uint32_t kChunkSize = 1024;
+	//これ以上の接触を持つアイランドは塗り分けて解く
+	static const uint32_t kColoringThreshold = 1024;
+	//塗り分けに使う色の数 最後の色は塗り切れなかった接触の受け皿で，順に解く
+	static const uint32_t kMaxColors = 32;
+
+	struct BallPool
+	{
+		std::vector<Vector3> position;
+		std::vector<Vector3> velocity;
+		std::vector<Vector3> force;			//ステップ中に加わる力 (ばねなど)
+		std::vector<float> inverseMass;		//動かないボールは0
+		std::vector<float> radius;
+		std::vector<unsigned int> color;
+	};
+
+	//接触しうるボールの組
+	struct BallPair
+	{
+		uint32_t ballA;
+		uint32_t ballB;
+	};
+
+	struct SpringPool
+	{
+		std::vector<Vector3> anchor;
+		std::vector<float> naturalLength;
+		std::vector<float> stiffness;
+		std::vector<float> dampingCoefficient;
+		std::vector<uint32_t> ball;
+	};
+
+	struct PendulumPool
+	{
+		std::vector<Vector3> anchor;
+		std::vector<float> length;
+		std::vector<float> angle;
+		std::vector<float> angularVelocity;
+		std::vector<float> angularAcceleration;
+	};
+
+	struct ConicalPendulumPool
+	{
+		std::vector<Vector3> anchor;
+		std::vector<float> length;
+		std::vector<float> halfApexAngle;
+		std::vector<float> angle;
+		std::vector<float> angularVelocity;
+	};
+
+	void ApplyForces(float _deltaTime);
+	void FindContacts(float _deltaTime);
+	/// <summary>
+	/// グリッドで近くのボールの組を探し直す 余裕を持たせて集めるので，ボールが余裕の半分動くまで使い回せる
+	/// </summary>
+	void BuildPairs();
+	/// <summary>
+	/// 接触でつながったボールをまとめ，接触をアイランド順に並べ直す
+	/// 接触の多いアイランドは後ろにまとめて色順に並べる
+	/// </summary>
+	void BuildIslands();
+	/// <summary>
+	/// [coloredBegin, 接触数) の接触を，同じボールに触れる接触が同じ色にならないように塗り分けて色順に並べる
+	/// </summary>
+	void ColorContacts();
+	void SolveIsland(uint32_t _island);
+	void SolveColoredContacts();
+	/// <summary>
+	/// 接触を順に1回ずつ解く
+	/// </summary>
+	void SolveContacts(BallContact* _begin, BallContact* _end);
+	void IntegratePositions(float _deltaTime);
+	void StepPendulums(float _deltaTime);
+	/// <summary>
+	/// [0, _count) をkChunkSizeずつに分けて実行する
+	/// </summary>
+	template <class Func>
+	void ForEachChunk(uint32_t _count, const Func& _func);
+
+	ThreadPool* threadPool;
+	PhysicsSettings settings;
+
+	BallPool balls;
+	SpringPool springs;
+	PendulumPool pendulums;
+	ConicalPendulumPool conicalPendulums;
+	std::vector<Plane> planes;
+
+	SpatialHashGrid grid;		//ボール同士の接触探索用
+	float maxRadius;
+	std::vector<float> reaches;		//ボールごとの1ステップの移動量
+
+	std::vector<BallPair> pairs;						//接触しうるボールの組 (Verletリスト)
+	std::vector<std::vector<BallPair>> chunkPairs;		//チャンクごとの探索結果
+	std::vector<std::vector<uint32_t>> chunkKeys;		//チャンクごとの速いボールの探索用
+	std::vector<Vector3> pairPositions;					//組を作ったときの位置
+	std::vector<float> pairReaches;						//組を作ったときの移動量
+	std::vector<uint8_t> chunkExpired;					//チャンクごとの組を作り直すかどうか
+	float pairSkin;										//組を作るときに足した余裕
+	bool arePairsDirty;									//ボールが増えたなどで作り直す
+
+	std::vector<BallContact> contacts;					//アイランド順
+	std::vector<std::vector<BallContact>> chunkContacts;	//チャンクごとの平面との接触
+	std::vector<std::vector<BallContact>> chunkPairContacts;	//チャンクごとのボール同士の接触
+	std::vector<uint32_t> islandParents;				//union-find
+	std::vector<uint32_t> islandIndices;				//根のボールごとのアイランド番号
+	std::vector<uint32_t> islandOffsets;				//アイランドごとの並べ替え先
+	std::vector<uint32_t> contactKeys;					//接触ごとのアイランド番号または色
+	std::vector<uint32_t> islandStarts;					//塗り分けないアイランドごとの接触の開始位置
+	uint32_t islandCount;
+	uint32_t coloredBegin;								//塗り分ける接触の開始位置
+	std::vector<uint32_t> ballColors;					//ボールごとの使った色のビット
+	std::vector<uint32_t> colorStarts;					//色ごとの接触の開始位置
+	uint32_t colorCount;
+	std::vector<BallContact> sortedContacts;
+};
+
+//振り子のおもりの位置 (z=0の平面で揺れる)
+Vector3 CalculatePendulumPosition(const Pendulum& _pendulum);
+
+//円錐振り子のおもりの位置
+Vector3 CalculatePendulumPosition(const ConicalPendulum& _pendulum);
@@ -0,0 +1,150 @@
+#include "RadixSort.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const uint32_t kRadixBits = 8;
+	const uint32_t kBucketCount = 1u << kRadixBits;
+	//これより少ない要素数のチャンクには分けない
+	const uint32_t kMinChunkSize = 16384;
+
+	/// <summary>
+	/// キーの幅だけパスを回すLSD基数ソート
+	/// </summary>
+	template <class Key>
+	void SortByRadix(Key* _keys, uint32_t* _values, Key* _keysTemp, uint32_t* _valuesTemp, std::vector<uint32_t>& _histograms, uint32_t _count, ThreadPool* _threadPool)
+	{
+		const uint32_t kPassCount = sizeof(Key) * 8 / kRadixBits;
+		if (_count < 2)
+		{
+			return;
+		}
+
+		uint32_t chunkCount = 1;
+		if (_threadPool != nullptr)
+		{
+			chunkCount = std::clamp(_count / kMinChunkSize, 1u, _threadPool->GetThreadCount());
+		}
+		const uint32_t chunkSize = (_count + chunkCount - 1) / chunkCount;
+
+		//チャンクごとのヒストグラム → 書き込み開始位置 毎フレーム呼ばれるので呼び出し側のものを使い回す
+		if (_histograms.size() < chunkCount * kBucketCount)
+		{
+			_histograms.resize(chunkCount * kBucketCount);
+		}
+		uint32_t* histograms = _histograms.data();
+
+		auto runChunks = [&](const auto& _func)
+			{
+				if (chunkCount == 1)
+				{
+					_func(0u);
+					return;
+				}
+				_threadPool->ParallelFor(chunkCount, _func);
+			};
+
+		Key* srcKeys = _keys;
+		uint32_t* srcValues = _values;
+		Key* dstKeys = _keysTemp;
+		uint32_t* dstValues = _valuesTemp;
+
+		for (uint32_t pass = 0; pass < kPassCount; pass++)
+		{
+			const uint32_t shift = pass * kRadixBits;
+
+			//ヒストグラム
+			runChunks([&](uint32_t _chunk)
+				{
+					uint32_t* histogram = &histograms[_chunk * kBucketCount];
+					std::fill(histogram, histogram + kBucketCount, 0u);
+					uint32_t begin = _chunk * chunkSize;
+					uint32_t end = (std::min)(begin + chunkSize, _count);
+					for (uint32_t index = begin; index < end; index++)
+					{
+						histogram[(srcKeys[index] >> shift) & (kBucketCount - 1)]++;
+					}
+				});
+
+			//全要素が同じ桁ならこのパスは並びが変わらない
+			bool isTrivial = false;
+			for (uint32_t bucket = 0; bucket < kBucketCount; bucket++)
+			{
+				uint32_t total = 0;
+				for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+				{
+					total += histograms[chunk * kBucketCount + bucket];
+				}
+				if (total != 0)
+				{
+					isTrivial = total == _count;
+					break;
+				}
+			}
+			if (isTrivial)
+			{
+				continue;
+			}
+
+			//バケット順 → チャンク順に並べたexclusive scan
+			uint32_t sum = 0;
+			for (uint32_t bucket = 0; bucket < kBucketCount; bucket++)
+			{
+				for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+				{
+					uint32_t& offset = histograms[chunk * kBucketCount + bucket];
+					uint32_t count = offset;
+					offset = sum;
+					sum += count;
+				}
+			}
+
+			//書き込み
+			runChunks([&](uint32_t _chunk)
+				{
+					uint32_t* offsets = &histograms[_chunk * kBucketCount];
+					uint32_t begin = _chunk * chunkSize;
+					uint32_t end = (std::min)(begin + chunkSize, _count);
+					for (uint32_t index = begin; index < end; index++)
+					{
+						Key key = srcKeys[index];
+						uint32_t destination = offsets[(key >> shift) & (kBucketCount - 1)]++;
+						dstKeys[destination] = key;
+						dstValues[destination] = srcValues[index];
+					}
+				});
+
+			std::swap(srcKeys, dstKeys);
+			std::swap(srcValues, dstValues);
+		}
+
+		//飛ばしたパスがあると作業用バッファ側に結果が残る
+		if (srcKeys != _keys)
+		{
+			std::memcpy(_keys, srcKeys, sizeof(Key) * _count);
+			std::memcpy(_values, srcValues, sizeof(uint32_t) * _count);
+		}
+	}
+}
+
+uint32_t FloatToSortableKey(float _value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &_value, sizeof(bits));
+	//負数は全ビット反転，正数は符号ビットだけ反転
+	uint32_t mask = (bits & 0x80000000u) ? 0xffffffffu : 0x80000000u;
+	return bits ^ mask;
+}
+
+void RadixSort(uint32_t* _keys, uint32_t* _values, uint32_t* _keysTemp, uint32_t* _valuesTemp, std::vector<uint32_t>& _histograms, uint32_t _count, ThreadPool* _threadPool)
+{
+	SortByRadix(_keys, _values, _keysTemp, _valuesTemp, _histograms, _count, _threadPool);
+}
+
+void RadixSort(uint64_t* _keys, uint32_t* _values, uint64_t* _keysTemp, uint32_t* _valuesTemp, std::vector<uint32_t>& _histograms, uint32_t _count, ThreadPool* _threadPool)
+{
+	SortByRadix(_keys, _values, _keysTemp, _valuesTemp, _histograms, _count, _threadPool);
+}
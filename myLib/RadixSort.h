@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/// <summary>
+/// 32bitキーのLSD基数ソート (8bit x 4パス，安定)
+/// 全要素で同じ桁になるパスは飛ばす
+/// </summary>
+/// <param name="_keys">キー 結果もここに入る</param>
+/// <param name="_values">キーに対応する値 結果もここに入る</param>
+/// <param name="_keysTemp">作業用 _count要素</param>
+/// <param name="_valuesTemp">作業用 _count要素</param>
+/// <param name="_histograms">作業用のヒストグラム 足りなければ広げるので，呼び出し側で持ち回せば毎回確保しない</param>
+/// <param name="_count">要素数</param>
+/// <param name="_threadPool">並列化に使うスレッドプール nullptrなら単一スレッド</param>
+void RadixSort(uint32_t* _keys, uint32_t* _values, uint32_t* _keysTemp, uint32_t* _valuesTemp, std::vector<uint32_t>& _histograms, uint32_t _count, ThreadPool* _threadPool);
+
+/// <summary>
+/// 64bitキーのLSD基数ソート (8bit x 8パス，安定)
+/// 描画のソートキーのように使われていない桁が多いキーでは飛ばせるパスが多い
+/// </summary>
+void RadixSort(uint64_t* _keys, uint32_t* _values, uint64_t* _keysTemp, uint32_t* _valuesTemp, std::vector<uint32_t>& _histograms, uint32_t _count, ThreadPool* _threadPool);
+
+/// <summary>
+/// floatを大小関係を保ったままuint32_tに変換する
+/// </summary>
+uint32_t FloatToSortableKey(float _value);
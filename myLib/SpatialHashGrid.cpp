@@ -0,0 +1,200 @@
+#include "SpatialHashGrid.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+SpatialHashGrid::SpatialHashGrid(float _cellSize, uint32_t _tableSize)
+{
+	assert(_cellSize > 0.0f);
+	cellSize = _cellSize;
+	inverseCellSize = 1.0f / _cellSize;
+
+	uint32_t tableSize = 1;
+	while (tableSize < _tableSize)
+	{
+		tableSize <<= 1;
+	}
+	tableMask = tableSize - 1;
+	cellStarts.assign(tableSize + 1, 0);
+}
+
+void SpatialHashGrid::BuildPoints(const Vector3* _positions, uint32_t _count, ThreadPool* _threadPool)
+{
+	keys.resize(_count);
+	elements.resize(_count);
+	positions.assign(_positions, _positions + _count);
+
+	auto computeKeys = [&](uint32_t _begin, uint32_t _end)
+		{
+			for (uint32_t index = _begin; index < _end; index++)
+			{
+				keys[index] = CalculateKey(CalculateCell(_positions[index]));
+				elements[index] = index;
+			}
+		};
+
+	const uint32_t kChunkSize = 4096;
+	uint32_t chunkCount = (_count + kChunkSize - 1) / kChunkSize;
+	if (_threadPool != nullptr && 1 < chunkCount)
+	{
+		_threadPool->ParallelFor(chunkCount, [&](uint32_t _chunk)
+			{
+				computeKeys(_chunk * kChunkSize, (std::min)((_chunk + 1) * kChunkSize, _count));
+			});
+	}
+	else
+	{
+		computeKeys(0, _count);
+	}
+
+	SortByKey();
+}
+
+void SpatialHashGrid::BuildBounds(const AABB* _bounds, uint32_t _count)
+{
+	keys.clear();
+	elements.clear();
+	positions.clear();
+
+	std::vector<uint32_t> elementKeys;
+	for (uint32_t element = 0; element < _count; element++)
+	{
+		Cell minCell = CalculateCell(_bounds[element].min);
+		Cell maxCell = CalculateCell(_bounds[element].max);
+		Vector3 center = (_bounds[element].min + _bounds[element].max) * 0.5f;
+
+		elementKeys.clear();
+		for (int32_t z = minCell.z; z <= maxCell.z; z++)
+		{
+			for (int32_t y = minCell.y; y <= maxCell.y; y++)
+			{
+				for (int32_t x = minCell.x; x <= maxCell.x; x++)
+				{
+					elementKeys.push_back(CalculateKey({ x, y, z }));
+				}
+			}
+		}
+		//別のセルが同じキーになると二重に入るので取り除く
+		std::sort(elementKeys.begin(), elementKeys.end());
+		elementKeys.erase(std::unique(elementKeys.begin(), elementKeys.end()), elementKeys.end());
+
+		for (uint32_t key : elementKeys)
+		{
+			keys.push_back(key);
+			elements.push_back(element);
+			positions.push_back(center);
+		}
+	}
+
+	SortByKey();
+}
+
+SpatialHashGrid::Cell SpatialHashGrid::CalculateCell(const Vector3& _point) const
+{
+	return {
+		static_cast<int32_t>(std::floor(_point.x * inverseCellSize)),
+		static_cast<int32_t>(std::floor(_point.y * inverseCellSize)),
+		static_cast<int32_t>(std::floor(_point.z * inverseCellSize))
+	};
+}
+
+uint32_t SpatialHashGrid::CalculateKey(const Cell& _cell) const
+{
+	uint32_t hash = (static_cast<uint32_t>(_cell.x) * 73856093u) ^
+		(static_cast<uint32_t>(_cell.y) * 19349663u) ^
+		(static_cast<uint32_t>(_cell.z) * 83492791u);
+	return hash & tableMask;
+}
+
+uint32_t SpatialHashGrid::CollectKeys(const Sphere& _sphere, uint32_t* _keys) const
+{
+	Vector3 radius = { _sphere.radius, _sphere.radius, _sphere.radius };
+	Cell minCell = CalculateCell(_sphere.center - radius);
+	Cell maxCell = CalculateCell(_sphere.center + radius);
+	//半径はセルの大きさ以下で使う
+	assert(maxCell.x - minCell.x < 3 && maxCell.y - minCell.y < 3 && maxCell.z - minCell.z < 3);
+
+	uint32_t keyCount = 0;
+	for (int32_t z = minCell.z; z <= maxCell.z; z++)
+	{
+		for (int32_t y = minCell.y; y <= maxCell.y; y++)
+		{
+			for (int32_t x = minCell.x; x <= maxCell.x; x++)
+			{
+				uint32_t key = CalculateKey({ x, y, z });
+				if (std::find(_keys, _keys + keyCount, key) == _keys + keyCount)
+				{
+					_keys[keyCount++] = key;
+				}
+			}
+		}
+	}
+	return keyCount;
+}
+
+void SpatialHashGrid::CollectKeys(const Sphere& _sphere, std::vector<uint32_t>& _keys) const
+{
+	Vector3 radius = { _sphere.radius, _sphere.radius, _sphere.radius };
+	Cell minCell = CalculateCell(_sphere.center - radius);
+	Cell maxCell = CalculateCell(_sphere.center + radius);
+
+	_keys.clear();
+	uint64_t cellCount = static_cast<uint64_t>(maxCell.x - minCell.x + 1) * (maxCell.y - minCell.y + 1) * (maxCell.z - minCell.z + 1);
+	if (tableMask < cellCount)
+	{
+		//セルを数え上げるより表全体を調べる方が速い
+		for (uint32_t key = 0; key <= tableMask; key++)
+		{
+			_keys.push_back(key);
+		}
+		return;
+	}
+
+	for (int32_t z = minCell.z; z <= maxCell.z; z++)
+	{
+		for (int32_t y = minCell.y; y <= maxCell.y; y++)
+		{
+			for (int32_t x = minCell.x; x <= maxCell.x; x++)
+			{
+				_keys.push_back(CalculateKey({ x, y, z }));
+			}
+		}
+	}
+	//別のセルが同じキーになると二重に数えるので取り除く
+	std::sort(_keys.begin(), _keys.end());
+	_keys.erase(std::unique(_keys.begin(), _keys.end()), _keys.end());
+}
+
+void SpatialHashGrid::SortByKey()
+{
+	const uint32_t count = static_cast<uint32_t>(keys.size());
+
+	//キーごとの数
+	std::fill(cellStarts.begin(), cellStarts.end(), 0u);
+	for (uint32_t index = 0; index < count; index++)
+	{
+		cellStarts[keys[index] + 1]++;
+	}
+	//累積して開始位置にする
+	for (size_t key = 1; key < cellStarts.size(); key++)
+	{
+		cellStarts[key] += cellStarts[key - 1];
+	}
+
+	sortedElements.resize(count);
+	sortedPositions.resize(count);
+	//cellStartsを書き込み位置として進める 終わると各キーの終了位置になっている
+	for (uint32_t index = 0; index < count; index++)
+	{
+		uint32_t destination = cellStarts[keys[index]]++;
+		sortedElements[destination] = elements[index];
+		sortedPositions[destination] = positions[index];
+	}
+	//1つずらして開始位置に戻す
+	for (size_t key = cellStarts.size() - 1; key > 0; key--)
+	{
+		cellStarts[key] = cellStarts[key - 1];
+	}
+	cellStarts[0] = 0;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "MyLib.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/// <summary>
+/// 一様グリッドのハッシュ表
+/// 毎フレーム (セルキー, 要素番号) を計数ソートで並べ直して構築する
+/// 同じセルの要素はメモリ上で連続するので近傍探索がキャッシュに乗りやすい
+/// </summary>
+class SpatialHashGrid
+{
+public:
+	/// <param name="_cellSize">セルの一辺の長さ</param>
+	/// <param name="_tableSize">ハッシュ表の大きさ 2の累乗に切り上げる</param>
+	SpatialHashGrid(float _cellSize, uint32_t _tableSize);
+
+	/// <summary>
+	/// 点の集合から構築する 各点はそれを含む1セルにだけ入る
+	/// </summary>
+	/// <param name="_positions">点の配列</param>
+	/// <param name="_count">点の数</param>
+	/// <param name="_threadPool">キー計算の並列化に使う nullptrなら単一スレッド</param>
+	void BuildPoints(const Vector3* _positions, uint32_t _count, ThreadPool* _threadPool);
+
+	/// <summary>
+	/// AABBの集合から構築する 各AABBは重なるすべてのセルに入る
+	/// </summary>
+	void BuildBounds(const AABB* _bounds, uint32_t _count);
+
+	/// <summary>
+	/// 点を含むセルに入っている要素を列挙する
+	/// </summary>
+	/// <param name="_point">点</param>
+	/// <param name="_func">void(uint32_t element)</param>
+	template <class Func>
+	void ForEachInCell(const Vector3& _point, const Func& _func) const
+	{
+		uint32_t key = CalculateKey(CalculateCell(_point));
+		for (uint32_t index = cellStarts[key]; index < cellStarts[key + 1]; index++)
+		{
+			_func(sortedElements[index]);
+		}
+	}
+
+	/// <summary>
+	/// 球に重なるセルに入っている要素を列挙する (BuildBoundsで作ったときの座標はAABBの中心)
+	/// 距離の判定は呼び出し側で行う
+	/// </summary>
+	/// <param name="_sphere">探索範囲</param>
+	/// <param name="_func">void(uint32_t element, const Vector3& position)</param>
+	template <class Func>
+	void ForEachNeighbor(const Sphere& _sphere, const Func& _func) const
+	{
+		uint32_t keys[kMaxQueryCells];
+		uint32_t keyCount = CollectKeys(_sphere, keys);
+		for (uint32_t keyIndex = 0; keyIndex < keyCount; keyIndex++)
+		{
+			uint32_t key = keys[keyIndex];
+			for (uint32_t index = cellStarts[key]; index < cellStarts[key + 1]; index++)
+			{
+				_func(sortedElements[index], sortedPositions[index]);
+			}
+		}
+	}
+
+	/// <summary>
+	/// ForEachNeighborと同じだが，球がセルより大きくてもよい 調べるセルが多いぶん遅い
+	/// </summary>
+	/// <param name="_sphere">探索範囲</param>
+	/// <param name="_keys">キーを集める作業用</param>
+	/// <param name="_func">void(uint32_t element, const Vector3& position)</param>
+	template <class Func>
+	void ForEachNeighborInRange(const Sphere& _sphere, std::vector<uint32_t>& _keys, const Func& _func) const
+	{
+		CollectKeys(_sphere, _keys);
+		for (uint32_t key : _keys)
+		{
+			for (uint32_t index = cellStarts[key]; index < cellStarts[key + 1]; index++)
+			{
+				_func(sortedElements[index], sortedPositions[index]);
+			}
+		}
+	}
+
+	float GetCellSize() const { return cellSize; }
+	uint32_t GetTableSize() const { return tableMask + 1; }
+	uint32_t GetElementCount() const { return static_cast<uint32_t>(sortedElements.size()); }
+	/// <summary>
+	/// セルキー順に並んだ要素番号
+	/// </summary>
+	const std::vector<uint32_t>& GetSortedElements() const { return sortedElements; }
+
+private:
+	//ForEachNeighborで調べるセル数の上限 (半径がセルの大きさ以下なら3x3x3)
+	static const uint32_t kMaxQueryCells = 27;
+
+	struct Cell
+	{
+		int32_t x, y, z;
+	};
+
+	Cell CalculateCell(const Vector3& _point) const;
+	uint32_t CalculateKey(const Cell& _cell) const;
+	/// <summary>
+	/// 球に重なるセルのキーを重複なく集める
+	/// </summary>
+	uint32_t CollectKeys(const Sphere& _sphere, uint32_t* _keys) const;
+	/// <summary>
+	/// 球に重なるセルのキーを重複なく集める セルが表の大きさ以上ならすべてのキーを返す
+	/// </summary>
+	void CollectKeys(const Sphere& _sphere, std::vector<uint32_t>& _keys) const;
+	/// <summary>
+	/// keys/elementsを計数ソートしてcellStarts/sortedElementsを作る
+	/// </summary>
+	void SortByKey();
+
+	float cellSize;
+	float inverseCellSize;
+	uint32_t tableMask;
+
+	std::vector<uint32_t> keys;				//要素ごとのセルキー (ソート前)
+	std::vector<uint32_t> elements;			//要素番号 (ソート前)
+	std::vector<Vector3> positions;			//点の座標 (ソート前)
+	std::vector<uint32_t> cellStarts;		//キーごとの開始位置 tableSize+1要素
+	std::vector<uint32_t> sortedElements;	//キー順の要素番号
+	std::vector<Vector3> sortedPositions;	//キー順の座標
+};
@@ -0,0 +1,236 @@
+#include "SweepAndPrune.h"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <utility>
+
+namespace
+{
+	float GetAxis(const Vector3& _v, uint32_t _axis)
+	{
+		return _axis == 0 ? _v.x : (_axis == 1 ? _v.y : _v.z);
+	}
+}
+
+uint32_t SweepAndPrune::AddProxy(const AABB& _bounds, uint32_t _group, uint32_t _userIndex)
+{
+	uint32_t proxy;
+	if (!freeList.empty())
+	{
+		proxy = freeList.back();
+		freeList.pop_back();
+	}
+	else
+	{
+		proxy = static_cast<uint32_t>(bounds.size());
+		bounds.emplace_back();
+		groups.emplace_back();
+		userIndices.emplace_back();
+		isActive.emplace_back(uint8_t(0));
+	}
+
+	bounds[proxy] = _bounds;
+	groups[proxy] = _group;
+	userIndices[proxy] = _userIndex;
+	isActive[proxy] = 1;
+
+	//末尾に置くと，挿入ソートで左へ動くときに重なりの開始・終了がそろって記録される
+	for (std::vector<Endpoint>& axisEndpoints : endpoints)
+	{
+		axisEndpoints.push_back({ 0.0f, proxy, false });
+		axisEndpoints.push_back({ 0.0f, proxy, true });
+	}
+	addedProxyCount++;
+	return proxy;
+}
+
+void SweepAndPrune::RemoveProxy(uint32_t _proxy)
+{
+	assert(_proxy < isActive.size() && isActive[_proxy]);
+	isActive[_proxy] = 0;
+	pendingFreeList.push_back(_proxy);
+
+	for (std::vector<Endpoint>& axisEndpoints : endpoints)
+	{
+		std::erase_if(axisEndpoints, [_proxy](const Endpoint& _endpoint) { return _endpoint.proxy == _proxy; });
+	}
+	std::erase_if(overlaps, [_proxy](uint64_t _key)
+		{
+			return static_cast<uint32_t>(_key >> 32) == _proxy || static_cast<uint32_t>(_key) == _proxy;
+		});
+}
+
+void SweepAndPrune::Update()
+{
+	//まとめて追加されたときは挿入ソートだとO(N^2)になるので作り直す
+	if (kRebuildThreshold < addedProxyCount)
+	{
+		RebuildEndpoints();
+	}
+	else
+	{
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			SortEndpoints(axis);
+		}
+	}
+	addedProxyCount = 0;
+
+	pairs.clear();
+	for (uint64_t key : overlaps)
+	{
+		pairs.push_back(MakePair(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key)));
+	}
+	auto isLess = [this](const ProxyPair& _a, const ProxyPair& _b) { return IsLess(_a, _b); };
+	std::sort(pairs.begin(), pairs.end(), isLess);
+
+	addedPairs.clear();
+	removedPairs.clear();
+	std::set_difference(pairs.begin(), pairs.end(), previousPairs.begin(), previousPairs.end(), std::back_inserter(addedPairs), isLess);
+	std::set_difference(previousPairs.begin(), previousPairs.end(), pairs.begin(), pairs.end(), std::back_inserter(removedPairs), isLess);
+	previousPairs = pairs;
+
+	//前回の組との比較が済んだので削除した番号を再利用してよい
+	freeList.insert(freeList.end(), pendingFreeList.begin(), pendingFreeList.end());
+	pendingFreeList.clear();
+}
+
+std::span<const ProxyPair> SweepAndPrune::GetPairs(uint32_t _groupA, uint32_t _groupB) const
+{
+	assert(_groupA <= _groupB);
+	//pairsはグループの組み合わせ順に並んでいる
+	auto groupPair = [this](const ProxyPair& _pair) { return std::pair{ groups[_pair.proxyA], groups[_pair.proxyB] }; };
+	const std::pair key{ _groupA, _groupB };
+	auto first = std::partition_point(pairs.begin(), pairs.end(), [&](const ProxyPair& _pair) { return groupPair(_pair) < key; });
+	auto last = std::partition_point(first, pairs.end(), [&](const ProxyPair& _pair) { return groupPair(_pair) == key; });
+	return { first, last };
+}
+
+uint64_t SweepAndPrune::MakePairKey(uint32_t _a, uint32_t _b)
+{
+	if (_b < _a)
+	{
+		std::swap(_a, _b);
+	}
+	return (uint64_t(_a) << 32) | _b;
+}
+
+ProxyPair SweepAndPrune::MakePair(uint32_t _a, uint32_t _b) const
+{
+	if (groups[_b] < groups[_a] || (groups[_a] == groups[_b] && _b < _a))
+	{
+		return { _b, _a };
+	}
+	return { _a, _b };
+}
+
+bool SweepAndPrune::IsLess(const ProxyPair& _a, const ProxyPair& _b) const
+{
+	if (groups[_a.proxyA] != groups[_b.proxyA])
+	{
+		return groups[_a.proxyA] < groups[_b.proxyA];
+	}
+	if (groups[_a.proxyB] != groups[_b.proxyB])
+	{
+		return groups[_a.proxyB] < groups[_b.proxyB];
+	}
+	if (_a.proxyA != _b.proxyA)
+	{
+		return _a.proxyA < _b.proxyA;
+	}
+	return _a.proxyB < _b.proxyB;
+}
+
+bool SweepAndPrune::IsBefore(const Endpoint& _a, const Endpoint& _b)
+{
+	if (_a.value != _b.value)
+	{
+		return _a.value < _b.value;
+	}
+	if (_a.isMax != _b.isMax)
+	{
+		return !_a.isMax;
+	}
+	return _a.proxy < _b.proxy;
+}
+
+bool SweepAndPrune::IsOverlapOtherAxes(uint32_t _a, uint32_t _b, uint32_t _axis) const
+{
+	const AABB& a = bounds[_a];
+	const AABB& b = bounds[_b];
+	bool overlapX = _axis == 0 || (a.min.x <= b.max.x && b.min.x <= a.max.x);
+	bool overlapY = _axis == 1 || (a.min.y <= b.max.y && b.min.y <= a.max.y);
+	bool overlapZ = _axis == 2 || (a.min.z <= b.max.z && b.min.z <= a.max.z);
+	return overlapX && overlapY && overlapZ;
+}
+
+void SweepAndPrune::SortEndpoints(uint32_t _axis)
+{
+	std::vector<Endpoint>& axisEndpoints = endpoints[_axis];
+	for (Endpoint& endpoint : axisEndpoints)
+	{
+		const AABB& proxyBounds = bounds[endpoint.proxy];
+		endpoint.value = GetAxis(endpoint.isMax ? proxyBounds.max : proxyBounds.min, _axis);
+	}
+
+	//挿入ソート 端点が入れ替わるときだけ重なりが変わりうる
+	//他の軸は並べ直す前でも更新後のAABBで調べるので，どの軸の入れ替わりで調べても結果は同じになる
+	for (size_t index = 1; index < axisEndpoints.size(); index++)
+	{
+		Endpoint endpoint = axisEndpoints[index];
+		size_t position = index;
+		while (0 < position && IsBefore(endpoint, axisEndpoints[position - 1]))
+		{
+			const Endpoint& passed = axisEndpoints[position - 1];
+			if (!endpoint.isMax && passed.isMax)
+			{
+				//始点が相手の終点より前に来た
+				if (IsOverlapOtherAxes(endpoint.proxy, passed.proxy, _axis))
+				{
+					overlaps.insert(MakePairKey(endpoint.proxy, passed.proxy));
+				}
+			}
+			else if (endpoint.isMax && !passed.isMax)
+			{
+				//終点が相手の始点より前に来た
+				overlaps.erase(MakePairKey(endpoint.proxy, passed.proxy));
+			}
+			axisEndpoints[position] = passed;
+			position--;
+		}
+		axisEndpoints[position] = endpoint;
+	}
+}
+
+void SweepAndPrune::RebuildEndpoints()
+{
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		for (Endpoint& endpoint : endpoints[axis])
+		{
+			const AABB& proxyBounds = bounds[endpoint.proxy];
+			endpoint.value = GetAxis(endpoint.isMax ? proxyBounds.max : proxyBounds.min, axis);
+		}
+		std::sort(endpoints[axis].begin(), endpoints[axis].end(), IsBefore);
+	}
+
+	//x軸の始点から終点までの間に始まったプロキシのうち，y,z軸でも重なるもの
+	overlaps.clear();
+	std::vector<uint32_t> active;
+	for (const Endpoint& endpoint : endpoints[0])
+	{
+		if (endpoint.isMax)
+		{
+			std::erase(active, endpoint.proxy);
+			continue;
+		}
+		for (uint32_t proxy : active)
+		{
+			if (IsOverlapOtherAxes(endpoint.proxy, proxy, 0))
+			{
+				overlaps.insert(MakePairKey(endpoint.proxy, proxy));
+			}
+		}
+		active.push_back(endpoint.proxy);
+	}
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include "MyLib.h"
+#include "GJK.h"
+#include <cstdint>
+#include <span>
+#include <unordered_set>
+#include <vector>
+
+/// <summary>
+/// AABBが重なっているプロキシの組
+/// proxyAのグループ番号はproxyB以下 (同じグループならproxyAの番号が小さい)
+/// </summary>
+struct ProxyPair
+{
+	uint32_t proxyA;
+	uint32_t proxyB;
+};
+
+/// <summary>
+/// 逐次ソートによるスイープ&プルーン (ブロードフェーズ)
+/// 3軸それぞれの端点の並びをフレーム間で保持し，挿入ソートで並べ直す
+/// 物体はフレーム間で少ししか動かないので並べ直しはほぼO(N)で済む
+/// 端点が入れ替わったときに残りの2軸も調べるので，重なっている組だけを保持すればよい
+/// </summary>
+class SweepAndPrune
+{
+public:
+	/// <summary>
+	/// プロキシを登録する
+	/// </summary>
+	/// <param name="_bounds">AABB</param>
+	/// <param name="_group">形状の種類などの分類 同じ組み合わせの組をまとめて判定するのに使う</param>
+	/// <param name="_userIndex">形状配列の添字など 自由に使ってよい</param>
+	/// <returns>プロキシ番号</returns>
+	uint32_t AddProxy(const AABB& _bounds, uint32_t _group, uint32_t _userIndex);
+	/// <summary>
+	/// プロキシを削除する 番号は次のUpdateが終わるまで再利用しない
+	/// </summary>
+	void RemoveProxy(uint32_t _proxy);
+	void SetBounds(uint32_t _proxy, const AABB& _bounds) { bounds[_proxy] = _bounds; }
+
+	/// <summary>
+	/// 端点を並べ直し，重なっている組を更新する
+	/// </summary>
+	void Update();
+
+	/// <summary>
+	/// 重なっているすべての組 (グループの組み合わせ順)
+	/// </summary>
+	const std::vector<ProxyPair>& GetPairs() const { return pairs; }
+	/// <summary>
+	/// 指定したグループの組み合わせの組 _groupA <= _groupB
+	/// </summary>
+	std::span<const ProxyPair> GetPairs(uint32_t _groupA, uint32_t _groupB) const;
+	/// <summary>
+	/// 前回のUpdateから重なり始めた組
+	/// </summary>
+	const std::vector<ProxyPair>& GetAddedPairs() const { return addedPairs; }
+	/// <summary>
+	/// 前回のUpdateから離れた組 (削除されたプロキシの組も含む)
+	/// </summary>
+	const std::vector<ProxyPair>& GetRemovedPairs() const { return removedPairs; }
+
+	uint32_t GetGroup(uint32_t _proxy) const { return groups[_proxy]; }
+	uint32_t GetUserIndex(uint32_t _proxy) const { return userIndices[_proxy]; }
+
+private:
+	struct Endpoint
+	{
+		float value;
+		uint32_t proxy;
+		bool isMax;
+	};
+
+	//前回のUpdateからこれより多く追加されたら端点を並べ直さずに作り直す
+	static const uint32_t kRebuildThreshold = 64;
+
+	static uint64_t MakePairKey(uint32_t _a, uint32_t _b);
+	/// <summary>
+	/// 端点の並び順 値が同じなら始点を先にし (接しているAABBも重なりとして扱う)，さらにプロキシ番号で決める
+	/// </summary>
+	static bool IsBefore(const Endpoint& _a, const Endpoint& _b);
+	/// <summary>
+	/// グループ順に向きをそろえた組を作る
+	/// </summary>
+	ProxyPair MakePair(uint32_t _a, uint32_t _b) const;
+	bool IsLess(const ProxyPair& _a, const ProxyPair& _b) const;
+	/// <summary>
+	/// 挿入ソートで並べ直し，入れ替わった端点から重なりを更新する
+	/// </summary>
+	void SortEndpoints(uint32_t _axis);
+	/// <summary>
+	/// 端点をソートし直し，重なりを一から求める
+	/// </summary>
+	void RebuildEndpoints();
+	/// <summary>
+	/// _axis以外の2軸で重なっているか
+	/// </summary>
+	bool IsOverlapOtherAxes(uint32_t _a, uint32_t _b, uint32_t _axis) const;
+
+	//プロキシのSoA
+	std::vector<AABB> bounds;
+	std::vector<uint32_t> groups;
+	std::vector<uint32_t> userIndices;
+	std::vector<uint8_t> isActive;
+	std::vector<uint32_t> freeList;
+	std::vector<uint32_t> pendingFreeList;	//次のUpdateの後でfreeListへ移す
+
+	std::vector<Endpoint> endpoints[3];		//軸ごとの端点 値の昇順
+	std::unordered_set<uint64_t> overlaps;	//AABBが重なっている組
+	uint32_t addedProxyCount = 0;			//前回のUpdateから追加された数
+
+	std::vector<ProxyPair> pairs;
+	std::vector<ProxyPair> previousPairs;
+	std::vector<ProxyPair> addedPairs;
+	std::vector<ProxyPair> removedPairs;
+};
+
+/// <summary>
+/// 引数の順番を気にせず既存のIsCollisionを呼ぶ
+/// 専用のIsCollisionがない組み合わせはGJKで判定する
+/// </summary>
+template <class ShapeA, class ShapeB>
+bool IsCollisionAnyOrder(const ShapeA& _a, const ShapeB& _b)
+{
+	if constexpr (requires { IsCollision(_a, _b); })
+	{
+		return IsCollision(_a, _b);
+	}
+	else if constexpr (requires { IsCollision(_b, _a); })
+	{
+		return IsCollision(_b, _a);
+	}
+	else
+	{
+		return IsCollisionGJK(_a, _b);
+	}
+}
+
+/// <summary>
+/// 指定したグループの組み合わせの組をまとめて詳細判定する
+/// 組ごとに形状の種類を調べる分岐や仮想関数呼び出しをしないで済む
+/// </summary>
+/// <param name="_shapesA">_groupAのプロキシのユーザー番号で引ける形状の配列 (Sphere, AABB, OBB など)</param>
+/// <param name="_shapesB">_groupBのプロキシのユーザー番号で引ける形状の配列</param>
+/// <param name="_func">void(const ProxyPair&) 衝突していた組ごとに呼ぶ</param>
+template <class ShapeA, class ShapeB, class Func>
+void CollidePairs(const SweepAndPrune& _broadPhase, uint32_t _groupA, const ShapeA* _shapesA, uint32_t _groupB, const ShapeB* _shapesB, const Func& _func)
+{
+	for (const ProxyPair& pair : _broadPhase.GetPairs(_groupA, _groupB))
+	{
+		if (IsCollisionAnyOrder(_shapesA[_broadPhase.GetUserIndex(pair.proxyA)], _shapesB[_broadPhase.GetUserIndex(pair.proxyB)]))
+		{
+			_func(pair);
+		}
+	}
+}
@@ -0,0 +1,132 @@
+#include "ThreadPool.h"
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+namespace
+{
+	//ParallelFor 1回分の共有状態
+	struct ParallelForJob
+	{
+		std::function<void(uint32_t)> func;
+		uint32_t count;
+		std::atomic<uint32_t> next{ 0 };		//次に処理するインデックス
+		std::atomic<uint32_t> finished{ 0 };	//処理し終わったインデックス数
+		std::mutex mutex;
+		std::condition_variable condition;
+
+		//空いているインデックスがなくなるまで処理する
+		void Drain()
+		{
+			uint32_t processed = 0;
+			for (uint32_t index = next.fetch_add(1); index < count; index = next.fetch_add(1))
+			{
+				func(index);
+				processed++;
+			}
+			if (processed != 0 && finished.fetch_add(processed) + processed == count)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				condition.notify_all();
+			}
+		}
+	};
+}
+
+ThreadPool::ThreadPool(uint32_t _workerCount)
+{
+	isStopping = false;
+	if (_workerCount == 0)
+	{
+		uint32_t hardwareCount = std::thread::hardware_concurrency();
+		_workerCount = hardwareCount > 1 ? hardwareCount - 1 : 1;
+	}
+
+	workers.reserve(_workerCount);
+	for (uint32_t index = 0; index < _workerCount; index++)
+	{
+		workers.emplace_back([this]() { WorkerMain(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+	condition.notify_all();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(uint32_t _count, const std::function<void(uint32_t)>& _func)
+{
+	if (_count == 0)
+	{
+		return;
+	}
+	//1つだけならスレッドを起こすまでもない
+	if (_count == 1 || workers.empty())
+	{
+		for (uint32_t index = 0; index < _count; index++)
+		{
+			_func(index);
+		}
+		return;
+	}
+
+	auto job = std::make_shared<ParallelForJob>();
+	job->func = _func;
+	job->count = _count;
+
+	//呼び出し元も処理するのでワーカーは_count-1まで
+	size_t helperCount = (std::min)(workers.size(), static_cast<size_t>(_count - 1));
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t index = 0; index < helperCount; index++)
+		{
+			tasks.emplace_back([job]() { job->Drain(); });
+		}
+	}
+	condition.notify_all();
+
+	job->Drain();
+
+	//他のスレッドが処理中のインデックスを待つ
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->condition.wait(lock, [&job]() { return job->finished.load() == job->count; });
+}
+
+std::future<void> ThreadPool::Submit(std::function<void()> _task)
+{
+	auto packagedTask = std::make_shared<std::packaged_task<void()>>(std::move(_task));
+	std::future<void> future = packagedTask->get_future();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.emplace_back([packagedTask]() { (*packagedTask)(); });
+	}
+	condition.notify_one();
+	return future;
+}
+
+void ThreadPool::WorkerMain()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return isStopping || !tasks.empty(); });
+			if (isStopping && tasks.empty())
+			{
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+/// <summary>
+/// ワーカースレッドの集合
+/// ParallelForは呼び出し元スレッドも処理に参加し，全インデックスの処理が終わるまで戻らない
+/// </summary>
+class ThreadPool
+{
+public:
+	/// <summary>
+	/// スレッドプールの生成
+	/// </summary>
+	/// <param name="_workerCount">ワーカースレッド数 0ならハードウェアスレッド数-1</param>
+	explicit ThreadPool(uint32_t _workerCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// <summary>
+	/// 呼び出し元を含めた並列数
+	/// </summary>
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+	/// <summary>
+	/// [0, _count) の各インデックスに対して_funcを並列に実行する
+	/// </summary>
+	/// <param name="_count">インデックス数</param>
+	/// <param name="_func">各インデックスで呼ばれる関数</param>
+	void ParallelFor(uint32_t _count, const std::function<void(uint32_t)>& _func);
+
+	/// <summary>
+	/// タスクを非同期に実行する
+	/// </summary>
+	/// <param name="_task">実行するタスク</param>
+	/// <returns>完了待ち用のfuture</returns>
+	std::future<void> Submit(std::function<void()> _task);
+
+private:
+	void WorkerMain();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool isStopping;
+};